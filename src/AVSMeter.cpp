@@ -19,10 +19,24 @@
 #include "common.h"
 #include "exception.h"
 #include "AvisynthInfo.h"
+#include "FrameServer.h"
+#include "FrameWriter.h"
+#include "Consumer.h"
+#include "TraceReplay.h"
+#include "Quality.h"
 #include "Utility.h"
 #include "SysInfo.h"
 #include "ProcessInfo.h"
 #include "GPUInfo.h"
+#include "PerfCounters.h"
+#include "CPUFreqInfo.h"
+#include "Benchmark.h"
+#include "BenchmarkServer.h"
+#include "EnergyInfo.h"
+#include "MemBench.h"
+#include "Histogram.h"
+#include "MetricsExporter.h"
+#include "SyntheticClip.h"
 #include "Timer.h"
 
 #define COLOR_DEFAULT           0
@@ -34,11 +48,14 @@
 #define REFRESH_INTERVAL              0.35  //seconds
 #define MIN_TIME_PER_FRAMEINTERVAL   20.00  //milliseconds
 #define MIN_RUNTIME                 500     //milliseconds
+#define SCALING_STEP_TIME            10     //seconds
+#define ISASWEEP_STEP_TIME           10     //seconds
 
 struct stSettings
 {
 	string    sLogDirectory;
 	string    sAVSDLL;
+	string    sVSScriptDLL;
 	BOOL      bDisplayFPS;
 	BOOL      bDisplayTPF;
 	BOOL      bCreateLog;
@@ -61,6 +78,17 @@ struct stSettings
 	BOOL      bLogFileDateTimeSuffix;
 	BOOL      bSpecifyCustomPluginDir;
 	BOOL      bLogUseFileSaveDialog;
+	BOOL      bPerfCounters;
+	BOOL      bCPUFreqInfo;
+	BOOL      bEnergyInfo;
+	BOOL      bMemBench;
+	string    sPowercapRoot;
+	string    sMetrics;
+	BOOL      bPluginCache;
+	string    sPluginCacheFile;
+	unsigned int uiPluginTestWorkers;
+	unsigned int uiPluginTestTimeout;
+	unsigned int uiVSRequests;
 } Settings;
 
 
@@ -70,13 +98,41 @@ struct stPerfData
 	float         fps_current;
 	float         fps_average;
 	double        cpu_usage;
+	double        busiest_thread;
 	BYTE          gpu_usage;
 	BYTE          vpu_usage;
 	DWORD         process_memory;
 	WORD          num_threads;
+	double        ipc;
+	double        cycles_per_pixel;
+	double        llc_misses;       //per frame
+	double        branch_misses;    //per frame
+	double        context_switches; //per frame
+	double        cpu_mhz;
+	BYTE          throttled;
+	double        power;            //watts
+	double        energy_per_frame; //joules
+	double        elapsed;          //seconds since the first GetFrame() call
+};
+
+#define STEADY_STATE_TOLERANCE 0.10  //interval frame rate within 10% of the average
+
+//Cold times come from the first load of the script in this process (the pre-scan, or the
+//benchmark run itself with -o), warm times from the benchmark run that follows a pre-scan.
+//The version probe has already loaded and released the frame server library before either,
+//so even the cold DLL load is served from the page cache.
+struct stStartupTimes
+{
+	BOOL   bCold;
+	double dDLLLoadMS;
+	double dEnvCreateMS;
+	double dImportMS;
+	double dDistributorMS;        //-1.0 if not invoked
+	double dFirstFrameMS;         //first GetFrame() call
+	double dTimeToFirstFrameMS;   //LoadLibrary() to the first frame, AVSMeter's own work included
+	double dTimeToSteadyStateMS;  //-1.0 if the frame rate did not settle
 };
 
-typedef IScriptEnvironment * __stdcall CREATE_ENV(int);
 
 static CUtils utils;
 static CTimer timer;
@@ -84,24 +140,53 @@ static CAvisynthInfo AvisynthInfo;
 static CSysInfo sys;
 
 
-unsigned int CalculateFrameInterval(string &s_avsfile, string &s_error);
+unsigned int CalculateFrameInterval(string &s_avsfile, BOOL b_avscapi, stStartupTimes &startup, string &s_error);
+void         InitStartupTimes(stStartupTimes &startup, BOOL b_cold);
+string       StartupLogText(stStartupTimes &startup);
+string       StartupJSON(stStartupTimes &startup);
 string       CreateLogFile(string &s_avsfile, string &s_logbuffer, string &s_gpuinfo, vector<stPerfData> &cs_pdata, string &s_avserror, BOOL bNVVP, BOOL bOmitstPerfData);
-string       CreateCSVFile(string &s_avsfile, vector<stPerfData> &cs_pdata, BOOL bNVVP);
+string       CreateCSVFile(string &s_avsfile, vector<stPerfData> &cs_pdata, BOOL bNVVP, double d_nominalmhz);
+string       CreateJSONFile(string &s_jsonfile, string &s_avsfile, string &s_version, stStartupTimes &coldstartup, stStartupTimes &warmstartup, string &s_runtime, string &s_avserror);
+string       JSONEscape(string s_string);
+string       JSONNumber(double d_value, int i_decimals);
 string       ParseINIFile();
 BOOL         WriteINIFile(string &s_inifile);
 void         PrintUsage();
 void         PollKeys();
 void         PrintConsole(BOOL bUseStdOut, WORD wAttributes, const char *fmt, ...);
 string       Pad(string s_line);
+int          RunScalingMode(string &s_avsfile, string &s_logbuffer);
+int          RunISASweepMode(string &s_avsfile, string &s_logbuffer);
+int          RunCompareMode(string &s_avsfile, string &s_reffile, string &s_logbuffer);
+int          RunReplayMode(string &s_avsfile, string &s_tracefile, BOOL b_avscapi, BOOL b_timing, BOOL b_threads, string &s_logbuffer);
+int          RunServerMode(string &s_pipename);
+void         ServerNotify(const string &s_message);
 
 
 
 int main(int argc, char* argv[])
 {
+	//plugin load test worker, see CAvisynthInfo::TestLoadPluginsIsolated()
+	if ((argc == 4) && (strcmp(argv[1], PLUGINTEST_WORKER_SWITCH) == 0))
+	{
+		SetErrorMode(SEM_FAILCRITICALERRORS | SEM_NOGPFAULTERRORBOX | SEM_NOOPENFILEERRORBOX);
+		return AvisynthInfo.PluginTestWorker(argv[2], atoi(argv[3]));
+	}
+
 	UINT nPrevErrorMode = SetErrorMode(SEM_FAILCRITICALERRORS);
 
 	string sINIRet = ParseINIFile();
 
+	//frames written to stdout, all console output goes to stderr
+	for (int iArg = 1; iArg < argc; iArg++)
+	{
+		string sOutputArg = argv[iArg];
+		utils.StrTrim(sOutputArg);
+		utils.StrToLC(sOutputArg);
+		if ((sOutputArg == "-y4m=-") || (sOutputArg == "-raw=-"))
+			Settings.bConUseStdOut = FALSE;
+	}
+
 	int iRet = 0;
 	string sAVSMVersion = utils.GetFileVersion("");
 	if (sAVSMVersion.length() > 5)
@@ -147,6 +232,33 @@ int main(int argc, char* argv[])
 	BOOL CLSwitches_o = FALSE;
 	BOOL CLSwitches_c = FALSE;
 	BOOL CLSwitches_lf = FALSE;
+	BOOL CLSwitches_perf = FALSE;
+	BOOL CLSwitches_cpufreq = FALSE;
+	BOOL CLSwitches_scaling = FALSE;
+	BOOL CLSwitches_isasweep = FALSE;
+	BOOL CLSwitches_capi = FALSE;
+	BOOL CLSwitches_output = FALSE;
+	BOOL CLSwitches_consumer = FALSE;
+	BOOL CLSwitches_replay = FALSE;
+	BOOL CLSwitches_replaytiming = FALSE;
+	BOOL CLSwitches_replaythreads = FALSE;
+	BOOL CLSwitches_compare = FALSE;
+	BOOL CLSwitches_energy = FALSE;
+	BOOL CLSwitches_membench = FALSE;
+	BOOL CLSwitches_metrics = FALSE;
+	BOOL CLSwitches_server = FALSE;
+	BOOL CLSwitches_rescan = FALSE;
+	BOOL CLSwitches_depgraph = FALSE;
+	BOOL CLSwitches_workers = FALSE;
+	BOOL CLSwitches_json = FALSE;
+	string sJSONFile = "";
+	string sOutputFile = "";
+	BOOL bOutputY4M = FALSE;
+	stConsumerParams consumerparams;
+	string sReplayFile = "";
+	string sCompareFile = "";
+	string sServerPipe = "";
+	string sDepGraphFile = "";
 
 	if (Settings.bAllowOnlyOneInstance)
 	{
@@ -242,6 +354,161 @@ int main(int argc, char* argv[])
 			continue;
 		}
 
+		if (sArgTest == "-perf")
+		{
+			CLSwitches_perf = TRUE;
+			Settings.bPerfCounters = TRUE;
+			continue;
+		}
+
+		if (sArgTest == "-cpufreq")
+		{
+			CLSwitches_cpufreq = TRUE;
+			Settings.bCPUFreqInfo = TRUE;
+			continue;
+		}
+
+		if (sArgTest == "-scaling")
+		{
+			CLSwitches_scaling = TRUE;
+			continue;
+		}
+
+		if (sArgTest == "-isasweep")
+		{
+			CLSwitches_isasweep = TRUE;
+			continue;
+		}
+
+		if (sArgTest == "-capi")
+		{
+			CLSwitches_capi = TRUE;
+			continue;
+		}
+
+		if (sArgTest == "-energy")
+		{
+			CLSwitches_energy = TRUE;
+			Settings.bEnergyInfo = TRUE;
+			continue;
+		}
+
+		if (sArgTest == "-membench")
+		{
+			CLSwitches_membench = TRUE;
+			Settings.bMemBench = TRUE;
+			continue;
+		}
+
+		if (sArgTest == "-rescan")
+		{
+			CLSwitches_rescan = TRUE;
+			continue;
+		}
+
+		if ((sArgTest == "-workers") || (sArgTest.substr(0, 9) == "-workers="))
+		{
+			CLSwitches_workers = TRUE;
+			if (arg_len > 9)
+			{
+				sTemp = sArgTest.substr(9);
+				if (!utils.IsNumeric(sTemp) || (atoi(sTemp.c_str()) < 1) || (atoi(sTemp.c_str()) > 64))
+				{
+					PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid argument: \"%s\"\nThe number of workers must be between 1 and 64\n", sArg.c_str());
+					PollKeys();
+					return -1;
+				}
+				Settings.uiPluginTestWorkers = (unsigned int)atoi(sTemp.c_str());
+			}
+			else
+			{
+				SYSTEM_INFO si;
+				::GetSystemInfo(&si);
+				Settings.uiPluginTestWorkers = (si.dwNumberOfProcessors > 64) ? 64 : si.dwNumberOfProcessors;
+			}
+			continue;
+		}
+
+		if ((sArgTest.substr(0, 6) == "-json=") && (arg_len > 6))
+		{
+			CLSwitches_json = TRUE;
+			sJSONFile = sArg.substr(6);
+			utils.StrTrim(sJSONFile);
+			continue;
+		}
+
+		if (((sArgTest.substr(0, 5) == "-y4m=") || (sArgTest.substr(0, 5) == "-raw=")) && (arg_len > 5))
+		{
+			CLSwitches_output = TRUE;
+			bOutputY4M = (sArgTest.substr(0, 5) == "-y4m=") ? TRUE : FALSE;
+			sOutputFile = sArg.substr(5);
+			utils.StrTrim(sOutputFile);
+			continue;
+		}
+
+		if ((sArgTest.substr(0, 10) == "-consumer=") && (arg_len > 10))
+		{
+			CLSwitches_consumer = TRUE;
+			if (!CConsumer::ParseSpec(sArgTest.substr(10), consumerparams, sTemp))
+			{
+				PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid consumer: \"%s\"\n%s\n", sArg.c_str(), sTemp.c_str());
+				PollKeys();
+				return -1;
+			}
+			continue;
+		}
+
+		if ((sArgTest.substr(0, 8) == "-replay=") && (arg_len > 8))
+		{
+			CLSwitches_replay = TRUE;
+			sReplayFile = sArg.substr(8);
+			utils.StrTrim(sReplayFile);
+			continue;
+		}
+
+		if (sArgTest == "-replaytiming")
+		{
+			CLSwitches_replaytiming = TRUE;
+			continue;
+		}
+
+		if (sArgTest == "-replaythreads")
+		{
+			CLSwitches_replaythreads = TRUE;
+			continue;
+		}
+
+		if ((sArgTest.substr(0, 9) == "-compare=") && (arg_len > 9))
+		{
+			CLSwitches_compare = TRUE;
+			sCompareFile = sArg.substr(9);
+			utils.StrTrim(sCompareFile);
+			continue;
+		}
+
+		if ((sArgTest.substr(0, 10) == "-depgraph=") && (arg_len > 10))
+		{
+			CLSwitches_depgraph = TRUE;
+			sDepGraphFile = sArg.substr(10);
+			utils.StrTrim(sDepGraphFile);
+			continue;
+		}
+
+		if ((sArgTest == "-server") || (sArgTest.substr(0, 8) == "-server="))
+		{
+			CLSwitches_server = TRUE;
+			if (arg_len > 8)
+				sServerPipe = sArg.substr(8);
+			continue;
+		}
+
+		if (sArgTest.substr(0, 9) == "-metrics=")
+		{
+			CLSwitches_metrics = TRUE;
+			Settings.sMetrics = sArgTest.substr(9);
+			continue;
+		}
+
 		if (sArgTest.substr(0, 7) == "-range=")
 		{
 			CLSwitches_range = TRUE;
@@ -331,9 +598,24 @@ int main(int argc, char* argv[])
 			continue;
 		}
 
+		if (CSyntheticSource::IsSyntheticSpec(sArgTest))
+		{
+			stSyntheticParams synthparams;
+			if (!CSyntheticSource::ParseSpec(sArgTest, synthparams, sTemp))
+			{
+				PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid synthetic clip: \"%s\"\n%s\n", sArg.c_str(), sTemp.c_str());
+				PrintUsage();
+				PollKeys();
+				return -1;
+			}
+
+			sAVSFile = sArgTest;
+			continue;
+		}
+
 		if (arg_len > 4)
 		{
-			if (sArgTest.substr(sArgTest.length() - 4) == ".avs")
+			if ((sArgTest.substr(sArgTest.length() - 4) == ".avs") || (sArgTest.substr(sArgTest.length() - 4) == ".vpy"))
 			{
 				LPTSTR lpPart;
 				char szOut[MAX_PATH + 1];
@@ -431,147 +713,427 @@ int main(int argc, char* argv[])
 			return -1;
 		}
 
-		if (sAVSFile != "")
+		if (CLSwitches_perf)
 		{
-			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nSpecifying a script together with \"avsinfo\" is pointless\n");
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-perf\"\n");
 			PrintUsage();
 			PollKeys();
 			return -1;
 		}
-	}
-	else
-	{
-		if (CLSwitches_c)
+
+		if (CLSwitches_cpufreq)
 		{
-			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-c\"\n");
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-cpufreq\"\n");
 			PrintUsage();
 			PollKeys();
 			return -1;
 		}
 
-		if (CLSwitches_lf)
+		if (CLSwitches_scaling)
 		{
-			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-lf\"\n");
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-scaling\"\n");
 			PrintUsage();
 			PollKeys();
 			return -1;
 		}
-	}
-
-	if (Settings.nProcessPriority == 1)
-		::SetPriorityClass(GetCurrentProcess(), IDLE_PRIORITY_CLASS);
-	else if (Settings.nProcessPriority == 3)
-		::SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS);
-	else
-		::SetPriorityClass(GetCurrentProcess(), NORMAL_PRIORITY_CLASS);
 
-	if (bCustomAVSDLLFromCL)
-	{
-		char szCustomAVSDLL[MAX_PATH + 1] = "";
-
-		OPENFILENAME ofn;
-		ofn.lStructSize       = sizeof(OPENFILENAME);
-		ofn.hwndOwner         = ConsoleHWND;
-		ofn.hInstance         = NULL;
-		ofn.lpstrFilter       = "*.dll";
-		ofn.lpstrCustomFilter = NULL;
-		ofn.nMaxCustFilter    = 0;
-		ofn.nFilterIndex      = 1;
-		ofn.lpstrFile         = szCustomAVSDLL;
-		ofn.nMaxFile          = MAX_PATH;
-		ofn.lpstrFileTitle    = NULL;
-		ofn.nMaxFileTitle     = NULL;
-		ofn.lpstrInitialDir   = ".";
-		ofn.lpstrTitle        = "Select Avisynth DLL";
-		ofn.nFileOffset       = 0;
-		ofn.nFileExtension    = 0;
-		ofn.lpstrDefExt       = NULL;
-		ofn.lCustData         = 0;
-		ofn.lpfnHook          = NULL;
-		ofn.lpTemplateName    = NULL;
-		ofn.Flags             = OFN_HIDEREADONLY | OFN_EXPLORER;
-			
-		if (GetOpenFileName(&ofn) == 0)
+		if (CLSwitches_isasweep)
 		{
-			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
-			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nCannot open file or no avisynth.dll selected.\n");
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-isasweep\"\n");
+			PrintUsage();
 			PollKeys();
 			return -1;
 		}
 
-		Settings.sAVSDLL.assign(szCustomAVSDLL);
-	}
-
-	PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("Query Avisynth info...").c_str());
-
-	BOOL bRet = FALSE;
-	if (bModeAVSInfo)
-		bRet = AvisynthInfo.GetInfo(Settings.sAVSDLL, Settings.bSpecifyCustomPluginDir, sErrorMsg);
-	else
-		bRet = AvisynthInfo.GetInfo(Settings.sAVSDLL, FALSE, sErrorMsg);
+		if (CLSwitches_capi)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-capi\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
 
-	if (!bRet)
-	{
-		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
-		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", sErrorMsg.c_str());
-		PollKeys();
-		return -1;
-	}
+		if (CLSwitches_output)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"%s\"\n", bOutputY4M ? "-y4m" : "-raw");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
 
-	if (!bModeAVSInfo)
-	{
-		PrintConsole(Settings.bConUseStdOut, COLOR_AVISYNTH_VERSION, "\r%s", AvisynthInfo.sVersionString.c_str());
-		PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, " (%s)\n", AvisynthInfo.sFileVersion.c_str());
-	}
+		if (CLSwitches_consumer)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-consumer\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
 
-	CGPUInfo gpuinfo;
-	if (Settings.bGPUInfo)
-	{
-		gpuinfo.GPUZInit();
-		if (!gpuinfo.bInitialized)
+		if (CLSwitches_replay || CLSwitches_replaytiming || CLSwitches_replaythreads)
 		{
-			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
-			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nCannot initialize GPU-Z shared memory interface:\n%s\n", gpuinfo.sError.c_str());
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-replay\"\n");
+			PrintUsage();
 			PollKeys();
 			return -1;
 		}
-	}
 
-	if (!timer.TestPerfCounter())
-	{
-		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
-		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nQueryPerformanceCounter() is not supported\n");
-		PollKeys();
-		return -1;
-	}
+		if (CLSwitches_compare)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-compare\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
 
-	PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+		if (CLSwitches_energy)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-energy\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
 
-	if (bModeAVSInfo)
-	{
-		sOutBuf = utils.StrFormat("Log file created with:      AVSMeter %s\n", sAVSMVersion.c_str());
-		sLogBuffer += sOutBuf;
+		if (CLSwitches_membench)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-membench\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
 
-		sLogBuffer += "\n[OS/Hardware info]\n";
-		sOutBuf = utils.StrFormat("Operating system:           %s\n", sys.GetOSVersion().c_str());
-		sLogBuffer += sOutBuf;
+		if (CLSwitches_metrics)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-metrics\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
 
-		if (sys.GetCPUInfo())
+		if (CLSwitches_json)
 		{
-			sOutBuf = utils.StrFormat("CPU brand string:           %s\n", sys.CPUBrandString.c_str());
-			sLogBuffer += sOutBuf;
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-json\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
 
-			sOutBuf = utils.StrFormat("CPU features:               %s\n", sys.CPUFeatures.c_str());
-			sLogBuffer += sOutBuf;
-			if (sys.CPUFeatures.find("*") != std::string::npos)
-				sLogBuffer += "                            (* CPU feature not supported by the operating system)\n";
+		if (CLSwitches_server)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-server\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
 		}
 
-		if (Settings.bGPUInfo)
+		if (sAVSFile != "")
 		{
-			sOutBuf = utils.StrFormat("\nVideo card:                 %s", gpuinfo.data.CardName.c_str());
-			sLogBuffer += sOutBuf + "\n";
-			sOutBuf = utils.StrFormat("GPU version:                %s", gpuinfo.data.GPUName.c_str());
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nSpecifying a script together with \"avsinfo\" is pointless\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+	}
+	else
+	{
+		if ((CLSwitches_scaling || CLSwitches_server || CLSwitches_isasweep) && CLSwitches_info)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-info [-i]\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if ((CLSwitches_server || CLSwitches_scaling || CLSwitches_isasweep) && CLSwitches_json)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-json\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if ((CLSwitches_server || CLSwitches_scaling || CLSwitches_isasweep) && CLSwitches_membench)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-membench\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if (CLSwitches_server && CLSwitches_scaling)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-scaling\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if ((CLSwitches_server || CLSwitches_scaling) && CLSwitches_isasweep)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-isasweep\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if ((CLSwitches_scaling || CLSwitches_isasweep) && CFrameServer::IsVapourSynthScript(sAVSFile))
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"%s\"\n", CLSwitches_scaling ? "-scaling" : "-isasweep");
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "VapourSynth scripts are only measured in the standard mode\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if ((CLSwitches_server || CLSwitches_scaling || CLSwitches_isasweep) && CLSwitches_capi)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-capi\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if ((CLSwitches_server || CLSwitches_scaling || CLSwitches_isasweep || CLSwitches_info || CLSwitches_capi) && CLSwitches_output)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"%s\"\n", bOutputY4M ? "-y4m" : "-raw");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if ((CLSwitches_server || CLSwitches_scaling || CLSwitches_isasweep || CLSwitches_info || CLSwitches_capi) && CLSwitches_consumer)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-consumer\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if ((CLSwitches_server || CLSwitches_scaling || CLSwitches_isasweep || CLSwitches_info || CLSwitches_output || CLSwitches_consumer) && CLSwitches_replay)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-replay\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if ((CLSwitches_server || CLSwitches_scaling || CLSwitches_isasweep || CLSwitches_info || CLSwitches_capi || CLSwitches_output || CLSwitches_consumer || CLSwitches_replay) && CLSwitches_compare)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-compare\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if ((CLSwitches_replaytiming || CLSwitches_replaythreads) && !CLSwitches_replay)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"%s\"\n", CLSwitches_replaytiming ? "-replaytiming" : "-replaythreads");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if (CLSwitches_replay && CFrameServer::IsVapourSynthScript(sAVSFile))
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-replay\"\n");
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "Traces are replayed against avisynth scripts only\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if (CLSwitches_capi && (CFrameServer::IsVapourSynthScript(sAVSFile) || CSyntheticSource::IsSyntheticSpec(sAVSFile)))
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-capi\"\n");
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "The C API serves avisynth scripts only\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if (CLSwitches_server && (sAVSFile != ""))
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nSpecifying a script together with \"-server\" is pointless\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if (CLSwitches_c)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-c\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if (CLSwitches_lf)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-lf\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if (CLSwitches_depgraph)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-depgraph\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+
+		if (CLSwitches_workers)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nInvalid switch in this context: \"-workers\"\n");
+			PrintUsage();
+			PollKeys();
+			return -1;
+		}
+	}
+
+	if (Settings.nProcessPriority == 1)
+		::SetPriorityClass(GetCurrentProcess(), IDLE_PRIORITY_CLASS);
+	else if (Settings.nProcessPriority == 3)
+		::SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS);
+	else
+		::SetPriorityClass(GetCurrentProcess(), NORMAL_PRIORITY_CLASS);
+
+	if (bCustomAVSDLLFromCL)
+	{
+		char szCustomAVSDLL[MAX_PATH + 1] = "";
+
+		OPENFILENAME ofn;
+		ofn.lStructSize       = sizeof(OPENFILENAME);
+		ofn.hwndOwner         = ConsoleHWND;
+		ofn.hInstance         = NULL;
+		ofn.lpstrFilter       = "*.dll";
+		ofn.lpstrCustomFilter = NULL;
+		ofn.nMaxCustFilter    = 0;
+		ofn.nFilterIndex      = 1;
+		ofn.lpstrFile         = szCustomAVSDLL;
+		ofn.nMaxFile          = MAX_PATH;
+		ofn.lpstrFileTitle    = NULL;
+		ofn.nMaxFileTitle     = 0;
+		ofn.lpstrInitialDir   = ".";
+		ofn.lpstrTitle        = "Select Avisynth DLL";
+		ofn.nFileOffset       = 0;
+		ofn.nFileExtension    = 0;
+		ofn.lpstrDefExt       = NULL;
+		ofn.lCustData         = 0;
+		ofn.lpfnHook          = NULL;
+		ofn.lpTemplateName    = NULL;
+		ofn.Flags             = OFN_HIDEREADONLY | OFN_EXPLORER;
+			
+		if (GetOpenFileName(&ofn) == 0)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nCannot open file or no avisynth.dll selected.\n");
+			PollKeys();
+			return -1;
+		}
+
+		Settings.sAVSDLL.assign(szCustomAVSDLL);
+	}
+
+	//VapourSynth scripts do not need avisynth, VSScript is only loaded to check it and to get its version
+	BOOL bVapourSynth = (!bModeAVSInfo && CFrameServer::IsVapourSynthScript(sAVSFile)) ? TRUE : FALSE;
+	//synthetic clips are served by CFrameServerSynthetic, avisynth is optional
+	BOOL bSynthetic = (!bModeAVSInfo && CSyntheticSource::IsSyntheticSpec(sAVSFile)) ? TRUE : FALSE;
+	string sServerVersion = "";
+
+	PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad(bVapourSynth ? "Query VapourSynth info..." : "Query Avisynth info...").c_str());
+
+	if (Settings.bPluginCache)
+		AvisynthInfo.sPluginCacheFile = Settings.sPluginCacheFile;
+	AvisynthInfo.bRescanPlugins = CLSwitches_rescan;
+	if (bModeAVSInfo)
+	{
+		AvisynthInfo.uiPluginTestWorkers = Settings.uiPluginTestWorkers;
+		AvisynthInfo.uiPluginTestTimeout = Settings.uiPluginTestTimeout * 1000;
+	}
+
+	BOOL bRet = FALSE;
+	if (bModeAVSInfo)
+		bRet = AvisynthInfo.GetInfo(Settings.sAVSDLL, Settings.bSpecifyCustomPluginDir, sErrorMsg);
+	else if (bVapourSynth)
+	{
+		CFrameServerVapourSynth vsprobe;
+		bRet = vsprobe.Load(Settings.sVSScriptDLL);
+		sErrorMsg = vsprobe.sError;
+		sServerVersion = vsprobe.sVersion;
+	}
+	else
+	{
+		bRet = AvisynthInfo.GetInfo(Settings.sAVSDLL, FALSE, sErrorMsg);
+		sServerVersion = AvisynthInfo.sVersionString;
+	}
+
+	if (!bRet && !bSynthetic)
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", sErrorMsg.c_str());
+		PollKeys();
+		return -1;
+	}
+
+	if (!bRet)
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\n", Pad("No avisynth, the synthetic clip is run directly").c_str());
+	else if (bVapourSynth)
+		PrintConsole(Settings.bConUseStdOut, COLOR_AVISYNTH_VERSION, "\r%s\n", sServerVersion.c_str());
+	else if (!bModeAVSInfo)
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_AVISYNTH_VERSION, "\r%s", AvisynthInfo.sVersionString.c_str());
+		PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, " (%s)\n", AvisynthInfo.sFileVersion.c_str());
+	}
+
+	CGPUInfo gpuinfo;
+	if (Settings.bGPUInfo)
+	{
+		gpuinfo.GPUZInit();
+		if (!gpuinfo.bInitialized)
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nCannot initialize GPU-Z shared memory interface:\n%s\n", gpuinfo.sError.c_str());
+			PollKeys();
+			return -1;
+		}
+	}
+
+	if (!timer.TestPerfCounter())
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nQueryPerformanceCounter() is not supported\n");
+		PollKeys();
+		return -1;
+	}
+
+	PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+
+	if (bModeAVSInfo)
+	{
+		sOutBuf = utils.StrFormat("Log file created with:      AVSMeter %s\n", sAVSMVersion.c_str());
+		sLogBuffer += sOutBuf;
+
+		sLogBuffer += "\n[OS/Hardware info]\n";
+		sOutBuf = utils.StrFormat("Operating system:           %s\n", sys.GetOSVersion().c_str());
+		sLogBuffer += sOutBuf;
+
+		if (sys.GetCPUInfo())
+		{
+			sOutBuf = utils.StrFormat("CPU brand string:           %s\n", sys.CPUBrandString.c_str());
+			sLogBuffer += sOutBuf;
+
+			sOutBuf = utils.StrFormat("CPU features:               %s\n", sys.CPUFeatures.c_str());
+			sLogBuffer += sOutBuf;
+			if (sys.CPUFeatures.find("*") != std::string::npos)
+				sLogBuffer += "                            (* CPU feature not supported by the operating system)\n";
+		}
+
+		if (Settings.bGPUInfo)
+		{
+			sOutBuf = utils.StrFormat("\nVideo card:                 %s", gpuinfo.data.CardName.c_str());
+			sLogBuffer += sOutBuf + "\n";
+			sOutBuf = utils.StrFormat("GPU version:                %s", gpuinfo.data.GPUName.c_str());
 			sLogBuffer += sOutBuf + "\n";
 			sOutBuf = utils.StrFormat("Video memory size:          %s", gpuinfo.data.MemSize.c_str());
 			sLogBuffer += sOutBuf + "\n";
@@ -728,12 +1290,38 @@ int main(int argc, char* argv[])
 			}
 		}
 
-		//Plugin Dependencies
-		if (AvisynthInfo.vPluginDependencies.size() > 0)
+		//Plugin load times
+		sOutBuf = "\n\n\n[Plugin load times]\n";
+		sOutBuf += utils.StrFormat("Environment creation:       %.1f ms\n", AvisynthInfo.dEnvCreateMS);
+		if (AvisynthInfo.dAutoloadMS >= 0.0)
+			sOutBuf += utils.StrFormat("Plugin autoload:            %.1f ms\n", AvisynthInfo.dAutoloadMS);
+		else
+			sOutBuf += "Plugin autoload:            n/a\n";
+		sOutBuf += utils.StrFormat("Plugin load test (total):   %.1f ms\n", AvisynthInfo.dPluginTestMS);
+		if (AvisynthInfo.uiPluginTestWorkers > 0)
+			sOutBuf += utils.StrFormat("Plugin test workers:        %u (timeout %u s)\n", AvisynthInfo.uiPluginTestWorkers, AvisynthInfo.uiPluginTestTimeout / 1000);
+		if (AvisynthInfo.sPluginCacheFile != "")
+			sOutBuf += utils.StrFormat("DLLs from plugin cache:     %u\n", AvisynthInfo.uiCachedDLLs);
+		sLogBuffer += sOutBuf;
+
+		if (AvisynthInfo.vPluginLoadTimes.size() > 0)
 		{
-			if (AvisynthInfo.bIs64BitAVSDLL)
-				sOutBuf = "\n\n\n[DLL dependencies (x64)]\n";
-			else
+			sLogBuffer += "\n Total(ms)    Map(ms)   Init(ms)   Deps(ms)   WS delta(KiB)   Plugin\n";
+			for (unsigned int PLoad = 0; PLoad < AvisynthInfo.vPluginLoadTimes.size(); PLoad++)
+			{
+				stPluginLoadTime &plt = AvisynthInfo.vPluginLoadTimes[PLoad];
+				sOutBuf = utils.StrFormat("%10.1f %10.1f %10.1f %10.1f %15lld   %s%s\n", plt.dDependencyMS + plt.dMapMS + plt.dLoadMS, plt.dMapMS, plt.dLoadMS, plt.dDependencyMS,
+					plt.iWorkingSetDeltaKB, plt.sPlugin.c_str(), plt.bFailed ? " (failed)" : "");
+				sLogBuffer += sOutBuf;
+			}
+		}
+
+		//Plugin Dependencies
+		if (AvisynthInfo.vPluginDependencies.size() > 0)
+		{
+			if (AvisynthInfo.bIs64BitAVSDLL)
+				sOutBuf = "\n\n\n[DLL dependencies (x64)]\n";
+			else
 				sOutBuf = "\n\n\n[DLL dependencies (x86)]\n";
 
 			sLogBuffer += sOutBuf;
@@ -745,6 +1333,31 @@ int main(int argc, char* argv[])
 			}
 		}
 
+		//Transitive dependencies
+		if (AvisynthInfo.DependencyGraph.vNodes.size() > 0)
+		{
+			if (AvisynthInfo.bIs64BitAVSDLL)
+				sOutBuf = "\n\n\n[DLL dependency graph (x64)]\n";
+			else
+				sOutBuf = "\n\n\n[DLL dependency graph (x86)]\n";
+
+			sOutBuf += AvisynthInfo.DependencyGraph.GetText();
+			sLogBuffer += sOutBuf;
+		}
+
+		if (CLSwitches_depgraph)
+		{
+			ofstream hDOTFile(sDepGraphFile.c_str());
+			if (hDOTFile.is_open())
+			{
+				hDOTFile << AvisynthInfo.DependencyGraph.GetDOT();
+				hDOTFile.flush();
+				hDOTFile.close();
+			}
+			else
+				PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nCannot create \"%s\"\n", sDepGraphFile.c_str());
+		}
+
 
 		if (bLogFunctions)
 		{
@@ -802,7 +1415,7 @@ int main(int argc, char* argv[])
 				ofn.lpstrFile         = szAVSInfoFile;
 				ofn.nMaxFile          = MAX_PATH;
 				ofn.lpstrFileTitle    = NULL;
-				ofn.nMaxFileTitle     = NULL;
+				ofn.nMaxFileTitle     = 0;
 				ofn.lpstrInitialDir   = NULL;
 				ofn.lpstrTitle        = "Save log file as...";
 				ofn.nFileOffset       = 0;
@@ -842,24 +1455,24 @@ int main(int argc, char* argv[])
 						if (Settings.bLogFileDateTimeSuffix)
 						{
 							if (PROCESS_64)
-								sAVSInfoFile = utils.StrFormat("%s\\avsinfo_x64 [%s].log", szPath, Settings.sSystemDateTime.c_str());
+								sAVSInfoFile = utils.StrFormat("%s" PATH_SEPARATOR_STR "avsinfo_x64 [%s].log", szPath, Settings.sSystemDateTime.c_str());
 							else
-								sAVSInfoFile = utils.StrFormat("%s\\avsinfo_x86 [%s].log", szPath, Settings.sSystemDateTime.c_str());
+								sAVSInfoFile = utils.StrFormat("%s" PATH_SEPARATOR_STR "avsinfo_x86 [%s].log", szPath, Settings.sSystemDateTime.c_str());
 						}
 						else
 						{
 							if (PROCESS_64)
-								sAVSInfoFile = utils.StrFormat("%s\\avsinfo_x64.log", szPath);
+								sAVSInfoFile = utils.StrFormat("%s" PATH_SEPARATOR_STR "avsinfo_x64.log", szPath);
 							else
-								sAVSInfoFile = utils.StrFormat("%s\\avsinfo_x86.log", szPath);
+								sAVSInfoFile = utils.StrFormat("%s" PATH_SEPARATOR_STR "avsinfo_x86.log", szPath);
 						}
 					}
 					else
 					{
 						if (Settings.bLogFileDateTimeSuffix)
-							sAVSInfoFile = utils.StrFormat("%s\\avsinfo [%s].log", Settings.sLogDirectory.c_str(), Settings.sSystemDateTime.c_str());
+							sAVSInfoFile = utils.StrFormat("%s" PATH_SEPARATOR_STR "avsinfo [%s].log", Settings.sLogDirectory.c_str(), Settings.sSystemDateTime.c_str());
 						else
-							sAVSInfoFile = utils.StrFormat("%s\\avsinfo.log", Settings.sLogDirectory.c_str());
+							sAVSInfoFile = utils.StrFormat("%s" PATH_SEPARATOR_STR "avsinfo.log", Settings.sLogDirectory.c_str());
 					}
 
 					ofstream hAVSInfoFile(sAVSInfoFile.c_str());
@@ -877,6 +1490,14 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 
+	if (CLSwitches_server)
+	{
+		iRet = RunServerMode(sServerPipe);
+		SetErrorMode(nPrevErrorMode);
+		PollKeys();
+		return iRet;
+	}
+
 	if (sAVSFile == "")
 	{
 		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nNo script file specified\n");
@@ -884,11 +1505,59 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 
+	if (CLSwitches_scaling || CLSwitches_isasweep)
+	{
+		if (CLSwitches_scaling)
+			iRet = RunScalingMode(sAVSFile, sLogBuffer);
+		else
+			iRet = RunISASweepMode(sAVSFile, sLogBuffer);
+
+		if (Settings.bCreateLog)
+		{
+			string sr = CreateLogFile(sAVSFile, sLogBuffer, sGPUInfo, perfdata, sAVSError, FALSE, TRUE);
+			if (sr != "")
+			{
+				PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, sr.c_str());
+				PollKeys();
+				return -1;
+			}
+		}
+
+		SetErrorMode(nPrevErrorMode);
+		PollKeys();
+		return iRet;
+	}
+
+	if (CLSwitches_replay || CLSwitches_compare)
+	{
+		if (CLSwitches_replay)
+			iRet = RunReplayMode(sAVSFile, sReplayFile, CLSwitches_capi, CLSwitches_replaytiming, CLSwitches_replaythreads, sLogBuffer);
+		else
+			iRet = RunCompareMode(sAVSFile, sCompareFile, sLogBuffer);
+
+		if (Settings.bCreateLog)
+		{
+			string sr = CreateLogFile(sAVSFile, sLogBuffer, sGPUInfo, perfdata, sAVSError, FALSE, TRUE);
+			if (sr != "")
+			{
+				PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, sr.c_str());
+				PollKeys();
+				return -1;
+			}
+		}
+
+		SetErrorMode(nPrevErrorMode);
+		PollKeys();
+		return iRet;
+	}
+
+	stStartupTimes prescan;
+	InitStartupTimes(prescan, TRUE);
 	if (!bInfoOnly)
 	{
 		if (!bOmitPreScan)
 		{
-			uiFrameInterval = CalculateFrameInterval(sAVSFile, sErrorMsg);
+			uiFrameInterval = CalculateFrameInterval(sAVSFile, CLSwitches_capi, prescan, sErrorMsg);
 			if (sErrorMsg != "")
 			{
 				PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\n", Pad("").c_str());
@@ -901,82 +1570,123 @@ int main(int argc, char* argv[])
 		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
 	}
 
-	HINSTANCE hDLL;
-	if (Settings.sAVSDLL == "")
-		hDLL = ::LoadLibrary("avisynth");
-	else
-		hDLL = ::LoadLibrary(Settings.sAVSDLL.c_str());
-
-	if (!hDLL)
+	//opened before avisynth creates any threads so that all of them are counted
+	CPerfCounters perfcounters;
+	if (Settings.bPerfCounters && !bInfoOnly)
 	{
-		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nCannot load avisynth.dll:\n%s\n", utils.SysErrorMessage().c_str());
-		PollKeys();
-		return -1;
+		if (!perfcounters.Open())
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nCannot initialize hardware performance counters:\n%s\n", perfcounters.sError.c_str());
+			PollKeys();
+			return -1;
+		}
 	}
 
-
-	IScriptEnvironment *AVS_env = 0;
-	try
+	CCPUFreqInfo cpufreqinfo;
+	if (Settings.bCPUFreqInfo && !bInfoOnly)
 	{
-		_set_se_translator(SE_Translator);
+		if (!cpufreqinfo.Init())
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nCannot initialize CPU clock monitoring:\n%s\n", cpufreqinfo.sError.c_str());
+			PollKeys();
+			return -1;
+		}
+	}
 
-		CREATE_ENV *CreateEnvironment = (CREATE_ENV *)GetProcAddress(hDLL, "CreateScriptEnvironment");
-		if (!CreateEnvironment)
+	CEnergyInfo energyinfo;
+	if (Settings.bEnergyInfo && !bInfoOnly)
+	{
+		if (!energyinfo.Init(Settings.sPowercapRoot))
 		{
-			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nFailed to load CreateScriptEnvironment()\n");
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nCannot initialize energy measurement:\n%s\n", energyinfo.sError.c_str());
 			PollKeys();
 			return -1;
 		}
+	}
 
-		AVS_env = CreateEnvironment(AvisynthInfo.iInterfaceVersion);
+	CMetricsExporter metricsexporter;
+	if ((Settings.sMetrics != "") && !bInfoOnly)
+	{
+		if (!metricsexporter.Start(Settings.sMetrics))
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nCannot start the metrics exporter:\n%s\n", metricsexporter.sError.c_str());
+			PollKeys();
+			return -1;
+		}
+	}
 
-		if (!AVS_env)
+	//measured before avisynth is loaded so that no filter threads compete for memory bandwidth
+	CMemBench membench;
+	if (Settings.bMemBench && !bInfoOnly)
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("Measuring memory bandwidth and latency...").c_str());
+		sys.GetCPUInfo();
+		if (!membench.Run(sys.bSSE2, sys.bAVX2))
 		{
-			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nCould not create IScriptenvironment\n");
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nMemory benchmark failed:\n%s\n", membench.sError.c_str());
 			PollKeys();
 			return -1;
 		}
 
-		AVS_linkage = AVS_env->GetAVSLinkage();
-		AVSValue AVS_main;
-		AVSValue AVS_temp;
-		PClip AVS_clip;
-		VideoInfo	AVS_vidinfo;
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n%s\n", membench.GetText().c_str());
+	}
+
+	//the benchmark run is only the first load of the script when the pre-scan was omitted
+	stStartupTimes startup;
+	InitStartupTimes(startup, bOmitPreScan || bInfoOnly);
+	stStartupTimes &coldstartup = startup.bCold ? startup : prescan;
+	string sJSONRuntime = "";
+	double dStartupBegin = timer.GetTimer();
+	double dPhaseStart = dStartupBegin;
+
+	CFrameServer *frameserver = CFrameServer::Create(sAVSFile, AvisynthInfo.iInterfaceVersion, CLSwitches_capi);
+	frameserver->bInvokeDistributor = Settings.bInvokeDistributor;
+	if (bVapourSynth)
+		((CFrameServerVapourSynth *)frameserver)->uiRequests = Settings.uiVSRequests;
+
+	if (!frameserver->Load(bVapourSynth ? Settings.sVSScriptDLL : Settings.sAVSDLL))
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", frameserver->sError.c_str());
+		delete frameserver;
+		PollKeys();
+		return -1;
+	}
+
+	startup.dDLLLoadMS = (timer.GetTimer() - dPhaseStart) * 1000.0;
+
+
+	try
+	{
+		_set_se_translator(SE_Translator);
+
+		dPhaseStart = timer.GetTimer();
+		frameserver->CreateEnvironment();
+		startup.dEnvCreateMS = (timer.GetTimer() - dPhaseStart) * 1000.0;
+
+		stClipInfo clipinfo;
 
 		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("Loading script...").c_str());
-		AVS_main = AVS_env->Invoke("Import", sAVSFile.c_str());
+		dPhaseStart = timer.GetTimer();
+		frameserver->Import(sAVSFile);
+		startup.dImportMS = (timer.GetTimer() - dPhaseStart) * 1000.0;
 		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
 
-		if (!AVS_main.IsClip())
-			AVS_env->ThrowError("\"%s\":\nScript did not return a clip", sAVSFile.c_str());
-
-		BOOL bIsSETMTVersion = TRUE;
-		int iMTMode = 0;
-		try
-		{
-			AVS_temp = AVS_env->Invoke("GetMTMode", false);
-			iMTMode = AVS_temp.IsInt() ? AVS_temp.AsInt() : 0;
-			if ((iMTMode > 0) && (iMTMode < 5) && Settings.bInvokeDistributor)
-				AVS_main = AVS_env->Invoke("Distributor", AVS_main);
-		}
-		catch (IScriptEnvironment::NotFound)
-		{
-			bIsSETMTVersion = FALSE;
-		}
+		frameserver->InvokeDistributor();
+		startup.dDistributorMS = frameserver->dDistributorMS;
 
-		AVS_clip = AVS_main.AsClip();
-		AVS_vidinfo = AVS_clip->GetVideoInfo();
+		frameserver->GetClipInfo(clipinfo);
 
 		BOOL bAudioOnly = FALSE;
-		if (!AVS_vidinfo.HasVideo() && AVS_vidinfo.HasAudio())
+		if (!clipinfo.bHasVideo && clipinfo.bHasAudio)
 			bAudioOnly = TRUE;
 
 		unsigned int uiFrames = 0;
 		__int64 iMilliSeconds = 0;
 		if (!bAudioOnly)
 		{
-			uiFrames = (unsigned int)AVS_vidinfo.num_frames;
-			iMilliSeconds = (__int64)((((double)uiFrames * (double)AVS_vidinfo.fps_denominator * 1000.0) / (double)AVS_vidinfo.fps_numerator) + 0.5);
+			uiFrames = clipinfo.uiFrames;
+			iMilliSeconds = (__int64)((((double)uiFrames * (double)clipinfo.uiFPSDenominator * 1000.0) / (double)clipinfo.uiFPSNumerator) + 0.5);
 		}
 
 		sOutBuf = utils.StrFormat("Log file created with:      AVSMeter %s", sAVSMVersion.c_str());
@@ -1005,6 +1715,9 @@ int main(int argc, char* argv[])
 				sLogBuffer += "                            (* CPU feature not supported by the operating system)\n";
 		}
 
+		if (membench.dPeakMBs > 0.0)
+			sLogBuffer += "\n[Memory benchmark]\n" + membench.GetText();
+
 		if (Settings.bGPUInfo)
 		{
 			sOutBuf = utils.StrFormat("\nVideo card:                 %s", gpuinfo.data.CardName.c_str());
@@ -1019,38 +1732,65 @@ int main(int argc, char* argv[])
 			sLogBuffer += sOutBuf;
 		}
 
-		sLogBuffer += "\n\n[Avisynth info]";
-		sOutBuf = utils.StrFormat("\nVersionString:              %s", AvisynthInfo.sVersionString.c_str());
-		sLogBuffer += sOutBuf + "\n";
+		if (bVapourSynth)
+		{
+			sLogBuffer += "\n\n[VapourSynth info]";
+			sOutBuf = utils.StrFormat("\nVersionString:              %s", frameserver->sVersion.c_str());
+			sLogBuffer += sOutBuf + "\n";
 
-		sOutBuf = utils.StrFormat("VersionNumber:              %s", AvisynthInfo.sVersionNumber.c_str());
-		sLogBuffer += sOutBuf + "\n";
+			sOutBuf = utils.StrFormat("VSScript location:          %s", frameserver->sDLLPath.c_str());
+			sLogBuffer += sOutBuf + "\n";
 
-		sOutBuf = utils.StrFormat("File / Product version:     %s / %s", AvisynthInfo.sFileVersion.c_str(), AvisynthInfo.sProductVersion.c_str());
-		sLogBuffer += sOutBuf + "\n";
+			sOutBuf = utils.StrFormat("Frame requests in flight:   %u", ((CFrameServerVapourSynth *)frameserver)->uiRequests);
+			sLogBuffer += sOutBuf + "\n";
+		}
+		else if (bSynthetic)
+		{
+			sLogBuffer += "\n\n[Synthetic clip info]";
+			sOutBuf = utils.StrFormat("\nVersionString:              %s", frameserver->sVersion.c_str());
+			sLogBuffer += sOutBuf + "\n";
 
-		sOutBuf = utils.StrFormat("Interface Version:          %d", AvisynthInfo.iInterfaceVersion);
-		sLogBuffer += sOutBuf + "\n";
+			sOutBuf = utils.StrFormat("Clip:                       %s", ((CFrameServerSynthetic *)frameserver)->source.GetDescription().c_str());
+			sLogBuffer += sOutBuf + "\n";
+		}
+		else
+		{
+			sLogBuffer += "\n\n[Avisynth info]";
+			sOutBuf = utils.StrFormat("\nVersionString:              %s", AvisynthInfo.sVersionString.c_str());
+			sLogBuffer += sOutBuf + "\n";
 
-		sOutBuf = utils.StrFormat("Multi-threading support:    %s", AvisynthInfo.bIsMTVersion ? ("Yes") : ("No"));
-		sLogBuffer += sOutBuf + "\n";
+			sOutBuf = utils.StrFormat("VersionNumber:              %s", AvisynthInfo.sVersionNumber.c_str());
+			sLogBuffer += sOutBuf + "\n";
 
-		sOutBuf = utils.StrFormat("Avisynth.dll location:      %s", AvisynthInfo.sDLLPath.c_str());
-		sLogBuffer += sOutBuf + "\n";
+			sOutBuf = utils.StrFormat("File / Product version:     %s / %s", AvisynthInfo.sFileVersion.c_str(), AvisynthInfo.sProductVersion.c_str());
+			sLogBuffer += sOutBuf + "\n";
 
-		sOutBuf = utils.StrFormat("Avisynth.dll time stamp:    %s", AvisynthInfo.sTimeStamp.c_str());
-		sLogBuffer += sOutBuf + "\n";
+			sOutBuf = utils.StrFormat("Interface Version:          %d", AvisynthInfo.iInterfaceVersion);
+			sLogBuffer += sOutBuf + "\n";
 
-		for (unsigned int uiPlugDir = 0; uiPlugDir < AvisynthInfo.vPluginDirs.size(); uiPlugDir++)
-		{
-			sTemp = AvisynthInfo.vPluginDirs[uiPlugDir];
-			if (sTemp != "")
+			sOutBuf = utils.StrFormat("Frames served through:      %s", CLSwitches_capi ? "C API" : "C++ API");
+			sLogBuffer += sOutBuf + "\n";
+
+			sOutBuf = utils.StrFormat("Multi-threading support:    %s", AvisynthInfo.bIsMTVersion ? ("Yes") : ("No"));
+			sLogBuffer += sOutBuf + "\n";
+
+			sOutBuf = utils.StrFormat("Avisynth.dll location:      %s", AvisynthInfo.sDLLPath.c_str());
+			sLogBuffer += sOutBuf + "\n";
+
+			sOutBuf = utils.StrFormat("Avisynth.dll time stamp:    %s", AvisynthInfo.sTimeStamp.c_str());
+			sLogBuffer += sOutBuf + "\n";
+
+			for (unsigned int uiPlugDir = 0; uiPlugDir < AvisynthInfo.vPluginDirs.size(); uiPlugDir++)
 			{
-				size_t spos = sTemp.find(":\t");
-				sTemp = sTemp.substr(0, spos + 1) + "   " + sTemp.substr(spos + 2);
+				sTemp = AvisynthInfo.vPluginDirs[uiPlugDir];
+				if (sTemp != "")
+				{
+					size_t spos = sTemp.find(":\t");
+					sTemp = sTemp.substr(0, spos + 1) + "   " + sTemp.substr(spos + 2);
 
-				sOutBuf = utils.StrFormat("%s", sTemp.c_str());
-				sLogBuffer += sOutBuf + "\n";
+					sOutBuf = utils.StrFormat("%s", sTemp.c_str());
+					sLogBuffer += sOutBuf + "\n";
+				}
 			}
 		}
 
@@ -1059,7 +1799,7 @@ int main(int argc, char* argv[])
 		sLogBuffer += "\n\n[Clip info]\n";
 
 		if (!bAudioOnly)
-			sOutBuf = utils.StrFormat("Number of frames:          %11u", AVS_vidinfo.num_frames);
+			sOutBuf = utils.StrFormat("Number of frames:          %11u", clipinfo.uiFrames);
 		else
 			sOutBuf = "Number of frames:                  n/a";
 
@@ -1075,7 +1815,7 @@ int main(int argc, char* argv[])
 		sLogBuffer += sOutBuf + "\n";
 
 		if (!bAudioOnly)
-			sOutBuf = utils.StrFormat("Frame width:               %11u", AVS_vidinfo.width);
+			sOutBuf = utils.StrFormat("Frame width:               %11u", clipinfo.uiWidth);
 		else
 			sOutBuf = "Frame width:                       n/a";
 
@@ -1083,7 +1823,7 @@ int main(int argc, char* argv[])
 		sLogBuffer += sOutBuf + "\n";
 
 		if (!bAudioOnly)
-			sOutBuf = utils.StrFormat("Frame height:              %11u", AVS_vidinfo.height);
+			sOutBuf = utils.StrFormat("Frame height:              %11u", clipinfo.uiHeight);
 		else
 			sOutBuf = "Frame height:                      n/a";
 
@@ -1092,17 +1832,17 @@ int main(int argc, char* argv[])
 
 		if (!bAudioOnly)
 		{
-			if (AVS_vidinfo.IsFieldBased())
+			if (clipinfo.bFieldBased)
 			{
-				if (AVS_vidinfo.IsTFF())
-					sOutBuf = utils.StrFormat("Framerate:                 %11.3f (%u/%u, TFF)", (double)AVS_vidinfo.fps_numerator / (double)AVS_vidinfo.fps_denominator, AVS_vidinfo.fps_numerator, AVS_vidinfo.fps_denominator);
-				else if (AVS_vidinfo.IsBFF())
-					sOutBuf = utils.StrFormat("Framerate:                 %11.3f (%u/%u, BFF)", (double)AVS_vidinfo.fps_numerator / (double)AVS_vidinfo.fps_denominator, AVS_vidinfo.fps_numerator, AVS_vidinfo.fps_denominator);
+				if (clipinfo.bTFF)
+					sOutBuf = utils.StrFormat("Framerate:                 %11.3f (%u/%u, TFF)", (double)clipinfo.uiFPSNumerator / (double)clipinfo.uiFPSDenominator, clipinfo.uiFPSNumerator, clipinfo.uiFPSDenominator);
+				else if (clipinfo.bBFF)
+					sOutBuf = utils.StrFormat("Framerate:                 %11.3f (%u/%u, BFF)", (double)clipinfo.uiFPSNumerator / (double)clipinfo.uiFPSDenominator, clipinfo.uiFPSNumerator, clipinfo.uiFPSDenominator);
 				else
-					sOutBuf = utils.StrFormat("Framerate:                 %11.3f (%u/%u)", (double)AVS_vidinfo.fps_numerator / (double)AVS_vidinfo.fps_denominator, AVS_vidinfo.fps_numerator, AVS_vidinfo.fps_denominator);
+					sOutBuf = utils.StrFormat("Framerate:                 %11.3f (%u/%u)", (double)clipinfo.uiFPSNumerator / (double)clipinfo.uiFPSDenominator, clipinfo.uiFPSNumerator, clipinfo.uiFPSDenominator);
 			}
 			else
-				sOutBuf = utils.StrFormat("Framerate:                 %11.3f (%u/%u)", (double)AVS_vidinfo.fps_numerator / (double)AVS_vidinfo.fps_denominator, AVS_vidinfo.fps_numerator, AVS_vidinfo.fps_denominator);
+				sOutBuf = utils.StrFormat("Framerate:                 %11.3f (%u/%u)", (double)clipinfo.uiFPSNumerator / (double)clipinfo.uiFPSDenominator, clipinfo.uiFPSNumerator, clipinfo.uiFPSDenominator);
 		}
 		else
 			sOutBuf = "Framerate:                         n/a";
@@ -1114,109 +1854,38 @@ int main(int argc, char* argv[])
 		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n%s", sOutBuf.c_str());
 		sLogBuffer += sOutBuf;
 
-		if (!AVS_vidinfo.HasVideo())
-			sOutBuf = "       n/a";
-		else
-		{
-			switch (AVS_vidinfo.pixel_type)
-			{
-				case VideoInfo::CS_YV411:       sOutBuf = "     YV411"; break;
-				case VideoInfo::CS_YV24:        sOutBuf = "      YV24"; break;
-				case VideoInfo::CS_YV16:        sOutBuf = "      YV16"; break;
-				case VideoInfo::CS_Y8:          sOutBuf = "        Y8"; break;
-				case VideoInfo::CS_YV12:        sOutBuf = "      YV12"; break;
-				case VideoInfo::CS_I420:        sOutBuf = "      i420"; break;
-				case VideoInfo::CS_YUY2:        sOutBuf = "      YUY2"; break;
-				case VideoInfo::CS_BGR24:       sOutBuf = "     RGB24"; break;
-				case VideoInfo::CS_BGR32:       sOutBuf = "     RGB32"; break;
-				case VideoInfo::CS_YUV444P16:   sOutBuf = " YUV444P16"; break;
-				case VideoInfo::CS_YUV422P16:   sOutBuf = " YUV422P16"; break;
-				case VideoInfo::CS_YUV420P16:   sOutBuf = " YUV420P16"; break;
-				case VideoInfo::CS_YUV444PS:    sOutBuf = "  YUV444PS"; break;
-				case VideoInfo::CS_YUV422PS:    sOutBuf = "  YUV422PS"; break;
-				case VideoInfo::CS_YUV420PS:    sOutBuf = "  YUV420PS"; break;
-				case VideoInfo::CS_Y16:         sOutBuf = "       Y16"; break;
-				case VideoInfo::CS_Y32:         sOutBuf = "       Y32"; break;
-				case VideoInfo::CS_YUV444P10:   sOutBuf = " YUV444P10"; break;
-				case VideoInfo::CS_YUV422P10:   sOutBuf = " YUV422P10"; break;
-				case VideoInfo::CS_YUV420P10:   sOutBuf = " YUV420P10"; break;
-				case VideoInfo::CS_Y10:         sOutBuf = "       Y10"; break;
-				case VideoInfo::CS_YUV444P12:   sOutBuf = " YUV444P12"; break;
-				case VideoInfo::CS_YUV422P12:   sOutBuf = " YUV422P12"; break;
-				case VideoInfo::CS_YUV420P12:   sOutBuf = " YUV420P12"; break;
-				case VideoInfo::CS_Y12:         sOutBuf = "       Y12"; break;
-				case VideoInfo::CS_YUV444P14:   sOutBuf = " YUV444P14"; break;
-				case VideoInfo::CS_YUV422P14:   sOutBuf = " YUV422P14"; break;
-				case VideoInfo::CS_YUV420P14:   sOutBuf = " YUV420P14"; break;
-				case VideoInfo::CS_Y14:         sOutBuf = "       Y14"; break;
-				case VideoInfo::CS_BGR48:       sOutBuf = "     BGR48"; break;
-				case VideoInfo::CS_BGR64:       sOutBuf = "     BGR64"; break;
-				case VideoInfo::CS_RGBP:        sOutBuf = "      RGBP"; break;
-				case VideoInfo::CS_RGBP10:      sOutBuf = "    RGBP10"; break;
-				case VideoInfo::CS_RGBP12:      sOutBuf = "    RGBP12"; break;
-				case VideoInfo::CS_RGBP14:      sOutBuf = "    RGBP14"; break;
-				case VideoInfo::CS_RGBP16:      sOutBuf = "    RGBP16"; break;
-				case VideoInfo::CS_RGBPS:       sOutBuf = "     RGBPS"; break;
-				case VideoInfo::CS_RGBAP:       sOutBuf = "     RGBAP"; break;
-				case VideoInfo::CS_RGBAP10:     sOutBuf = "   RGBAP10"; break;
-				case VideoInfo::CS_RGBAP12:     sOutBuf = "   RGBAP12"; break;
-				case VideoInfo::CS_RGBAP14:     sOutBuf = "   RGBAP14"; break;
-				case VideoInfo::CS_RGBAP16:     sOutBuf = "   RGBAP16"; break;
-				case VideoInfo::CS_RGBAPS:      sOutBuf = "    RGBAPS"; break;
-				case VideoInfo::CS_YUVA444:     sOutBuf = "   YUVA444"; break;
-				case VideoInfo::CS_YUVA422:     sOutBuf = "   YUVA422"; break;
-				case VideoInfo::CS_YUVA420:     sOutBuf = "   YUVA420"; break;
-				case VideoInfo::CS_YUVA444P10:  sOutBuf = "YUVA444P10"; break;
-				case VideoInfo::CS_YUVA422P10:  sOutBuf = "YUVA422P10"; break;
-				case VideoInfo::CS_YUVA420P10:  sOutBuf = "YUVA420P10"; break;
-				case VideoInfo::CS_YUVA444P12:  sOutBuf = "YUVA444P12"; break;
-				case VideoInfo::CS_YUVA422P12:  sOutBuf = "YUVA422P12"; break;
-				case VideoInfo::CS_YUVA420P12:  sOutBuf = "YUVA420P12"; break;
-				case VideoInfo::CS_YUVA444P14:  sOutBuf = "YUVA444P14"; break;
-				case VideoInfo::CS_YUVA422P14:  sOutBuf = "YUVA422P14"; break;
-				case VideoInfo::CS_YUVA420P14:  sOutBuf = "YUVA420P14"; break;
-				case VideoInfo::CS_YUVA444P16:  sOutBuf = "YUVA444P16"; break;
-				case VideoInfo::CS_YUVA422P16:  sOutBuf = "YUVA422P16"; break;
-				case VideoInfo::CS_YUVA420P16:  sOutBuf = "YUVA420P16"; break;
-				case VideoInfo::CS_YUVA444PS:   sOutBuf = " YUVA444PS"; break;
-				case VideoInfo::CS_YUVA422PS:   sOutBuf = " YUVA422PS"; break;
-				case VideoInfo::CS_YUVA420PS:   sOutBuf = " YUVA420PS"; break;
-				case VideoInfo::CS_RAW32:       sOutBuf = "     RAW32"; break;
-				case VideoInfo::CS_YUV9:        sOutBuf = "      YUV9"; break;
-				default:                        sOutBuf = "   Unknown";
-			}
-		}
+		sOutBuf = clipinfo.sColorspace;
 
 		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "%s\n", sOutBuf.c_str());
 		sLogBuffer += sOutBuf + "\n";
 
-		if (bIsSETMTVersion)
+		if (frameserver->iMTMode >= 0)
 		{
-			sOutBuf = utils.StrFormat("Active MT Mode:                      %d", iMTMode);
+			sOutBuf = utils.StrFormat("Active MT Mode:                      %d", frameserver->iMTMode);
 			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "%s\n", sOutBuf.c_str());
 			sLogBuffer += sOutBuf + "\n";
 		}
 
 		sOutBuf = "Audio channels:    ";
 		sLogBuffer += sOutBuf;
-		if (AVS_vidinfo.HasAudio())
+		if (clipinfo.bHasAudio)
 			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "%s", sOutBuf.c_str());
 
-		if (AVS_vidinfo.nchannels)
-			sOutBuf = utils.StrFormat("%19d", AVS_vidinfo.nchannels);
+		if (clipinfo.iAudioChannels)
+			sOutBuf = utils.StrFormat("%19d", clipinfo.iAudioChannels);
 		else
 			sOutBuf = "                n/a";
 
 		sLogBuffer += sOutBuf + "\n";
-		if (AVS_vidinfo.HasAudio())
+		if (clipinfo.bHasAudio)
 			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "%s\n", sOutBuf.c_str());
 
 		sOutBuf = "Audio bits/sample: ";
 		sLogBuffer += sOutBuf;
-		if (AVS_vidinfo.HasAudio())
+		if (clipinfo.bHasAudio)
 			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "%s", sOutBuf.c_str());
 
-		switch (AVS_vidinfo.sample_type)
+		switch (clipinfo.iAudioSampleType)
 		{
 			case SAMPLE_INT8:  sOutBuf = "                  8";         break;
 			case SAMPLE_INT16: sOutBuf = "                 16";         break;
@@ -1227,44 +1896,40 @@ int main(int argc, char* argv[])
 		}
 
 		sLogBuffer += sOutBuf + "\n";
-		if (AVS_vidinfo.HasAudio())
+		if (clipinfo.bHasAudio)
 			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "%s\n", sOutBuf.c_str());
 
 		sOutBuf = "Audio sample rate: ";
 		sLogBuffer += sOutBuf;
-		if (AVS_vidinfo.HasAudio())
+		if (clipinfo.bHasAudio)
 			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "%s", sOutBuf.c_str());
 
-		if (AVS_vidinfo.audio_samples_per_second)
-			sOutBuf = utils.StrFormat("%19d", AVS_vidinfo.audio_samples_per_second);
+		if (clipinfo.iAudioSampleRate)
+			sOutBuf = utils.StrFormat("%19d", clipinfo.iAudioSampleRate);
 		else
 			sOutBuf = "                n/a";
 
 		sLogBuffer += sOutBuf + "\n";
-		if (AVS_vidinfo.HasAudio())
+		if (clipinfo.bHasAudio)
 			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "%s\n", sOutBuf.c_str());
 
 		sOutBuf = "Audio samples:     ";
 		sLogBuffer += sOutBuf;
-		if (AVS_vidinfo.HasAudio())
+		if (clipinfo.bHasAudio)
 			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "%s", sOutBuf.c_str());
 
-		if (AVS_vidinfo.num_audio_samples)
-			sOutBuf = utils.StrFormat("%19I64d", AVS_vidinfo.num_audio_samples);
+		if (clipinfo.iAudioSamples)
+			sOutBuf = utils.StrFormat("%19lld", clipinfo.iAudioSamples);
 		else
 			sOutBuf = "                n/a";
 
 		sLogBuffer += sOutBuf + "\n";
-		if (AVS_vidinfo.HasAudio())
+		if (clipinfo.bHasAudio)
 			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "%s\n", sOutBuf.c_str());
 
 		if (bInfoOnly)
 		{
-			AVS_clip = 0;
-			AVS_main = 0;
-			AVS_temp = 0;
-			AVS_env->DeleteScriptEnvironment();
-			AVS_env = 0;
+			frameserver->Release();
 
 			if (Settings.bCreateLog)
 			{
@@ -1273,8 +1938,8 @@ int main(int argc, char* argv[])
 					PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, sLogRet.c_str());
 			}
 
-			AVS_linkage = 0;
-			::FreeLibrary(hDLL);
+			frameserver->Unload();
+			delete frameserver;
 
 			PollKeys();
 			return 0;
@@ -1282,8 +1947,8 @@ int main(int argc, char* argv[])
 
 		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
 
-		if (!AVS_vidinfo.HasVideo())
-			AVS_env->ThrowError("Script did not return a video clip:\n%s", sAVSFile.c_str());
+		if (!clipinfo.bHasVideo)
+			frameserver->ThrowError(utils.StrFormat("Script did not return a video clip:\n%s", sAVSFile.c_str()));
 
 		unsigned int uiFramesToProcess = 0;
 		unsigned int uiFirstFrame = 0;
@@ -1304,7 +1969,25 @@ int main(int argc, char* argv[])
 		else
 		{
 			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s", Pad("").c_str());
-			AVS_env->ThrowError("Invalid frame range specified:\n\"%s\"\n", Settings.sFrameRange.c_str());
+			frameserver->ThrowError(utils.StrFormat("Invalid frame range specified:\n\"%s\"\n", Settings.sFrameRange.c_str()));
+		}
+
+		CFrameWriter framewriter;
+		stFramePlanes frameplanes;
+		if (CLSwitches_output)
+		{
+			if (!framewriter.Open(sOutputFile, bOutputY4M, clipinfo))
+				frameserver->ThrowError(framewriter.sError);
+
+			frameserver->uiHeldFrames = framewriter.uiHeldFrames;
+		}
+
+		CConsumer consumer;
+		if (CLSwitches_consumer)
+		{
+			consumer.Init(consumerparams, clipinfo);
+			if (consumer.params.uiRefs > frameserver->uiHeldFrames)
+				frameserver->uiHeldFrames = consumer.params.uiRefs;
 		}
 
 		while ((uiFramesToProcess / uiFrameInterval) > 100000)
@@ -1335,6 +2018,12 @@ int main(int argc, char* argv[])
 		unsigned int uiVPUUsageAcc = 0;
 		unsigned int uiVPUUsageAvg = 0;
 		unsigned int uiIntervalCounter = 0;
+		double dCPUMHzAcc = 0.0;
+		double dCPUMHzTimeMS = 0.0;
+		double dCPUMHzAvg = 0.0;
+		double dEnergyStart = 0.0;
+		double dEnergyPrev = 0.0;
+		double dEnergyCur = 0.0;
 
 		unsigned int uiCurrentFrame = 0;
 		double dFPSAverage = 0.0;
@@ -1342,26 +2031,65 @@ int main(int argc, char* argv[])
 		double dFPSMin = 1.0e+20;
 		double dFPSMax = 0.0;
 
+		CHistogram tpfhistogram;
+		size_t nHistogramIndex = 0;
+		stMetricsSnapshot metrics;
+
 		if (Settings.bGPUInfo)
 		{
 			gpuinfo.ReadSensors();
 			if (gpuinfo.sensors.ReadError)
-				AVS_env->ThrowError("Error reading GPU sensors\n");
+				frameserver->ThrowError("Error reading GPU sensors\n");
 		}
 
 		processinfo.Update();
+		cpufreqinfo.Update();
+
+		if (energyinfo.bInitialized)
+		{
+			energyinfo.Update();
+			dEnergyStart = energyinfo.dPackageJoules + energyinfo.dDRAMJoules;
+			dEnergyPrev = dEnergyStart;
+		}
+
+		stPerfCounterValues pcStart, pcPrev, pcCur, pcDelta;
+		double dPixelsPerFrame = (double)clipinfo.uiWidth * (double)clipinfo.uiHeight;
+		if (perfcounters.bInitialized)
+		{
+			perfcounters.Read(pcStart);
+			pcPrev = pcStart;
+		}
 
 		double dStartTime = timer.GetTimer();
 		double dCurrentTime = dStartTime;
 		double dLastDisplayTime = dStartTime;
 		double dLastIntervalTime = dStartTime;
 
+		frameserver->SetFrameRange(uiFirstFrame, uiLastFrame);
+
 		unsigned int uiCursorOffset = 0;
 		for (uiCurrentFrame = uiFirstFrame; uiCurrentFrame <= uiLastFrame; uiCurrentFrame++)
 		{
-			PVideoFrame src_frame = AVS_clip->GetFrame(uiCurrentFrame, AVS_env);
+			if (CLSwitches_output || CLSwitches_consumer)
+			{
+				frameserver->GetFramePlanes(uiCurrentFrame, frameplanes);
+				if (CLSwitches_output && !framewriter.WriteFrame(frameplanes))
+					frameserver->ThrowError(framewriter.sError);
+				if (CLSwitches_consumer)
+					consumer.Consume(frameplanes);
+			}
+			else
+				frameserver->GetFrame(uiCurrentFrame);
+
 			++uiFramesRead;
 
+			if (uiFramesRead == 1)
+			{
+				dCurrentTime = timer.GetTimer();
+				startup.dFirstFrameMS = (dCurrentTime - dStartTime) * 1000.0;
+				startup.dTimeToFirstFrameMS = (dCurrentTime - dStartupBegin) * 1000.0;
+			}
+
 			if (((uiFramesRead % uiFrameInterval) != 0) && (uiFramesRead != uiFramesToProcess))
 				continue;
 
@@ -1371,11 +2099,19 @@ int main(int argc, char* argv[])
 
 			++uiIntervalCounter;
 
+			//only new samples count, weighted with the time they cover (the first one is short)
+			if (cpufreqinfo.Update() && (cpufreqinfo.dSampleMS > 0.0))
+			{
+				dCPUMHzAcc += cpufreqinfo.dCurrentMHz * cpufreqinfo.dSampleMS;
+				dCPUMHzTimeMS += cpufreqinfo.dSampleMS;
+				dCPUMHzAvg = dCPUMHzAcc / dCPUMHzTimeMS;
+			}
+
 			if (Settings.bGPUInfo)
 			{
 				gpuinfo.ReadSensors();
 				if (gpuinfo.sensors.ReadError)
-					AVS_env->ThrowError("Error reading GPU sensors\n");
+					frameserver->ThrowError("Error reading GPU sensors\n");
 
 				uiGPUUsageCur = (unsigned int)gpuinfo.sensors.GPULoad;
 				uiGPUUsageAcc += uiGPUUsageCur;
@@ -1417,6 +2153,7 @@ int main(int argc, char* argv[])
 			pdata.fps_current = (float)dFPSCurrent;
 			pdata.fps_average = (float)dFPSAverage;
 			pdata.cpu_usage = processinfo.dCPUUsage;
+			pdata.busiest_thread = processinfo.dBusiestThreadUsage;
 
 			if (Settings.bGPUInfo)
 			{
@@ -1431,6 +2168,43 @@ int main(int argc, char* argv[])
 
 			pdata.num_threads = processinfo.wThreadCount;
 			pdata.process_memory = dwMemCurrentMB;
+
+			pdata.ipc = 0.0;
+			pdata.cycles_per_pixel = 0.0;
+			pdata.llc_misses = 0.0;
+			pdata.branch_misses = 0.0;
+			pdata.context_switches = 0.0;
+			if (perfcounters.bInitialized)
+			{
+				perfcounters.Read(pcCur);
+				perfcounters.Delta(pcCur, pcPrev, pcDelta);
+				pcPrev = pcCur;
+
+				if (pcDelta.uiValue[PERFCOUNTER_CYCLES] > 0)
+					pdata.ipc = (double)pcDelta.uiValue[PERFCOUNTER_INSTRUCTIONS] / (double)pcDelta.uiValue[PERFCOUNTER_CYCLES];
+				if (dPixelsPerFrame > 0.0)
+					pdata.cycles_per_pixel = (double)pcDelta.uiValue[PERFCOUNTER_CYCLES] / ((double)uiFrameInterval * dPixelsPerFrame);
+				pdata.llc_misses = (double)pcDelta.uiValue[PERFCOUNTER_LLC_MISSES] / (double)uiFrameInterval;
+				pdata.branch_misses = (double)pcDelta.uiValue[PERFCOUNTER_BRANCH_MISSES] / (double)uiFrameInterval;
+				pdata.context_switches = (double)pcDelta.uiValue[PERFCOUNTER_CONTEXT_SWITCHES] / (double)uiFrameInterval;
+			}
+
+			pdata.cpu_mhz = cpufreqinfo.dCurrentMHz;
+			pdata.throttled = cpufreqinfo.bThrottled ? 1 : 0;
+
+			pdata.power = 0.0;
+			pdata.energy_per_frame = 0.0;
+			if (energyinfo.bInitialized)
+			{
+				energyinfo.Update();
+				dEnergyCur = energyinfo.dPackageJoules + energyinfo.dDRAMJoules;
+				if ((dCurrentTime - dLastIntervalTime) > 0.000001)
+					pdata.power = (dEnergyCur - dEnergyPrev) / (dCurrentTime - dLastIntervalTime);
+				pdata.energy_per_frame = (dEnergyCur - dEnergyPrev) / (double)uiFrameInterval;
+				dEnergyPrev = dEnergyCur;
+			}
+
+			pdata.elapsed = dCurrentTime - dStartTime;
 			perfdata.push_back(pdata);
 
 			dLastIntervalTime = dCurrentTime;
@@ -1440,6 +2214,25 @@ int main(int argc, char* argv[])
 
 			dLastDisplayTime = dCurrentTime;
 
+			if (metricsexporter.bRunning)
+			{
+				for (; nHistogramIndex < perfdata.size(); nHistogramIndex++)
+					tpfhistogram.Add(1000.0 / (double)perfdata[nHistogramIndex].fps_current, uiFrameInterval);
+
+				metrics.uiFrame = uiCurrentFrame;
+				metrics.uiFramesRead = uiFramesRead;
+				metrics.dFPSCurrent = dFPSCurrent;
+				metrics.dFPSAverage = dFPSAverage;
+				metrics.uiFrameInterval = uiFrameInterval;
+				metrics.dTPFP50 = tpfhistogram.Percentile(50.0);
+				metrics.dTPFP90 = tpfhistogram.Percentile(90.0);
+				metrics.dTPFP99 = tpfhistogram.Percentile(99.0);
+				metrics.dwMemMB = dwMemCurrentMB;
+				metrics.dCPUUsage = dCPUUsageCur;
+				metrics.wThreadCount = processinfo.wThreadCount;
+				metricsexporter.Publish(metrics);
+			}
+
 			if (!bFirstScr)
 			{
 				utils.CursorUp(uiCursorOffset);
@@ -1486,6 +2279,13 @@ int main(int argc, char* argv[])
 				++uiCursorOffset;
 			}
 
+			if (cpufreqinfo.bInitialized)
+			{
+				sOutBuf = utils.StrFormat("CPU clock (current | average):  %.0f | %.0f MHz%s", cpufreqinfo.dCurrentMHz, dCPUMHzAvg, cpufreqinfo.bThrottled ? " (throttled)" : "");
+				PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+				++uiCursorOffset;
+			}
+
 			if (Settings.bGPUInfo)
 			{
 				PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
@@ -1555,11 +2355,46 @@ int main(int argc, char* argv[])
 			}
 		}
 
+		vector<stThreadCPUTime> threadtimes;
+		unsigned __int64 uiProcessCPUTime = 0;
+		processinfo.GetThreadCPUTimes(threadtimes, uiProcessCPUTime);
 		processinfo.CloseProcess();
 
+		if (perfcounters.bInitialized)
+		{
+			perfcounters.Read(pcCur);
+			perfcounters.Delta(pcCur, pcStart, pcDelta);
+			perfcounters.Close();
+		}
+
+		cpufreqinfo.Release();
+
+		if (energyinfo.bInitialized)
+		{
+			energyinfo.Update();
+			dEnergyCur = energyinfo.dPackageJoules + energyinfo.dDRAMJoules;
+			energyinfo.Release();
+		}
+
+		metricsexporter.Stop();
+
 		if (Settings.bGPUInfo)
 			gpuinfo.GPUZRelease();
 
+		//steady state begins after the last interval that deviates more than STEADY_STATE_TOLERANCE from the average
+		if ((perfdata.size() > 1) && (dFPSAverage > 0.0))
+		{
+			size_t nSteady = 0;
+			for (size_t nInterval = 0; nInterval < perfdata.size(); nInterval++)
+			{
+				if (fabs((double)perfdata[nInterval].fps_current - dFPSAverage) > (dFPSAverage * STEADY_STATE_TOLERANCE))
+					nSteady = nInterval + 1;
+			}
+
+			if (nSteady < perfdata.size())
+				startup.dTimeToSteadyStateMS = ((dStartTime - dStartupBegin) * 1000.0) + ((nSteady > 0) ? (perfdata[nSteady - 1].elapsed * 1000.0) : startup.dFirstFrameMS);
+		}
+
 		sLogBuffer += "\n\n[Runtime info]\n";
 
 		if (iElapsedMS >= MIN_RUNTIME)
@@ -1608,6 +2443,30 @@ int main(int argc, char* argv[])
 				PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
 				sLogBuffer += sOutBuf + "\n";
 
+				if ((threadtimes.size() > 0) && (uiProcessCPUTime > 0) && (dCurrentTime > dStartTime))
+				{
+					/*
+					Amdahl estimate: the work done by the busiest thread is treated as the
+					serial part, everything else is assumed to scale across all logical CPUs.
+					*/
+					SYSTEM_INFO si;
+					::GetSystemInfo(&si);
+					double dCPUs = (double)si.dwNumberOfProcessors;
+					double dWallTime = (dCurrentTime - dStartTime) * 1.0e+7; //100ns units
+					double dBusiest = (double)threadtimes[0].uiCPUTime;
+					double dSerial = dBusiest / (double)uiProcessCPUTime;
+					if (dSerial > 1.0)
+						dSerial = 1.0;
+
+					sOutBuf = utils.StrFormat("Busiest thread (usage | share): %.1f%% | %.1f%%", (100.0 * dBusiest) / dWallTime, 100.0 * dSerial);
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+
+					sOutBuf = utils.StrFormat("Parallelism (measured | max):   %.2f | %.2f (serial fraction: %.3f)", (double)uiProcessCPUTime / dWallTime, 1.0 / (dSerial + ((1.0 - dSerial) / dCPUs)), dSerial);
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+				}
+
 				if (Settings.bDisplayEfficiencyIndex)
 				{
 					sOutBuf = utils.StrFormat("Efficiency index:               %s", utils.StrFormatTPF(dFPSAverage / dCPUUsageAvg).c_str());
@@ -1615,54 +2474,214 @@ int main(int argc, char* argv[])
 					sLogBuffer += sOutBuf + "\n";
 				}
 
-				if (Settings.bGPUInfo)
+				if (Settings.bCPUFreqInfo && (dCPUMHzAvg > 0.0))
 				{
 					PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
 					sLogBuffer += "\n";
 
-					sOutBuf = utils.StrFormat("GPU usage (average):            %u%%", uiGPUUsageAvg);
+					if (cpufreqinfo.dNominalMHz > 0.0)
+						sOutBuf = utils.StrFormat("CPU clock (average | nominal):  %.0f | %.0f MHz (%s)", dCPUMHzAvg, cpufreqinfo.dNominalMHz, cpufreqinfo.sSource.c_str());
+					else
+						sOutBuf = utils.StrFormat("CPU clock (average | nominal):  %.0f MHz | unknown (%s)", dCPUMHzAvg, cpufreqinfo.sSource.c_str());
 					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
 					sLogBuffer += sOutBuf + "\n";
 
-					if (gpuinfo.data.NVVPU)
-					{
-						sOutBuf = utils.StrFormat("VPU usage (average):            %u%%", uiVPUUsageAvg);
-						PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
-						sLogBuffer += sOutBuf + "\n";
-					}
+					sOutBuf = utils.StrFormat("Throttled samples:              %u of %u", cpufreqinfo.uiThrottledSamples, cpufreqinfo.uiSamples);
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
 
-					if (gpuinfo.data.GeneralMem)
+					//FPS scaled to what the run would have achieved at the nominal clock
+					if (cpufreqinfo.dNominalMHz > 0.0)
 					{
-						sOutBuf = utils.StrFormat("GPU memory usage:               %u MiB", gpuinfo.sensors.MemoryUsedGeneral);
+						sOutBuf = utils.StrFormat("FPS (raw | at nominal clock):   %s | %s", utils.StrFormatFPS(dFPSAverage).c_str(), utils.StrFormatFPS(dFPSAverage * cpufreqinfo.dNominalMHz / dCPUMHzAvg).c_str());
 						PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
 						sLogBuffer += sOutBuf + "\n";
 					}
+				}
 
-					if (gpuinfo.data.DedicatedMem)
-					{
-						sOutBuf = utils.StrFormat("GPU memory usage (Dedicated):   %u MiB", gpuinfo.sensors.MemoryUsedDedicated);
-						PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
-						sLogBuffer += sOutBuf + "\n";
-					}
+				if (Settings.bEnergyInfo && (uiFramesRead > 0) && (dCurrentTime > dStartTime))
+				{
+					PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
+					sLogBuffer += "\n";
 
-					if (gpuinfo.data.DynamicMem)
+					double dJoules = dEnergyCur - dEnergyStart;
+					if (energyinfo.bDRAM)
+						sOutBuf = utils.StrFormat("Energy (package + DRAM):        %.1f J", dJoules);
+					else
+						sOutBuf = utils.StrFormat("Energy (package):               %.1f J", dJoules);
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+
+					sOutBuf = utils.StrFormat("Power (average):                %.1f W", dJoules / (dCurrentTime - dStartTime));
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+
+					sOutBuf = utils.StrFormat("Energy per frame:               %.4f J", dJoules / (double)uiFramesRead);
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+
+					if (dJoules > 0.0)
 					{
-						sOutBuf = utils.StrFormat("GPU memory usage (Dynamic):     %u MiB", gpuinfo.sensors.MemoryUsedDynamic);
+						sOutBuf = utils.StrFormat("Frames per kWh:                 %.0f", ((double)uiFramesRead * 3.6e+6) / dJoules);
 						PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
 						sLogBuffer += sOutBuf + "\n";
 					}
 				}
 
-				PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
-				sLogBuffer += "\n";
-			}
+				if (membench.dPeakMBs > 0.0)
+				{
+					PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
+					sLogBuffer += "\n";
 
-			if ((Settings.bLogEstimatedTime) && (uiFramesRead < uiFramesToProcess))
-				sOutBuf = utils.StrFormat("Time (elapsed | estimated):     %s | %s", timer.FormatTimeString(iElapsedMS, FALSE).c_str(), timer.FormatTimeString(iEstimatedMS, FALSE).c_str());
-			else
-				sOutBuf = utils.StrFormat("Time (elapsed):                 %s", timer.FormatTimeString(iElapsedMS, FALSE).c_str());
+					//output frame bytes only, the bytes a filter chain reads are not known
+					double dScriptMBs = (double)clipinfo.iFrameBytes * dFPSAverage / 1.0e+6;
+					sOutBuf = utils.StrFormat("Script bandwidth (frame x FPS): %.0f MB/s", dScriptMBs);
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
 
-			PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sOutBuf = utils.StrFormat("Share of machine bandwidth:     %.1f%% (of %.0f MB/s)", 100.0 * dScriptMBs / membench.dPeakMBs, membench.dPeakMBs);
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+				}
+
+				if (CLSwitches_output && (dCurrentTime > dStartTime))
+				{
+					PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
+					sLogBuffer += "\n";
+
+					sOutBuf = utils.StrFormat("Output written:                 %.1f MiB to %s", (double)framewriter.uiBytesWritten / 1048576.0, (sOutputFile == "-") ? "stdout" : sOutputFile.c_str());
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+
+					sOutBuf = utils.StrFormat("Output format | write call:     %s | %s", framewriter.sFormat.c_str(), framewriter.sMethod.c_str());
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+
+					//the write calls block while the consumer is busy, the rest is the script
+					double dRunSeconds = dCurrentTime - dStartTime;
+					sOutBuf = utils.StrFormat("Time blocked on output:         %.2f s (%.1f%%)", framewriter.dWriteSeconds, 100.0 * framewriter.dWriteSeconds / dRunSeconds);
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+
+					if (dRunSeconds > framewriter.dWriteSeconds)
+					{
+						sOutBuf = utils.StrFormat("FPS (generating frames only):   %s", utils.StrFormatFPS((double)uiFramesRead / (dRunSeconds - framewriter.dWriteSeconds)).c_str());
+						PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+						sLogBuffer += sOutBuf + "\n";
+					}
+				}
+
+				if (CLSwitches_consumer && (dCurrentTime > dStartTime))
+				{
+					PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
+					sLogBuffer += "\n";
+
+					sOutBuf = utils.StrFormat("Consumer:                       %s", consumer.GetDescription().c_str());
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+
+					double dRunSeconds = dCurrentTime - dStartTime;
+					sOutBuf = utils.StrFormat("Time in consumer:               %.2f s (%.1f%%)", consumer.dConsumerSeconds, 100.0 * consumer.dConsumerSeconds / dRunSeconds);
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+
+					if (dRunSeconds > consumer.dConsumerSeconds)
+					{
+						sOutBuf = utils.StrFormat("FPS (script share only):        %s", utils.StrFormatFPS((double)uiFramesRead / (dRunSeconds - consumer.dConsumerSeconds)).c_str());
+						PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+						sLogBuffer += sOutBuf + "\n";
+					}
+				}
+
+				if (Settings.bPerfCounters && (uiFramesRead > 0))
+				{
+					PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
+					sLogBuffer += "\n";
+
+					if (pcDelta.bValid[PERFCOUNTER_CYCLES] && pcDelta.bValid[PERFCOUNTER_INSTRUCTIONS] && (pcDelta.uiValue[PERFCOUNTER_CYCLES] > 0))
+						sOutBuf = utils.StrFormat("IPC | cycles per pixel:         %.2f | %.2f", (double)pcDelta.uiValue[PERFCOUNTER_INSTRUCTIONS] / (double)pcDelta.uiValue[PERFCOUNTER_CYCLES],
+							(double)pcDelta.uiValue[PERFCOUNTER_CYCLES] / ((double)uiFramesRead * dPixelsPerFrame));
+					else
+						sOutBuf = "IPC | cycles per pixel:         n/a";
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+
+					if (pcDelta.bValid[PERFCOUNTER_LLC_MISSES] && pcDelta.bValid[PERFCOUNTER_BRANCH_MISSES])
+						sOutBuf = utils.StrFormat("Misses/frame (LLC | branch):    %.0f | %.0f", (double)pcDelta.uiValue[PERFCOUNTER_LLC_MISSES] / (double)uiFramesRead,
+							(double)pcDelta.uiValue[PERFCOUNTER_BRANCH_MISSES] / (double)uiFramesRead);
+					else
+						sOutBuf = "Misses/frame (LLC | branch):    n/a";
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+
+					if (pcDelta.bValid[PERFCOUNTER_TASK_CLOCK] && pcDelta.bValid[PERFCOUNTER_CONTEXT_SWITCHES])
+					{
+						sOutBuf = utils.StrFormat("Task clock | context switches:  %.3f s | %.1f per frame", (double)pcDelta.uiValue[PERFCOUNTER_TASK_CLOCK] / 1.0e+9,
+							(double)pcDelta.uiValue[PERFCOUNTER_CONTEXT_SWITCHES] / (double)uiFramesRead);
+						PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+						sLogBuffer += sOutBuf + "\n";
+					}
+				}
+
+				if (Settings.bGPUInfo)
+				{
+					PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
+					sLogBuffer += "\n";
+
+					sOutBuf = utils.StrFormat("GPU usage (average):            %u%%", uiGPUUsageAvg);
+					PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+					sLogBuffer += sOutBuf + "\n";
+
+					if (gpuinfo.data.NVVPU)
+					{
+						sOutBuf = utils.StrFormat("VPU usage (average):            %u%%", uiVPUUsageAvg);
+						PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+						sLogBuffer += sOutBuf + "\n";
+					}
+
+					if (gpuinfo.data.GeneralMem)
+					{
+						sOutBuf = utils.StrFormat("GPU memory usage:               %u MiB", gpuinfo.sensors.MemoryUsedGeneral);
+						PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+						sLogBuffer += sOutBuf + "\n";
+					}
+
+					if (gpuinfo.data.DedicatedMem)
+					{
+						sOutBuf = utils.StrFormat("GPU memory usage (Dedicated):   %u MiB", gpuinfo.sensors.MemoryUsedDedicated);
+						PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+						sLogBuffer += sOutBuf + "\n";
+					}
+
+					if (gpuinfo.data.DynamicMem)
+					{
+						sOutBuf = utils.StrFormat("GPU memory usage (Dynamic):     %u MiB", gpuinfo.sensors.MemoryUsedDynamic);
+						PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+						sLogBuffer += sOutBuf + "\n";
+					}
+				}
+
+				PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
+				sLogBuffer += "\n";
+			}
+
+			if ((Settings.bLogEstimatedTime) && (uiFramesRead < uiFramesToProcess))
+				sOutBuf = utils.StrFormat("Time (elapsed | estimated):     %s | %s", timer.FormatTimeString(iElapsedMS, FALSE).c_str(), timer.FormatTimeString(iEstimatedMS, FALSE).c_str());
+			else
+				sOutBuf = utils.StrFormat("Time (elapsed):                 %s", timer.FormatTimeString(iElapsedMS, FALSE).c_str());
+
+			PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+			sLogBuffer += sOutBuf + "\n";
+
+			sOutBuf = utils.StrFormat("Time to first frame (cold):     %.1f ms", coldstartup.dTimeToFirstFrameMS);
+			PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
+			sLogBuffer += sOutBuf + "\n";
+
+			if (startup.dTimeToSteadyStateMS >= 0.0)
+				sOutBuf = utils.StrFormat("Time to steady state (%s):     %.1f ms", startup.bCold ? "cold" : "warm", startup.dTimeToSteadyStateMS);
+			else
+				sOutBuf = utils.StrFormat("Time to steady state (%s):     n/a", startup.bCold ? "cold" : "warm");
+			PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\r%s\n", Pad(sOutBuf).c_str());
 			sLogBuffer += sOutBuf + "\n";
 
 			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\n", Pad("").c_str());
@@ -1686,12 +2705,36 @@ int main(int argc, char* argv[])
 			bRuntimeTooShort = TRUE;
 		}
 
-		AVS_clip = 0;
-		AVS_main = 0;
-		AVS_temp = 0;
-		AVS_env->DeleteScriptEnvironment();
-		AVS_env = 0;
-		AVS_linkage = 0;
+		if (!bRuntimeTooShort && (threadtimes.size() > 0) && (dCurrentTime > dStartTime))
+		{
+			sLogBuffer += "\n\n[Thread CPU time]\n   Thread ID    CPU time(s)   Usage(%)   Share(%)\n";
+			for (size_t uiThread = 0; uiThread < threadtimes.size(); uiThread++)
+			{
+				sOutBuf = utils.StrFormat("%12u %14.3f %10.1f %10.1f", threadtimes[uiThread].dwThreadID, (double)threadtimes[uiThread].uiCPUTime / 1.0e+7,
+					(100.0 * (double)threadtimes[uiThread].uiCPUTime) / ((dCurrentTime - dStartTime) * 1.0e+7),
+					(uiProcessCPUTime > 0) ? (100.0 * (double)threadtimes[uiThread].uiCPUTime) / (double)uiProcessCPUTime : 0.0);
+				sLogBuffer += sOutBuf + "\n";
+			}
+		}
+
+		sLogBuffer += "\n\n[Startup latency, cold (first load of the script, library already probed)]\n";
+		sLogBuffer += StartupLogText(coldstartup);
+		if (!startup.bCold)
+		{
+			sLogBuffer += "\n\n[Startup latency, warm (benchmark run after the pre-scan)]\n";
+			sLogBuffer += StartupLogText(startup);
+		}
+
+		if (!bRuntimeTooShort)
+		{
+			sJSONRuntime  = utils.StrFormat("\t\t\"frames\": %u,\n", uiFramesRead);
+			sJSONRuntime += "\t\t\"fps_min\": " + JSONNumber(dFPSMin, 3) + ",\n";
+			sJSONRuntime += "\t\t\"fps_max\": " + JSONNumber(dFPSMax, 3) + ",\n";
+			sJSONRuntime += "\t\t\"fps_average\": " + JSONNumber(dFPSAverage, 3) + ",\n";
+			sJSONRuntime += utils.StrFormat("\t\t\"elapsed_ms\": %lld\n", iElapsedMS);
+		}
+
+		frameserver->Release();
 	}
 	catch (AvisynthError err)
 	{
@@ -1748,7 +2791,8 @@ int main(int argc, char* argv[])
 			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", sAVSError.c_str());
 	}
 
-	::FreeLibrary(hDLL);
+	frameserver->Unload();
+	delete frameserver;
 
 	if (Settings.bCreateLog)
 	{
@@ -1763,7 +2807,7 @@ int main(int argc, char* argv[])
 
 	if (Settings.bCreateCSV && !bRuntimeTooShort && (sAVSError == ""))
 	{
-		string cr = CreateCSVFile(sAVSFile, perfdata, gpuinfo.data.NVVPU);
+		string cr = CreateCSVFile(sAVSFile, perfdata, gpuinfo.data.NVVPU, cpufreqinfo.dNominalMHz);
 		if (cr != "")
 		{
 			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, cr.c_str());
@@ -1772,6 +2816,17 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	if (CLSwitches_json)
+	{
+		string jr = CreateJSONFile(sJSONFile, sAVSFile, sServerVersion, coldstartup, startup, sJSONRuntime, sAVSError);
+		if (jr != "")
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, jr.c_str());
+			PollKeys();
+			return -1;
+		}
+	}
+
 	SetErrorMode(nPrevErrorMode);
 
 	PollKeys();
@@ -1794,11 +2849,12 @@ string ParseINIFile()
 		size_t i = 0;
 		for (i = (sProgramPath.length() - 1); i > 0; i--)
 		{
-			if (sProgramPath[i] == '\\')
+			if (sProgramPath[i] == PATH_SEPARATOR)
 				break;
 		}
 		sProgramPath = sProgramPath.substr(0, i);
-		sINIFile = sProgramPath + "\\AVSMeter.ini";
+		sINIFile = sProgramPath + PATH_SEPARATOR_STR "AVSMeter.ini";
+		Settings.sPluginCacheFile = sProgramPath + PATH_SEPARATOR_STR + (PROCESS_64 ? "AVSMeter_plugins_x64.cache" : "AVSMeter_plugins_x86.cache");
 	}
 
 	string sCurrentLine = "";
@@ -1806,6 +2862,7 @@ string ParseINIFile()
 	//defaults
 	Settings.sLogDirectory = "";
 	Settings.sAVSDLL = "";
+	Settings.sVSScriptDLL = "";
 	Settings.bDisplayFPS = TRUE;
 	Settings.bDisplayTPF = FALSE;
 	Settings.bCreateLog = FALSE;
@@ -1825,6 +2882,16 @@ string ParseINIFile()
 	Settings.bLogEstimatedTime = FALSE;
 	Settings.bAutoCompleteExtension = FALSE;
 	Settings.bLogUseFileSaveDialog = FALSE;
+	Settings.bPerfCounters = FALSE;
+	Settings.bCPUFreqInfo = FALSE;
+	Settings.bEnergyInfo = FALSE;
+	Settings.bMemBench = FALSE;
+	Settings.sPowercapRoot = "";
+	Settings.sMetrics = "";
+	Settings.bPluginCache = TRUE;
+	Settings.uiPluginTestWorkers = 0;
+	Settings.uiVSRequests = 0;
+	Settings.uiPluginTestTimeout = 30;
 
 	if (!utils.FileExists(sINIFile)) //No ini file present, create the file with defaults
 	{
@@ -1862,7 +2929,7 @@ string ParseINIFile()
 		if (sCurrentLine.substr(0, 12) == "logdirectory")
 		{
 			Settings.sLogDirectory = sOrgLine.substr(13);
-			Settings.sLogDirectory.erase(Settings.sLogDirectory.find_last_not_of("\\") + 1); //remove trailing bs if present
+			Settings.sLogDirectory.erase(Settings.sLogDirectory.find_last_not_of(PATH_SEPARATOR) + 1); //remove trailing bs if present
 			utils.StrTrim(Settings.sLogDirectory);
 			if ((!utils.DirectoryExists(Settings.sLogDirectory)) && (Settings.sLogDirectory != ""))
 			{
@@ -1882,6 +2949,31 @@ string ParseINIFile()
 			}
 			continue;
 		}
+		if (sCurrentLine.substr(0, 11) == "vsscriptdll")
+		{
+			Settings.sVSScriptDLL = sOrgLine.substr(12);
+			utils.StrTrim(Settings.sVSScriptDLL);
+			if ((!utils.FileExists(Settings.sVSScriptDLL)) && (Settings.sVSScriptDLL != ""))
+			{
+				sRet = utils.StrFormat("\nThe file specified in AVSMeter.ini does not exist:\nVSScriptDLL=%s\n", Settings.sVSScriptDLL.c_str());
+				return sRet;
+			}
+			continue;
+		}
+
+		if (sCurrentLine.substr(0, 12) == "powercaproot")
+		{
+			Settings.sPowercapRoot = sOrgLine.substr(13);
+			utils.StrTrim(Settings.sPowercapRoot);
+			continue;
+		}
+
+		if (sCurrentLine.substr(0, 7) == "metrics")
+		{
+			Settings.sMetrics = sOrgLine.substr(8);
+			utils.StrTrim(Settings.sMetrics);
+			continue;
+		}
 
 		if (sCurrentLine.substr(0, 15) == "processpriority")
 		{
@@ -1950,6 +3042,45 @@ string ParseINIFile()
 		}
 
 
+		if (sCurrentLine.substr(0, 17) == "plugintestworkers")
+		{
+			sTemp = sCurrentLine.substr(18);
+			if (utils.IsNumeric(sTemp) && (atoi(sTemp.c_str()) >= 0) && (atoi(sTemp.c_str()) <= 64))
+				Settings.uiPluginTestWorkers = (unsigned int)atoi(sTemp.c_str());
+			else
+			{
+				sRet = utils.StrFormat("\nINI setting is invalid:\n\"%s\"\nValue must be between \'0\' (test in process) and \'64\'\n", sOrgLine.c_str());
+				return sRet;
+			}
+			continue;
+		}
+
+		if (sCurrentLine.substr(0, 10) == "vsrequests")
+		{
+			sTemp = sCurrentLine.substr(11);
+			if (utils.IsNumeric(sTemp) && (atoi(sTemp.c_str()) >= 0) && (atoi(sTemp.c_str()) <= 256))
+				Settings.uiVSRequests = (unsigned int)atoi(sTemp.c_str());
+			else
+			{
+				sRet = utils.StrFormat("\nINI setting is invalid:\n\"%s\"\nValue must be between \'0\' (number of logical CPUs) and \'256\'\n", sOrgLine.c_str());
+				return sRet;
+			}
+			continue;
+		}
+
+		if (sCurrentLine.substr(0, 17) == "plugintesttimeout")
+		{
+			sTemp = sCurrentLine.substr(18);
+			if (utils.IsNumeric(sTemp) && (atoi(sTemp.c_str()) >= 1) && (atoi(sTemp.c_str()) <= 3600))
+				Settings.uiPluginTestTimeout = (unsigned int)atoi(sTemp.c_str());
+			else
+			{
+				sRet = utils.StrFormat("\nINI setting is invalid:\n\"%s\"\nValue must be between \'1\' and \'3600\' (seconds)\n", sOrgLine.c_str());
+				return sRet;
+			}
+			continue;
+		}
+
 		iBoolValue = -1;
 		if (sCurrentLine.length() > 3)
 		{
@@ -2003,6 +3134,21 @@ string ParseINIFile()
 
 			if (sCurrentLine.substr(0, 20) == "logusefilesavedialog")
 				Settings.bLogUseFileSaveDialog = (iBoolValue == 0) ? FALSE : TRUE;
+
+			if (sCurrentLine.substr(0, 12) == "perfcounters")
+				Settings.bPerfCounters = (iBoolValue == 0) ? FALSE : TRUE;
+
+			if (sCurrentLine.substr(0, 15) == "monitorcpuclock")
+				Settings.bCPUFreqInfo = (iBoolValue == 0) ? FALSE : TRUE;
+
+			if (sCurrentLine.substr(0, 13) == "measureenergy")
+				Settings.bEnergyInfo = (iBoolValue == 0) ? FALSE : TRUE;
+
+			if (sCurrentLine.substr(0, 15) == "memorybenchmark")
+				Settings.bMemBench = (iBoolValue == 0) ? FALSE : TRUE;
+
+			if (sCurrentLine.substr(0, 11) == "plugincache")
+				Settings.bPluginCache = (iBoolValue == 0) ? FALSE : TRUE;
 		}
 	}
 
@@ -2037,10 +3183,14 @@ BOOL WriteINIFile(string &s_inifile)
 	sSettings = utils.StrFormat("DisplayFPS=%u\n", Settings.bDisplayFPS);
 	sSettings += utils.StrFormat("DisplayTPF=%u\n", Settings.bDisplayTPF);
 	sSettings += utils.StrFormat("MonitorGPULoad=%u\n", Settings.bGPUInfo);
+	sSettings += utils.StrFormat("PerfCounters=%u\n", Settings.bPerfCounters);
+	sSettings += utils.StrFormat("MonitorCPUClock=%u\n", Settings.bCPUFreqInfo);
+	sSettings += utils.StrFormat("MeasureEnergy=%u\n", Settings.bEnergyInfo);
+	sSettings += utils.StrFormat("MemoryBenchmark=%u\n", Settings.bMemBench);
 	sSettings += utils.StrFormat("DisplayEfficiencyIndex=%u\n\n", Settings.bDisplayEfficiencyIndex);
 
-	sSettings += utils.StrFormat("TimeLimit=%I64d\n", Settings.iTimeLimit);
-	sSettings += utils.StrFormat("FrameRange=%I64d,%I64d\n\n", Settings.iStartFrame, Settings.iStopFrame);
+	sSettings += utils.StrFormat("TimeLimit=%lld\n", Settings.iTimeLimit);
+	sSettings += utils.StrFormat("FrameRange=%lld,%lld\n\n", Settings.iStartFrame, Settings.iStopFrame);
 
 	sSettings += utils.StrFormat("CreateLog=%u\n", Settings.bCreateLog);
 	sSettings += utils.StrFormat("CreateCSV=%u\n", Settings.bCreateCSV);
@@ -2048,7 +3198,15 @@ BOOL WriteINIFile(string &s_inifile)
 	sSettings += utils.StrFormat("LogFileDateTimeSuffix=%u\n", Settings.bLogFileDateTimeSuffix);
 	sSettings += utils.StrFormat("LogUseFileSaveDialog=%u\n\n", Settings.bLogUseFileSaveDialog);
 
-	sSettings += utils.StrFormat("AVSDLL=%s\n\n", Settings.sAVSDLL.c_str());
+	sSettings += utils.StrFormat("PluginCache=%u\n", Settings.bPluginCache);
+	sSettings += utils.StrFormat("PluginTestWorkers=%u\n", Settings.uiPluginTestWorkers);
+	sSettings += utils.StrFormat("PluginTestTimeout=%u\n\n", Settings.uiPluginTestTimeout);
+
+	sSettings += utils.StrFormat("AVSDLL=%s\n", Settings.sAVSDLL.c_str());
+	sSettings += utils.StrFormat("VSScriptDLL=%s\n", Settings.sVSScriptDLL.c_str());
+	sSettings += utils.StrFormat("VSRequests=%u\n", Settings.uiVSRequests);
+	sSettings += utils.StrFormat("PowercapRoot=%s\n", Settings.sPowercapRoot.c_str());
+	sSettings += utils.StrFormat("Metrics=%s\n\n", Settings.sMetrics.c_str());
 
 	sSettings += utils.StrFormat("AllowOnlyOneInstance=%u\n", Settings.bAllowOnlyOneInstance);
 	sSettings += utils.StrFormat("ProcessPriority=%u\n", Settings.nProcessPriority);
@@ -2074,31 +3232,40 @@ string CreateLogFile(string &s_avsfile, string &s_logbuffer, string &s_gpuinfo,
 	string sRet = "";
 	string sAVSBuffer = "";
 	string sCurrentLine = "";
+	string sScriptFile = s_avsfile;
 
-	ifstream hAVSFile(s_avsfile.c_str());
-	if (!hAVSFile.is_open())
+	if (CSyntheticSource::IsSyntheticSpec(s_avsfile))
 	{
-		sRet = utils.StrFormat("\nCannot open \"%s\"\n", s_avsfile.c_str());
-		return sRet;
+		sAVSBuffer = "#" + s_avsfile;
+		sScriptFile = "." PATH_SEPARATOR_STR + CSyntheticSource::GetOutputName(s_avsfile);
 	}
+	else
+	{
+		ifstream hAVSFile(s_avsfile.c_str());
+		if (!hAVSFile.is_open())
+		{
+			sRet = utils.StrFormat("\nCannot open \"%s\"\n", s_avsfile.c_str());
+			return sRet;
+		}
 
-	while (getline(hAVSFile, sCurrentLine))
-		sAVSBuffer += sCurrentLine + "\n";
+		while (getline(hAVSFile, sCurrentLine))
+			sAVSBuffer += sCurrentLine + "\n";
 
-	hAVSFile.close();
-	utils.StrTrim(sAVSBuffer);
+		hAVSFile.close();
+		utils.StrTrim(sAVSBuffer);
+	}
 
 	string sLogFile = "";
-	size_t ilen = s_avsfile.length();
+	size_t ilen = sScriptFile.length();
 	ofstream hLogFile;
 
 	if (Settings.bLogUseFileSaveDialog)
 	{
-		sLogFile = s_avsfile.substr(0, ilen - 4) + ".log";
+		sLogFile = sScriptFile.substr(0, ilen - 4) + ".log";
 
 		for (ilen = (sLogFile.length() - 1); ilen > 0; ilen--)
 		{
-			if (sLogFile[ilen] == '\\')
+			if (sLogFile[ilen] == PATH_SEPARATOR)
 				break;
 		}
 
@@ -2117,7 +3284,7 @@ string CreateLogFile(string &s_avsfile, string &s_logbuffer, string &s_gpuinfo,
 		ofn.lpstrFile         = szLogFile;
 		ofn.nMaxFile          = MAX_PATH;
 		ofn.lpstrFileTitle    = NULL;
-		ofn.nMaxFileTitle     = NULL;
+		ofn.nMaxFileTitle     = 0;
 		ofn.lpstrInitialDir   = ".";
 		ofn.lpstrTitle        = "Save log file as...";
 		ofn.nFileOffset       = 0;
@@ -2147,16 +3314,16 @@ string CreateLogFile(string &s_avsfile, string &s_logbuffer, string &s_gpuinfo,
 		if (ilen > 4)
 		{
 			if (Settings.bLogFileDateTimeSuffix)
-				sLogFile = s_avsfile.substr(0, ilen - 4) + " [" + Settings.sSystemDateTime + "].log";
+				sLogFile = sScriptFile.substr(0, ilen - 4) + " [" + Settings.sSystemDateTime + "].log";
 			else
-				sLogFile = s_avsfile.substr(0, ilen - 4) + ".log";
+				sLogFile = sScriptFile.substr(0, ilen - 4) + ".log";
 		}
 		else
 		{
 			if (Settings.bLogFileDateTimeSuffix)
-				sLogFile = s_avsfile + " [" + Settings.sSystemDateTime + "].log";
+				sLogFile = sScriptFile + " [" + Settings.sSystemDateTime + "].log";
 			else
-				sLogFile = s_avsfile + ".log";
+				sLogFile = sScriptFile + ".log";
 		}
 
 		if (Settings.sLogDirectory != "")
@@ -2164,9 +3331,9 @@ string CreateLogFile(string &s_avsfile, string &s_logbuffer, string &s_gpuinfo,
 			size_t sLen = sLogFile.length();
 			for (size_t nPos = (sLen - 1); nPos > 0; nPos--)
 			{
-				if (sLogFile[nPos] == '\\')
+				if (sLogFile[nPos] == PATH_SEPARATOR)
 				{
-					sLogFile = Settings.sLogDirectory + "\\" + sLogFile.substr(nPos + 1);
+					sLogFile = Settings.sLogDirectory + PATH_SEPARATOR_STR + sLogFile.substr(nPos + 1);
 					break;
 				}
 			}
@@ -2198,12 +3365,12 @@ string CreateLogFile(string &s_avsfile, string &s_logbuffer, string &s_gpuinfo,
 		if (Settings.bGPUInfo)
 		{
 			if (bNVVP)
-				sLog = "\n[Performance data]\n       Frame    Frames/sec   Time/frame(ms)   CPU(%)   GPU(%)   VPU(%)   Threads   Memory(MiB)\n";
+				sLog = "\n[Performance data]\n       Frame    Frames/sec   Time/frame(ms)   CPU(%)   Thread(%)   GPU(%)   VPU(%)   Threads   Memory(MiB)\n";
 			else
-				sLog = "\n[Performance data]\n       Frame    Frames/sec   Time/frame(ms)   CPU(%)   GPU(%)   Threads   Memory(MiB)\n";
+				sLog = "\n[Performance data]\n       Frame    Frames/sec   Time/frame(ms)   CPU(%)   Thread(%)   GPU(%)   Threads   Memory(MiB)\n";
 		}
 		else
-			sLog = "\n[Performance data]\n       Frame    Frames/sec   Time/frame(ms)   CPU(%)   Threads   Memory(MiB)\n";
+			sLog = "\n[Performance data]\n       Frame    Frames/sec   Time/frame(ms)   CPU(%)   Thread(%)   Threads   Memory(MiB)\n";
 
 
 		hLogFile << sLog;
@@ -2219,12 +3386,12 @@ string CreateLogFile(string &s_avsfile, string &s_logbuffer, string &s_gpuinfo,
 			if (Settings.bGPUInfo)
 			{
 				if (bNVVP)
-					stemp2 = utils.StrFormat("%s%u %13.3f %16.6f %8.1f %8u %8u %9u %13u", spad.c_str(), uiFrame, cs_pdata[i].fps_current, 1000.0 / cs_pdata[i].fps_current, cs_pdata[i].cpu_usage, cs_pdata[i].gpu_usage, cs_pdata[i].vpu_usage, cs_pdata[i].num_threads, cs_pdata[i].process_memory);
+					stemp2 = utils.StrFormat("%s%u %13.3f %16.6f %8.1f %11.1f %8u %8u %9u %13u", spad.c_str(), uiFrame, cs_pdata[i].fps_current, 1000.0 / cs_pdata[i].fps_current, cs_pdata[i].cpu_usage, cs_pdata[i].busiest_thread, cs_pdata[i].gpu_usage, cs_pdata[i].vpu_usage, cs_pdata[i].num_threads, cs_pdata[i].process_memory);
 				else
-					stemp2 = utils.StrFormat("%s%u %13.3f %16.6f %8.1f %8u %9u %13u", spad.c_str(), uiFrame, cs_pdata[i].fps_current, 1000.0 / cs_pdata[i].fps_current, cs_pdata[i].cpu_usage, cs_pdata[i].gpu_usage, cs_pdata[i].num_threads, cs_pdata[i].process_memory);
+					stemp2 = utils.StrFormat("%s%u %13.3f %16.6f %8.1f %11.1f %8u %9u %13u", spad.c_str(), uiFrame, cs_pdata[i].fps_current, 1000.0 / cs_pdata[i].fps_current, cs_pdata[i].cpu_usage, cs_pdata[i].busiest_thread, cs_pdata[i].gpu_usage, cs_pdata[i].num_threads, cs_pdata[i].process_memory);
 			}
 			else
-				stemp2 = utils.StrFormat("%s%u %13.3f %16.6f %8.1f %9u %13u", spad.c_str(), uiFrame, cs_pdata[i].fps_current, 1000.0 / cs_pdata[i].fps_current, cs_pdata[i].cpu_usage, cs_pdata[i].num_threads, cs_pdata[i].process_memory);
+				stemp2 = utils.StrFormat("%s%u %13.3f %16.6f %8.1f %11.1f %9u %13u", spad.c_str(), uiFrame, cs_pdata[i].fps_current, 1000.0 / cs_pdata[i].fps_current, cs_pdata[i].cpu_usage, cs_pdata[i].busiest_thread, cs_pdata[i].num_threads, cs_pdata[i].process_memory);
 
 			hLogFile << stemp2 + "\n";
 		}
@@ -2237,21 +3404,22 @@ string CreateLogFile(string &s_avsfile, string &s_logbuffer, string &s_gpuinfo,
 }
 
 
-string CreateCSVFile(string &s_avsfile, vector<stPerfData> &cs_pdata, BOOL bNVVP)
+string CreateCSVFile(string &s_avsfile, vector<stPerfData> &cs_pdata, BOOL bNVVP, double d_nominalmhz)
 {
 	string sRet = "";
 
+	string sScriptFile = CSyntheticSource::IsSyntheticSpec(s_avsfile) ? ("." PATH_SEPARATOR_STR + CSyntheticSource::GetOutputName(s_avsfile)) : s_avsfile;
 	string sCSVFile = "";
-	size_t ilen = s_avsfile.length();
+	size_t ilen = sScriptFile.length();
 	ofstream hCSVFile;
 
 	if (Settings.bLogUseFileSaveDialog)
 	{
-		sCSVFile = s_avsfile.substr(0, ilen - 4) + ".csv";
+		sCSVFile = sScriptFile.substr(0, ilen - 4) + ".csv";
 
 		for (ilen = (sCSVFile.length() - 1); ilen > 0; ilen--)
 		{
-			if (sCSVFile[ilen] == '\\')
+			if (sCSVFile[ilen] == PATH_SEPARATOR)
 				break;
 		}
 
@@ -2270,7 +3438,7 @@ string CreateCSVFile(string &s_avsfile, vector<stPerfData> &cs_pdata, BOOL bNVVP
 		ofn.lpstrFile         = szCSVFile;
 		ofn.nMaxFile          = MAX_PATH;
 		ofn.lpstrFileTitle    = NULL;
-		ofn.nMaxFileTitle     = NULL;
+		ofn.nMaxFileTitle     = 0;
 		ofn.lpstrInitialDir   = ".";
 		ofn.lpstrTitle        = "Save CSV file as...";
 		ofn.nFileOffset       = 0;
@@ -2300,16 +3468,16 @@ string CreateCSVFile(string &s_avsfile, vector<stPerfData> &cs_pdata, BOOL bNVVP
 		if (ilen > 4)
 		{
 			if (Settings.bLogFileDateTimeSuffix)
-				sCSVFile = s_avsfile.substr(0, ilen - 4) + " [" + Settings.sSystemDateTime + "].csv";
+				sCSVFile = sScriptFile.substr(0, ilen - 4) + " [" + Settings.sSystemDateTime + "].csv";
 			else
-				sCSVFile = s_avsfile.substr(0, ilen - 4) + ".csv";
+				sCSVFile = sScriptFile.substr(0, ilen - 4) + ".csv";
 		}
 		else
 		{
 			if (Settings.bLogFileDateTimeSuffix)
-				sCSVFile = s_avsfile + " [" + Settings.sSystemDateTime + "].csv";
+				sCSVFile = sScriptFile + " [" + Settings.sSystemDateTime + "].csv";
 			else
-				sCSVFile = s_avsfile + ".csv";
+				sCSVFile = sScriptFile + ".csv";
 		}
 
 		if (Settings.sLogDirectory != "")
@@ -2317,9 +3485,9 @@ string CreateCSVFile(string &s_avsfile, vector<stPerfData> &cs_pdata, BOOL bNVVP
 			size_t sLen = sCSVFile.length();
 			for (size_t nPos = (sLen - 1); nPos > 0; nPos--)
 			{
-				if (sCSVFile[nPos] == '\\')
+				if (sCSVFile[nPos] == PATH_SEPARATOR)
 				{
-					sCSVFile = Settings.sLogDirectory + "\\" + sCSVFile.substr(nPos + 1);
+					sCSVFile = Settings.sLogDirectory + PATH_SEPARATOR_STR + sCSVFile.substr(nPos + 1);
 					break;
 				}
 			}
@@ -2340,12 +3508,21 @@ string CreateCSVFile(string &s_avsfile, vector<stPerfData> &cs_pdata, BOOL bNVVP
 		if (Settings.bGPUInfo)
 		{
 			if (bNVVP)
-				sCSV = "Frame,Frames/sec,Frames/sec(average),Time/frame(ms),Time/frame(average)(ms),CPU(%),GPU(%),VPU(%),Threads,Memory(MiB)\n";
+				sCSV = "Frame,Frames/sec,Frames/sec(average),Time/frame(ms),Time/frame(average)(ms),CPU(%),Thread(%),GPU(%),VPU(%),Threads,Memory(MiB)\n";
 			else
-				sCSV = "Frame,Frames/sec,Frames/sec(average),Time/frame(ms),Time/frame(average)(ms),CPU(%),GPU(%),Threads,Memory(MiB)\n";
+				sCSV = "Frame,Frames/sec,Frames/sec(average),Time/frame(ms),Time/frame(average)(ms),CPU(%),Thread(%),GPU(%),Threads,Memory(MiB)\n";
 		}
 		else
-			sCSV = "Frame,Frames/sec,Frames/sec(average),Time/frame(ms),Time/frame(average)(ms),CPU(%),Threads,Memory(MiB)\n";
+			sCSV = "Frame,Frames/sec,Frames/sec(average),Time/frame(ms),Time/frame(average)(ms),CPU(%),Thread(%),Threads,Memory(MiB)\n";
+
+		if (Settings.bPerfCounters)
+			sCSV.insert(sCSV.length() - 1, ",IPC,Cycles/pixel,LLC misses/frame,Branch misses/frame,Context switches/frame");
+
+		if (Settings.bCPUFreqInfo)
+			sCSV.insert(sCSV.length() - 1, ",CPU clock(MHz),Throttled,Frames/sec(nominal clock)");
+
+		if (Settings.bEnergyInfo)
+			sCSV.insert(sCSV.length() - 1, ",Power(W),Energy/frame(J)");
 
 		hCSVFile << sCSV;
 
@@ -2357,12 +3534,30 @@ string CreateCSVFile(string &s_avsfile, vector<stPerfData> &cs_pdata, BOOL bNVVP
 			if (Settings.bGPUInfo)
 			{
 				if (bNVVP)
-					stemp = utils.StrFormat("%u,%.3f,%.3f,%.6f,%.6f,%.1f,%u,%u,%u,%u", uiFrame, cs_pdata[i].fps_current, cs_pdata[i].fps_average, 1000.0 / cs_pdata[i].fps_current, 1000.0 / cs_pdata[i].fps_average, cs_pdata[i].cpu_usage, cs_pdata[i].gpu_usage, cs_pdata[i].vpu_usage, cs_pdata[i].num_threads, cs_pdata[i].process_memory);
+					stemp = utils.StrFormat("%u,%.3f,%.3f,%.6f,%.6f,%.1f,%.1f,%u,%u,%u,%u", uiFrame, cs_pdata[i].fps_current, cs_pdata[i].fps_average, 1000.0 / cs_pdata[i].fps_current, 1000.0 / cs_pdata[i].fps_average, cs_pdata[i].cpu_usage, cs_pdata[i].busiest_thread, cs_pdata[i].gpu_usage, cs_pdata[i].vpu_usage, cs_pdata[i].num_threads, cs_pdata[i].process_memory);
 				else
-					stemp = utils.StrFormat("%u,%.3f,%.3f,%.6f,%.6f,%.1f,%u,%u,%u", uiFrame, cs_pdata[i].fps_current, cs_pdata[i].fps_average, 1000.0 / cs_pdata[i].fps_current, 1000.0 / cs_pdata[i].fps_average, cs_pdata[i].cpu_usage, cs_pdata[i].gpu_usage, cs_pdata[i].num_threads, cs_pdata[i].process_memory);
+					stemp = utils.StrFormat("%u,%.3f,%.3f,%.6f,%.6f,%.1f,%.1f,%u,%u,%u", uiFrame, cs_pdata[i].fps_current, cs_pdata[i].fps_average, 1000.0 / cs_pdata[i].fps_current, 1000.0 / cs_pdata[i].fps_average, cs_pdata[i].cpu_usage, cs_pdata[i].busiest_thread, cs_pdata[i].gpu_usage, cs_pdata[i].num_threads, cs_pdata[i].process_memory);
 			}
 			else
-				stemp = utils.StrFormat("%u,%.3f,%.3f,%.6f,%.6f,%.1f,%u,%u", uiFrame, cs_pdata[i].fps_current, cs_pdata[i].fps_average, 1000.0 / cs_pdata[i].fps_current, 1000.0 / cs_pdata[i].fps_average, cs_pdata[i].cpu_usage, cs_pdata[i].num_threads, cs_pdata[i].process_memory);
+				stemp = utils.StrFormat("%u,%.3f,%.3f,%.6f,%.6f,%.1f,%.1f,%u,%u", uiFrame, cs_pdata[i].fps_current, cs_pdata[i].fps_average, 1000.0 / cs_pdata[i].fps_current, 1000.0 / cs_pdata[i].fps_average, cs_pdata[i].cpu_usage, cs_pdata[i].busiest_thread, cs_pdata[i].num_threads, cs_pdata[i].process_memory);
+
+			if (Settings.bPerfCounters)
+				stemp += utils.StrFormat(",%.3f,%.3f,%.0f,%.0f,%.2f", cs_pdata[i].ipc, cs_pdata[i].cycles_per_pixel, cs_pdata[i].llc_misses, cs_pdata[i].branch_misses, cs_pdata[i].context_switches);
+
+			if (Settings.bCPUFreqInfo)
+			{
+				//empty until the clock is known
+				if (cs_pdata[i].cpu_mhz > 0.0)
+					stemp += utils.StrFormat(",%.0f,%u,", cs_pdata[i].cpu_mhz, cs_pdata[i].throttled);
+				else
+					stemp += utils.StrFormat(",,%u,", cs_pdata[i].throttled);
+
+				if ((cs_pdata[i].cpu_mhz > 0.0) && (d_nominalmhz > 0.0))
+					stemp += utils.StrFormat("%.3f", cs_pdata[i].fps_current * d_nominalmhz / cs_pdata[i].cpu_mhz);
+			}
+
+			if (Settings.bEnergyInfo)
+				stemp += utils.StrFormat(",%.2f,%.5f", cs_pdata[i].power, cs_pdata[i].energy_per_frame);
 
 			hCSVFile << stemp + "\n";
 		}
@@ -2375,6 +3570,130 @@ string CreateCSVFile(string &s_avsfile, vector<stPerfData> &cs_pdata, BOOL bNVVP
 }
 
 
+void InitStartupTimes(stStartupTimes &startup, BOOL b_cold)
+{
+	startup.bCold = b_cold;
+	startup.dDLLLoadMS = 0.0;
+	startup.dEnvCreateMS = 0.0;
+	startup.dImportMS = 0.0;
+	startup.dDistributorMS = -1.0;
+	startup.dFirstFrameMS = 0.0;
+	startup.dTimeToFirstFrameMS = 0.0;
+	startup.dTimeToSteadyStateMS = -1.0;
+
+	return;
+}
+
+
+string StartupLogText(stStartupTimes &startup)
+{
+	string sText = "";
+	sText += utils.StrFormat("DLL load:                       %.3f ms\n", startup.dDLLLoadMS);
+	sText += utils.StrFormat("Environment creation:           %.3f ms\n", startup.dEnvCreateMS);
+	sText += utils.StrFormat("Import:                         %.3f ms\n", startup.dImportMS);
+	if (startup.dDistributorMS >= 0.0)
+		sText += utils.StrFormat("Distributor:                    %.3f ms\n", startup.dDistributorMS);
+	sText += utils.StrFormat("First frame:                    %.3f ms\n", startup.dFirstFrameMS);
+	sText += utils.StrFormat("Time to first frame:            %.3f ms\n", startup.dTimeToFirstFrameMS);
+	if (startup.dTimeToSteadyStateMS >= 0.0)
+		sText += utils.StrFormat("Time to steady state:           %.3f ms", startup.dTimeToSteadyStateMS);
+	else
+		sText += "Time to steady state:           n/a";
+
+	return sText;
+}
+
+
+string StartupJSON(stStartupTimes &startup)
+{
+	string sJSON = "{\n";
+	sJSON += "\t\t\t\"dll_load\": " + JSONNumber(startup.dDLLLoadMS, 3) + ",\n";
+	sJSON += "\t\t\t\"environment\": " + JSONNumber(startup.dEnvCreateMS, 3) + ",\n";
+	sJSON += "\t\t\t\"import\": " + JSONNumber(startup.dImportMS, 3) + ",\n";
+	sJSON += "\t\t\t\"distributor\": " + JSONNumber(startup.dDistributorMS, 3) + ",\n";
+	sJSON += "\t\t\t\"first_frame\": " + JSONNumber(startup.dFirstFrameMS, 3) + ",\n";
+	sJSON += "\t\t\t\"time_to_first_frame\": " + JSONNumber(startup.dTimeToFirstFrameMS, 3) + ",\n";
+	sJSON += "\t\t\t\"time_to_steady_state\": " + JSONNumber(startup.dTimeToSteadyStateMS, 3) + "\n";
+	sJSON += "\t\t}";
+
+	return sJSON;
+}
+
+
+string CreateJSONFile(string &s_jsonfile, string &s_avsfile, string &s_version, stStartupTimes &coldstartup, stStartupTimes &warmstartup, string &s_runtime, string &s_avserror)
+{
+	ofstream hJSONFile;
+	hJSONFile.open(s_jsonfile.c_str());
+	if (!hJSONFile.is_open())
+		return utils.StrFormat("\nCannot create \"%s\"\n", s_jsonfile.c_str());
+
+	string sJSON = "{\n";
+	sJSON += "\t\"script\": \"" + JSONEscape(s_avsfile) + "\",\n";
+	sJSON += "\t\"avisynth\": \"" + JSONEscape(s_version) + "\",\n";
+	sJSON += "\t\"startup_ms\": {\n";
+	sJSON += "\t\t\"cold\": " + StartupJSON(coldstartup) + ",\n";
+	if (&warmstartup != &coldstartup)
+		sJSON += "\t\t\"warm\": " + StartupJSON(warmstartup) + "\n";
+	else
+		sJSON += "\t\t\"warm\": null\n";
+	sJSON += "\t},\n";
+
+	if (s_runtime != "")
+		sJSON += "\t\"runtime\": {\n" + s_runtime + "\t},\n";
+	else
+		sJSON += "\t\"runtime\": null,\n";
+
+	if (s_avserror != "")
+		sJSON += "\t\"error\": \"" + JSONEscape(s_avserror) + "\"\n";
+	else
+		sJSON += "\t\"error\": null\n";
+
+	sJSON += "}\n";
+
+	hJSONFile << sJSON;
+	hJSONFile.flush();
+	hJSONFile.close();
+
+	return "";
+}
+
+
+string JSONEscape(string s_text)
+{
+	string sRet = "";
+	for (size_t nPos = 0; nPos < s_text.length(); nPos++)
+	{
+		unsigned char c = (unsigned char)s_text[nPos];
+		if (c == '\"')
+			sRet += "\\\"";
+		else if (c == '\\')
+			sRet += "\\\\";
+		else if (c == '\n')
+			sRet += "\\n";
+		else if (c == '\r')
+			sRet += "\\r";
+		else if (c == '\t')
+			sRet += "\\t";
+		else if (c < 0x20)
+			sRet += utils.StrFormat("\\u%04X", c);
+		else
+			sRet += (char)c;
+	}
+
+	return sRet;
+}
+
+
+string JSONNumber(double d_value, int i_decimals)
+{
+	//negative values mark phases that did not run
+	if ((d_value < 0.0) || (d_value != d_value))
+		return "null";
+
+	return utils.StrFormat("%.*f", i_decimals, d_value);
+}
+
+
 void PollKeys()
 {
 	if (Settings.bPauseBeforeExit)
@@ -2437,79 +3756,53 @@ string Pad(string s_line)
 }
 
 
-unsigned int CalculateFrameInterval(string &s_avsfile, string &s_error)
+unsigned int CalculateFrameInterval(string &s_avsfile, BOOL b_avscapi, stStartupTimes &startup, string &s_error)
 {
 	s_error = "";
 	unsigned int uiFrameInterval = 10;
 
-	HINSTANCE hDLL;
-	if (Settings.sAVSDLL == "")
-		hDLL = ::LoadLibrary("avisynth");
-	else
-		hDLL = ::LoadLibrary(Settings.sAVSDLL.c_str());
+	//the first load of the script in this process, so its phases are the cold startup times
+	double dStartupBegin = timer.GetTimer();
+	double dPhaseStart = dStartupBegin;
+
+	CFrameServer *frameserver = CFrameServer::Create(s_avsfile, AvisynthInfo.iInterfaceVersion, b_avscapi);
+	frameserver->bInvokeDistributor = Settings.bInvokeDistributor;
+	frameserver->dwDeleteDelay = DSE_DELAY;
+	if (CFrameServer::IsVapourSynthScript(s_avsfile))
+		((CFrameServerVapourSynth *)frameserver)->uiRequests = Settings.uiVSRequests;
 
-	if (!hDLL)
+	if (!frameserver->Load(CFrameServer::IsVapourSynthScript(s_avsfile) ? Settings.sVSScriptDLL : Settings.sAVSDLL))
 	{
-		s_error = "Cannot load avisynth.dll";
+		s_error = frameserver->sError;
+		delete frameserver;
 		return uiFrameInterval;
 	}
 
-	IScriptEnvironment *AVS_env = 0;
+	startup.dDLLLoadMS = (timer.GetTimer() - dPhaseStart) * 1000.0;
 
 	try
 	{
 		_set_se_translator(SE_Translator);
 
-		CREATE_ENV *CreateEnvironment = (CREATE_ENV *)GetProcAddress(hDLL, "CreateScriptEnvironment");
-		if (!CreateEnvironment)
-		{
-			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nFailed to load CreateScriptEnvironment()\n");
-			PollKeys();
-			return -1;
-		}
-
-		AVS_env = CreateEnvironment(AvisynthInfo.iInterfaceVersion);
-
-		if (!AVS_env)
-		{
-			s_error = "Could not create IScriptenvironment";
-			::FreeLibrary(hDLL);
-			return uiFrameInterval;
-		}
+		dPhaseStart = timer.GetTimer();
+		frameserver->CreateEnvironment();
+		startup.dEnvCreateMS = (timer.GetTimer() - dPhaseStart) * 1000.0;
 
 		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("Loading script...").c_str());
 
-		AVS_linkage = AVS_env->GetAVSLinkage();
-		AVSValue AVS_main;
-		AVSValue AVS_temp;
-		PClip AVS_clip;
-		VideoInfo	AVS_vidinfo;
+		stClipInfo clipinfo;
 
-		AVS_main = AVS_env->Invoke("Import", s_avsfile.c_str());
+		dPhaseStart = timer.GetTimer();
+		frameserver->Import(s_avsfile);
+		startup.dImportMS = (timer.GetTimer() - dPhaseStart) * 1000.0;
+		frameserver->InvokeDistributor();
+		startup.dDistributorMS = frameserver->dDistributorMS;
+		frameserver->GetClipInfo(clipinfo);
 
-		if (!AVS_main.IsClip()) //not a clip
-			AVS_env->ThrowError("Script did not return a video clip:\n%s", s_avsfile.c_str());
+		unsigned int uiTotalFrames = clipinfo.uiFrames;
 
-		int iMTMode = 0;
-		try
-		{
-			AVS_temp = AVS_env->Invoke("GetMTMode", false);
-			iMTMode = AVS_temp.IsInt() ? AVS_temp.AsInt() : 0;
-			if ((iMTMode > 0) && (iMTMode < 5) && Settings.bInvokeDistributor)
-				AVS_main = AVS_env->Invoke("Distributor", AVS_main);
-		}
-		catch (IScriptEnvironment::NotFound)
-		{
-			iMTMode = 0;
-		}
-
-		AVS_clip = AVS_main.AsClip();
-		AVS_vidinfo = AVS_clip->GetVideoInfo();
-
-		unsigned int uiTotalFrames = (unsigned int)AVS_vidinfo.num_frames;
-
-		if (!AVS_vidinfo.HasVideo())
-			AVS_env->ThrowError("Script did not return a video clip:\n%s", s_avsfile.c_str());
+		if (!clipinfo.bHasVideo)
+			frameserver->ThrowError(utils.StrFormat("Script did not return a video clip:\n%s", s_avsfile.c_str()));
 
 		unsigned int uiFrame = 0;
 		double TDelta = 0.0;
@@ -2520,7 +3813,7 @@ unsigned int CalculateFrameInterval(string &s_avsfile, string &s_error)
 			if (_kbhit())
 			{
 				if (_getch() == 0x1B) //ESC
-					AVS_env->ThrowError("\'ESC\' pressed, cancelled.");
+					frameserver->ThrowError("\'ESC\' pressed, cancelled.");
 			}
 
 			if ((timer.GetSTDTimerMS() - D0) >= 150)
@@ -2529,8 +3822,18 @@ unsigned int CalculateFrameInterval(string &s_avsfile, string &s_error)
 				D0 = timer.GetSTDTimerMS();
 			}
 
-			PVideoFrame src_frame = AVS_clip->GetFrame(uiFrame, AVS_env);
-			++uiFrame;
+			if (uiFrame == 0)
+			{
+				dPhaseStart = timer.GetTimer();
+				frameserver->GetFrame(uiFrame);
+				double dFirstFrame = timer.GetTimer();
+				startup.dFirstFrameMS = (dFirstFrame - dPhaseStart) * 1000.0;
+				startup.dTimeToFirstFrameMS = (dFirstFrame - dStartupBegin) * 1000.0;
+			}
+			else
+				frameserver->GetFrame(uiFrame);
+
+			++uiFrame;
 			TDelta = timer.GetSTDTimer() - T0;
 		}
 
@@ -2538,7 +3841,7 @@ unsigned int CalculateFrameInterval(string &s_avsfile, string &s_error)
 		if (TDelta >= ((double)MIN_RUNTIME / 1000.0))
 			dAverageFrameTime = (1000.0 * TDelta) / (double)uiFrame; //convert to milliseconds
 		else
-			AVS_env->ThrowError("Script runtime is too short for meaningful measurements");
+			frameserver->ThrowError("Script runtime is too short for meaningful measurements");
 
 		uiFrameInterval = 1000;
 		if (dAverageFrameTime > (MIN_TIME_PER_FRAMEINTERVAL /  500.0)) uiFrameInterval =  500;
@@ -2549,13 +3852,7 @@ unsigned int CalculateFrameInterval(string &s_avsfile, string &s_error)
 		if (dAverageFrameTime > (MIN_TIME_PER_FRAMEINTERVAL /   10.0)) uiFrameInterval =   10;
 		if (dAverageFrameTime > (MIN_TIME_PER_FRAMEINTERVAL))          uiFrameInterval =    1;
 
-		AVS_clip = 0;
-		AVS_main = 0;
-		AVS_temp = 0;
-		Sleep(DSE_DELAY);
-		AVS_env->DeleteScriptEnvironment();
-		AVS_env = 0;
-		AVS_linkage = 0;
+		frameserver->Release();
 
 		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
 	}
@@ -2578,20 +3875,699 @@ unsigned int CalculateFrameInterval(string &s_avsfile, string &s_error)
 		uiFrameInterval = 10;
 	}
 
-	if (!::FreeLibrary(hDLL))
+	if (!frameserver->Unload())
 	{
 		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
-		s_error = "Cannot unload avisynth.dll";
+		s_error = utils.StrFormat("Cannot unload the %s library", frameserver->sName.c_str());
 		uiFrameInterval = 10;
 	}
 
+	delete frameserver;
+
 	return uiFrameInterval;
 }
 
 
+int RunScalingMode(string &s_avsfile, string &s_logbuffer)
+{
+	struct stScalingStep
+	{
+		string            sVariant;
+		unsigned int      uiCPUs;
+		DWORD_PTR         dwpMask;
+		stBenchmarkResult result;
+	};
+
+	string sOutBuf = "";
+
+	DWORD_PTR dwpProcessMask = 0;
+	DWORD_PTR dwpSystemMask = 0;
+	if (!::GetProcessAffinityMask(::GetCurrentProcess(), &dwpProcessMask, &dwpSystemMask))
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\nCannot query the process affinity:\n%s\n", utils.SysErrorMessage().c_str());
+		return -1;
+	}
+
+	//one bit per logical CPU, in the order the OS enumerates them (SMT siblings are adjacent)
+	vector<DWORD_PTR> vLogical;
+	for (unsigned int uiBit = 0; uiBit < (sizeof(DWORD_PTR) * 8); uiBit++)
+	{
+		if (dwpProcessMask & ((DWORD_PTR)1 << uiBit))
+			vLogical.push_back((DWORD_PTR)1 << uiBit);
+	}
+
+	//first logical CPU of every physical core
+	vector<DWORD_PTR> vPhysical;
+	DWORD dwLength = 0;
+	::GetLogicalProcessorInformation(NULL, &dwLength);
+	if (dwLength > 0)
+	{
+		vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> vSLPI(dwLength / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+		if (::GetLogicalProcessorInformation(&vSLPI[0], &dwLength))
+		{
+			for (size_t i = 0; i < vSLPI.size(); i++)
+			{
+				if (vSLPI[i].Relationship != RelationProcessorCore)
+					continue;
+
+				DWORD_PTR dwpCore = vSLPI[i].ProcessorMask & dwpProcessMask;
+				if (dwpCore != 0)
+					vPhysical.push_back(dwpCore & (~dwpCore + 1)); //lowest bit
+			}
+			sort(vPhysical.begin(), vPhysical.end());
+		}
+	}
+
+	vector<stScalingStep> vSteps;
+	stScalingStep step;
+	for (int iVariant = 0; iVariant < 2; iVariant++)
+	{
+		vector<DWORD_PTR> &vCPUs = (iVariant == 0) ? vLogical : vPhysical;
+		if ((iVariant == 1) && (vPhysical.size() == vLogical.size())) //no SMT
+			break;
+
+		//1, 2, 4, ... and always the total count
+		step.sVariant = (iVariant == 0) ? "logical" : "physical";
+		unsigned int uiCount = 1;
+		while (uiCount <= vCPUs.size())
+		{
+			step.uiCPUs = uiCount;
+			step.dwpMask = 0;
+			for (unsigned int i = 0; i < uiCount; i++)
+				step.dwpMask |= vCPUs[i];
+
+			vSteps.push_back(step);
+
+			if (uiCount == vCPUs.size())
+				break;
+
+			uiCount = ((uiCount * 2) < vCPUs.size()) ? (uiCount * 2) : (unsigned int)vCPUs.size();
+		}
+	}
+
+	CBenchmark benchmark;
+	if (!benchmark.LoadAvisynth(Settings.sAVSDLL, AvisynthInfo.iInterfaceVersion) && !CSyntheticSource::IsSyntheticSpec(s_avsfile))
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", benchmark.sError.c_str());
+		return -1;
+	}
+
+	benchmark.bInvokeDistributor = Settings.bInvokeDistributor;
+	benchmark.dMeasureSeconds = (Settings.iTimeLimit != -1) ? (double)Settings.iTimeLimit : (double)SCALING_STEP_TIME;
+
+	s_logbuffer += utils.StrFormat("Script file:                %s\n", s_avsfile.c_str());
+	s_logbuffer += utils.StrFormat("Operating system:           %s\n", sys.GetOSVersion().c_str());
+	if (sys.GetCPUInfo())
+		s_logbuffer += utils.StrFormat("CPU brand string:           %s\n", sys.CPUBrandString.c_str());
+	if (benchmark.bLoaded)
+		s_logbuffer += utils.StrFormat("Avisynth version:           %s (%s)\n", AvisynthInfo.sVersionString.c_str(), AvisynthInfo.sFileVersion.c_str());
+	else
+		s_logbuffer += "Avisynth version:           none (synthetic clip run directly)\n";
+	s_logbuffer += utils.StrFormat("CPUs (logical | physical):  %u | %u\n", (unsigned int)vLogical.size(), (unsigned int)vPhysical.size());
+	s_logbuffer += utils.StrFormat("Time per step:              %.0f s (+ %.0f s warm-up)\n", benchmark.dMeasureSeconds, benchmark.dWarmupSeconds);
+
+	sOutBuf = "\n[Scaling]\n  Variant   CPUs       FPS   Speedup   Efficiency(%)   CPU usage(%)   Pool threads";
+	PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+	s_logbuffer += sOutBuf + "\n";
+
+	int iRet = 0;
+	double dBaseFPS = 0.0;
+	for (size_t i = 0; i < vSteps.size(); i++)
+	{
+		sOutBuf = utils.StrFormat("Running %s, %u CPU(s)...", vSteps[i].sVariant.c_str(), vSteps[i].uiCPUs);
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad(sOutBuf).c_str());
+
+		::SetProcessAffinityMask(::GetCurrentProcess(), vSteps[i].dwpMask);
+		benchmark.iThreads = (int)vSteps[i].uiCPUs;
+		benchmark.Run(s_avsfile, vSteps[i].result);
+		::SetProcessAffinityMask(::GetCurrentProcess(), dwpProcessMask);
+
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+
+		if (vSteps[i].result.sError != "")
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", vSteps[i].result.sError.c_str());
+			s_logbuffer += "\n" + vSteps[i].result.sError + "\n";
+			iRet = -1;
+			break;
+		}
+
+		if (vSteps[i].uiCPUs == 1)
+			dBaseFPS = vSteps[i].result.dFPS;
+
+		double dSpeedup = (dBaseFPS > 0.0) ? vSteps[i].result.dFPS / dBaseFPS : 0.0;
+		sOutBuf = utils.StrFormat("%9s %6u %9s %9.2f %15.1f %14.1f", vSteps[i].sVariant.c_str(), vSteps[i].uiCPUs, utils.StrFormatFPS(vSteps[i].result.dFPS).c_str(),
+			dSpeedup, (100.0 * dSpeedup) / (double)vSteps[i].uiCPUs,
+			(vSteps[i].result.dSeconds > 0.0) ? (100.0 * vSteps[i].result.dCPUSeconds) / (vSteps[i].result.dSeconds * (double)vLogical.size()) : 0.0);
+
+		if (vSteps[i].result.iThreadPoolThreads >= 0)
+			sOutBuf += utils.StrFormat(" %14d", vSteps[i].result.iThreadPoolThreads);
+		else
+			sOutBuf += "            n/a";
+
+		PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+		s_logbuffer += sOutBuf + "\n";
+	}
+
+	benchmark.UnloadAvisynth();
+
+	if (iRet != 0)
+		return iRet;
+
+	/*
+	Least squares fits over the logical variant, N: CPUs, S: speedup
+	Amdahl:    1/S = s + (1 - s)/N  ->  s = sum((1 - x)(y - x)) / sum((1 - x)^2) with x = 1/N, y = 1/S
+	Gustafson: S = N - a(N - 1)     ->  a = sum((N - 1)(N - S)) / sum((N - 1)^2)
+	*/
+	double dAmdahlNum = 0.0, dAmdahlDen = 0.0, dGustNum = 0.0, dGustDen = 0.0;
+	for (size_t i = 0; i < vSteps.size(); i++)
+	{
+		if ((vSteps[i].sVariant != "logical") || (vSteps[i].result.dFPS <= 0.0) || (dBaseFPS <= 0.0))
+			continue;
+
+		double dN = (double)vSteps[i].uiCPUs;
+		double dS = vSteps[i].result.dFPS / dBaseFPS;
+		double dX = 1.0 / dN;
+		double dY = 1.0 / dS;
+		dAmdahlNum += (1.0 - dX) * (dY - dX);
+		dAmdahlDen += (1.0 - dX) * (1.0 - dX);
+		dGustNum += (dN - 1.0) * (dN - dS);
+		dGustDen += (dN - 1.0) * (dN - 1.0);
+	}
+
+	if ((dAmdahlDen > 0.0) && (dGustDen > 0.0))
+	{
+		double dSerial = dAmdahlNum / dAmdahlDen;
+		double dAlpha = dGustNum / dGustDen;
+
+		sOutBuf = utils.StrFormat("\nAmdahl fit (serial fraction):   %.3f (max. speedup: %s)", dSerial, (dSerial > 0.0) ? utils.StrFormat("%.1f", 1.0 / dSerial).c_str() : "unbounded");
+		PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+		s_logbuffer += sOutBuf + "\n";
+
+		sOutBuf = utils.StrFormat("Gustafson fit (serial part):    %.3f", dAlpha);
+		PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+		s_logbuffer += sOutBuf + "\n";
+	}
+
+	PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
+
+	return 0;
+}
+
+
+int RunISASweepMode(string &s_avsfile, string &s_logbuffer)
+{
+	struct stISALevel
+	{
+		string            sName;
+		string            sMaxCPU;  //SetMaxCPU() argument
+		BOOL              bAvailable;
+		stBenchmarkResult result;
+	};
+
+	string sOutBuf = "";
+
+	sys.GetCPUInfo();
+
+	stISALevel levels[] =
+	{
+		{"C",      "none",   TRUE,       stBenchmarkResult()},
+		{"SSE2",   "sse2",   sys.bSSE2,  stBenchmarkResult()},
+		{"SSSE3",  "ssse3",  sys.bSSSE3, stBenchmarkResult()},
+		{"SSE4.1", "sse4.1", sys.bSSE41, stBenchmarkResult()},
+		{"AVX",    "avx",    sys.bAVX,   stBenchmarkResult()},
+		{"AVX2",   "avx2",   sys.bAVX2,  stBenchmarkResult()}
+	};
+	const size_t nLevels = sizeof(levels) / sizeof(levels[0]);
+
+	CBenchmark benchmark;
+	if (!benchmark.LoadAvisynth(Settings.sAVSDLL, AvisynthInfo.iInterfaceVersion))
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", benchmark.sError.c_str());
+		return -1;
+	}
+
+	benchmark.bInvokeDistributor = Settings.bInvokeDistributor;
+	benchmark.dMeasureSeconds = (Settings.iTimeLimit != -1) ? (double)Settings.iTimeLimit : (double)ISASWEEP_STEP_TIME;
+
+	s_logbuffer += utils.StrFormat("Script file:                %s\n", s_avsfile.c_str());
+	s_logbuffer += utils.StrFormat("Operating system:           %s\n", sys.GetOSVersion().c_str());
+	s_logbuffer += utils.StrFormat("CPU brand string:           %s\n", sys.CPUBrandString.c_str());
+	s_logbuffer += utils.StrFormat("CPU features:               %s\n", sys.CPUFeatures.c_str());
+	s_logbuffer += utils.StrFormat("Avisynth version:           %s (%s)\n", AvisynthInfo.sVersionString.c_str(), AvisynthInfo.sFileVersion.c_str());
+	s_logbuffer += utils.StrFormat("Time per step:              %.0f s (+ %.0f s warm-up)\n", benchmark.dMeasureSeconds, benchmark.dWarmupSeconds);
+
+	sOutBuf = "\n[ISA sweep]\n  Max. CPU         FPS   Speedup (vs C)   Tier gain   CPU flags";
+	PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+	s_logbuffer += sOutBuf + "\n";
+
+	int iRet = 0;
+	double dBaseFPS = 0.0;
+	double dPrevFPS = 0.0;
+	for (size_t i = 0; i < nLevels; i++)
+	{
+		if (!levels[i].bAvailable)
+		{
+			sOutBuf = utils.StrFormat("%10s   not supported by this CPU/OS", levels[i].sName.c_str());
+			PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "%s\n", sOutBuf.c_str());
+			s_logbuffer += sOutBuf + "\n";
+			continue;
+		}
+
+		sOutBuf = utils.StrFormat("Running with the CPU level capped at %s...", levels[i].sName.c_str());
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad(sOutBuf).c_str());
+
+		benchmark.sMaxCPU = levels[i].sMaxCPU;
+		benchmark.Run(s_avsfile, levels[i].result);
+
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+
+		if (levels[i].result.sError != "")
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", levels[i].result.sError.c_str());
+			s_logbuffer += "\n" + levels[i].result.sError + "\n";
+			iRet = -1;
+			break;
+		}
+
+		if (dBaseFPS <= 0.0)
+			dBaseFPS = levels[i].result.dFPS;
+
+		//gain of this tier over the previous measured one
+		sOutBuf = utils.StrFormat("%10s %11s %16.2f %11.2f   0x%08X", levels[i].sName.c_str(), utils.StrFormatFPS(levels[i].result.dFPS).c_str(),
+			(dBaseFPS > 0.0) ? levels[i].result.dFPS / dBaseFPS : 0.0, (dPrevFPS > 0.0) ? levels[i].result.dFPS / dPrevFPS : 1.0, (unsigned int)levels[i].result.lCPUFlags);
+		PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+		s_logbuffer += sOutBuf + "\n";
+
+		dPrevFPS = levels[i].result.dFPS;
+	}
+
+	benchmark.UnloadAvisynth();
+
+	PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
+
+	return iRet;
+}
+
+
+int RunReplayMode(string &s_avsfile, string &s_tracefile, BOOL b_avscapi, BOOL b_timing, BOOL b_threads, string &s_logbuffer)
+{
+	string sOutBuf = "";
+
+	CFrameTrace trace;
+	if (!trace.Load(s_tracefile))
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", trace.sError.c_str());
+		return -1;
+	}
+
+	CFrameServer *frameserver = CFrameServer::Create(s_avsfile, AvisynthInfo.iInterfaceVersion, b_avscapi);
+	frameserver->bInvokeDistributor = Settings.bInvokeDistributor;
+	frameserver->dwDeleteDelay = DSE_DELAY;
+
+	if (!frameserver->Load(Settings.sAVSDLL))
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", frameserver->sError.c_str());
+		delete frameserver;
+		return -1;
+	}
+
+	s_logbuffer += utils.StrFormat("Script file:                %s\n", s_avsfile.c_str());
+	s_logbuffer += utils.StrFormat("Operating system:           %s\n", sys.GetOSVersion().c_str());
+	if (sys.GetCPUInfo())
+		s_logbuffer += utils.StrFormat("CPU brand string:           %s\n", sys.CPUBrandString.c_str());
+	if (CSyntheticSource::IsSyntheticSpec(s_avsfile))
+		s_logbuffer += utils.StrFormat("Frames served through:      %s\n", frameserver->sVersion.c_str());
+	else
+	{
+		s_logbuffer += utils.StrFormat("Avisynth version:           %s (%s)\n", AvisynthInfo.sVersionString.c_str(), AvisynthInfo.sFileVersion.c_str());
+		s_logbuffer += utils.StrFormat("Frames served through:      %s\n", b_avscapi ? "C API" : "C++ API");
+	}
+	s_logbuffer += utils.StrFormat("Trace file:                 %s\n", s_tracefile.c_str());
+
+	CTraceReplay replay;
+	string sError = "";
+	try
+	{
+		_set_se_translator(SE_Translator);
+
+		frameserver->CreateEnvironment();
+
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("Loading script...").c_str());
+
+		stClipInfo clipinfo;
+
+		frameserver->Import(s_avsfile);
+		frameserver->InvokeDistributor();
+		frameserver->GetClipInfo(clipinfo);
+
+		if (!clipinfo.bHasVideo)
+			frameserver->ThrowError(utils.StrFormat("Script did not return a video clip:\n%s", s_avsfile.c_str()));
+
+		for (size_t i = 0; i < trace.vRequests.size(); i++)
+		{
+			if (trace.vRequests[i].uiFrame >= clipinfo.uiFrames)
+				frameserver->ThrowError(utils.StrFormat("The trace requests frame %u, the clip has %u frames", trace.vRequests[i].uiFrame, clipinfo.uiFrames));
+		}
+
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("Replaying trace...").c_str());
+
+		if (!replay.Run(frameserver, trace, b_timing, b_threads))
+			frameserver->ThrowError(replay.sError);
+
+		frameserver->Release();
+
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+	}
+	catch (AvisynthError err)
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+		sError = utils.StrFormat("%s", (PCSTR)err.msg);
+	}
+	catch (exception& ex)
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+		sError = ex.what();
+	}
+	catch (...)
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+		sError = utils.SysErrorMessage();
+	}
+
+	if (!frameserver->Unload() && (sError == ""))
+		sError = utils.StrFormat("Cannot unload the %s library", frameserver->sName.c_str());
+
+	delete frameserver;
+
+	if (sError != "")
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", sError.c_str());
+		s_logbuffer += "\n" + sError + "\n";
+		return -1;
+	}
+
+	unsigned int uiRequests = (unsigned int)trace.vRequests.size();
+	s_logbuffer += utils.StrFormat("Requests | frames:          %u | %u (%u re-requests)\n", uiRequests, trace.uiUniqueFrames, uiRequests - trace.uiUniqueFrames);
+	s_logbuffer += utils.StrFormat("Threads | max. in flight:   %u | %u\n", trace.uiThreads, trace.uiMaxConcurrency);
+	s_logbuffer += utils.StrFormat("Replay:                     %s, %s\n", (replay.uiWorkers > 1) ? utils.StrFormat("%u threads", replay.uiWorkers).c_str() : "serial",
+		b_timing ? "recorded timing" : "as fast as possible");
+
+	sOutBuf = "\n[Replay]\n    Source   Requests/s   Avg(ms)   P50(ms)   P90(ms)   P99(ms)   Max(ms)   Time(s)";
+	PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+	s_logbuffer += sOutBuf + "\n";
+
+	for (int iSource = 0; iSource < 2; iSource++)
+	{
+		CHistogram histogram;
+		double dSumMS = 0.0;
+		double dMaxMS = 0.0;
+		for (size_t i = 0; i < trace.vRequests.size(); i++)
+		{
+			double dMS = (iSource == 0) ? trace.vRequests[i].dDurationMS : replay.vLatencyMS[i];
+			histogram.Add(dMS, 1);
+			dSumMS += dMS;
+			if (dMS > dMaxMS)
+				dMaxMS = dMS;
+		}
+
+		double dSeconds = (iSource == 0) ? (trace.dSpanMS / 1000.0) : replay.dSeconds;
+		sOutBuf = utils.StrFormat("%10s %12.1f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f", (iSource == 0) ? "Recorded" : "Replayed",
+			(dSeconds > 0.0) ? (double)uiRequests / dSeconds : 0.0, dSumMS / (double)uiRequests,
+			histogram.Percentile(50.0), histogram.Percentile(90.0), histogram.Percentile(99.0), dMaxMS, dSeconds);
+		PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+		s_logbuffer += sOutBuf + "\n";
+	}
+
+	//with the recorded timing the run takes as long as the recording, only the latencies compare
+	if (!b_timing && (replay.dSeconds > 0.0))
+	{
+		sOutBuf = utils.StrFormat("\nReplay speedup:                 %.2fx", (trace.dSpanMS / 1000.0) / replay.dSeconds);
+		PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+		s_logbuffer += sOutBuf + "\n";
+	}
+
+	PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
+
+	return 0;
+}
+
+
+int RunCompareMode(string &s_avsfile, string &s_reffile, string &s_logbuffer)
+{
+	string sOutBuf = "";
+
+	//both scripts are served by their own frame server, avisynth was not queried for a VapourSynth candidate
+	int iInterfaceVersion = (AvisynthInfo.iInterfaceVersion > 0) ? AvisynthInfo.iInterfaceVersion : 6;
+	CFrameServer *frameservers[2];
+	string *pScripts[2] = {&s_avsfile, &s_reffile};
+	for (int i = 0; i < 2; i++)
+	{
+		frameservers[i] = CFrameServer::Create(*pScripts[i], iInterfaceVersion, FALSE);
+		frameservers[i]->bInvokeDistributor = Settings.bInvokeDistributor;
+		frameservers[i]->dwDeleteDelay = DSE_DELAY;
+		if (CFrameServer::IsVapourSynthScript(*pScripts[i]))
+			((CFrameServerVapourSynth *)frameservers[i])->uiRequests = Settings.uiVSRequests;
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (!frameservers[i]->Load(CFrameServer::IsVapourSynthScript(*pScripts[i]) ? Settings.sVSScriptDLL : Settings.sAVSDLL))
+		{
+			PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", frameservers[i]->sError.c_str());
+			for (int j = 0; j < i; j++)
+				frameservers[j]->Unload();
+			delete frameservers[0];
+			delete frameservers[1];
+			return -1;
+		}
+	}
+
+	s_logbuffer += utils.StrFormat("Script file:                %s\n", s_avsfile.c_str());
+	s_logbuffer += utils.StrFormat("Reference script:           %s\n", s_reffile.c_str());
+	s_logbuffer += utils.StrFormat("Operating system:           %s\n", sys.GetOSVersion().c_str());
+	if (sys.GetCPUInfo())
+		s_logbuffer += utils.StrFormat("CPU brand string:           %s\n", sys.CPUBrandString.c_str());
+	string sServers[2];
+	for (int i = 0; i < 2; i++)
+	{
+		sServers[i] = frameservers[i]->sVersion;
+		if (sServers[i] == "")
+			sServers[i] = ((frameservers[i]->sName == "Avisynth") && (AvisynthInfo.sVersionString != "")) ? AvisynthInfo.sVersionString : frameservers[i]->sName;
+	}
+	s_logbuffer += utils.StrFormat("Frame servers:              %s | %s\n", sServers[0].c_str(), sServers[1].c_str());
+
+	CQualityMetrics quality;
+	unsigned int uiTotalFrames = 0;
+	double dSeconds[2] = {0.0, 0.0};
+	double dMetricSeconds = 0.0;
+	stClipInfo clipinfo[2];
+	string sError = "";
+	try
+	{
+		_set_se_translator(SE_Translator);
+
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("Loading scripts...").c_str());
+
+		for (int i = 0; i < 2; i++)
+		{
+			frameservers[i]->CreateEnvironment();
+			frameservers[i]->Import(*pScripts[i]);
+			frameservers[i]->InvokeDistributor();
+			frameservers[i]->GetClipInfo(clipinfo[i]);
+
+			if (!clipinfo[i].bHasVideo)
+				frameservers[i]->ThrowError(utils.StrFormat("Script did not return a video clip:\n%s", pScripts[i]->c_str()));
+		}
+
+		if (!quality.Init(clipinfo[0], clipinfo[1], sys.bAVX2))
+			frameservers[0]->ThrowError(quality.sError);
+
+		//the shorter clip decides
+		uiTotalFrames = (clipinfo[0].uiFrames < clipinfo[1].uiFrames) ? clipinfo[0].uiFrames : clipinfo[1].uiFrames;
+		if (uiTotalFrames == 0)
+			frameservers[0]->ThrowError("The clips have no frames");
+
+		frameservers[0]->SetFrameRange(0, uiTotalFrames - 1);
+		frameservers[1]->SetFrameRange(0, uiTotalFrames - 1);
+
+		stFramePlanes planes[2];
+		double T0 = timer.GetTimer();
+		unsigned __int64 D0 = 0;
+		for (unsigned int uiFrame = 0; uiFrame < uiTotalFrames; uiFrame++)
+		{
+			if (_kbhit())
+			{
+				if (_getch() == 0x1B) //ESC
+					frameservers[0]->ThrowError("\'ESC\' pressed, cancelled.");
+			}
+
+			if ((timer.GetSTDTimerMS() - D0) >= 150)
+			{
+				PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\rComparing frame %u / %u\r", uiFrame, uiTotalFrames);
+				D0 = timer.GetSTDTimerMS();
+			}
+
+			double dStart = timer.GetTimer();
+			frameservers[0]->GetFramePlanes(uiFrame, planes[0]);
+			double dCandidate = timer.GetTimer();
+			frameservers[1]->GetFramePlanes(uiFrame, planes[1]);
+			double dReference = timer.GetTimer();
+			if (!quality.Compare(planes[0], planes[1]))
+				frameservers[0]->ThrowError(utils.StrFormat("Frame %u:\n%s", uiFrame, quality.sError.c_str()));
+
+			dSeconds[0] += dCandidate - dStart;
+			dSeconds[1] += dReference - dCandidate;
+			dMetricSeconds += timer.GetTimer() - dReference;
+
+			if ((Settings.iTimeLimit != -1) && ((timer.GetTimer() - T0) >= (double)Settings.iTimeLimit))
+				break;
+		}
+
+		//another environment may be deleted first, see CFrameServerAvisynth::Release()
+		frameservers[0]->Release();
+		frameservers[1]->Release();
+
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+	}
+	catch (AvisynthError err)
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+		sError = utils.StrFormat("%s", (PCSTR)err.msg);
+	}
+	catch (exception& ex)
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+		sError = ex.what();
+	}
+	catch (...)
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\r%s\r", Pad("").c_str());
+		sError = utils.SysErrorMessage();
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (!frameservers[i]->Unload() && (sError == ""))
+			sError = utils.StrFormat("Cannot unload the %s library", frameservers[i]->sName.c_str());
+		delete frameservers[i];
+	}
+
+	if (sError != "")
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", sError.c_str());
+		s_logbuffer += "\n" + sError + "\n";
+		return -1;
+	}
+
+	s_logbuffer += utils.StrFormat("Frames compared:            %u of %u\n", quality.uiFrames, uiTotalFrames);
+	utils.StrTrim(clipinfo[0].sColorspace);
+	s_logbuffer += utils.StrFormat("Colorspace:                 %s\n", clipinfo[0].sColorspace.c_str());
+	s_logbuffer += utils.StrFormat("Metric kernels:             %s\n", quality.sKernels.c_str());
+
+	sOutBuf = "\n[Quality]\n  Plane   PSNR avg(dB)   PSNR min(dB)   PSNR glob(dB)   SSIM avg   SSIM min";
+	PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+	s_logbuffer += sOutBuf + "\n";
+
+	for (int iPlane = 0; iPlane < quality.iPlanes; iPlane++)
+	{
+		sOutBuf = utils.StrFormat("%7s %14.3f %14.3f %15.3f %10.5f %10.5f", quality.GetPlaneName(iPlane).c_str(),
+			quality.dPSNRAvg[iPlane], quality.dPSNRMin[iPlane], quality.dPSNRGlobal[iPlane], quality.dSSIMAvg[iPlane], quality.dSSIMMin[iPlane]);
+		PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+		s_logbuffer += sOutBuf + "\n";
+	}
+
+	//time spent in each script's frame requests, a pipelined VapourSynth server keeps working in the other's share
+	sOutBuf = "\n[Throughput]\n     Script        FPS   Time(s)";
+	PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+	s_logbuffer += sOutBuf + "\n";
+
+	for (int i = 0; i < 2; i++)
+	{
+		sOutBuf = utils.StrFormat("%11s %10s %9.2f", (i == 0) ? "Candidate" : "Reference",
+			utils.StrFormatFPS((dSeconds[i] > 0.0) ? (double)quality.uiFrames / dSeconds[i] : 0.0).c_str(), dSeconds[i]);
+		PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+		s_logbuffer += sOutBuf + "\n";
+	}
+
+	sOutBuf = utils.StrFormat("\nSpeedup vs. reference:          %.2fx", (dSeconds[0] > 0.0) ? dSeconds[1] / dSeconds[0] : 0.0);
+	sOutBuf += utils.StrFormat("\nTime in metrics:                %.2f s", dMetricSeconds);
+	PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "%s\n", sOutBuf.c_str());
+	s_logbuffer += sOutBuf + "\n";
+
+	//per frame values go to the log only
+	sOutBuf = "\n[Per frame]\n  Frame";
+	for (int iPlane = 0; iPlane < quality.iPlanes; iPlane++)
+		sOutBuf += utils.StrFormat(" %11s", ("PSNR " + quality.GetPlaneName(iPlane)).c_str());
+	for (int iPlane = 0; iPlane < quality.iPlanes; iPlane++)
+		sOutBuf += utils.StrFormat(" %11s", ("SSIM " + quality.GetPlaneName(iPlane)).c_str());
+	s_logbuffer += sOutBuf + "\n";
+
+	for (unsigned int uiFrame = 0; uiFrame < quality.uiFrames; uiFrame++)
+	{
+		sOutBuf = utils.StrFormat("%7u", uiFrame);
+		for (int iPlane = 0; iPlane < quality.iPlanes; iPlane++)
+			sOutBuf += utils.StrFormat(" %11.3f", quality.vPSNR[iPlane][uiFrame]);
+		for (int iPlane = 0; iPlane < quality.iPlanes; iPlane++)
+			sOutBuf += utils.StrFormat(" %11.5f", quality.vSSIM[iPlane][uiFrame]);
+		s_logbuffer += sOutBuf + "\n";
+	}
+
+	PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "\n");
+
+	return 0;
+}
+
+
+int RunServerMode(string &s_pipename)
+{
+	CBenchmark benchmark;
+	if (!benchmark.LoadAvisynth(Settings.sAVSDLL, AvisynthInfo.iInterfaceVersion))
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", benchmark.sError.c_str());
+		return -1;
+	}
+
+	benchmark.bInvokeDistributor = Settings.bInvokeDistributor;
+	if (Settings.iTimeLimit != -1)
+		benchmark.dMeasureSeconds = (double)Settings.iTimeLimit;
+
+	CBenchmarkServer server;
+	server.sVersion = AvisynthInfo.sVersionString;
+
+	PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "\n[Server]\n");
+	if (!server.Run(s_pipename, benchmark, ServerNotify))
+	{
+		PrintConsole(Settings.bConUseStdOut, COLOR_ERROR, "\n%s\n", server.sError.c_str());
+		benchmark.UnloadAvisynth();
+		return -1;
+	}
+
+	benchmark.UnloadAvisynth();
+	PrintConsole(Settings.bConUseStdOut, COLOR_EMPHASIS, "Server stopped after %u job(s)\n", server.uiJobs);
+
+	return 0;
+}
+
+
+void ServerNotify(const string &s_message)
+{
+	PrintConsole(Settings.bConUseStdOut, COLOR_DEFAULT, "%s\n", s_message.c_str());
+
+	return;
+}
+
+
 void PrintUsage()
 {
-	PrintConsole(TRUE, BG_BLACK | FG_HYELLOW, "\nUsage 1:  AVSMeter script.avs [switches]\n\n");
+	PrintConsole(TRUE, BG_BLACK | FG_HYELLOW, "\nUsage 1:  AVSMeter script.avs|script.vpy [switches]\n\n");
+
+	PrintConsole(TRUE, COLOR_EMPHASIS, "Script:\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  script.vpy          VapourSynth script, served through VSScript\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  synthetic[:opts]    Built-in test clip instead of a script file, opts:\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "                      WxH, format, frames=n, fps=num/den, threads=n, seed=n,\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "                      cost=constant|jitter|spikes|memory, ms=x, jitter=x,\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "                      period=n, spike=x, mem=MiB\n\n");
 
 	PrintConsole(TRUE, COLOR_EMPHASIS, "Switches:\n");
 	
@@ -2599,7 +4575,30 @@ void PrintUsage()
 	PrintConsole(TRUE, COLOR_EMPHASIS, "  -info   [-i]        Display clip info\n");
 	PrintConsole(TRUE, COLOR_EMPHASIS, "  -log    [-l]        Create log file\n");
 	PrintConsole(TRUE, COLOR_EMPHASIS, "  -csv                Create csv file\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -json=file          Write results and startup latency as JSON\n");
 	PrintConsole(TRUE, COLOR_EMPHASIS, "  -gpu                Display GPU/VPU usage (requires GPU-Z)\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -perf               Collect hardware performance counters (Linux)\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -cpufreq            Monitor CPU clock and throttling\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -scaling            Measure scaling from 1 to n CPUs\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -isasweep           Measure FPS with the CPU level capped from C to AVX2\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -capi               Serve frames through the avisynth C API\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -y4m=file|-         Write the frames as YUV4MPEG2 to a file or stdout\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -raw=file|-         Write the raw frame planes to a file or stdout\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -consumer=spec      Emulate an encoder: preset[,refs=n][,ms=x][,mode=busy|sleep][,read=0|1]\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "                      presets: x264-ultrafast, x264-medium, x264-veryslow,\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "                      x265-medium, x265-slow, nvenc\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -replay=file        Replay a frame request trace (AVSMeterTrace plugin)\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -replaytiming       Issue the requests at their recorded times\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -replaythreads      Issue the requests from the recorded threads\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -compare=script     Measure PSNR/SSIM and FPS against a reference script\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -energy             Measure CPU package/DRAM energy (Linux)\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -membench           Measure memory bandwidth/latency before the script\n");
+#if defined(_WIN32)
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -server[=name]      Run as benchmark server on \\\\.\\pipe\\name (no script)\n");
+#else
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -server[=name]      Run as benchmark server on $XDG_RUNTIME_DIR/name.sock (no script)\n");
+#endif
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -metrics=type[:..]  Export live metrics (prometheus[:port], statsd[:host[:port]])\n");
 	PrintConsole(TRUE, COLOR_EMPHASIS, "  -range=first,last   Set frame range\n");
 	PrintConsole(TRUE, COLOR_EMPHASIS, "  -timelimit=n        Set time limit (seconds)\n");
 	PrintConsole(TRUE, COLOR_EMPHASIS, "  -priority=n         Set process priority (1:low, 2:normal, 3:high)\n");
@@ -2613,7 +4612,10 @@ void PrintUsage()
  	PrintConsole(TRUE, COLOR_EMPHASIS, "  -avsdll             Specify avisynth.dll to be used\n");
 	PrintConsole(TRUE, COLOR_EMPHASIS, "  -c                  Specify custom plugin directory\n");
 	PrintConsole(TRUE, COLOR_EMPHASIS, "  -log    [-l]        Create log file\n");
-	PrintConsole(TRUE, COLOR_EMPHASIS, "  -lf                 Add internal/external functions to the log file\n\n\n\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -lf                 Add internal/external functions to the log file\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -rescan             Ignore the plugin cache and inspect all DLLs\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -depgraph=file.dot  Write the plugin DLL dependency graph (Graphviz)\n");
+	PrintConsole(TRUE, COLOR_EMPHASIS, "  -workers[=n]        Test-load plugins in n isolated worker processes\n\n\n\n");
 
 
 	PrintConsole(TRUE, COLOR_EMPHASIS, "  For more info on the command line switches and INI file\n");
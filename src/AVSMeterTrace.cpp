@@ -0,0 +1,93 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+	AVSMeterTrace plugin (AVSMeterTrace.dll / libavsmetertrace.so).
+	Append AVSMeterTrace("trace.txt") to the end of a script and feed it to
+	the encoder, every frame request of the encoder is logged with the
+	requesting thread and its timing. "AVSMeter script -replay=trace.txt"
+	issues the same requests again, see CTraceReplay.
+*/
+
+#include "common.h"
+#include "avs_headers/avisynth.h"
+#include "FrameTrace.h"
+
+const AVS_Linkage *AVS_linkage = 0;
+
+
+class CTraceFilter : public GenericVideoFilter
+{
+public:
+	CTraceFilter(PClip _child, const char *psz_file, IScriptEnvironment *env);
+	virtual ~CTraceFilter() {}
+
+	PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment *env);
+	int __stdcall SetCacheHints(int cachehints, int frame_range);
+
+private:
+	CTraceRecorder recorder;
+};
+
+
+CTraceFilter::CTraceFilter(PClip _child, const char *psz_file, IScriptEnvironment *env) : GenericVideoFilter(_child)
+{
+	if (!vi.HasVideo())
+		env->ThrowError("AVSMeterTrace: The clip has no video");
+
+	if (!recorder.Open(psz_file))
+		env->ThrowError("AVSMeterTrace: %s", recorder.sError.c_str());
+}
+
+
+PVideoFrame __stdcall CTraceFilter::GetFrame(int n, IScriptEnvironment *env)
+{
+	double dStartMS = recorder.Now();
+	PVideoFrame frame = child->GetFrame(n, env);
+	recorder.Record((unsigned int)n, dStartMS, recorder.Now());
+
+	return frame;
+}
+
+
+int __stdcall CTraceFilter::SetCacheHints(int cachehints, int frame_range)
+{
+	//one instance for all threads and no cache in front of it, every request of the consumer has to show up
+	if (cachehints == CACHE_GET_MTMODE)
+		return MT_NICE_FILTER;
+
+	if (cachehints == CACHE_DONT_CACHE_ME)
+		return 1;
+
+	return 0;
+}
+
+
+AVSValue __cdecl Create_AVSMeterTrace(AVSValue args, void *user_data, IScriptEnvironment *env)
+{
+	return new CTraceFilter(args[0].AsClip(), args[1].AsString("AVSMeterTrace.txt"), env);
+}
+
+
+extern "C" __declspec(dllexport) const char* __stdcall AvisynthPluginInit3(IScriptEnvironment *env, const AVS_Linkage *const vectors)
+{
+	AVS_linkage = vectors;
+	env->AddFunction("AVSMeterTrace", "c[file]s", Create_AVSMeterTrace, 0);
+
+	return "AVSMeter frame request trace";
+}
@@ -21,11 +21,79 @@
 
 #include "common.h"
 #include "exception.h"
-#include "utility.h"
-#include "avs_headers\avisynth.h"
+#include "Utility.h"
+#include "Timer.h"
+#include "PEFile.h"
+#include "DependencyGraph.h"
+#include "avs_headers/avisynth.h"
 
 const AVS_Linkage *AVS_linkage = 0;
 
+struct stPluginLoadTime
+{
+	string  sPlugin;
+	double  dDependencyMS;       //GetDLLDependencies()
+	double  dMapMS;              //LoadLibraryEx(), includes static imports and DllMain
+	double  dLoadMS;             //Invoke("LoadPlugin"), plugin init and function registration
+	__int64 iWorkingSetDeltaKB;
+	BOOL    bFailed;
+};
+
+#define PLUGINSCAN_MAX_THREADS 16  //the inspection is mostly I/O bound (network shares)
+#define PLUGINCACHE_HEADER     "AVSMeter plugin cache 1"
+
+struct stPluginScanJob
+{
+	string  sFile;
+	unsigned __int64 uiFileSize;
+	unsigned __int64 uiLastWriteTime;
+	BOOL    bCached;        //type and imports taken from the plugin cache
+	BOOL    bRet;
+	string  sMessage;
+	BOOL    bIs64Bit;
+	BOOL    bImports;
+	vector  <string> vImports;
+	BOOL    bDependencies;  //only for DLLs recognized as plugins, see TestLoadPlugins()
+	string  sDependencies;
+	string  sFailedDependencies;
+	string  sHint;
+	double  dDependencyMS;
+};
+
+#define PLUGINTEST_WORKER_SWITCH    "-plugintestworker"
+#define PLUGINTEST_DEFAULT_TIMEOUT  30000
+#define PLUGINTEST_NONE             ((size_t)-1)
+
+struct stPluginTestJob
+{
+	string  sPluginType;
+	string  sFailedDependencies;
+	string  sHint;
+	stPluginLoadTime plt;
+	BOOL    bDone;
+	string  sError;         //raw LoadPlugin error, the notes are added when merging
+};
+
+struct stPluginTestWorker
+{
+	vector  <size_t> vShard;  //vJobs indices
+	size_t  nDone;            //shard entries finished
+	size_t  nSpawnedAt;       //shard entry the current process started with
+	size_t  nCurrent;         //shard entry being loaded or PLUGINTEST_NONE
+	double  dStart;           //BEGIN of nCurrent
+	double  dLastActivity;    //spawn or last protocol line, the timeout runs from here
+	HANDLE  hProcess;
+	HANDLE  hOutput;
+	string  sPending;
+};
+
+#if defined(_WIN32)
+static BOOL ComparePluginLoadTime(const stPluginLoadTime &first, const stPluginLoadTime &second)
+{
+	return ((first.dDependencyMS + first.dMapMS + first.dLoadMS) > (second.dDependencyMS + second.dMapMS + second.dLoadMS)) ? TRUE : FALSE;
+}
+#endif //_WIN32
+
 class CAvisynthInfo
 {
 public:
@@ -40,6 +108,17 @@ public:
 	vector  <string> vPlugins;
 	vector  <string> vPluginDependencies;
 	vector  <string> vPluginErrors;
+	vector  <stPluginLoadTime> vPluginLoadTimes; //sorted by total time, descending
+	double  dEnvCreateMS;
+	double  dAutoloadMS;         //AVS+ only, -1.0 if not measured
+	double  dPluginTestMS;
+	string  sPluginCacheFile;    //empty: no cache
+	BOOL    bRescanPlugins;      //ignore (and rewrite) the cache
+	unsigned int uiCachedDLLs;
+	CDependencyGraph DependencyGraph;  //plugins and avisynth.dll, see CheckDLLDependencies()
+	unsigned int uiPluginTestWorkers;  //0: test in this process
+	unsigned int uiPluginTestTimeout;  //ms per plugin, worker processes only
+	int     PluginTestWorker(string s_AVSDLL, int i_InterfaceVersion);
 	string  sDLLPath;
 	string  sFileVersion;
 	string  sProductVersion;
@@ -52,14 +131,31 @@ public:
 
 private:
 	CUtils              utils;
+	CTimer              timer;
 	string              sAVSDLL;
   void                EnumPluginDirs(BOOL b_CustomPluginDir);
 	void                EnumPluginDLLs();
 	BOOL                GetPluginType(string s_dll, string &s_Msg, BOOL &b_Is64BitDLL);
+	void                ScanPluginDLLs();
+	static unsigned __stdcall ScanThreadProc(void *p_this);
+	void                LoadPluginCache();
+	void                SavePluginCache();
+	vector  <stPluginScanJob> vScanJobs;
+	map     <string, size_t>  mScanJobs;  //lower case path -> vScanJobs index
+	volatile LONG       lNextScanJob;
 	void                TestLoadPlugins();
+	void                TestLoadPluginsIsolated();
+	BOOL                StartPluginTestWorker(stPluginTestWorker &worker, vector<stPluginTestJob> &v_jobs, string s_commandline);
+	void                StopPluginTestWorker(stPluginTestWorker &worker);
+	void                ParsePluginTestOutput(stPluginTestWorker &worker, vector<stPluginTestJob> &v_jobs);
+	void                GetPluginDependencies(string s_plugin, string &s_dependencies, string &s_failed_dependencies, string &s_hint, double &d_ms);
+	string              GetPluginErrorNote(string s_plugin_type, string s_error, string s_failed_dependencies, string s_hint);
 	void                GetDLLDependencies(string s_dll, string &s_dependencies, string &s_failed_dependencies, string &s_hint);
+	BOOL                GetDLLImports(string s_dll, vector<string> &v_imports);
+	void                CheckDLLDependencies(string s_dll, const vector<string> &v_imports, string &s_dependencies, string &s_failed_dependencies, string &s_hint);
 	BOOL                IsRuntimeInstalled(string s_version);
 	__int64             FileSize(string s_file);
+	unsigned __int64    GetWorkingSet();
 	BOOL                Is64BitOS();
 	string              BrowseDirectory();
 	typedef             IScriptEnvironment * __stdcall CREATE_ENV(int);
@@ -68,6 +164,11 @@ private:
 
 CAvisynthInfo::CAvisynthInfo()
 {
+	sPluginCacheFile = "";
+	bRescanPlugins = FALSE;
+	uiCachedDLLs = 0;
+	uiPluginTestWorkers = 0;
+	uiPluginTestTimeout = PLUGINTEST_DEFAULT_TIMEOUT;
 }
 
 CAvisynthInfo::~CAvisynthInfo()
@@ -75,6 +176,8 @@ CAvisynthInfo::~CAvisynthInfo()
 }
 
 
+#if defined(_WIN32)
+
 string CAvisynthInfo::BrowseDirectory()
 {
 	BROWSEINFO		bi;
@@ -106,6 +209,8 @@ string CAvisynthInfo::BrowseDirectory()
 	return sDir;
 }
 
+#endif //_WIN32
+
 
 BOOL CAvisynthInfo::GetInfo(string s_AVSDLL, BOOL b_CustomPluginDir, string &s_ErrorMsg)
 {
@@ -114,6 +219,9 @@ BOOL CAvisynthInfo::GetInfo(string s_AVSDLL, BOOL b_CustomPluginDir, string &s_E
 	bIsMTVersion = FALSE;
 	bIsAVSPlus = FALSE;
 	iInterfaceVersion = 0;
+	dEnvCreateMS = 0.0;
+	dAutoloadMS = -1.0;
+	dPluginTestMS = 0.0;
 	sFileVersion = "";
 	sProductVersion = "";
 	sVersionString = "Unknown Avisynth Version";
@@ -121,16 +229,20 @@ BOOL CAvisynthInfo::GetInfo(string s_AVSDLL, BOOL b_CustomPluginDir, string &s_E
 	BOOL bSuccess = TRUE;
 	s_ErrorMsg = "";
 
-	LOADED_IMAGE li;
-	BOOL bLoaded;
-
 	//Make a local copy
 	sAVSDLL = s_AVSDLL;
 
-	if (sAVSDLL == "")
-		bLoaded = MapAndLoad("avisynth", NULL, &li,	TRUE,	TRUE);
-	else
-		bLoaded = MapAndLoad((LPSTR)sAVSDLL.c_str(), NULL, &li,	TRUE,	TRUE);
+#if defined(_WIN32)
+	CPEFile pe;
+	BOOL bLoaded = FALSE;
+	char szPath[MAX_PATH + 1];
+
+	//same search order as LoadLibrary()
+	if (::SearchPath(NULL, (sAVSDLL == "") ? "avisynth" : sAVSDLL.c_str(), ".dll", MAX_PATH, szPath, NULL) > 0)
+	{
+		sDLLPath = szPath;
+		bLoaded = pe.Open(sDLLPath);
+	}
 
 	if (!bLoaded)
 	{
@@ -146,14 +258,12 @@ BOOL CAvisynthInfo::GetInfo(string s_AVSDLL, BOOL b_CustomPluginDir, string &s_E
 	try
 	{
 		_set_se_translator(SE_Translator);
-		sDLLPath = utils.StrFormat("%s", li.ModuleName);
 
-		if (li.FileHeader->FileHeader.Machine != IMAGE_FILE_MACHINE_I386)
+		if (pe.wMachine != PE_MACHINE_I386)
 		{
 			bIs64BitAVSDLL = TRUE;
 			if (!PROCESS_64) //trying to load 64 bit avisynth.dll with 32 bit AVSMeter
 			{
-				UnMapAndLoad(&li);
 				s_ErrorMsg = "AVSMeter (x86) cannot load a 64 Bit avisynth.dll.";
 				return FALSE;
 			}
@@ -162,24 +272,17 @@ BOOL CAvisynthInfo::GetInfo(string s_AVSDLL, BOOL b_CustomPluginDir, string &s_E
 		{
 			if (PROCESS_64) //trying to load 32 bit avisynth.dll with 64 bit AVSMeter
 			{
-				UnMapAndLoad(&li);
 				s_ErrorMsg = "AVSMeter (x64) cannot load a 32 Bit avisynth.dll.";
 				return FALSE;
 			}
 		}
 
-		DWORD expVA = li.FileHeader->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress;
-		PIMAGE_EXPORT_DIRECTORY pExp = (PIMAGE_EXPORT_DIRECTORY)ImageRvaToVa(li.FileHeader, li.MappedAddress, expVA, NULL);
-		DWORD rvaNames = pExp->AddressOfNames;
-		DWORD *prvaNames = (DWORD*)ImageRvaToVa(li.FileHeader, li.MappedAddress, rvaNames, NULL);
-
-		for (DWORD dwName = 0; dwName < pExp->NumberOfNames; ++dwName)
+		vector <string> vExports;
+		pe.GetExportNames(vExports);
+		for (size_t i = 0; i < vExports.size(); i++)
 		{
-			DWORD rvaName = prvaNames[dwName];
-			string sName((char *)ImageRvaToVa(li.FileHeader, li.MappedAddress, rvaName, NULL));
-			utils.StrToLC(sName);
-
-			if (sName.find("avs_linkage") != string::npos)
+			utils.StrToLC(vExports[i]);
+			if (vExports[i].find("avs_linkage") != string::npos)
 			{
 				bAVSLinkage = TRUE;
 				break;
@@ -201,7 +304,7 @@ BOOL CAvisynthInfo::GetInfo(string s_AVSDLL, BOOL b_CustomPluginDir, string &s_E
 			s_ErrorMsg = "Cannot load avisynth.dll";
 	}
 
-	UnMapAndLoad(&li);
+	pe.Close();
 
 	if (!bSuccess)
 		return FALSE;
@@ -233,6 +336,9 @@ BOOL CAvisynthInfo::GetInfo(string s_AVSDLL, BOOL b_CustomPluginDir, string &s_E
 	if (sDeps != "")
 		vPluginDependencies.push_back(sDeps);
 
+	//plugins importing avisynth.dll get the one that is already loaded
+	DependencyGraph.AddKnownModule("avisynth.dll", sDLLPath);
+
 	if (sFailedDeps != "")
 	{
 		s_ErrorMsg = utils.StrFormat("Cannot load avisynth.dll\n\nDependencies that could not be loaded:\n%s", sFailedDeps.c_str());
@@ -250,7 +356,7 @@ BOOL CAvisynthInfo::GetInfo(string s_AVSDLL, BOOL b_CustomPluginDir, string &s_E
 
 	if (!hDLL)
 	{
-		s_ErrorMsg = utils.SysErrorMessage();
+		s_ErrorMsg = utils.LibraryErrorMessage();
 		if (s_ErrorMsg != "")
 			s_ErrorMsg = "Cannot load avisynth.dll:\n" + s_ErrorMsg;
 		else
@@ -258,6 +364,31 @@ BOOL CAvisynthInfo::GetInfo(string s_AVSDLL, BOOL b_CustomPluginDir, string &s_E
 
 		return FALSE;
 	}
+#else //_WIN32
+	//dlopen() search order, a library of the wrong architecture fails to load
+	HINSTANCE hDLL = ::LoadLibrary((sAVSDLL == "") ? "avisynth" : sAVSDLL.c_str());
+	if (!hDLL)
+	{
+		s_ErrorMsg = utils.LibraryErrorMessage();
+		if (s_ErrorMsg != "")
+			s_ErrorMsg = "Cannot load libavisynth.so:\n" + s_ErrorMsg;
+		else
+			s_ErrorMsg = "Cannot load libavisynth.so";
+
+		return FALSE;
+	}
+
+	char szPath[MAX_PATH + 1];
+	if (::GetModuleFileName(hDLL, szPath, MAX_PATH) > 0)
+		sDLLPath = szPath;
+	else
+		sDLLPath = (sAVSDLL == "") ? "libavisynth.so" : sAVSDLL;
+
+	bIs64BitAVSDLL = PROCESS_64;
+	sFileVersion = utils.GetFileVersion(sDLLPath);
+	sProductVersion = utils.GetProductVersion(sDLLPath);
+	sTimeStamp = utils.GetFileTimeStamp(sDLLPath);
+#endif //_WIN32
 
 	IScriptEnvironment *AVS_env = 0;
 
@@ -274,6 +405,7 @@ BOOL CAvisynthInfo::GetInfo(string s_AVSDLL, BOOL b_CustomPluginDir, string &s_E
 		}
 
 		iInterfaceVersion = 6;
+		double dStart = timer.GetTimer();
 		while (!AVS_env)
 		{
 			if (iInterfaceVersion < 5)
@@ -286,6 +418,7 @@ BOOL CAvisynthInfo::GetInfo(string s_AVSDLL, BOOL b_CustomPluginDir, string &s_E
 			AVS_env = CreateEnvironment(iInterfaceVersion);
 			iInterfaceVersion--;
 		}
+		dEnvCreateMS = (timer.GetTimer() - dStart) * 1000.0;
 
 
 		AVS_linkage = AVS_env->GetAVSLinkage();
@@ -337,6 +470,20 @@ BOOL CAvisynthInfo::GetInfo(string s_AVSDLL, BOOL b_CustomPluginDir, string &s_E
 		string sDLLFunctions = "";
 		if (!b_CustomPluginDir)
 		{
+			if (bIsAVSPlus)
+			{
+				try
+				{
+					dStart = timer.GetTimer();
+					AVS_env->Invoke("AutoloadPlugins", AVSValue(&foo, 0));
+					dAutoloadMS = (timer.GetTimer() - dStart) * 1000.0;
+				}
+				catch (...)
+				{
+					dAutoloadMS = -1.0;
+				}
+			}
+
 			try
 			{
 				foo = AVS_env->GetVar("$PluginFunctions$");
@@ -380,14 +527,21 @@ BOOL CAvisynthInfo::GetInfo(string s_AVSDLL, BOOL b_CustomPluginDir, string &s_E
 	if (!bSuccess)
 		return FALSE;
 
+	//plugin inspection reads PE headers and the registry
+#if defined(_WIN32)
 	EnumPluginDirs(b_CustomPluginDir);
 	EnumPluginDLLs();
 	TestLoadPlugins();
+	DependencyGraph.Finalize();
+#endif
 
 	return bSuccess;
 }
 
 
+#if defined(_WIN32)
+
+
 void CAvisynthInfo::EnumPluginDirs(BOOL b_CustomPluginDir)
 {
 	vPluginDirs.empty();
@@ -517,6 +671,16 @@ void CAvisynthInfo::EnumPluginDLLs()
 	BOOL bIs64BitPlugin = FALSE;
 	set <string> mDuplicates;
 
+	/*
+	The directories are enumerated serially so that the order and the duplicate
+	handling stay the same, the DLLs are then inspected by a pool of threads
+	(ScanPluginDLLs) and the results are merged back in enumeration order.
+	*/
+	vector <string> vFiles;
+	vScanJobs.clear();
+	mScanJobs.clear();
+	stPluginScanJob job;
+
 	for (size_t uiPlugDir = 0; uiPlugDir < vPluginDirs.size(); uiPlugDir++)
 	{
 		sDir = vPluginDirs[uiPlugDir];
@@ -547,52 +711,17 @@ void CAvisynthInfo::EnumPluginDLLs()
 					}
 
 					mDuplicates.insert(sCurrentFileLC);
+					vFiles.push_back(sCurrentFile);
 
 					if (sCurrentFileLC.substr(sCurrentFileLC.length() - 4) == ".dll")
 					{
-						if (!GetPluginType(sCurrentFile, sMessage, bIs64BitPlugin))
-						{
-							if (sMessage != "")
-								vPluginErrors.push_back(sMessage);
-						}
-						else
-						{
-							if (bIs64BitPlugin)
-							{
-								if (sMessage == "AVSC25")
-									vPlugins.push_back("C 2.5 Plugins (64 Bit)|" + sCurrentFile);
-								if (sMessage == "AVSC20")
-									vPlugins.push_back("C 2.0 Plugins (64 Bit)|" + sCurrentFile);
-								if (sMessage == "AVSCPP26")
-									vPlugins.push_back("CPP 2.6 Plugins (64 Bit)|" + sCurrentFile);
-								if (sMessage == "AVSCPP25")
-									vPlugins.push_back("CPP 2.5 Plugins (64 Bit)|" + sCurrentFile);
-								if (sMessage == "AVSCPP20")
-									vPlugins.push_back("CPP 2.0 Plugins (64 Bit)|" + sCurrentFile);
-								if (sMessage == "UNCATEGORIZED")
-									vPlugins.push_back("Uncategorized DLLs (64 Bit)|" + sCurrentFile);
-							}
-							else
-							{
-								if (sMessage == "AVSC25")
-									vPlugins.push_back("C 2.5 Plugins (32 Bit)|" + sCurrentFile);
-								if (sMessage == "AVSC20")
-									vPlugins.push_back("C 2.0 Plugins (32 Bit)|" + sCurrentFile);
-								if (sMessage == "AVSCPP26")
-									vPlugins.push_back("CPP 2.6 Plugins (32 Bit)|" + sCurrentFile);
-								if (sMessage == "AVSCPP25")
-									vPlugins.push_back("CPP 2.5 Plugins (32 Bit)|" + sCurrentFile);
-								if (sMessage == "AVSCPP20")
-									vPlugins.push_back("CPP 2.0 Plugins (32 Bit)|" + sCurrentFile);
-								if (sMessage == "UNCATEGORIZED")
-									vPlugins.push_back("Uncategorized DLLs (32 Bit)|" + sCurrentFile);
-							}
-						}
+						job.sFile = sCurrentFile;
+						job.uiFileSize = (((unsigned __int64)fd.nFileSizeHigh) << 32) + (unsigned __int64)fd.nFileSizeLow;
+						job.uiLastWriteTime = (((unsigned __int64)fd.ftLastWriteTime.dwHighDateTime) << 32) + (unsigned __int64)fd.ftLastWriteTime.dwLowDateTime;
+						job.bCached = FALSE;
+						mScanJobs[sCurrentFileLC] = vScanJobs.size();
+						vScanJobs.push_back(job);
 					}
-					else if (sCurrentFileLC.substr(sCurrentFileLC.length() - 5) == ".avsi")
-						vPlugins.push_back("Scripts (AVSI)|" + sCurrentFile);
-					else
-						vPlugins.push_back("Uncategorized files|" + sCurrentFile);
 				}
 				bRet = FindNextFile(hFind, &fd);
 			}
@@ -601,136 +730,320 @@ void CAvisynthInfo::EnumPluginDLLs()
 		}
 	}
 
+	ScanPluginDLLs();
+
+	string sCurrentFile = "";
+	string sCurrentFileLC = "";
+	for (size_t uiFile = 0; uiFile < vFiles.size(); uiFile++)
+	{
+		sCurrentFile = vFiles[uiFile];
+		sCurrentFileLC = sCurrentFile;
+		utils.StrToLC(sCurrentFileLC);
+
+		if (sCurrentFileLC.substr(sCurrentFileLC.length() - 4) == ".dll")
+		{
+			stPluginScanJob &scanjob = vScanJobs[mScanJobs[sCurrentFileLC]];
+			sMessage = scanjob.sMessage;
+			bIs64BitPlugin = scanjob.bIs64Bit;
+
+			if (!scanjob.bRet)
+			{
+				if (sMessage != "")
+					vPluginErrors.push_back(sMessage);
+			}
+			else
+			{
+				if (bIs64BitPlugin)
+				{
+					if (sMessage == "AVSC25")
+						vPlugins.push_back("C 2.5 Plugins (64 Bit)|" + sCurrentFile);
+					if (sMessage == "AVSC20")
+						vPlugins.push_back("C 2.0 Plugins (64 Bit)|" + sCurrentFile);
+					if (sMessage == "AVSCPP26")
+						vPlugins.push_back("CPP 2.6 Plugins (64 Bit)|" + sCurrentFile);
+					if (sMessage == "AVSCPP25")
+						vPlugins.push_back("CPP 2.5 Plugins (64 Bit)|" + sCurrentFile);
+					if (sMessage == "AVSCPP20")
+						vPlugins.push_back("CPP 2.0 Plugins (64 Bit)|" + sCurrentFile);
+					if (sMessage == "UNCATEGORIZED")
+						vPlugins.push_back("Uncategorized DLLs (64 Bit)|" + sCurrentFile);
+				}
+				else
+				{
+					if (sMessage == "AVSC25")
+						vPlugins.push_back("C 2.5 Plugins (32 Bit)|" + sCurrentFile);
+					if (sMessage == "AVSC20")
+						vPlugins.push_back("C 2.0 Plugins (32 Bit)|" + sCurrentFile);
+					if (sMessage == "AVSCPP26")
+						vPlugins.push_back("CPP 2.6 Plugins (32 Bit)|" + sCurrentFile);
+					if (sMessage == "AVSCPP25")
+						vPlugins.push_back("CPP 2.5 Plugins (32 Bit)|" + sCurrentFile);
+					if (sMessage == "AVSCPP20")
+						vPlugins.push_back("CPP 2.0 Plugins (32 Bit)|" + sCurrentFile);
+					if (sMessage == "UNCATEGORIZED")
+						vPlugins.push_back("Uncategorized DLLs (32 Bit)|" + sCurrentFile);
+				}
+			}
+		}
+		else if (sCurrentFileLC.substr(sCurrentFileLC.length() - 5) == ".avsi")
+			vPlugins.push_back("Scripts (AVSI)|" + sCurrentFile);
+		else
+			vPlugins.push_back("Uncategorized files|" + sCurrentFile);
+	}
+
 	sort(vPlugins.begin(), vPlugins.end(), CompareNoCase);
 
 	return;
 }
 
 
-BOOL CAvisynthInfo::GetPluginType(string s_dll, string &s_Msg, BOOL &b_Is64BitDLL)
+void CAvisynthInfo::ScanPluginDLLs()
 {
-	BOOL bRet = TRUE;
-	b_Is64BitDLL = FALSE;
-	s_Msg = "UNCATEGORIZED";		
-
-	LOADED_IMAGE li;
-	BOOL bLoaded = MapAndLoad((LPSTR)s_dll.c_str(), NULL, &li,	TRUE,	TRUE);
+	if (vScanJobs.size() == 0)
+		return;
 
-	if (!bLoaded)
+	uiCachedDLLs = 0;
+	if ((sPluginCacheFile != "") && !bRescanPlugins)
+		LoadPluginCache();
+
+	SYSTEM_INFO si;
+	::GetSystemInfo(&si);
+	size_t nThreads = (size_t)si.dwNumberOfProcessors * 2;
+	if (nThreads > PLUGINSCAN_MAX_THREADS)
+		nThreads = PLUGINSCAN_MAX_THREADS;
+	if (nThreads > vScanJobs.size())
+		nThreads = vScanJobs.size();
+
+	lNextScanJob = -1;
+	vector <HANDLE> vThreads;
+	for (size_t i = 0; i < nThreads; i++)
 	{
-		s_Msg = utils.SysErrorMessage();
-		if (s_Msg != "")
-			s_Msg = utils.StrFormat("Error loading \"%s\":\n%s", s_dll.c_str(), s_Msg.c_str());
-		else
-			s_Msg = utils.StrFormat("Error loading \"%s\"", s_dll.c_str());
-
-		return FALSE;
+		HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, ScanThreadProc, this, 0, NULL);
+		if (hThread)
+			vThreads.push_back(hThread);
 	}
 
-	try
+	//no threads: do the work in the calling thread
+	if (vThreads.size() == 0)
+		ScanThreadProc(this);
+
+	for (size_t i = 0; i < vThreads.size(); i++)
 	{
-		_set_se_translator(SE_Translator);
+		::WaitForSingleObject(vThreads[i], INFINITE);
+		::CloseHandle(vThreads[i]);
+	}
+
+	if (sPluginCacheFile != "")
+		SavePluginCache();
+
+	return;
+}
+
+
+void CAvisynthInfo::LoadPluginCache()
+{
+	/*
+	One line per DLL, tab separated:
+	path, size, last write time, 64 bit, type, has imports, imports ('|' separated)
+	Entries are only used if path, size and last write time match.
+	*/
+	ifstream hCacheFile(sPluginCacheFile.c_str());
+	if (!hCacheFile.is_open())
+		return;
 
-		if (li.FileHeader->FileHeader.Machine != IMAGE_FILE_MACHINE_I386)
+	string sLine = "";
+	if (!getline(hCacheFile, sLine) || (sLine != PLUGINCACHE_HEADER))
+		return;
+
+	vector <string> vFields;
+	string sPathLC = "";
+	size_t nPos = 0;
+	size_t nTab = 0;
+	while (getline(hCacheFile, sLine))
+	{
+		vFields.clear();
+		nPos = 0;
+		while ((nTab = sLine.find('\t', nPos)) != string::npos)
 		{
-			b_Is64BitDLL = TRUE;
-			if (!PROCESS_64)
-			{
-				UnMapAndLoad(&li);
-				return TRUE;
-			}
+			vFields.push_back(sLine.substr(nPos, nTab - nPos));
+			nPos = nTab + 1;
 		}
-		else
+		vFields.push_back(sLine.substr(nPos));
+
+		if (vFields.size() != 7)
+			continue;
+
+		sPathLC = vFields[0];
+		utils.StrToLC(sPathLC);
+		if (mScanJobs.find(sPathLC) == mScanJobs.end())
+			continue;
+
+		stPluginScanJob &job = vScanJobs[mScanJobs[sPathLC]];
+		if ((job.uiFileSize != _strtoui64(vFields[1].c_str(), NULL, 10)) || (job.uiLastWriteTime != _strtoui64(vFields[2].c_str(), NULL, 10)))
+			continue;
+
+		job.bRet = TRUE;
+		job.bIs64Bit = (vFields[3] == "1") ? TRUE : FALSE;
+		job.sMessage = vFields[4];
+		job.bImports = (vFields[5] == "1") ? TRUE : FALSE;
+		job.vImports.clear();
+		if (vFields[6] != "")
 		{
-			if (PROCESS_64)
+			nPos = 0;
+			while ((nTab = vFields[6].find('|', nPos)) != string::npos)
 			{
-				UnMapAndLoad(&li);
-				return TRUE;
+				job.vImports.push_back(vFields[6].substr(nPos, nTab - nPos));
+				nPos = nTab + 1;
 			}
+			job.vImports.push_back(vFields[6].substr(nPos));
 		}
+		job.bCached = TRUE;
+		++uiCachedDLLs;
+	}
 
-		DWORD expVA = li.FileHeader->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress;
-		if (expVA == 0)
-		{
-			UnMapAndLoad(&li);
-			return TRUE;
-		}
+	hCacheFile.close();
 
-		PIMAGE_EXPORT_DIRECTORY pExp = (PIMAGE_EXPORT_DIRECTORY)ImageRvaToVa(li.FileHeader, li.MappedAddress, expVA, NULL);
-		if (pExp == 0)
-		{
-			UnMapAndLoad(&li);
-			return TRUE;
-		}
+	return;
+}
 
-		DWORD rvaNames = pExp->AddressOfNames;
-		DWORD *prvaNames = (DWORD*)ImageRvaToVa(li.FileHeader, li.MappedAddress, rvaNames, NULL);
-		if (prvaNames == 0)
-		{
-			UnMapAndLoad(&li);
-			return TRUE;
-		}
 
-		string sName = "";
-		DWORD dwName = 0;
-		for (dwName = 0; dwName < pExp->NumberOfNames; ++dwName)
-		{
-			sName = "";
-			DWORD rvaName = prvaNames[dwName];
-			sName = (char *)ImageRvaToVa(li.FileHeader, li.MappedAddress, rvaName, NULL);
-			utils.StrToLC(sName);
+void CAvisynthInfo::SavePluginCache()
+{
+	ofstream hCacheFile(sPluginCacheFile.c_str());
+	if (!hCacheFile.is_open())
+		return;
 
-			if (sName.find("avisynthplugininit3") != string::npos)
-			{
-				s_Msg = "AVSCPP26";
-				break;
-			}
+	hCacheFile << PLUGINCACHE_HEADER << "\n";
 
-			if (sName.find("avisynthplugininit2") != string::npos)
-			{
-				s_Msg = "AVSCPP25";
-				break;
-			}
+	string sImports = "";
+	for (size_t i = 0; i < vScanJobs.size(); i++)
+	{
+		//errors may be temporary (locked file, network), they are not cached
+		if (!vScanJobs[i].bRet)
+			continue;
 
-			if (sName.find("avisynthplugininit") != string::npos)
-				s_Msg = "AVSCPP20";
+		sImports = "";
+		for (size_t j = 0; j < vScanJobs[i].vImports.size(); j++)
+			sImports += ((j > 0) ? "|" : "") + vScanJobs[i].vImports[j];
 
-			if (sName.find("avisynth_c_plugin_init@4") != string::npos) //32 bit implied
-			{
-				s_Msg = "AVSC25";
-				break;
-			}
+		hCacheFile << utils.StrFormat("%s\t%I64u\t%I64u\t%u\t%s\t%u\t", vScanJobs[i].sFile.c_str(), vScanJobs[i].uiFileSize, vScanJobs[i].uiLastWriteTime,
+			vScanJobs[i].bIs64Bit ? 1 : 0, vScanJobs[i].sMessage.c_str(), vScanJobs[i].bImports ? 1 : 0) << sImports << "\n";
+	}
 
-			if ((sName.find("avisynth_c_plugin_init") != string::npos) && (b_Is64BitDLL))
-				s_Msg = "AVSC25";
+	hCacheFile.close();
 
-			if ((sName.find("avisynth_c_plugin_init") != string::npos) && (!b_Is64BitDLL))
-				s_Msg = "AVSC20";
-		}
-	}
-	catch (exception& ex)
+	return;
+}
+
+
+unsigned __stdcall CAvisynthInfo::ScanThreadProc(void *p_this)
+{
+	CAvisynthInfo *pThis = (CAvisynthInfo *)p_this;
+	LONG lJob = 0;
+	CTimer timer;
+
+	while ((lJob = ::InterlockedIncrement(&pThis->lNextScanJob)) < (LONG)pThis->vScanJobs.size())
 	{
-		bRet = FALSE;
-		s_Msg = utils.StrFormat("\"%s\"\n", s_dll.c_str()) + ex.what();
+		stPluginScanJob &job = pThis->vScanJobs[lJob];
+		if (!job.bCached)
+			job.bRet = pThis->GetPluginType(job.sFile, job.sMessage, job.bIs64Bit);
+
+		job.bDependencies = (job.bRet && (job.sMessage != "UNCATEGORIZED")) ? TRUE : FALSE;
+		job.dDependencyMS = 0.0;
+
+		if (job.bDependencies)
+		{
+			//the import list is cached, whether the imports can be loaded is always checked
+			double dStart = timer.GetTimer();
+			if (!job.bCached)
+				job.bImports = pThis->GetDLLImports(job.sFile, job.vImports);
+			if (job.bImports)
+				pThis->CheckDLLDependencies(job.sFile, job.vImports, job.sDependencies, job.sFailedDependencies, job.sHint);
+			job.dDependencyMS = (timer.GetTimer() - dStart) * 1000.0;
+		}
+		else if (!job.bCached)
+			job.bImports = FALSE;
 	}
-	catch (...)
+
+	return 0;
+}
+
+
+BOOL CAvisynthInfo::GetPluginType(string s_dll, string &s_Msg, BOOL &b_Is64BitDLL)
+{
+	b_Is64BitDLL = FALSE;
+	s_Msg = "UNCATEGORIZED";		
+
+	CPEFile pe;
+	if (!pe.Open(s_dll))
 	{
-		bRet = FALSE;
 		s_Msg = utils.SysErrorMessage();
+		if (s_Msg == "")
+			s_Msg = pe.sError;
+
 		if (s_Msg != "")
-			s_Msg = utils.StrFormat("\"%s\"\n%s", s_dll.c_str(), s_Msg.c_str());
+			s_Msg = utils.StrFormat("Error loading \"%s\":\n%s", s_dll.c_str(), s_Msg.c_str());
 		else
-			s_Msg = utils.StrFormat("Unknown exception:\n\"%s\"", s_dll.c_str());
+			s_Msg = utils.StrFormat("Error loading \"%s\"", s_dll.c_str());
+
+		return FALSE;
 	}
 
-	UnMapAndLoad(&li);
+	if (pe.wMachine != PE_MACHINE_I386)
+		b_Is64BitDLL = TRUE;
+
+	if (b_Is64BitDLL != (PROCESS_64 ? TRUE : FALSE))
+		return TRUE;
+
+	vector <string> vExports;
+	pe.GetExportNames(vExports);
+
+	string sName = "";
+	for (size_t i = 0; i < vExports.size(); i++)
+	{
+		sName = vExports[i];
+		utils.StrToLC(sName);
+
+		if (sName.find("avisynthplugininit3") != string::npos)
+		{
+			s_Msg = "AVSCPP26";
+			break;
+		}
+
+		if (sName.find("avisynthplugininit2") != string::npos)
+		{
+			s_Msg = "AVSCPP25";
+			break;
+		}
+
+		if (sName.find("avisynthplugininit") != string::npos)
+			s_Msg = "AVSCPP20";
+
+		if (sName.find("avisynth_c_plugin_init@4") != string::npos) //32 bit implied
+		{
+			s_Msg = "AVSC25";
+			break;
+		}
+
+		if ((sName.find("avisynth_c_plugin_init") != string::npos) && (b_Is64BitDLL))
+			s_Msg = "AVSC25";
 
-	return bRet;
+		if ((sName.find("avisynth_c_plugin_init") != string::npos) && (!b_Is64BitDLL))
+			s_Msg = "AVSC20";
+	}
+
+	return TRUE;
 }
 
 
 void CAvisynthInfo::TestLoadPlugins()
 {
+	if (uiPluginTestWorkers > 0)
+	{
+		TestLoadPluginsIsolated();
+		return;
+	}
+
 	HINSTANCE hDLL;
 	if (sAVSDLL == "")
 		hDLL = ::LoadLibrary("avisynth");
@@ -741,8 +1054,6 @@ void CAvisynthInfo::TestLoadPlugins()
 		return;
 
 	string sPlugLoadError = "";
-	string sPlugLoadErrorLC = "";
-	string sNote = "";
 	string sPlugin = "";
 	string sPluginType = "";
 	size_t uiPlugin = 0;
@@ -751,7 +1062,11 @@ void CAvisynthInfo::TestLoadPlugins()
 	string sFailedDependencies = "";
 	string sHint = "";
 	string sMsg = "";
-	string sTemp = "";
+	stPluginLoadTime plt;
+	HINSTANCE hPlugin = NULL;
+	unsigned __int64 uiWorkingSet = 0;
+	double dStart = 0.0;
+	double dTestStart = timer.GetTimer();
 
 	IScriptEnvironment *AVS_env = 0;
 
@@ -800,51 +1115,42 @@ void CAvisynthInfo::TestLoadPlugins()
 
 		sPlugin = sPlugin.substr(spos + 1);
 
-		sDependencies = "";
-		sFailedDependencies = "";
-		sHint = "";
-		GetDLLDependencies(sPlugin, sDependencies, sFailedDependencies, sHint);
+		plt.sPlugin = sPlugin;
+		plt.bFailed = FALSE;
+		GetPluginDependencies(sPlugin, sDependencies, sFailedDependencies, sHint, plt.dDependencyMS);
 		if (sDependencies != "")
 			vPluginDependencies.push_back(sDependencies);
 
+		//Map the DLL first (same search path as LoadPlugin) so that LoadPlugin only pays for the init
+		uiWorkingSet = GetWorkingSet();
+		dStart = timer.GetTimer();
+		hPlugin = ::LoadLibraryEx(sPlugin.c_str(), NULL, LOAD_WITH_ALTERED_SEARCH_PATH);
+		plt.dMapMS = (timer.GetTimer() - dStart) * 1000.0;
+
 		sPlugLoadError = "";
-		sNote = "";
+		dStart = timer.GetTimer();
 		try
 		{
 			AVS_env->Invoke("LoadPlugin", sPlugin.c_str());
 		}
 		catch (AvisynthError err)
 		{
+			plt.bFailed = TRUE;
+
 			sPlugLoadError = utils.StrFormat("%s", (PCSTR)err.msg);
 			utils.StrTrim(sPlugLoadError);
-			sPlugLoadErrorLC = sPlugLoadError;
-			utils.StrToLC(sPlugLoadErrorLC);
-
-			if (sFailedDependencies != "")
-			{
-				sNote += utils.StrFormat("\n\nDependencies that could not be loaded:\n%s", sFailedDependencies.c_str());
-				if (sHint != "")
-					sNote += utils.StrFormat("\n\nNote: %s", sHint.c_str());
-			}
-
-			if ((sPlugLoadErrorLC.find("proc not found") != string::npos) || (sPlugLoadErrorLC.find("the specified procedure could not be found") != string::npos))
-				sNote += "\n\nNote: You may need a newer OS version in order to use this plugin";
-
-			if (sPluginType.substr(0, 5) == "C 2.5")
-				sNote += "\n\nNote: C-Plugins must be loaded explicitly with \"LoadCPlugin()\"";
-
-			if ((sPluginType.substr(0, 5) == "C 2.0") && (bIsAVSPlus))
-				sNote += "\n\nNote: C 2.0 Plugins are not supported by Avisynth+";
-
-			if ((sPluginType.substr(0, 7) == "CPP 2.0") && (bIsAVSPlus))
-				sNote += "\n\nNote: CPP 2.0 Plugins are not supported by Avisynth+";
-
-			sPlugLoadError += sNote;
+			sPlugLoadError += GetPluginErrorNote(sPluginType, sPlugLoadError, sFailedDependencies, sHint);
 
 			if (sPlugLoadError != "")
 				vPluginErrors.push_back(sPlugLoadError);
 		}
 
+		plt.dLoadMS = (timer.GetTimer() - dStart) * 1000.0;
+		plt.iWorkingSetDeltaKB = ((__int64)GetWorkingSet() - (__int64)uiWorkingSet) / 1024;
+		if (hPlugin)
+			::FreeLibrary(hPlugin);
+		vPluginLoadTimes.push_back(plt);
+
 		if (((uiPlugin % 40) == 0) && (AVS_env != 0))
 		{
 			AVS_env->DeleteScriptEnvironment();
@@ -862,64 +1168,584 @@ void CAvisynthInfo::TestLoadPlugins()
 
 	FreeLibrary(hDLL);
 
+	dPluginTestMS = (timer.GetTimer() - dTestStart) * 1000.0;
+	sort(vPluginLoadTimes.begin(), vPluginLoadTimes.end(), ComparePluginLoadTime);
+
 	return;
 }
 
 
-void CAvisynthInfo::GetDLLDependencies(string s_dll, string &s_dependencies, string &s_failed_dependencies, string &s_hint)
+void CAvisynthInfo::GetPluginDependencies(string s_plugin, string &s_dependencies, string &s_failed_dependencies, string &s_hint, double &d_ms)
 {
-	HANDLE hFile = NULL;
-	HANDLE hFileMapping = NULL;
-	LPBYTE lpbaseAddress = NULL;
+	s_dependencies = "";
 	s_failed_dependencies = "";
-	string sTemp = "";
+	s_hint = "";
 
-	hFile = CreateFile(s_dll.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-	if (hFile == INVALID_HANDLE_VALUE)
+	string sPluginLC = s_plugin;
+	utils.StrToLC(sPluginLC);
+	if ((mScanJobs.find(sPluginLC) != mScanJobs.end()) && vScanJobs[mScanJobs[sPluginLC]].bDependencies)
+	{
+		stPluginScanJob &scanjob = vScanJobs[mScanJobs[sPluginLC]];
+		s_dependencies = scanjob.sDependencies;
+		s_failed_dependencies = scanjob.sFailedDependencies;
+		s_hint = scanjob.sHint;
+		d_ms = scanjob.dDependencyMS;
 		return;
+	}
+
+	double dStart = timer.GetTimer();
+	GetDLLDependencies(s_plugin, s_dependencies, s_failed_dependencies, s_hint);
+	d_ms = (timer.GetTimer() - dStart) * 1000.0;
 
-	hFileMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
-	if (hFileMapping == NULL || hFileMapping == INVALID_HANDLE_VALUE)
+	return;
+}
+
+
+string CAvisynthInfo::GetPluginErrorNote(string s_plugin_type, string s_error, string s_failed_dependencies, string s_hint)
+{
+	string sNote = "";
+	utils.StrToLC(s_error);
+
+	if (s_failed_dependencies != "")
 	{
-		CloseHandle(hFile);
-		return;
+		sNote += utils.StrFormat("\n\nDependencies that could not be loaded:\n%s", s_failed_dependencies.c_str());
+		if (s_hint != "")
+			sNote += utils.StrFormat("\n\nNote: %s", s_hint.c_str());
+	}
+
+	if ((s_error.find("proc not found") != string::npos) || (s_error.find("the specified procedure could not be found") != string::npos))
+		sNote += "\n\nNote: You may need a newer OS version in order to use this plugin";
+
+	if (s_plugin_type.substr(0, 5) == "C 2.5")
+		sNote += "\n\nNote: C-Plugins must be loaded explicitly with \"LoadCPlugin()\"";
+
+	if ((s_plugin_type.substr(0, 5) == "C 2.0") && (bIsAVSPlus))
+		sNote += "\n\nNote: C 2.0 Plugins are not supported by Avisynth+";
+
+	if ((s_plugin_type.substr(0, 7) == "CPP 2.0") && (bIsAVSPlus))
+		sNote += "\n\nNote: CPP 2.0 Plugins are not supported by Avisynth+";
+
+	return sNote;
+}
+
+
+void CAvisynthInfo::TestLoadPluginsIsolated()
+{
+	/*
+	The plugins are sharded across worker processes (AVSMeter PLUGINTEST_WORKER_SWITCH),
+	each with its own script environment. A worker that crashes or exceeds the
+	per-plugin timeout is terminated, the plugin is reported and a new worker
+	continues with the rest of the shard.
+	The timeout counts from the spawn or the last line of the worker, so a
+	hang after a DONE line is caught too (FreeLibrary() runs the DllMain
+	detach, DeleteScriptEnvironment() unloads the plugins) and blamed on the
+	plugin last reported done. A worker hanging before its first BEGIN
+	(avisynth.dll, CreateScriptEnvironment()) is not respawned.
+	*/
+	double dTestStart = timer.GetTimer();
+	vector <stPluginTestJob> vJobs;
+	stPluginTestJob job;
+	string sPlugin = "";
+	string sDependencies = "";
+	size_t spos = 0;
+	size_t i = 0;
+
+	for (i = 0; i < vPlugins.size(); i++)
+	{
+		sPlugin = vPlugins[i];
+		spos = sPlugin.find("|");
+		if ((spos == string::npos) || (spos < 3))
+			continue;
+
+		job.sPluginType = sPlugin.substr(0, spos);
+		if (job.sPluginType.find("Plugins") == string::npos)
+			continue;
+
+		job.plt.sPlugin = sPlugin.substr(spos + 1);
+		job.plt.dMapMS = 0.0;
+		job.plt.dLoadMS = 0.0;
+		job.plt.iWorkingSetDeltaKB = 0;
+		job.plt.bFailed = FALSE;
+		job.bDone = FALSE;
+		job.sError = "";
+		GetPluginDependencies(job.plt.sPlugin, sDependencies, job.sFailedDependencies, job.sHint, job.plt.dDependencyMS);
+		if (sDependencies != "")
+			vPluginDependencies.push_back(sDependencies);
+
+		vJobs.push_back(job);
 	}
 
-	lpbaseAddress = (LPBYTE)MapViewOfFile(hFileMapping, FILE_MAP_READ, 0, 0, 0);
-	if (lpbaseAddress == NULL)
+	char szExe[MAX_PATH + 1];
+	if ((vJobs.size() == 0) || (::GetModuleFileName(NULL, szExe, MAX_PATH) == 0))
 	{
-		CloseHandle(hFileMapping);
-		CloseHandle(hFile);
+		dPluginTestMS = (timer.GetTimer() - dTestStart) * 1000.0;
 		return;
 	}
 
-	PIMAGE_DOS_HEADER pDosHeader = (PIMAGE_DOS_HEADER)lpbaseAddress;
-	PIMAGE_NT_HEADERS pNtHeaders = (PIMAGE_NT_HEADERS)(lpbaseAddress + pDosHeader->e_lfanew);
-	DWORD rva_import_table = pNtHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress;
-	if (rva_import_table == 0)
+	size_t nWorkers = (uiPluginTestWorkers < vJobs.size()) ? uiPluginTestWorkers : vJobs.size();
+	vector <stPluginTestWorker> vWorkers(nWorkers);
+	for (i = 0; i < vJobs.size(); i++)
+		vWorkers[i % nWorkers].vShard.push_back(i);
+
+	string sCommandLine = utils.StrFormat("\"%s\" %s \"%s\" %d", szExe, PLUGINTEST_WORKER_SWITCH, (sAVSDLL == "") ? "-" : sAVSDLL.c_str(), iInterfaceVersion);
+	size_t nActive = 0;
+	for (i = 0; i < nWorkers; i++)
 	{
-		UnmapViewOfFile(lpbaseAddress);
-		CloseHandle(hFileMapping);
-		CloseHandle(hFile);
-		return;
+		vWorkers[i].nDone = 0;
+		if (StartPluginTestWorker(vWorkers[i], vJobs, sCommandLine))
+			++nActive;
 	}
 
-	s_dependencies = s_dll + ":\n";
+	char szBuf[4096];
+	DWORD dwAvail = 0;
+	DWORD dwRead = 0;
+	DWORD dwExitCode = 0;
+	double dTimeout = (double)uiPluginTestTimeout / 1000.0;
+	while (nActive > 0)
+	{
+		for (i = 0; i < nWorkers; i++)
+		{
+			stPluginTestWorker &worker = vWorkers[i];
+			if (!worker.hProcess)
+				continue;
+
+			BOOL bExited = (::WaitForSingleObject(worker.hProcess, 0) == WAIT_OBJECT_0) ? TRUE : FALSE;
+
+			//after the exit check, so that the last lines of a finished worker are not lost
+			while (::PeekNamedPipe(worker.hOutput, NULL, 0, NULL, &dwAvail, NULL) && (dwAvail > 0))
+			{
+				if (!::ReadFile(worker.hOutput, szBuf, sizeof(szBuf), &dwRead, NULL) || (dwRead == 0))
+					break;
+				worker.sPending.append(szBuf, dwRead);
+			}
+			ParsePluginTestOutput(worker, vJobs);
+
+			if (bExited)
+			{
+				::GetExitCodeProcess(worker.hProcess, &dwExitCode);
+				if (worker.nCurrent != PLUGINTEST_NONE)
+				{
+					stPluginTestJob &crashed = vJobs[worker.vShard[worker.nCurrent]];
+					crashed.plt.bFailed = TRUE;
+					crashed.plt.dLoadMS = (timer.GetTimer() - worker.dStart) * 1000.0;
+					crashed.sError = utils.StrFormat("The plugin test worker terminated (exit code 0x%08X) while loading \"%s\"", dwExitCode, crashed.plt.sPlugin.c_str());
+					crashed.bDone = TRUE;
+					worker.nDone = worker.nCurrent + 1;
+				}
+				else if (worker.nDone == worker.nSpawnedAt)
+				{
+					//no progress at all, e.g. no script environment: do not respawn forever
+					for (; worker.nDone < worker.vShard.size(); worker.nDone++)
+					{
+						vJobs[worker.vShard[worker.nDone]].sError = utils.StrFormat("The plugin test worker terminated (exit code 0x%08X) before loading \"%s\"",
+							dwExitCode, vJobs[worker.vShard[worker.nDone]].plt.sPlugin.c_str());
+						vJobs[worker.vShard[worker.nDone]].plt.bFailed = TRUE;
+						vJobs[worker.vShard[worker.nDone]].bDone = TRUE;
+					}
+				}
+
+				StopPluginTestWorker(worker);
+				if ((worker.nDone >= worker.vShard.size()) || !StartPluginTestWorker(worker, vJobs, sCommandLine))
+					--nActive;
+				continue;
+			}
+
+			if ((timer.GetTimer() - worker.dLastActivity) > dTimeout)
+			{
+				::TerminateProcess(worker.hProcess, ERROR_TIMEOUT);
+				::WaitForSingleObject(worker.hProcess, INFINITE);
+
+				if (worker.nCurrent != PLUGINTEST_NONE)
+				{
+					stPluginTestJob &hung = vJobs[worker.vShard[worker.nCurrent]];
+					hung.plt.bFailed = TRUE;
+					hung.plt.dLoadMS = (timer.GetTimer() - worker.dStart) * 1000.0;
+					hung.sError = utils.StrFormat("Loading \"%s\" did not finish within %.1f seconds, the plugin test worker was terminated", hung.plt.sPlugin.c_str(), dTimeout);
+					hung.bDone = TRUE;
+					worker.nDone = worker.nCurrent + 1;
+				}
+				else if (worker.nDone > worker.nSpawnedAt)
+				{
+					stPluginTestJob &hung = vJobs[worker.vShard[worker.nDone - 1]];
+					hung.plt.bFailed = TRUE;
+					hung.sError += utils.StrFormat("%sUnloading \"%s\" did not finish within %.1f seconds, the plugin test worker was terminated",
+						(hung.sError != "") ? "\n" : "", hung.plt.sPlugin.c_str(), dTimeout);
+				}
+				else
+				{
+					for (; worker.nDone < worker.vShard.size(); worker.nDone++)
+					{
+						vJobs[worker.vShard[worker.nDone]].sError = utils.StrFormat("The plugin test worker did not start within %.1f seconds, \"%s\" was not loaded",
+							dTimeout, vJobs[worker.vShard[worker.nDone]].plt.sPlugin.c_str());
+						vJobs[worker.vShard[worker.nDone]].plt.bFailed = TRUE;
+						vJobs[worker.vShard[worker.nDone]].bDone = TRUE;
+					}
+				}
+
+				StopPluginTestWorker(worker);
+				if ((worker.nDone >= worker.vShard.size()) || !StartPluginTestWorker(worker, vJobs, sCommandLine))
+					--nActive;
+			}
+		}
+
+		::Sleep(5);
+	}
+
+	//merge in the original plugin order
+	string sPlugLoadError = "";
+	for (i = 0; i < vJobs.size(); i++)
+	{
+		if (!vJobs[i].bDone)
+		{
+			vJobs[i].plt.bFailed = TRUE;
+			vJobs[i].sError = utils.StrFormat("\"%s\" could not be tested", vJobs[i].plt.sPlugin.c_str());
+		}
+
+		vPluginLoadTimes.push_back(vJobs[i].plt);
+		if (!vJobs[i].plt.bFailed)
+			continue;
+
+		sPlugLoadError = vJobs[i].sError;
+		utils.StrTrim(sPlugLoadError);
+		sPlugLoadError += GetPluginErrorNote(vJobs[i].sPluginType, sPlugLoadError, vJobs[i].sFailedDependencies, vJobs[i].sHint);
+		if (sPlugLoadError != "")
+			vPluginErrors.push_back(sPlugLoadError);
+	}
+
+	dPluginTestMS = (timer.GetTimer() - dTestStart) * 1000.0;
+	sort(vPluginLoadTimes.begin(), vPluginLoadTimes.end(), ComparePluginLoadTime);
+
+	return;
+}
+
+
+BOOL CAvisynthInfo::StartPluginTestWorker(stPluginTestWorker &worker, vector<stPluginTestJob> &v_jobs, string s_commandline)
+{
+	worker.hProcess = NULL;
+	worker.hOutput = NULL;
+	worker.sPending = "";
+	worker.nCurrent = PLUGINTEST_NONE;
+	worker.nSpawnedAt = worker.nDone;
+	worker.dLastActivity = timer.GetTimer();
+
+	SECURITY_ATTRIBUTES sa;
+	sa.nLength = sizeof(sa);
+	sa.lpSecurityDescriptor = NULL;
+	sa.bInheritHandle = TRUE;
+
+	HANDLE hInRead = NULL;
+	HANDLE hInWrite = NULL;
+	HANDLE hOutRead = NULL;
+	HANDLE hOutWrite = NULL;
+	if (!::CreatePipe(&hInRead, &hInWrite, &sa, 0))
+		return FALSE;
+
+	if (!::CreatePipe(&hOutRead, &hOutWrite, &sa, 0))
+	{
+		::CloseHandle(hInRead);
+		::CloseHandle(hInWrite);
+		return FALSE;
+	}
+
+	//the worker must only inherit its own ends
+	::SetHandleInformation(hInWrite, HANDLE_FLAG_INHERIT, 0);
+	::SetHandleInformation(hOutRead, HANDLE_FLAG_INHERIT, 0);
+
+	STARTUPINFO si;
+	PROCESS_INFORMATION pi;
+	memset(&si, 0, sizeof(si));
+	memset(&pi, 0, sizeof(pi));
+	si.cb = sizeof(si);
+	si.dwFlags = STARTF_USESTDHANDLES;
+	si.hStdInput = hInRead;
+	si.hStdOutput = hOutWrite;
+	si.hStdError = hOutWrite;
+
+	vector <char> vCommandLine(s_commandline.begin(), s_commandline.end());
+	vCommandLine.push_back(0);
+	BOOL bStarted = ::CreateProcess(NULL, &vCommandLine[0], NULL, NULL, TRUE, CREATE_NO_WINDOW | BELOW_NORMAL_PRIORITY_CLASS, NULL, NULL, &si, &pi);
+
+	::CloseHandle(hInRead);
+	::CloseHandle(hOutWrite);
+
+	if (!bStarted)
+	{
+		::CloseHandle(hInWrite);
+		::CloseHandle(hOutRead);
+		return FALSE;
+	}
+
+	::CloseHandle(pi.hThread);
+	worker.hProcess = pi.hProcess;
+	worker.hOutput = hOutRead;
+
+	//the worker reads its whole list before loading anything, so this cannot deadlock
+	string sList = "";
+	for (size_t i = worker.nDone; i < worker.vShard.size(); i++)
+		sList += v_jobs[worker.vShard[i]].plt.sPlugin + "\n";
+
+	DWORD dwWritten = 0;
+	::WriteFile(hInWrite, sList.c_str(), (DWORD)sList.length(), &dwWritten, NULL);
+	::CloseHandle(hInWrite);
+
+	return TRUE;
+}
+
+
+void CAvisynthInfo::StopPluginTestWorker(stPluginTestWorker &worker)
+{
+	if (worker.hOutput)
+		::CloseHandle(worker.hOutput);
+	if (worker.hProcess)
+		::CloseHandle(worker.hProcess);
+
+	worker.hOutput = NULL;
+	worker.hProcess = NULL;
+	worker.nCurrent = PLUGINTEST_NONE;
+
+	return;
+}
+
+
+void CAvisynthInfo::ParsePluginTestOutput(stPluginTestWorker &worker, vector<stPluginTestJob> &v_jobs)
+{
+	//BEGIN <index>
+	//DONE <index> <map ms> <load ms> <working set delta KiB> <failed> <error>
+	size_t nEOL = 0;
+	string sLine = "";
+	vector <string> vFields;
+	while ((nEOL = worker.sPending.find('\n')) != string::npos)
+	{
+		sLine = worker.sPending.substr(0, nEOL);
+		worker.sPending.erase(0, nEOL + 1);
+		sLine.erase(sLine.find_last_not_of("\r") + 1);
+
+		vFields.clear();
+		size_t nStart = 0;
+		size_t nTab = 0;
+		while ((nTab = sLine.find('\t', nStart)) != string::npos)
+		{
+			vFields.push_back(sLine.substr(nStart, nTab - nStart));
+			nStart = nTab + 1;
+		}
+		vFields.push_back(sLine.substr(nStart));
+
+		if (vFields.size() < 2)
+			continue;
+
+		size_t nIndex = worker.nSpawnedAt + (size_t)atoi(vFields[1].c_str());
+		if (nIndex >= worker.vShard.size())
+			continue;
+
+		worker.dLastActivity = timer.GetTimer();
+
+		if (vFields[0] == "BEGIN")
+		{
+			worker.nCurrent = nIndex;
+			worker.dStart = worker.dLastActivity;
+		}
+		else if ((vFields[0] == "DONE") && (vFields.size() >= 7))
+		{
+			stPluginTestJob &job = v_jobs[worker.vShard[nIndex]];
+			job.plt.dMapMS = atof(vFields[2].c_str());
+			job.plt.dLoadMS = atof(vFields[3].c_str());
+			job.plt.iWorkingSetDeltaKB = _atoi64(vFields[4].c_str());
+			job.plt.bFailed = (vFields[5] == "1") ? TRUE : FALSE;
+			job.sError = "";
+			for (size_t i = 0; i < vFields[6].length(); i++)
+			{
+				if ((vFields[6][i] == '\\') && ((i + 1) < vFields[6].length()))
+				{
+					++i;
+					job.sError += (vFields[6][i] == 'n') ? '\n' : ((vFields[6][i] == 't') ? '\t' : vFields[6][i]);
+				}
+				else
+					job.sError += vFields[6][i];
+			}
+			job.bDone = TRUE;
+			worker.nCurrent = PLUGINTEST_NONE;
+			worker.nDone = nIndex + 1;
+		}
+	}
+
+	return;
+}
+
+
+#endif //_WIN32
+
+
+int CAvisynthInfo::PluginTestWorker(string s_AVSDLL, int i_InterfaceVersion)
+{
+#if !defined(_WIN32)
+	return -1;
+#else
+	//stdin: one plugin per line, stdout: see ParsePluginTestOutput()
+	vector <string> vFiles;
+	char szLine[MAX_PATH * 4];
+	string sLine = "";
+	while (fgets(szLine, sizeof(szLine), stdin))
+	{
+		sLine = szLine;
+		sLine.erase(sLine.find_last_not_of("\r\n") + 1);
+		if (sLine != "")
+			vFiles.push_back(sLine);
+	}
+
+	HINSTANCE hDLL = ::LoadLibrary(((s_AVSDLL == "") || (s_AVSDLL == "-")) ? "avisynth" : s_AVSDLL.c_str());
+	if (!hDLL)
+		return 1;
+
+	CREATE_ENV *CreateEnvironment = (CREATE_ENV *)GetProcAddress(hDLL, "CreateScriptEnvironment");
+	if (!CreateEnvironment)
+	{
+		::FreeLibrary(hDLL);
+		return 1;
+	}
+
+	IScriptEnvironment *AVS_env = 0;
+	HINSTANCE hPlugin = NULL;
+	unsigned __int64 uiWorkingSet = 0;
+	double dStart = 0.0;
+	double dMapMS = 0.0;
+	string sError = "";
+	string sEscaped = "";
+	BOOL bFailed = FALSE;
+
+	for (size_t i = 0; i < vFiles.size(); i++)
+	{
+		if (AVS_env == 0)
+		{
+			try
+			{
+				_set_se_translator(SE_Translator);
+				AVS_env = CreateEnvironment(i_InterfaceVersion);
+			}
+			catch (...)
+			{
+				AVS_env = 0;
+			}
+
+			if (!AVS_env)
+				break;
+
+			AVS_linkage = AVS_env->GetAVSLinkage();
+		}
+
+		printf("BEGIN\t%u\n", (unsigned int)i);
+		fflush(stdout);
+
+		uiWorkingSet = GetWorkingSet();
+		dStart = timer.GetTimer();
+		hPlugin = ::LoadLibraryEx(vFiles[i].c_str(), NULL, LOAD_WITH_ALTERED_SEARCH_PATH);
+		dMapMS = (timer.GetTimer() - dStart) * 1000.0;
+
+		sError = "";
+		bFailed = FALSE;
+		dStart = timer.GetTimer();
+		try
+		{
+			AVS_env->Invoke("LoadPlugin", vFiles[i].c_str());
+		}
+		catch (AvisynthError err)
+		{
+			bFailed = TRUE;
+			sError = utils.StrFormat("%s", (PCSTR)err.msg);
+		}
+		catch (exception& ex)
+		{
+			bFailed = TRUE;
+			sError = utils.StrFormat("\"%s\"\n%s", vFiles[i].c_str(), ex.what());
+		}
+		catch (...)
+		{
+			bFailed = TRUE;
+			sError = utils.StrFormat("Unknown exception:\n\"%s\"", vFiles[i].c_str());
+		}
+
+		sEscaped = "";
+		for (size_t c = 0; c < sError.length(); c++)
+		{
+			if (sError[c] == '\n')
+				sEscaped += "\\n";
+			else if (sError[c] == '\t')
+				sEscaped += "\\t";
+			else if (sError[c] == '\\')
+				sEscaped += "\\\\";
+			else if (sError[c] != '\r')
+				sEscaped += sError[c];
+		}
+
+		printf("DONE\t%u\t%.3f\t%.3f\t%I64d\t%d\t%s\n", (unsigned int)i, dMapMS, (timer.GetTimer() - dStart) * 1000.0,
+			((__int64)GetWorkingSet() - (__int64)uiWorkingSet) / 1024, bFailed ? 1 : 0, sEscaped.c_str());
+		fflush(stdout);
+
+		if (hPlugin)
+			::FreeLibrary(hPlugin);
+
+		if (((i % 40) == 0) && (AVS_env != 0))
+		{
+			AVS_env->DeleteScriptEnvironment();
+			AVS_env = 0;
+			AVS_linkage = 0;
+		}
+	}
+
+	if (AVS_env != 0)
+		AVS_env->DeleteScriptEnvironment();
+
+	AVS_linkage = 0;
+	::FreeLibrary(hDLL);
+
+	return 0;
+#endif //_WIN32
+}
+
+
+#if defined(_WIN32)
+
+void CAvisynthInfo::GetDLLDependencies(string s_dll, string &s_dependencies, string &s_failed_dependencies, string &s_hint)
+{
+	vector <string> vImports;
+	s_failed_dependencies = "";
+
+	if (!GetDLLImports(s_dll, vImports))
+		return;
+
+	CheckDLLDependencies(s_dll, vImports, s_dependencies, s_failed_dependencies, s_hint);
+
+	return;
+}
+
+
+BOOL CAvisynthInfo::GetDLLImports(string s_dll, vector<string> &v_imports)
+{
+	v_imports.clear();
+
+	CPEFile pe;
+	if (!pe.Open(s_dll))
+		return FALSE;
+
+	return pe.GetImportNames(v_imports);
+}
+
+
+void CAvisynthInfo::CheckDLLDependencies(string s_dll, const vector<string> &v_imports, string &s_dependencies, string &s_failed_dependencies, string &s_hint)
+{
+	string sTemp = "";
 	string sDepDLL = "";
-	PIMAGE_IMPORT_DESCRIPTOR pImageTable = (PIMAGE_IMPORT_DESCRIPTOR)ImageRvaToVa(pNtHeaders, lpbaseAddress, rva_import_table, NULL);
-	IMAGE_IMPORT_DESCRIPTOR null_iid;
-	IMAGE_THUNK_DATA null_thunk;
-	memset(&null_iid, 0, sizeof(null_iid));
-	memset(&null_thunk, 0, sizeof(null_thunk));
+	vector <string> vMissing;
+	s_failed_dependencies = "";
+	s_dependencies = s_dll + ":\n";
+	size_t uiRoot = DependencyGraph.AddRoot(s_dll, v_imports);
 
-	for (int i = 0; memcmp(pImageTable + i, &null_iid, sizeof(null_iid)) != 0; i++)
+	for (size_t i = 0; i < v_imports.size(); i++)
 	{
-		LPCSTR szDepName = (LPCSTR)ImageRvaToVa(pNtHeaders, lpbaseAddress, pImageTable[i].Name,NULL);
-		sTemp = utils.StrFormat("%s", szDepName);
+		sTemp = v_imports[i];
 		utils.StrToLC(sTemp);
 		utils.StrTrim(sTemp);
 
-		sDepDLL = utils.StrFormat("  %s\n", szDepName);
+		sDepDLL = utils.StrFormat("  %s\n", v_imports[i].c_str());
 		s_dependencies += "  " + sDepDLL;
 
 		if ((sTemp == "msvcm80.dll") || (sTemp == "msvcp80.dll") || (sTemp == "msvcr80.dll"))
@@ -938,20 +1764,22 @@ void CAvisynthInfo::GetDLLDependencies(string s_dll, string &s_dependencies, str
 			continue;
 		}
 
-		HINSTANCE hDLL = ::LoadLibrary(szDepName);
-		if (!hDLL)
+		//resolved from the import tables, nothing is loaded
+		DependencyGraph.GetMissing(uiRoot, i, vMissing);
+		if (vMissing.size() == 1)
+			utils.StrToLC(vMissing[0]);
+		if ((vMissing.size() == 1) && (vMissing[0] == sTemp))
 			s_failed_dependencies += sDepDLL;
-		else
-			::FreeLibrary(hDLL);
+		else if (vMissing.size() > 0)
+		{
+			sDepDLL.erase(sDepDLL.length() - 1);
+			sDepDLL += " (missing:";
+			for (size_t j = 0; j < vMissing.size(); j++)
+				sDepDLL += ((j > 0) ? ", " : " ") + vMissing[j];
+			s_failed_dependencies += sDepDLL + ")\n";
+		}
 	}
 
-	if (lpbaseAddress)
-		UnmapViewOfFile(lpbaseAddress);
-	if (hFileMapping)
-		CloseHandle(hFileMapping);
-	if (hFile)
-		CloseHandle(hFile);
-
 	s_failed_dependencies.erase(s_failed_dependencies.find_last_not_of("\n") + 1);
 	sTemp = s_failed_dependencies;
 	utils.StrToLC(sTemp);
@@ -1088,6 +1916,16 @@ __int64 CAvisynthInfo::FileSize(string s_file)
 }
 
 
+unsigned __int64 CAvisynthInfo::GetWorkingSet()
+{
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!::GetProcessMemoryInfo(::GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return 0;
+
+	return (unsigned __int64)pmc.WorkingSetSize;
+}
+
+
 BOOL CAvisynthInfo::Is64BitOS()
 {
 	if (sizeof(void*) == 8)
@@ -1109,6 +1947,8 @@ BOOL CAvisynthInfo::Is64BitOS()
 	return FALSE;
 }
 
+#endif //_WIN32
+
 
 #endif //_AVISYNTHINFO_H
 
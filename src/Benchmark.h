@@ -0,0 +1,431 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_BENCHMARK_H)
+#define _BENCHMARK_H
+
+#include "common.h"
+#include "exception.h"
+#include "Utility.h"
+#include "Timer.h"
+#include "avs_headers/avisynth.h"
+#include "SyntheticClip.h"
+
+#define BENCHMARK_THREADS_VAR "AVSMeter_Threads"
+
+extern const AVS_Linkage *AVS_linkage;
+
+struct stBenchmarkResult
+{
+	unsigned int uiFrames;           //frames measured, warm-up excluded
+	double       dSeconds;
+	double       dFPS;
+	double       dCPUSeconds;        //process CPU time during the measurement
+	int          iThreadPoolThreads; //AVS+ only, -1 if unknown
+	long         lCPUFlags;          //GetCPUFlags() of the environment the script ran in
+	BOOL         bReusedEnvironment;
+	string       sError;
+};
+
+
+/*
+	Loads avisynth.dll once and runs a script for a fixed time after a warm-up
+	phase. Every call to Run() creates and deletes its own script environment
+	unless bReuseEnvironment is set, in which case the environment (and the
+	plugins autoloaded into it) is kept until ReleaseEnvironment().
+	Synthetic clips (see SyntheticClip.h) are also run without avisynth.dll,
+	the source is then driven directly.
+*/
+class CBenchmark
+{
+public:
+	CBenchmark();
+	virtual ~CBenchmark();
+
+	BOOL   LoadAvisynth(string s_avsdll, int i_interfaceversion);
+	void   UnloadAvisynth();
+	BOOL   Run(string &s_avsfile, stBenchmarkResult &result);
+	void   ReleaseEnvironment();
+
+	double dWarmupSeconds;
+	double dMeasureSeconds;
+	int    iThreads;           //exported as global BENCHMARK_THREADS_VAR before the script is imported, 0: not set
+	BOOL   bInvokeDistributor;
+	BOOL   bReuseEnvironment;
+	string sMaxCPU;            //SetMaxCPU() argument applied before the script is imported (AVS+), "": not set
+	DWORD  dwDeleteDelay;      //ms to wait before DeleteScriptEnvironment()
+	BOOL   bLoaded;
+	string sError;
+
+private:
+	typedef IScriptEnvironment * __stdcall CREATE_ENV(int);
+	typedef IScriptEnvironment2 * __stdcall CREATE_ENV2(int);
+
+	BOOL   RunSynthetic(string &s_avsfile, stBenchmarkResult &result);
+	unsigned __int64 GetProcessCPUTime();
+
+	HINSTANCE   hDLL;
+	IScriptEnvironment  *AVS_envReused;
+	IScriptEnvironment2 *AVS_env2Reused;
+	CREATE_ENV  *CreateEnvironment;
+	CREATE_ENV2 *CreateEnvironment2;
+	int         iInterfaceVersion;
+	CTimer      timer;
+	CUtils      utils;
+};
+
+
+CBenchmark::CBenchmark()
+{
+	dWarmupSeconds = 2.0;
+	dMeasureSeconds = 10.0;
+	iThreads = 0;
+	bInvokeDistributor = TRUE;
+	bReuseEnvironment = FALSE;
+	sMaxCPU = "";
+	dwDeleteDelay = DSE_DELAY;
+	bLoaded = FALSE;
+	sError = "";
+	hDLL = NULL;
+	AVS_envReused = 0;
+	AVS_env2Reused = 0;
+	CreateEnvironment = NULL;
+	CreateEnvironment2 = NULL;
+	iInterfaceVersion = 0;
+}
+
+CBenchmark::~CBenchmark()
+{
+	UnloadAvisynth();
+}
+
+
+BOOL CBenchmark::LoadAvisynth(string s_avsdll, int i_interfaceversion)
+{
+	sError = "";
+	UnloadAvisynth();
+
+	if (s_avsdll == "")
+		hDLL = ::LoadLibrary("avisynth");
+	else
+		hDLL = ::LoadLibrary(s_avsdll.c_str());
+
+	if (!hDLL)
+	{
+		sError = "Cannot load avisynth.dll:\n" + utils.LibraryErrorMessage();
+		return FALSE;
+	}
+
+	CreateEnvironment = (CREATE_ENV *)::GetProcAddress(hDLL, "CreateScriptEnvironment");
+	if (!CreateEnvironment)
+	{
+		sError = "Failed to load CreateScriptEnvironment()";
+		UnloadAvisynth();
+		return FALSE;
+	}
+
+	//AVS+ only, needed for GetProperty()
+	CreateEnvironment2 = (CREATE_ENV2 *)::GetProcAddress(hDLL, "CreateScriptEnvironment2");
+
+	iInterfaceVersion = i_interfaceversion;
+	bLoaded = TRUE;
+
+	return TRUE;
+}
+
+
+void CBenchmark::UnloadAvisynth()
+{
+	ReleaseEnvironment();
+
+	if (hDLL)
+		::FreeLibrary(hDLL);
+
+	hDLL = NULL;
+	CreateEnvironment = NULL;
+	CreateEnvironment2 = NULL;
+	bLoaded = FALSE;
+
+	return;
+}
+
+
+BOOL CBenchmark::Run(string &s_avsfile, stBenchmarkResult &result)
+{
+	result.uiFrames = 0;
+	result.dSeconds = 0.0;
+	result.dFPS = 0.0;
+	result.dCPUSeconds = 0.0;
+	result.iThreadPoolThreads = -1;
+	result.lCPUFlags = 0;
+	result.bReusedEnvironment = FALSE;
+	result.sError = "";
+
+	if (!bLoaded && CSyntheticSource::IsSyntheticSpec(s_avsfile))
+		return RunSynthetic(s_avsfile, result);
+
+	if (!bLoaded)
+	{
+		result.sError = "avisynth.dll is not loaded";
+		return FALSE;
+	}
+
+	IScriptEnvironment *AVS_env = 0;
+	IScriptEnvironment2 *AVS_env2 = 0;
+
+	try
+	{
+		_set_se_translator(SE_Translator);
+
+		if (!bReuseEnvironment)
+			ReleaseEnvironment();
+
+		if (AVS_envReused)
+		{
+			AVS_env = AVS_envReused;
+			AVS_env2 = AVS_env2Reused;
+			result.bReusedEnvironment = TRUE;
+		}
+		else if (CreateEnvironment2)
+		{
+			AVS_env2 = CreateEnvironment2(iInterfaceVersion);
+			AVS_env = AVS_env2;
+		}
+		else
+			AVS_env = CreateEnvironment(iInterfaceVersion);
+
+		if (!AVS_env)
+		{
+			result.sError = "Could not create IScriptenvironment";
+			return FALSE;
+		}
+
+		AVS_linkage = AVS_env->GetAVSLinkage();
+		AVSValue AVS_main;
+		AVSValue AVS_temp;
+		PClip AVS_clip;
+		VideoInfo	AVS_vidinfo;
+
+		//scripts can use the hint with Prefetch(AVSMeter_Threads)
+		if (iThreads > 0)
+			AVS_env->SetGlobalVar(BENCHMARK_THREADS_VAR, AVSValue(iThreads));
+
+		//filters pick their code paths when they are created, so the cap has to be in place before Import()
+		if (sMaxCPU != "")
+		{
+			try
+			{
+				AVS_env->Invoke("SetMaxCPU", sMaxCPU.c_str());
+			}
+			catch (IScriptEnvironment::NotFound)
+			{
+				AVS_env->ThrowError("SetMaxCPU() is not available, Avisynth+ is required");
+			}
+		}
+
+		result.lCPUFlags = AVS_env->GetCPUFlags();
+
+		AVS_main = CSyntheticClip::ImportScript(AVS_env, s_avsfile);
+
+		if (!AVS_main.IsClip())
+			AVS_env->ThrowError("\"%s\":\nScript did not return a clip", s_avsfile.c_str());
+
+		try
+		{
+			AVS_temp = AVS_env->Invoke("GetMTMode", false);
+			int iMTMode = AVS_temp.IsInt() ? AVS_temp.AsInt() : 0;
+			if ((iMTMode > 0) && (iMTMode < 5) && bInvokeDistributor)
+				AVS_main = AVS_env->Invoke("Distributor", AVS_main);
+		}
+		catch (IScriptEnvironment::NotFound)
+		{
+		}
+
+		AVS_clip = AVS_main.AsClip();
+		AVS_vidinfo = AVS_clip->GetVideoInfo();
+
+		if (!AVS_vidinfo.HasVideo() || (AVS_vidinfo.num_frames < 1))
+			AVS_env->ThrowError("Script did not return a video clip:\n%s", s_avsfile.c_str());
+
+		unsigned int uiTotalFrames = (unsigned int)AVS_vidinfo.num_frames;
+		unsigned int uiFrame = 0;
+
+		double dStart = timer.GetTimer();
+		while ((timer.GetTimer() - dStart) < dWarmupSeconds)
+		{
+			PVideoFrame src_frame = AVS_clip->GetFrame(uiFrame % uiTotalFrames, AVS_env);
+			++uiFrame;
+		}
+
+		//steady state, the clip is wrapped around if it is too short
+		unsigned __int64 uiCPUStart = GetProcessCPUTime();
+		dStart = timer.GetTimer();
+		double dNow = dStart;
+		while ((dNow - dStart) < dMeasureSeconds)
+		{
+			PVideoFrame src_frame = AVS_clip->GetFrame(uiFrame % uiTotalFrames, AVS_env);
+			++uiFrame;
+			++result.uiFrames;
+			dNow = timer.GetTimer();
+		}
+
+		result.dSeconds = dNow - dStart;
+		result.dCPUSeconds = (double)(GetProcessCPUTime() - uiCPUStart) / 1.0e+7;
+		if (result.dSeconds > 0.0)
+			result.dFPS = (double)result.uiFrames / result.dSeconds;
+
+		if (AVS_env2)
+			result.iThreadPoolThreads = (int)AVS_env2->GetProperty(AEP_THREADPOOL_THREADS);
+
+		AVS_clip = 0;
+		AVS_main = 0;
+		AVS_temp = 0;
+		if (bReuseEnvironment)
+		{
+			AVS_envReused = AVS_env;
+			AVS_env2Reused = AVS_env2;
+		}
+		else
+		{
+			if (dwDeleteDelay > 0)
+				Sleep(dwDeleteDelay);
+			AVS_env->DeleteScriptEnvironment();
+			AVS_linkage = 0;
+		}
+		AVS_env = 0;
+	}
+	catch (AvisynthError err)
+	{
+		result.sError = utils.StrFormat("%s", (PCSTR)err.msg);
+	}
+	catch (exception& ex)
+	{
+		result.sError = ex.what();
+		if (result.sError == "")
+			result.sError = "Unknown exception";
+	}
+	catch (...)
+	{
+		result.sError = utils.SysErrorMessage();
+		if (result.sError == "")
+			result.sError = "Unknown exception";
+	}
+
+	if (AVS_env) //failed after the environment was created, a reused one is not trusted either
+	{
+		AVS_envReused = 0;
+		AVS_env2Reused = 0;
+		try
+		{
+			AVS_env->DeleteScriptEnvironment();
+		}
+		catch (...)
+		{
+		}
+		AVS_linkage = 0;
+	}
+
+	return (result.sError == "") ? TRUE : FALSE;
+}
+
+
+BOOL CBenchmark::RunSynthetic(string &s_avsfile, stBenchmarkResult &result)
+{
+	stSyntheticParams params;
+	if (!CSyntheticSource::ParseSpec(s_avsfile, params, result.sError))
+		return FALSE;
+
+	if (sMaxCPU != "")
+	{
+		result.sError = "SetMaxCPU() is not available, Avisynth+ is required";
+		return FALSE;
+	}
+
+	CSyntheticSource source;
+	if (!source.Init(params))
+	{
+		result.sError = source.sError;
+		return FALSE;
+	}
+
+	stSyntheticFrame frame;
+	source.AllocFrame(frame);
+
+	unsigned int uiFrame = 0;
+	double dStart = timer.GetTimer();
+	while ((timer.GetTimer() - dStart) < dWarmupSeconds)
+	{
+		source.Render(uiFrame % params.uiFrames, frame);
+		++uiFrame;
+	}
+
+	unsigned __int64 uiCPUStart = GetProcessCPUTime();
+	dStart = timer.GetTimer();
+	double dNow = dStart;
+	while ((dNow - dStart) < dMeasureSeconds)
+	{
+		source.Render(uiFrame % params.uiFrames, frame);
+		++uiFrame;
+		++result.uiFrames;
+		dNow = timer.GetTimer();
+	}
+
+	result.dSeconds = dNow - dStart;
+	result.dCPUSeconds = (double)(GetProcessCPUTime() - uiCPUStart) / 1.0e+7;
+	if (result.dSeconds > 0.0)
+		result.dFPS = (double)result.uiFrames / result.dSeconds;
+
+	return TRUE;
+}
+
+
+void CBenchmark::ReleaseEnvironment()
+{
+	if (!AVS_envReused)
+		return;
+
+	try
+	{
+		if (dwDeleteDelay > 0)
+			Sleep(dwDeleteDelay);
+		AVS_envReused->DeleteScriptEnvironment();
+	}
+	catch (...)
+	{
+	}
+
+	AVS_envReused = 0;
+	AVS_env2Reused = 0;
+	AVS_linkage = 0;
+
+	return;
+}
+
+
+unsigned __int64 CBenchmark::GetProcessCPUTime()
+{
+	FILETIME ftCreation, ftExit, ftKernel, ftUser;
+	if (!::GetProcessTimes(::GetCurrentProcess(), &ftCreation, &ftExit, &ftKernel, &ftUser))
+		return 0;
+
+	return (((unsigned __int64)ftKernel.dwHighDateTime) << 32) + (unsigned __int64)ftKernel.dwLowDateTime +
+	       (((unsigned __int64)ftUser.dwHighDateTime) << 32) + (unsigned __int64)ftUser.dwLowDateTime;
+}
+
+
+#endif //_BENCHMARK_H
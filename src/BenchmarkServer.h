@@ -0,0 +1,538 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_BENCHMARKSERVER_H)
+#define _BENCHMARKSERVER_H
+
+#include "common.h"
+#include "Utility.h"
+#include "Benchmark.h"
+
+#if defined(_WIN32)
+#include <sddl.h>
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+#define SERVER_DEFAULT_PIPE  "AVSMeter"
+#define SERVER_BUFSIZE       4096
+
+typedef void SERVER_NOTIFY(const string &s_message);
+
+
+/*
+	Line based protocol on \\.\pipe\<name> (a UNIX domain socket at
+	$XDG_RUNTIME_DIR/<name>.sock or /tmp/AVSMeter-<uid>/<name>.sock on POSIX),
+	one client at a time:
+
+	PING                                  -> OK <version>
+	RUN [-warmup=s] [-time=s] [-threads=n] [-distributor=0|1] [-reuse] script.avs
+	                                      -> STARTED <script>, then RESULT ... or ERROR <message>
+	RELEASE                               -> OK (deletes a reused environment)
+	QUIT                                  -> OK (stops the server)
+
+	avisynth.dll stays loaded for the lifetime of the server. Unless a job
+	passes -reuse, it gets a fresh script environment.
+	RUN evaluates any script and scripts can load any DLL, so only the user
+	running the server may connect, and only from the local machine.
+*/
+class CBenchmarkServer
+{
+public:
+	CBenchmarkServer();
+	virtual ~CBenchmarkServer();
+
+	BOOL   Run(string s_pipename, CBenchmark &benchmark, SERVER_NOTIFY *p_notify);
+	string sPipePath;
+	string sVersion;
+	unsigned int uiJobs;
+	string sError;
+
+private:
+	BOOL   Listen(string s_pipename);
+#if defined(_WIN32)
+	BOOL   CreateUserOnlyDescriptor(PSECURITY_DESCRIPTOR &p_sd);
+#else
+	BOOL   GetPrivateDir(string &s_dir);
+#endif
+	HANDLE Accept();
+	void   Disconnect(HANDLE h_pipe);
+	void   Close();
+	BOOL   ReadLine(HANDLE h_pipe, string &s_line);
+	BOOL   WriteLine(HANDLE h_pipe, const string &s_line);
+	BOOL   HandleJob(HANDLE h_pipe, string s_args, CBenchmark &benchmark, SERVER_NOTIFY *p_notify);
+	string sPending;
+	HANDLE hListen;
+	CUtils utils;
+};
+
+
+CBenchmarkServer::CBenchmarkServer()
+{
+	sPipePath = "";
+	sVersion = "";
+	uiJobs = 0;
+	sError = "";
+	sPending = "";
+	hListen = INVALID_HANDLE_VALUE;
+}
+
+CBenchmarkServer::~CBenchmarkServer()
+{
+}
+
+
+BOOL CBenchmarkServer::Run(string s_pipename, CBenchmark &benchmark, SERVER_NOTIFY *p_notify)
+{
+	sError = "";
+
+	if (!benchmark.bLoaded)
+	{
+		sError = "avisynth.dll is not loaded";
+		return FALSE;
+	}
+
+	if (s_pipename == "")
+		s_pipename = SERVER_DEFAULT_PIPE;
+
+	if (!Listen(s_pipename))
+		return FALSE;
+
+	p_notify("Listening on " + sPipePath);
+
+	BOOL bQuit = FALSE;
+	string sLine = "";
+	string sCommand = "";
+	while (!bQuit)
+	{
+		HANDLE hPipe = Accept();
+		if (hPipe == INVALID_HANDLE_VALUE)
+			break;
+
+		sPending = "";
+		p_notify("Client connected");
+
+		while (ReadLine(hPipe, sLine))
+		{
+			utils.StrTrim(sLine);
+			if (sLine == "")
+				continue;
+
+			size_t nSpace = sLine.find(' ');
+			sCommand = sLine.substr(0, nSpace);
+			utils.StrToUC(sCommand);
+
+			if (sCommand == "PING")
+				WriteLine(hPipe, "OK " + sVersion);
+			else if (sCommand == "RUN")
+				HandleJob(hPipe, (nSpace == string::npos) ? "" : sLine.substr(nSpace + 1), benchmark, p_notify);
+			else if (sCommand == "RELEASE")
+			{
+				benchmark.ReleaseEnvironment();
+				WriteLine(hPipe, "OK");
+			}
+			else if (sCommand == "QUIT")
+			{
+				WriteLine(hPipe, "OK");
+				bQuit = TRUE;
+				break;
+			}
+			else
+				WriteLine(hPipe, "ERROR Unknown command \"" + sCommand + "\"");
+		}
+
+		Disconnect(hPipe);
+		p_notify("Client disconnected");
+	}
+
+	benchmark.ReleaseEnvironment();
+	Close();
+
+	return (sError == "") ? TRUE : FALSE;
+}
+
+
+BOOL CBenchmarkServer::HandleJob(HANDLE h_pipe, string s_args, CBenchmark &benchmark, SERVER_NOTIFY *p_notify)
+{
+	//per-job options only last for this job
+	double dWarmupSeconds = benchmark.dWarmupSeconds;
+	double dMeasureSeconds = benchmark.dMeasureSeconds;
+	int iThreads = benchmark.iThreads;
+	BOOL bInvokeDistributor = benchmark.bInvokeDistributor;
+	BOOL bReuseEnvironment = FALSE;
+	string sOption = "";
+	string sValue = "";
+	string sResponse = "";
+
+	utils.StrTrim(s_args);
+	while ((s_args.length() > 0) && (s_args[0] == '-'))
+	{
+		size_t nSpace = s_args.find(' ');
+		sOption = s_args.substr(0, nSpace);
+		s_args = (nSpace == string::npos) ? "" : s_args.substr(nSpace + 1);
+		utils.StrTrim(s_args);
+		utils.StrToLC(sOption);
+
+		size_t nEqual = sOption.find('=');
+		sValue = (nEqual == string::npos) ? "" : sOption.substr(nEqual + 1);
+		sOption = sOption.substr(0, nEqual);
+
+		if ((sOption == "-warmup") && (sValue != ""))
+			dWarmupSeconds = atof(sValue.c_str());
+		else if ((sOption == "-time") && (sValue != ""))
+			dMeasureSeconds = atof(sValue.c_str());
+		else if ((sOption == "-threads") && utils.IsNumeric(sValue))
+			iThreads = atoi(sValue.c_str());
+		else if ((sOption == "-distributor") && (sValue != ""))
+			bInvokeDistributor = (sValue == "0") ? FALSE : TRUE;
+		else if (sOption == "-reuse")
+			bReuseEnvironment = TRUE;
+		else
+			return WriteLine(h_pipe, "ERROR Invalid option \"" + sOption + "\"");
+	}
+
+	if ((s_args.length() > 1) && (s_args[0] == '\"') && (s_args[s_args.length() - 1] == '\"'))
+		s_args = s_args.substr(1, s_args.length() - 2);
+
+	if ((s_args == "") || !utils.FileExists(s_args))
+		return WriteLine(h_pipe, "ERROR File not found: \"" + s_args + "\"");
+
+	if ((dMeasureSeconds <= 0.0) || (dWarmupSeconds < 0.0))
+		return WriteLine(h_pipe, "ERROR Invalid run time");
+
+	++uiJobs;
+	p_notify(utils.StrFormat("Job %u: %s", uiJobs, s_args.c_str()));
+	WriteLine(h_pipe, "STARTED " + s_args);
+
+	double dWarmupDefault = benchmark.dWarmupSeconds;
+	double dMeasureDefault = benchmark.dMeasureSeconds;
+	int iThreadsDefault = benchmark.iThreads;
+	BOOL bDistributorDefault = benchmark.bInvokeDistributor;
+
+	benchmark.dWarmupSeconds = dWarmupSeconds;
+	benchmark.dMeasureSeconds = dMeasureSeconds;
+	benchmark.iThreads = iThreads;
+	benchmark.bInvokeDistributor = bInvokeDistributor;
+	benchmark.bReuseEnvironment = bReuseEnvironment;
+
+	stBenchmarkResult result;
+	benchmark.Run(s_args, result);
+
+	benchmark.dWarmupSeconds = dWarmupDefault;
+	benchmark.dMeasureSeconds = dMeasureDefault;
+	benchmark.iThreads = iThreadsDefault;
+	benchmark.bInvokeDistributor = bDistributorDefault;
+	benchmark.bReuseEnvironment = FALSE;
+
+	if (result.sError != "")
+	{
+		sResponse = result.sError;
+		std::replace(sResponse.begin(), sResponse.end(), '\n', ' ');
+		p_notify(utils.StrFormat("Job %u: %s", uiJobs, sResponse.c_str()));
+		return WriteLine(h_pipe, "ERROR " + sResponse);
+	}
+
+	sResponse = utils.StrFormat("RESULT frames=%u seconds=%.3f fps=%.3f cpu_seconds=%.3f pool_threads=%d env=%s",
+		result.uiFrames, result.dSeconds, result.dFPS, result.dCPUSeconds, result.iThreadPoolThreads, result.bReusedEnvironment ? "reused" : "fresh");
+
+	p_notify(utils.StrFormat("Job %u: %s fps", uiJobs, utils.StrFormatFPS(result.dFPS).c_str()));
+
+	return WriteLine(h_pipe, sResponse);
+}
+
+
+#if defined(_WIN32)
+
+BOOL CBenchmarkServer::Listen(string s_pipename)
+{
+	sPipePath = "\\\\.\\pipe\\" + s_pipename;
+
+	PSECURITY_DESCRIPTOR pSD = NULL;
+	if (!CreateUserOnlyDescriptor(pSD))
+	{
+		sError = "Cannot create the pipe security descriptor:\n" + utils.SysErrorMessage();
+		return FALSE;
+	}
+
+	SECURITY_ATTRIBUTES sa;
+	sa.nLength = sizeof(sa);
+	sa.lpSecurityDescriptor = pSD;
+	sa.bInheritHandle = FALSE;
+
+	//FILE_FLAG_FIRST_PIPE_INSTANCE: fail if someone else already created a pipe with that name
+	hListen = ::CreateNamedPipe(sPipePath.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+		1, SERVER_BUFSIZE, SERVER_BUFSIZE, 0, &sa);
+	DWORD dwError = ::GetLastError();
+	::LocalFree(pSD);
+	if (hListen == INVALID_HANDLE_VALUE)
+	{
+		::SetLastError(dwError);
+		sError = "Cannot create \"" + sPipePath + "\":\n" + utils.SysErrorMessage();
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+//DACL with a single entry, full access for the user of the process token
+BOOL CBenchmarkServer::CreateUserOnlyDescriptor(PSECURITY_DESCRIPTOR &p_sd)
+{
+	p_sd = NULL;
+
+	HANDLE hToken = NULL;
+	if (!::OpenProcessToken(::GetCurrentProcess(), TOKEN_QUERY, &hToken))
+		return FALSE;
+
+	DWORD dwSize = 0;
+	::GetTokenInformation(hToken, TokenUser, NULL, 0, &dwSize);
+	vector<BYTE> vTokenUser(dwSize > 0 ? dwSize : 1);
+	BOOL bRet = ::GetTokenInformation(hToken, TokenUser, &vTokenUser[0], dwSize, &dwSize);
+	::CloseHandle(hToken);
+	if (!bRet)
+		return FALSE;
+
+	LPSTR pszSid = NULL;
+	if (!::ConvertSidToStringSidA(((TOKEN_USER *)&vTokenUser[0])->User.Sid, &pszSid))
+		return FALSE;
+
+	string sSDDL = "D:P(A;;GA;;;" + string(pszSid) + ")";
+	::LocalFree(pszSid);
+
+	return ::ConvertStringSecurityDescriptorToSecurityDescriptorA(sSDDL.c_str(), SDDL_REVISION_1, &p_sd, NULL) ? TRUE : FALSE;
+}
+
+
+//The pipe instance itself is the connection
+HANDLE CBenchmarkServer::Accept()
+{
+	if (!::ConnectNamedPipe(hListen, NULL) && (::GetLastError() != ERROR_PIPE_CONNECTED))
+	{
+		sError = "ConnectNamedPipe() failed:\n" + utils.SysErrorMessage();
+		return INVALID_HANDLE_VALUE;
+	}
+
+	return hListen;
+}
+
+
+void CBenchmarkServer::Disconnect(HANDLE h_pipe)
+{
+	::FlushFileBuffers(h_pipe);
+	::DisconnectNamedPipe(h_pipe);
+}
+
+
+void CBenchmarkServer::Close()
+{
+	if (hListen != INVALID_HANDLE_VALUE)
+		::CloseHandle(hListen);
+	hListen = INVALID_HANDLE_VALUE;
+}
+
+
+BOOL CBenchmarkServer::ReadLine(HANDLE h_pipe, string &s_line)
+{
+	char szBuf[SERVER_BUFSIZE];
+	DWORD dwRead = 0;
+	size_t nEOL = 0;
+
+	while ((nEOL = sPending.find('\n')) == string::npos)
+	{
+		if (!::ReadFile(h_pipe, szBuf, sizeof(szBuf), &dwRead, NULL) || (dwRead == 0))
+			return FALSE; //client disconnected
+
+		sPending.append(szBuf, dwRead);
+	}
+
+	s_line = sPending.substr(0, nEOL);
+	sPending.erase(0, nEOL + 1);
+
+	return TRUE;
+}
+
+
+BOOL CBenchmarkServer::WriteLine(HANDLE h_pipe, const string &s_line)
+{
+	string sOut = s_line + "\n";
+	DWORD dwWritten = 0;
+
+	return ::WriteFile(h_pipe, sOut.c_str(), (DWORD)sOut.length(), &dwWritten, NULL) ? TRUE : FALSE;
+}
+
+#else //_WIN32
+
+//Handles are socket descriptors
+BOOL CBenchmarkServer::Listen(string s_pipename)
+{
+	if (s_pipename.find('/') != string::npos)
+	{
+		sError = "Invalid server name: \"" + s_pipename + "\"";
+		return FALSE;
+	}
+
+	string sDir = "";
+	if (!GetPrivateDir(sDir))
+		return FALSE;
+
+	sPipePath = sDir + "/" + s_pipename + ".sock";
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (sPipePath.length() >= sizeof(addr.sun_path))
+	{
+		sError = "Socket path too long: \"" + sPipePath + "\"";
+		return FALSE;
+	}
+	memcpy(addr.sun_path, sPipePath.c_str(), sPipePath.length() + 1);
+
+	//a stale socket in the private directory can only be ours, the umask keeps the new one 0600 from the start
+	int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	::unlink(sPipePath.c_str());
+	mode_t uiMask = ::umask(0077);
+	BOOL bBound = ((fd >= 0) && (::bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)) ? TRUE : FALSE;
+	::umask(uiMask);
+	if (!bBound || (::chmod(sPipePath.c_str(), 0600) != 0) || (::listen(fd, 1) != 0))
+	{
+		sError = "Cannot create \"" + sPipePath + "\":\n" + utils.SysErrorMessage();
+		if (fd >= 0)
+			::close(fd);
+		return FALSE;
+	}
+
+	hListen = (HANDLE)(intptr_t)fd;
+
+	return TRUE;
+}
+
+
+/*
+	$XDG_RUNTIME_DIR if it is set, otherwise /tmp/AVSMeter-<uid>, created
+	with mode 0700. Either must be a directory owned by the user that nobody
+	else can access, the socket is not created in a shared directory.
+*/
+BOOL CBenchmarkServer::GetPrivateDir(string &s_dir)
+{
+	const char *pszRuntimeDir = getenv("XDG_RUNTIME_DIR");
+	if (pszRuntimeDir && (pszRuntimeDir[0] == '/'))
+		s_dir = pszRuntimeDir;
+	else
+	{
+		s_dir = utils.StrFormat("/tmp/AVSMeter-%u", (unsigned int)::getuid());
+		if ((::mkdir(s_dir.c_str(), 0700) != 0) && (errno != EEXIST))
+		{
+			sError = "Cannot create \"" + s_dir + "\":\n" + utils.SysErrorMessage();
+			return FALSE;
+		}
+	}
+
+	struct stat st;
+	if (::lstat(s_dir.c_str(), &st) != 0)
+	{
+		sError = "Cannot access \"" + s_dir + "\":\n" + utils.SysErrorMessage();
+		return FALSE;
+	}
+
+	if (!S_ISDIR(st.st_mode) || (st.st_uid != ::getuid()) || ((st.st_mode & 0077) != 0))
+	{
+		sError = "\"" + s_dir + "\" is not a private directory (owned by the user, mode 0700)";
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+HANDLE CBenchmarkServer::Accept()
+{
+	int fd = -1;
+	while (((fd = ::accept((int)(intptr_t)hListen, NULL, NULL)) < 0) && (errno == EINTR)) {}
+	if (fd < 0)
+	{
+		sError = "accept() failed:\n" + utils.SysErrorMessage();
+		return INVALID_HANDLE_VALUE;
+	}
+
+	return (HANDLE)(intptr_t)fd;
+}
+
+
+void CBenchmarkServer::Disconnect(HANDLE h_pipe)
+{
+	::close((int)(intptr_t)h_pipe);
+}
+
+
+void CBenchmarkServer::Close()
+{
+	if (hListen != INVALID_HANDLE_VALUE)
+	{
+		::close((int)(intptr_t)hListen);
+		::unlink(sPipePath.c_str());
+	}
+	hListen = INVALID_HANDLE_VALUE;
+}
+
+
+BOOL CBenchmarkServer::ReadLine(HANDLE h_pipe, string &s_line)
+{
+	char szBuf[SERVER_BUFSIZE];
+	ssize_t nRead = 0;
+	size_t nEOL = 0;
+
+	while ((nEOL = sPending.find('\n')) == string::npos)
+	{
+		while (((nRead = ::recv((int)(intptr_t)h_pipe, szBuf, sizeof(szBuf), 0)) < 0) && (errno == EINTR)) {}
+		if (nRead <= 0)
+			return FALSE; //client disconnected
+
+		sPending.append(szBuf, (size_t)nRead);
+	}
+
+	s_line = sPending.substr(0, nEOL);
+	sPending.erase(0, nEOL + 1);
+
+	return TRUE;
+}
+
+
+BOOL CBenchmarkServer::WriteLine(HANDLE h_pipe, const string &s_line)
+{
+	string sOut = s_line + "\n";
+	size_t nWritten = 0;
+
+	while (nWritten < sOut.length())
+	{
+		ssize_t nRet = ::send((int)(intptr_t)h_pipe, sOut.c_str() + nWritten, sOut.length() - nWritten, MSG_NOSIGNAL);
+		if ((nRet < 0) && (errno == EINTR))
+			continue;
+		if (nRet <= 0)
+			return FALSE;
+		nWritten += (size_t)nRet;
+	}
+
+	return TRUE;
+}
+
+#endif //_WIN32
+
+
+#endif //_BENCHMARKSERVER_H
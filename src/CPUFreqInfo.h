@@ -0,0 +1,461 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_CPUFREQINFO_H)
+#define _CPUFREQINFO_H
+
+#include "common.h"
+
+#if defined(_WIN32)
+#include <powrprof.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+#define MSR_IA32_MPERF 0xE7
+#define MSR_IA32_APERF 0xE8
+#define MSR_PLATFORM_INFO 0xCE  //Intel, bits 15:8 are the base (non-turbo) ratio in units of 100 MHz
+
+#define CPUFREQ_SAMPLE_INTERVAL        500  //ms
+#define CPUFREQ_FIRST_SAMPLE_INTERVAL  20   //ms, until the first clock is known
+
+
+class CCPUFreqInfo
+{
+public:
+	CCPUFreqInfo();
+	virtual ~CCPUFreqInfo();
+
+	BOOL   Init();
+	void   Release();
+	BOOL   Update();            //TRUE: a new sample with a known clock was taken
+	double dNominalMHz;         //0 if unknown, FPS is not normalized then
+	double dCurrentMHz;         //last sample, 0 until known. POSIX: logical CPUs weighted by busy time, Windows: plain mean
+	double dSampleMS;           //time covered by the last sample
+	double dMinMHz;
+	double dMaxMHz;
+	BOOL   bThrottled;          //throttle indication during the last sample
+	unsigned int uiThrottledSamples;
+	unsigned int uiSamples;
+	vector<double> vCoreMHz;
+	string sSource;
+	string sError;
+	BOOL   bInitialized;
+
+private:
+	BOOL Sample();              //FALSE: no clock for this sample
+	unsigned __int64 GetSTDTimer();
+	BOOL bFirstRun;
+	unsigned __int64 uiLastSampleTime;
+	unsigned int uiCPUs;
+
+#if defined(_WIN32)
+	typedef struct _AVSM_PROCESSOR_POWER_INFORMATION //not declared in the SDK headers
+	{
+		ULONG Number;
+		ULONG MaxMhz;
+		ULONG CurrentMhz;
+		ULONG MhzLimit;
+		ULONG MaxIdleState;
+		ULONG CurrentIdleState;
+	} AVSM_PROCESSOR_POWER_INFORMATION;
+
+	vector<AVSM_PROCESSOR_POWER_INFORMATION> vPPI;
+#else
+	BOOL ReadSysfsValue(unsigned int ui_cpu, const char *s_file, unsigned __int64 &ui_value);
+	BOOL ReadMSR(unsigned int ui_cpu, unsigned int ui_msr, unsigned __int64 &ui_value);
+	BOOL ReadBusyTimes(vector<unsigned __int64> &v_busy);
+
+	vector<int>              vMSRFiles;
+	vector<unsigned __int64> vPrevAPERF;
+	vector<unsigned __int64> vPrevMPERF;
+	vector<unsigned __int64> vPrevThrottleCount;
+	vector<unsigned __int64> vBusy;
+	vector<unsigned __int64> vPrevBusy;
+	BOOL                     bUseMSR;
+#endif
+};
+
+
+CCPUFreqInfo::CCPUFreqInfo()
+{
+	dNominalMHz = 0.0;
+	dCurrentMHz = 0.0;
+	dSampleMS = 0.0;
+	dMinMHz = 0.0;
+	dMaxMHz = 0.0;
+	bThrottled = FALSE;
+	uiThrottledSamples = 0;
+	uiSamples = 0;
+	uiCPUs = 0;
+	sSource = "";
+	sError = "";
+	bInitialized = FALSE;
+	bFirstRun = TRUE;
+	uiLastSampleTime = 0;
+#if !defined(_WIN32)
+	bUseMSR = FALSE;
+#endif
+}
+
+CCPUFreqInfo::~CCPUFreqInfo()
+{
+	Release();
+}
+
+
+BOOL CCPUFreqInfo::Update()
+{
+	if (!bInitialized)
+		return FALSE;
+
+	//the first sample is only the baseline for the counters, the next one comes early so that the clock is known soon
+	unsigned __int64 uiNow = GetSTDTimer();
+	if (!bFirstRun && ((uiNow - uiLastSampleTime) < ((dCurrentMHz > 0.0) ? CPUFREQ_SAMPLE_INTERVAL : CPUFREQ_FIRST_SAMPLE_INTERVAL)))
+		return FALSE;
+
+	dSampleMS = bFirstRun ? 0.0 : (double)(uiNow - uiLastSampleTime);
+	uiLastSampleTime = uiNow;
+
+	BOOL bNewSample = Sample();
+
+	if (!bFirstRun && bNewSample)
+	{
+		++uiSamples;
+		if (bThrottled)
+			++uiThrottledSamples;
+	}
+
+	bNewSample = (bNewSample && !bFirstRun) ? TRUE : FALSE;
+	bFirstRun = FALSE;
+
+	return bNewSample;
+}
+
+
+#if defined(_WIN32)
+
+BOOL CCPUFreqInfo::Init()
+{
+	sError = "";
+	SYSTEM_INFO si;
+	::GetSystemInfo(&si);
+	uiCPUs = (unsigned int)si.dwNumberOfProcessors;
+
+	vPPI.resize(uiCPUs);
+	if (::CallNtPowerInformation(ProcessorInformation, NULL, 0, &vPPI[0], (ULONG)(uiCPUs * sizeof(AVSM_PROCESSOR_POWER_INFORMATION))) != 0)
+	{
+		sError = "CallNtPowerInformation() failed";
+		return FALSE;
+	}
+
+	//MaxMhz is the rated (non-turbo) clock
+	dNominalMHz = (double)vPPI[0].MaxMhz;
+	sSource = "CallNtPowerInformation";
+	vCoreMHz.resize(uiCPUs);
+	bInitialized = TRUE;
+
+	return TRUE;
+}
+
+
+void CCPUFreqInfo::Release()
+{
+	vPPI.clear();
+	bInitialized = FALSE;
+
+	return;
+}
+
+
+BOOL CCPUFreqInfo::Sample()
+{
+	//CurrentMhz is an instantaneous reading without busy times, every CPU counts the same
+	if (::CallNtPowerInformation(ProcessorInformation, NULL, 0, &vPPI[0], (ULONG)(uiCPUs * sizeof(AVSM_PROCESSOR_POWER_INFORMATION))) != 0)
+		return FALSE;
+
+	double dSum = 0.0;
+	bThrottled = FALSE;
+	dMinMHz = 1.0e+20;
+	dMaxMHz = 0.0;
+
+	for (unsigned int i = 0; i < uiCPUs; i++)
+	{
+		vCoreMHz[i] = (double)vPPI[i].CurrentMhz;
+		dSum += vCoreMHz[i];
+		if (vCoreMHz[i] < dMinMHz) dMinMHz = vCoreMHz[i];
+		if (vCoreMHz[i] > dMaxMHz) dMaxMHz = vCoreMHz[i];
+
+		//the power manager lowers MhzLimit on thermal or power constraints
+		if (vPPI[i].MhzLimit < vPPI[i].MaxMhz)
+			bThrottled = TRUE;
+	}
+
+	dCurrentMHz = dSum / (double)uiCPUs;
+
+	return (dCurrentMHz > 0.0) ? TRUE : FALSE;
+}
+
+#else //_WIN32
+
+BOOL CCPUFreqInfo::Init()
+{
+	sError = "";
+	long lCPUs = sysconf(_SC_NPROCESSORS_CONF);
+	uiCPUs = (lCPUs > 0) ? (unsigned int)lCPUs : 1;
+
+	vCoreMHz.assign(uiCPUs, 0.0);
+	vMSRFiles.assign(uiCPUs, -1);
+	vPrevAPERF.assign(uiCPUs, 0);
+	vPrevMPERF.assign(uiCPUs, 0);
+	vPrevThrottleCount.assign(uiCPUs, 0);
+
+	//APERF/MPERF needs read access to /dev/cpu/*/msr (msr module, usually root)
+	bUseMSR = TRUE;
+	char szPath[64];
+	for (unsigned int i = 0; i < uiCPUs; i++)
+	{
+		snprintf(szPath, sizeof(szPath), "/dev/cpu/%u/msr", i);
+		vMSRFiles[i] = open(szPath, O_RDONLY);
+		if (vMSRFiles[i] < 0)
+			bUseMSR = FALSE;
+	}
+
+	/*
+	base_frequency is only provided by intel_pstate, otherwise the base ratio
+	comes from MSR_PLATFORM_INFO. cpuinfo_max_freq is not used, it includes
+	turbo with acpi-cpufreq and amd-pstate.
+	*/
+	dNominalMHz = 0.0;
+	unsigned __int64 uiValue = 0;
+	if (ReadSysfsValue(0, "cpufreq/base_frequency", uiValue))
+		dNominalMHz = (double)uiValue / 1000.0;
+	else if (bUseMSR && ReadMSR(0, MSR_PLATFORM_INFO, uiValue))
+		dNominalMHz = (double)((uiValue >> 8) & 0xFF) * 100.0;
+
+	//APERF/MPERF only gives the clock relative to the nominal one
+	if (dNominalMHz <= 0.0)
+		bUseMSR = FALSE;
+
+	if (!bUseMSR)
+	{
+		for (unsigned int i = 0; i < uiCPUs; i++)
+		{
+			if (vMSRFiles[i] >= 0)
+				close(vMSRFiles[i]);
+			vMSRFiles[i] = -1;
+		}
+	}
+
+	if (!bUseMSR && !ReadSysfsValue(0, "cpufreq/scaling_cur_freq", uiValue))
+	{
+		Release();
+		sError = "cpufreq is not available (/sys/devices/system/cpu/cpu0/cpufreq)";
+		return FALSE;
+	}
+
+	vBusy.assign(uiCPUs, 0);
+	vPrevBusy.assign(uiCPUs, 0);
+	sSource = bUseMSR ? "APERF/MPERF" : "cpufreq";
+	bInitialized = TRUE;
+
+	return TRUE;
+}
+
+
+void CCPUFreqInfo::Release()
+{
+	for (unsigned int i = 0; i < vMSRFiles.size(); i++)
+	{
+		if (vMSRFiles[i] >= 0)
+			close(vMSRFiles[i]);
+	}
+
+	vMSRFiles.clear();
+	bInitialized = FALSE;
+
+	return;
+}
+
+
+BOOL CCPUFreqInfo::Sample()
+{
+	/*
+	Every CPU is weighted with the time it was busy during the sample, an idle
+	core parked at its lowest clock would otherwise deflate the average for
+	scripts that do not load all cores. With APERF/MPERF the weight is the
+	MPERF delta, scaling_cur_freq is weighted with the busy time from
+	/proc/stat (all CPUs count the same if that cannot be read).
+	*/
+	double dSum = 0.0;
+	double dWeights = 0.0;
+	double dWeight = 0.0;
+	unsigned __int64 uiValue = 0;
+	unsigned __int64 uiAPERF = 0;
+	unsigned __int64 uiMPERF = 0;
+	unsigned __int64 uiThrottleCount = 0;
+	bThrottled = FALSE;
+	dMinMHz = 1.0e+20;
+	dMaxMHz = 0.0;
+
+	BOOL bBusyTimes = (!bUseMSR && ReadBusyTimes(vBusy)) ? TRUE : FALSE;
+
+	for (unsigned int i = 0; i < uiCPUs; i++)
+	{
+		vCoreMHz[i] = 0.0;
+		dWeight = 0.0;
+
+		if (bUseMSR && ReadMSR(i, MSR_IA32_APERF, uiAPERF) && ReadMSR(i, MSR_IA32_MPERF, uiMPERF))
+		{
+			//MPERF ticks at the nominal clock, APERF at the actual clock, both only while not halted
+			if (!bFirstRun && (uiMPERF > vPrevMPERF[i]))
+			{
+				vCoreMHz[i] = dNominalMHz * (double)(uiAPERF - vPrevAPERF[i]) / (double)(uiMPERF - vPrevMPERF[i]);
+				dWeight = (double)(uiMPERF - vPrevMPERF[i]);
+			}
+
+			vPrevAPERF[i] = uiAPERF;
+			vPrevMPERF[i] = uiMPERF;
+		}
+		else if (ReadSysfsValue(i, "cpufreq/scaling_cur_freq", uiValue))
+		{
+			vCoreMHz[i] = (double)uiValue / 1000.0;
+			if (!bBusyTimes)
+				dWeight = 1.0;
+			else if (!bFirstRun && (vBusy[i] > vPrevBusy[i]))
+				dWeight = (double)(vBusy[i] - vPrevBusy[i]);
+		}
+
+		if (bBusyTimes)
+			vPrevBusy[i] = vBusy[i];
+
+		uiThrottleCount = 0;
+		if (ReadSysfsValue(i, "thermal_throttle/core_throttle_count", uiValue))
+			uiThrottleCount += uiValue;
+		if (ReadSysfsValue(i, "thermal_throttle/package_throttle_count", uiValue))
+			uiThrottleCount += uiValue;
+
+		if (!bFirstRun && (uiThrottleCount > vPrevThrottleCount[i]))
+			bThrottled = TRUE;
+
+		vPrevThrottleCount[i] = uiThrottleCount;
+
+		if ((vCoreMHz[i] <= 0.0) || (dWeight <= 0.0))
+			continue;
+
+		dWeights += dWeight;
+		dSum += vCoreMHz[i] * dWeight;
+		if (vCoreMHz[i] < dMinMHz) dMinMHz = vCoreMHz[i];
+		if (vCoreMHz[i] > dMaxMHz) dMaxMHz = vCoreMHz[i];
+	}
+
+	//nothing was busy or this is the baseline, the last clock stays valid
+	if (dWeights <= 0.0)
+	{
+		dMinMHz = 0.0;
+		return FALSE;
+	}
+
+	dCurrentMHz = dSum / dWeights;
+
+	return TRUE;
+}
+
+
+BOOL CCPUFreqInfo::ReadSysfsValue(unsigned int ui_cpu, const char *s_file, unsigned __int64 &ui_value)
+{
+	char szPath[128];
+	char szBuf[32];
+	snprintf(szPath, sizeof(szPath), "/sys/devices/system/cpu/cpu%u/%s", ui_cpu, s_file);
+
+	int iFD = open(szPath, O_RDONLY);
+	if (iFD < 0)
+		return FALSE;
+
+	ssize_t iLen = read(iFD, szBuf, sizeof(szBuf) - 1);
+	close(iFD);
+	if (iLen <= 0)
+		return FALSE;
+
+	szBuf[iLen] = '\0';
+	ui_value = (unsigned __int64)strtoull(szBuf, NULL, 10);
+
+	return TRUE;
+}
+
+
+BOOL CCPUFreqInfo::ReadBusyTimes(vector<unsigned __int64> &v_busy)
+{
+	//"cpuN user nice system idle iowait irq softirq steal ..." in USER_HZ, idle and iowait are not busy
+	FILE *pFile = fopen("/proc/stat", "r");
+	if (!pFile)
+		return FALSE;
+
+	char szLine[512];
+	unsigned int uiCPU = 0;
+	unsigned __int64 uiTimes[8];
+	BOOL bRet = FALSE;
+	while (fgets(szLine, sizeof(szLine), pFile) != NULL)
+	{
+		if ((strncmp(szLine, "cpu", 3) != 0) || (szLine[3] < '0') || (szLine[3] > '9'))
+			continue;
+
+		memset(uiTimes, 0, sizeof(uiTimes));
+		if (sscanf(szLine + 3, "%u %llu %llu %llu %llu %llu %llu %llu %llu", &uiCPU, &uiTimes[0], &uiTimes[1], &uiTimes[2], &uiTimes[3],
+			&uiTimes[4], &uiTimes[5], &uiTimes[6], &uiTimes[7]) < 5)
+			continue;
+
+		if (uiCPU >= v_busy.size())
+			continue;
+
+		v_busy[uiCPU] = uiTimes[0] + uiTimes[1] + uiTimes[2] + uiTimes[5] + uiTimes[6] + uiTimes[7];
+		bRet = TRUE;
+	}
+	fclose(pFile);
+
+	return bRet;
+}
+
+
+BOOL CCPUFreqInfo::ReadMSR(unsigned int ui_cpu, unsigned int ui_msr, unsigned __int64 &ui_value)
+{
+	if ((ui_cpu >= vMSRFiles.size()) || (vMSRFiles[ui_cpu] < 0))
+		return FALSE;
+
+	return (pread(vMSRFiles[ui_cpu], &ui_value, sizeof(ui_value), (off_t)ui_msr) == (ssize_t)sizeof(ui_value)) ? TRUE : FALSE;
+}
+
+#endif //_WIN32
+
+
+unsigned __int64 CCPUFreqInfo::GetSTDTimer()
+{
+	static unsigned __int64 uiLastSTDTimer;
+	unsigned __int64 uiSTDTimer = (unsigned __int64)GetTickCount();
+	unsigned __int64 uiTimerWrapComp = (uiSTDTimer < uiLastSTDTimer) ? 4294967296 : 0;
+	uiLastSTDTimer = uiSTDTimer;
+
+	return (uiSTDTimer + uiTimerWrapComp);
+}
+
+
+#endif //_CPUFREQINFO_H
@@ -0,0 +1,282 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_CONSUMER_H)
+#define _CONSUMER_H
+
+#include "common.h"
+#include "Utility.h"
+#include "Timer.h"
+#include "FrameServer.h"
+
+#define CONSUMER_MAX_REFS    64
+
+#define CONSUMER_COST_BUSY   0  //spins, shows up as CPU load like an encoder thread
+#define CONSUMER_COST_SLEEP  1  //waits, like a hardware encoder (ms granularity)
+
+
+struct stConsumerParams
+{
+	string       sPreset;
+	unsigned int uiRefs;            //frames kept referenced besides the current one
+	double       dCostMS;           //per frame
+	double       dCostMSPerMPixel;  //per frame and megapixel, added to dCostMS
+	int          iCostMode;
+	BOOL         bRead;             //read every pixel of the frame once
+};
+
+
+/*
+	Emulates what an encoder does between two frame requests: it keeps the
+	last uiRefs frames referenced (the frame server holds them, see
+	CFrameServer::uiHeldFrames), reads the new frame and spends time on it.
+	Both change the cache and memory behaviour of the script compared to
+	AVSMeter's default loop that drops each frame and asks for the next one.
+
+	Spec: preset[,refs=n][,ms=x][,mode=busy|sleep][,read=0|1]
+	      or the options alone. The preset costs are per megapixel and only
+	      roughly shaped like the serial part of the named encoder settings.
+*/
+static const struct
+{
+	const char   *pszName;
+	unsigned int uiRefs;
+	double       dCostMSPerMPixel;
+	int          iCostMode;
+} ConsumerPresets[] =
+{
+	{"x264-ultrafast",  1,  0.5, CONSUMER_COST_BUSY},
+	{"x264-medium",     3,  3.0, CONSUMER_COST_BUSY},
+	{"x264-veryslow",  16, 12.0, CONSUMER_COST_BUSY},
+	{"x265-medium",     3,  8.0, CONSUMER_COST_BUSY},
+	{"x265-slow",       4, 16.0, CONSUMER_COST_BUSY},
+	{"nvenc",           4,  1.0, CONSUMER_COST_SLEEP}
+};
+
+
+class CConsumer
+{
+public:
+	CConsumer();
+	virtual ~CConsumer() {}
+
+	static BOOL ParseSpec(const string &s_spec, stConsumerParams &params, string &s_error);
+
+	void   Init(const stConsumerParams &params, const stClipInfo &clipinfo);
+	void   Consume(const stFramePlanes &planes);
+	string GetDescription();
+
+	stConsumerParams params;
+	double dFrameCostMS;            //resolved for the clip
+	double dConsumerSeconds;        //time spent in Consume()
+	BOOL   bActive;
+
+private:
+	void   Spin(double d_ms);
+
+	double           dPerfFreq;
+	unsigned __int64 uiChecksum;    //keeps the read pass from being optimized away
+	CUtils           utils;
+	CTimer           timer;
+};
+
+
+CConsumer::CConsumer()
+{
+	params.sPreset = "";
+	params.uiRefs = 0;
+	params.dCostMS = 0.0;
+	params.dCostMSPerMPixel = 0.0;
+	params.iCostMode = CONSUMER_COST_BUSY;
+	params.bRead = TRUE;
+	dFrameCostMS = 0.0;
+	dConsumerSeconds = 0.0;
+	bActive = FALSE;
+	uiChecksum = 0;
+
+	LARGE_INTEGER liPerfFreq;
+	dPerfFreq = ::QueryPerformanceFrequency(&liPerfFreq) ? (double)liPerfFreq.QuadPart : 0.0;
+}
+
+
+BOOL CConsumer::ParseSpec(const string &s_spec, stConsumerParams &params, string &s_error)
+{
+	s_error = "";
+
+	params.sPreset = "";
+	params.uiRefs = 0;
+	params.dCostMS = 0.0;
+	params.dCostMSPerMPixel = 0.0;
+	params.iCostMode = CONSUMER_COST_BUSY;
+	params.bRead = TRUE;
+
+	string sOptions = s_spec;
+	string sOption = "";
+	string sKey = "";
+	string sValue = "";
+	while (sOptions != "")
+	{
+		size_t nComma = sOptions.find(',');
+		sOption = sOptions.substr(0, nComma);
+		sOptions = (nComma == string::npos) ? "" : sOptions.substr(nComma + 1);
+		transform(sOption.begin(), sOption.end(), sOption.begin(), ::tolower);
+		if (sOption == "")
+			continue;
+
+		size_t nEqual = sOption.find('=');
+		sKey = sOption.substr(0, nEqual);
+		sValue = (nEqual == string::npos) ? "" : sOption.substr(nEqual + 1);
+
+		if (nEqual == string::npos)
+		{
+			BOOL bFound = FALSE;
+			for (size_t i = 0; i < (sizeof(ConsumerPresets) / sizeof(ConsumerPresets[0])); i++)
+			{
+				if (sKey == ConsumerPresets[i].pszName)
+				{
+					params.sPreset = ConsumerPresets[i].pszName;
+					params.uiRefs = ConsumerPresets[i].uiRefs;
+					params.dCostMSPerMPixel = ConsumerPresets[i].dCostMSPerMPixel;
+					params.iCostMode = ConsumerPresets[i].iCostMode;
+					bFound = TRUE;
+					break;
+				}
+			}
+
+			if (!bFound)
+			{
+				s_error = "Unknown preset: \"" + sKey + "\"";
+				return FALSE;
+			}
+		}
+		else if (sKey == "refs")
+			params.uiRefs = (unsigned int)atoi(sValue.c_str());
+		else if (sKey == "ms")
+		{
+			//replaces the preset cost
+			params.dCostMS = atof(sValue.c_str());
+			params.dCostMSPerMPixel = 0.0;
+		}
+		else if (sKey == "mode")
+		{
+			if (sValue == "busy")
+				params.iCostMode = CONSUMER_COST_BUSY;
+			else if (sValue == "sleep")
+				params.iCostMode = CONSUMER_COST_SLEEP;
+			else
+			{
+				s_error = "Unknown cost mode: \"" + sValue + "\"";
+				return FALSE;
+			}
+		}
+		else if (sKey == "read")
+			params.bRead = (atoi(sValue.c_str()) != 0) ? TRUE : FALSE;
+		else
+		{
+			s_error = "Unknown option: \"" + sKey + "\"";
+			return FALSE;
+		}
+	}
+
+	if (params.uiRefs > CONSUMER_MAX_REFS)
+		s_error = "Reference frames must be between 0 and 64";
+	else if (params.dCostMS < 0.0)
+		s_error = "Consumer cost must not be negative";
+
+	return (s_error == "") ? TRUE : FALSE;
+}
+
+
+void CConsumer::Init(const stConsumerParams &consumerparams, const stClipInfo &clipinfo)
+{
+	params = consumerparams;
+	dFrameCostMS = params.dCostMS + (params.dCostMSPerMPixel * (double)clipinfo.uiWidth * (double)clipinfo.uiHeight / 1.0e+6);
+	dConsumerSeconds = 0.0;
+	bActive = TRUE;
+
+	return;
+}
+
+
+void CConsumer::Consume(const stFramePlanes &planes)
+{
+	double dStart = timer.GetTimer();
+
+	if (params.bRead)
+	{
+		unsigned __int64 uiSum = 0;
+		for (int iPlane = 0; iPlane < planes.iPlanes; iPlane++)
+		{
+			for (int iRow = 0; iRow < planes.iHeight[iPlane]; iRow++)
+			{
+				const BYTE *pRow = planes.pData[iPlane] + (__int64)iRow * planes.iPitch[iPlane];
+				int iWords = planes.iRowSize[iPlane] / 8;
+				for (int iWord = 0; iWord < iWords; iWord++)
+				{
+					unsigned __int64 uiWord;
+					memcpy(&uiWord, pRow + (iWord * 8), 8);
+					uiSum += uiWord;
+				}
+			}
+		}
+		uiChecksum += uiSum;
+	}
+
+	if (params.iCostMode == CONSUMER_COST_SLEEP)
+	{
+		if (dFrameCostMS >= 0.5)
+			Sleep((DWORD)(dFrameCostMS + 0.5));
+	}
+	else
+		Spin(dFrameCostMS);
+
+	dConsumerSeconds += timer.GetTimer() - dStart;
+
+	return;
+}
+
+
+void CConsumer::Spin(double d_ms)
+{
+	if ((d_ms <= 0.0) || (dPerfFreq <= 0.0))
+		return;
+
+	LARGE_INTEGER liStart = {0,0};
+	LARGE_INTEGER liNow = {0,0};
+	::QueryPerformanceCounter(&liStart);
+	__int64 iTicks = (__int64)((d_ms * dPerfFreq) / 1000.0);
+	do
+	{
+		::QueryPerformanceCounter(&liNow);
+	}
+	while ((liNow.QuadPart - liStart.QuadPart) < iTicks);
+
+	return;
+}
+
+
+string CConsumer::GetDescription()
+{
+	string sText = (params.sPreset != "") ? (params.sPreset + ", ") : "";
+	sText += utils.StrFormat("%u refs, %.2f ms %s%s", params.uiRefs, dFrameCostMS, (params.iCostMode == CONSUMER_COST_SLEEP) ? "sleep" : "busy", params.bRead ? ", read" : "");
+
+	return sText;
+}
+
+
+#endif //_CONSUMER_H
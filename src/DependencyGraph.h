@@ -0,0 +1,582 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_DEPENDENCYGRAPH_H)
+#define _DEPENDENCYGRAPH_H
+
+#include "common.h"
+#include "Utility.h"
+#include "PEFile.h"
+
+#define DEPGRAPH_NODE_NONE ((size_t)-1)
+
+
+struct stDependencyNode
+{
+	string  sName;          //as imported (or file name for roots)
+	string  sPath;          //empty if not found
+	BOOL    bRoot;
+	BOOL    bMissing;
+	BOOL    bVirtual;       //API set or side-by-side assembly, resolved by the loader
+	vector  <size_t> vImports;
+	unsigned int uiDependents; //number of roots that depend on this node, see Finalize()
+};
+
+static BOOL CompareDependents(const stDependencyNode *first, const stDependencyNode *second)
+{
+	if (first->uiDependents != second->uiDependents)
+		return (first->uiDependents > second->uiDependents) ? TRUE : FALSE;
+
+	return (first->sName < second->sName) ? TRUE : FALSE;
+}
+
+
+/*
+	Transitive DLL dependency graph built from import tables only, nothing is
+	loaded or executed. Each file is parsed once and every (directory, name)
+	lookup is memoized, so plugins sharing the same runtimes only pay for their
+	own imports. Imports are searched like LoadLibraryEx() with
+	LOAD_WITH_ALTERED_SEARCH_PATH: the importing module's directory, the system
+	directory, the Windows directory, the current directory and PATH.
+	Delay-load imports are not followed since they cannot fail the load.
+*/
+class CDependencyGraph
+{
+public:
+	CDependencyGraph();
+	virtual ~CDependencyGraph();
+
+	void   Reset(WORD w_machine);
+	void   AddKnownModule(const string &s_name, const string &s_path);
+	size_t AddRoot(const string &s_file, const vector<string> &v_imports);
+	void   GetMissing(size_t ui_node, size_t ui_import, vector<string> &v_missing);
+	void   Finalize();
+	string GetText();
+	string GetDOT();
+	vector <stDependencyNode> vNodes;
+	unsigned int uiParsedFiles;
+	unsigned int uiCacheHits;
+
+private:
+	size_t Resolve(const string &s_name, const string &s_dir);
+	size_t AddNode(const string &s_name, const string &s_path);
+	void   ParseImports(size_t ui_node);
+	string FindModule(const string &s_name, const string &s_dir);
+	BOOL   IsMachineMatch(const string &s_path);
+	void   Reach(size_t ui_node, vector<BOOL> &v_visited);
+	string DirOf(const string &s_path);
+	string EscapeDOT(const string &s_string);
+	map    <string, size_t> mPaths;     //lower case path -> node
+	map    <string, size_t> mResolved;  //lower case "dir|name" -> node
+	map    <string, size_t> mKnown;     //lower case name -> node (already loaded modules)
+	map    <string, string> mSearch;    //lower case name -> path found in the standard directories
+	map    <string, size_t> mMissing;   //lower case name -> node, one node per missing module
+	vector <string> vSearchDirs;
+	WORD   wMachine;
+	CRITICAL_SECTION csGraph;           //the plugin scan threads share one graph
+	CUtils utils;
+};
+
+
+CDependencyGraph::CDependencyGraph()
+{
+	::InitializeCriticalSection(&csGraph);
+	Reset(PROCESS_64 ? PE_MACHINE_AMD64 : PE_MACHINE_I386);
+}
+
+CDependencyGraph::~CDependencyGraph()
+{
+	::DeleteCriticalSection(&csGraph);
+}
+
+
+void CDependencyGraph::Reset(WORD w_machine)
+{
+	::EnterCriticalSection(&csGraph);
+
+	wMachine = w_machine;
+	uiParsedFiles = 0;
+	uiCacheHits = 0;
+	vNodes.clear();
+	mPaths.clear();
+	mResolved.clear();
+	mKnown.clear();
+	mSearch.clear();
+	mMissing.clear();
+	vSearchDirs.clear();
+
+	char szPath[MAX_PATH + 1];
+#if defined(_WIN32)
+	if (::GetSystemDirectory(szPath, MAX_PATH) > 0)
+		vSearchDirs.push_back(szPath);
+	if (::GetWindowsDirectory(szPath, MAX_PATH) > 0)
+	{
+		vSearchDirs.push_back(string(szPath) + "\\System");
+		vSearchDirs.push_back(szPath);
+	}
+#endif
+	if (::GetCurrentDirectory(MAX_PATH, szPath) > 0)
+		vSearchDirs.push_back(szPath);
+
+	char *pszEnv = getenv("PATH");
+	string sEnv = pszEnv ? pszEnv : "";
+	string sDir = "";
+	size_t nStart = 0;
+	size_t nEnd = 0;
+	while (nStart <= sEnv.length())
+	{
+		nEnd = sEnv.find(';', nStart);
+		if (nEnd == string::npos)
+			nEnd = sEnv.length();
+
+		sDir = sEnv.substr(nStart, nEnd - nStart);
+		utils.StrTrim(sDir);
+		if ((sDir.length() > 1) && (sDir[0] == '\"') && (sDir[sDir.length() - 1] == '\"'))
+			sDir = sDir.substr(1, sDir.length() - 2);
+		if ((sDir.length() > 0) && (sDir[sDir.length() - 1] == '\\'))
+			sDir.erase(sDir.length() - 1);
+		if (sDir != "")
+			vSearchDirs.push_back(sDir);
+
+		nStart = nEnd + 1;
+	}
+
+	::LeaveCriticalSection(&csGraph);
+
+	return;
+}
+
+
+void CDependencyGraph::AddKnownModule(const string &s_name, const string &s_path)
+{
+	::EnterCriticalSection(&csGraph);
+
+	string sName = s_name;
+	utils.StrToLC(sName);
+	string sPath = s_path;
+	utils.StrToLC(sPath);
+
+	size_t uiNode = (mPaths.find(sPath) != mPaths.end()) ? mPaths[sPath] : AddNode(s_name, s_path);
+	mKnown[sName] = uiNode;
+
+	::LeaveCriticalSection(&csGraph);
+
+	return;
+}
+
+
+size_t CDependencyGraph::AddRoot(const string &s_file, const vector<string> &v_imports)
+{
+	::EnterCriticalSection(&csGraph);
+
+	string sPath = s_file;
+	utils.StrToLC(sPath);
+
+	size_t uiNode = 0;
+	if (mPaths.find(sPath) != mPaths.end())
+	{
+		uiNode = mPaths[sPath];
+		++uiCacheHits;
+	}
+	else
+	{
+		//the caller has parsed (or cached) the root's imports already
+		size_t nSlash = s_file.find_last_of("\\/");
+		uiNode = AddNode((nSlash == string::npos) ? s_file : s_file.substr(nSlash + 1), s_file);
+		string sDir = DirOf(s_file);
+		for (size_t i = 0; i < v_imports.size(); i++)
+		{
+			size_t uiImport = Resolve(v_imports[i], sDir);
+			vNodes[uiNode].vImports.push_back(uiImport);
+		}
+	}
+
+	vNodes[uiNode].bRoot = TRUE;
+
+	::LeaveCriticalSection(&csGraph);
+
+	return uiNode;
+}
+
+
+size_t CDependencyGraph::AddNode(const string &s_name, const string &s_path)
+{
+	stDependencyNode node;
+	node.sName = s_name;
+	node.sPath = s_path;
+	node.bRoot = FALSE;
+	node.bMissing = (s_path == "") ? TRUE : FALSE;
+	node.bVirtual = FALSE;
+	node.uiDependents = 0;
+	vNodes.push_back(node);
+
+	if (s_path != "")
+	{
+		string sPath = s_path;
+		utils.StrToLC(sPath);
+		mPaths[sPath] = vNodes.size() - 1;
+	}
+
+	return vNodes.size() - 1;
+}
+
+
+size_t CDependencyGraph::Resolve(const string &s_name, const string &s_dir)
+{
+	string sName = s_name;
+	utils.StrToLC(sName);
+	utils.StrTrim(sName);
+
+	if (mKnown.find(sName) != mKnown.end())
+	{
+		++uiCacheHits;
+		return mKnown[sName];
+	}
+
+	string sKey = s_dir + "|" + sName;
+	utils.StrToLC(sKey);
+	if (mResolved.find(sKey) != mResolved.end())
+	{
+		++uiCacheHits;
+		return mResolved[sKey];
+	}
+
+	string sPath = "";
+	size_t uiNode = DEPGRAPH_NODE_NONE;
+
+	//VC 2005/2008 runtimes live in WinSxS, see CAvisynthInfo::IsRuntimeInstalled()
+	BOOL bSideBySide = ((sName == "msvcm80.dll") || (sName == "msvcp80.dll") || (sName == "msvcr80.dll") ||
+		(sName == "msvcm90.dll") || (sName == "msvcp90.dll") || (sName == "msvcr90.dll")) ? TRUE : FALSE;
+
+	if (!bSideBySide)
+		sPath = FindModule(s_name, s_dir);
+
+	if (sPath != "")
+	{
+		string sPathLC = sPath;
+		utils.StrToLC(sPathLC);
+		if (mPaths.find(sPathLC) != mPaths.end())
+		{
+			uiNode = mPaths[sPathLC];
+			++uiCacheHits;
+		}
+	}
+	else if (mMissing.find(sName) != mMissing.end())
+		uiNode = mMissing[sName];
+
+	if (uiNode == DEPGRAPH_NODE_NONE)
+	{
+		uiNode = AddNode(s_name, sPath);
+
+		if (bSideBySide || ((sPath == "") && ((sName.substr(0, 7) == "api-ms-") || (sName.substr(0, 7) == "ext-ms-")) && (sName.substr(0, 15) != "api-ms-win-crt-")))
+		{
+			//API sets without a host file are mapped by the loader, the CRT ones are real files (UCRT)
+			vNodes[uiNode].bVirtual = TRUE;
+			vNodes[uiNode].bMissing = FALSE;
+		}
+
+		if (sPath == "")
+			mMissing[sName] = uiNode;
+
+		//register before descending, import cycles (kernel32 <-> kernelbase) are common
+		mResolved[sKey] = uiNode;
+
+		if (sPath != "")
+			ParseImports(uiNode);
+	}
+	else
+		mResolved[sKey] = uiNode;
+
+	return uiNode;
+}
+
+
+void CDependencyGraph::ParseImports(size_t ui_node)
+{
+	CPEFile pe;
+	vector <string> vImports;
+
+	if (!pe.Open(vNodes[ui_node].sPath))
+		return;
+
+	++uiParsedFiles;
+	pe.GetImportNames(vImports);
+	pe.Close();
+
+	string sDir = DirOf(vNodes[ui_node].sPath);
+	for (size_t i = 0; i < vImports.size(); i++)
+	{
+		size_t uiImport = Resolve(vImports[i], sDir);
+		vNodes[ui_node].vImports.push_back(uiImport);
+	}
+
+	return;
+}
+
+
+string CDependencyGraph::FindModule(const string &s_name, const string &s_dir)
+{
+	//fully qualified imports are rare but legal
+	if ((s_name.find('\\') != string::npos) || (s_name.find('/') != string::npos))
+		return (utils.FileExists(s_name) && IsMachineMatch(s_name)) ? s_name : "";
+
+	string sPath = s_dir + "\\" + s_name;
+	if (utils.FileExists(sPath) && IsMachineMatch(sPath))
+		return sPath;
+
+	string sName = s_name;
+	utils.StrToLC(sName);
+	if (mSearch.find(sName) != mSearch.end())
+		return mSearch[sName];
+
+	string sFound = "";
+	for (size_t i = 0; i < vSearchDirs.size(); i++)
+	{
+		//the loader skips images of the wrong architecture and keeps searching
+		sPath = vSearchDirs[i] + "\\" + s_name;
+		if (utils.FileExists(sPath) && IsMachineMatch(sPath))
+		{
+			sFound = sPath;
+			break;
+		}
+	}
+
+	mSearch[sName] = sFound;
+
+	return sFound;
+}
+
+
+BOOL CDependencyGraph::IsMachineMatch(const string &s_path)
+{
+	CPEFile pe;
+	if (!pe.Open(s_path))
+		return FALSE;
+
+	return (pe.wMachine == wMachine) ? TRUE : FALSE;
+}
+
+
+string CDependencyGraph::DirOf(const string &s_path)
+{
+	size_t nSlash = s_path.find_last_of("\\/");
+
+	return (nSlash == string::npos) ? "." : s_path.substr(0, nSlash);
+}
+
+
+void CDependencyGraph::Reach(size_t ui_node, vector<BOOL> &v_visited)
+{
+	//iterative, the graph can be deep and cyclic
+	vector <size_t> vStack;
+	vStack.push_back(ui_node);
+	while (vStack.size() > 0)
+	{
+		size_t uiNode = vStack.back();
+		vStack.pop_back();
+		if (v_visited[uiNode])
+			continue;
+
+		v_visited[uiNode] = TRUE;
+		for (size_t i = 0; i < vNodes[uiNode].vImports.size(); i++)
+		{
+			if (!v_visited[vNodes[uiNode].vImports[i]])
+				vStack.push_back(vNodes[uiNode].vImports[i]);
+		}
+	}
+
+	return;
+}
+
+
+void CDependencyGraph::GetMissing(size_t ui_node, size_t ui_import, vector<string> &v_missing)
+{
+	//missing modules reachable through the node's ui_import'th import, including the import itself
+	::EnterCriticalSection(&csGraph);
+
+	v_missing.clear();
+	if ((ui_node < vNodes.size()) && (ui_import < vNodes[ui_node].vImports.size()))
+	{
+		vector <BOOL> vVisited(vNodes.size(), FALSE);
+		Reach(vNodes[ui_node].vImports[ui_import], vVisited);
+		for (size_t i = 0; i < vNodes.size(); i++)
+		{
+			if (vVisited[i] && vNodes[i].bMissing)
+				v_missing.push_back(vNodes[i].sName);
+		}
+	}
+
+	::LeaveCriticalSection(&csGraph);
+
+	return;
+}
+
+
+void CDependencyGraph::Finalize()
+{
+	::EnterCriticalSection(&csGraph);
+
+	size_t i = 0;
+	size_t j = 0;
+	for (i = 0; i < vNodes.size(); i++)
+		vNodes[i].uiDependents = 0;
+
+	for (i = 0; i < vNodes.size(); i++)
+	{
+		if (!vNodes[i].bRoot)
+			continue;
+
+		vector <BOOL> vVisited(vNodes.size(), FALSE);
+		Reach(i, vVisited);
+		for (j = 0; j < vNodes.size(); j++)
+		{
+			if (vVisited[j] && (j != i))
+				++vNodes[j].uiDependents;
+		}
+	}
+
+	::LeaveCriticalSection(&csGraph);
+
+	return;
+}
+
+
+string CDependencyGraph::GetText()
+{
+	::EnterCriticalSection(&csGraph);
+
+	size_t i = 0;
+	size_t j = 0;
+	unsigned int uiRoots = 0;
+	unsigned int uiMissing = 0;
+	vector <const stDependencyNode *> vShared;
+	for (i = 0; i < vNodes.size(); i++)
+	{
+		if (vNodes[i].bRoot)
+			++uiRoots;
+		else if (vNodes[i].bMissing)
+			++uiMissing;
+		else if (vNodes[i].uiDependents > 1)
+			vShared.push_back(&vNodes[i]);
+	}
+	sort(vShared.begin(), vShared.end(), CompareDependents);
+
+	string sOut = utils.StrFormat("Root modules:               %u\n", uiRoots);
+	sOut += utils.StrFormat("Modules in graph:           %u\n", (unsigned int)vNodes.size());
+	sOut += utils.StrFormat("Import tables parsed:       %u\n", uiParsedFiles + uiRoots);
+	sOut += utils.StrFormat("Resolver cache hits:        %u\n", uiCacheHits);
+	sOut += utils.StrFormat("Missing modules:            %u\n", uiMissing);
+
+	if (uiMissing > 0)
+	{
+		sOut += "\nMissing modules (imported by -> required by roots):\n";
+		for (i = 0; i < vNodes.size(); i++)
+		{
+			if (!vNodes[i].bMissing || vNodes[i].bRoot)
+				continue;
+
+			sOut += utils.StrFormat("  %s\n", vNodes[i].sName.c_str());
+			for (j = 0; j < vNodes.size(); j++)
+			{
+				if (find(vNodes[j].vImports.begin(), vNodes[j].vImports.end(), i) != vNodes[j].vImports.end())
+					sOut += utils.StrFormat("    <- %s\n", (vNodes[j].sPath != "") ? vNodes[j].sPath.c_str() : vNodes[j].sName.c_str());
+			}
+
+			for (j = 0; j < vNodes.size(); j++)
+			{
+				if (!vNodes[j].bRoot)
+					continue;
+
+				vector <BOOL> vVisited(vNodes.size(), FALSE);
+				Reach(j, vVisited);
+				if (vVisited[i] && (find(vNodes[j].vImports.begin(), vNodes[j].vImports.end(), i) == vNodes[j].vImports.end()))
+					sOut += utils.StrFormat("    <= %s\n", vNodes[j].sPath.c_str());
+			}
+		}
+	}
+
+	if (vShared.size() > 0)
+	{
+		sOut += "\nShared modules (dependent roots, module, path):\n";
+		for (i = 0; i < vShared.size(); i++)
+		{
+			sOut += utils.StrFormat("%6u   %-32s %s\n", vShared[i]->uiDependents, vShared[i]->sName.c_str(),
+				vShared[i]->bVirtual ? "(resolved by the loader)" : vShared[i]->sPath.c_str());
+		}
+	}
+
+	::LeaveCriticalSection(&csGraph);
+
+	return sOut;
+}
+
+
+string CDependencyGraph::EscapeDOT(const string &s_string)
+{
+	string sOut = "";
+	for (size_t i = 0; i < s_string.length(); i++)
+	{
+		if ((s_string[i] == '\"') || (s_string[i] == '\\'))
+			sOut += '\\';
+		sOut += s_string[i];
+	}
+
+	return sOut;
+}
+
+
+string CDependencyGraph::GetDOT()
+{
+	::EnterCriticalSection(&csGraph);
+
+	string sOut = "digraph \"plugin dependencies\"\n{\n\trankdir=LR;\n\tnode [shape=box, fontname=\"Consolas\", fontsize=10];\n\n";
+	size_t i = 0;
+	size_t j = 0;
+	for (i = 0; i < vNodes.size(); i++)
+	{
+		sOut += utils.StrFormat("\tn%u [label=\"%s\"", (unsigned int)i, EscapeDOT(vNodes[i].sName).c_str());
+		if (vNodes[i].sPath != "")
+			sOut += utils.StrFormat(", tooltip=\"%s\"", EscapeDOT(vNodes[i].sPath).c_str());
+		if (vNodes[i].bRoot)
+			sOut += ", style=filled, fillcolor=\"#cfe2ff\"";
+		if (vNodes[i].bMissing)
+			sOut += ", color=red, fontcolor=red, style=dashed";
+		else if (vNodes[i].bVirtual)
+			sOut += ", color=gray, fontcolor=gray";
+		sOut += "];\n";
+	}
+
+	sOut += "\n";
+	for (i = 0; i < vNodes.size(); i++)
+	{
+		for (j = 0; j < vNodes[i].vImports.size(); j++)
+		{
+			sOut += utils.StrFormat("\tn%u -> n%u%s;\n", (unsigned int)i, (unsigned int)vNodes[i].vImports[j],
+				vNodes[vNodes[i].vImports[j]].bMissing ? " [color=red]" : "");
+		}
+	}
+
+	sOut += "}\n";
+
+	::LeaveCriticalSection(&csGraph);
+
+	return sOut;
+}
+
+
+#endif //_DEPENDENCYGRAPH_H
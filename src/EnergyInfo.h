@@ -0,0 +1,253 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_ENERGYINFO_H)
+#define _ENERGYINFO_H
+
+#include "common.h"
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+#define POWERCAP_DEFAULT_ROOT "/sys/class/powercap"
+
+
+class CEnergyInfo
+{
+public:
+	CEnergyInfo();
+	virtual ~CEnergyInfo();
+
+	BOOL   Init(string s_root);
+	void   Release();
+	void   Update();
+	double dPackageJoules;  //accumulated since Init()
+	double dDRAMJoules;
+	BOOL   bDRAM;
+	string sDomains;
+	string sError;
+	BOOL   bInitialized;
+
+private:
+	struct stDomain
+	{
+		string           sEnergyFile;
+		unsigned __int64 uiMaxRange;  //microjoules
+		unsigned __int64 uiPrev;
+		BOOL             bDRAM;
+	};
+
+	vector<stDomain> vDomains;
+
+#if !defined(_WIN32)
+	BOOL ReadValue(const string &s_file, unsigned __int64 &ui_value);
+	BOOL ReadName(const string &s_file, string &s_name);
+#endif
+};
+
+
+CEnergyInfo::CEnergyInfo()
+{
+	dPackageJoules = 0.0;
+	dDRAMJoules = 0.0;
+	bDRAM = FALSE;
+	sDomains = "";
+	sError = "";
+	bInitialized = FALSE;
+}
+
+CEnergyInfo::~CEnergyInfo()
+{
+	Release();
+}
+
+
+void CEnergyInfo::Release()
+{
+	vDomains.clear();
+	bInitialized = FALSE;
+
+	return;
+}
+
+
+#if defined(_WIN32)
+
+BOOL CEnergyInfo::Init(string)
+{
+	sError = "Energy counters are only supported on Linux (RAPL powercap)";
+
+	return FALSE;
+}
+
+
+void CEnergyInfo::Update()
+{
+	return;
+}
+
+#else //_WIN32
+
+BOOL CEnergyInfo::Init(string s_root)
+{
+	/*
+	Packages are <root>/intel-rapl:N named "package-N", their sub-zones
+	intel-rapl:N:M are only used if named "dram" since core/uncore are already
+	part of the package. Other top-level zones are skipped, "psys" (platform,
+	client CPUs) includes the packages and would count them twice.
+	*/
+	sError = "";
+	Release();
+	dPackageJoules = 0.0;
+	dDRAMJoules = 0.0;
+	bDRAM = FALSE;
+	sDomains = "";
+
+	if (s_root == "")
+		s_root = POWERCAP_DEFAULT_ROOT;
+
+	DIR *pDir = opendir(s_root.c_str());
+	if (!pDir)
+	{
+		sError = "Cannot open \"" + s_root + "\"";
+		return FALSE;
+	}
+
+	vector<string> vZones;
+	struct dirent *pEntry;
+	while ((pEntry = readdir(pDir)) != NULL)
+	{
+		string sName(pEntry->d_name);
+		if (sName.substr(0, 11) == "intel-rapl:")
+			vZones.push_back(sName);
+	}
+	closedir(pDir);
+	sort(vZones.begin(), vZones.end());
+
+	stDomain domain;
+	string sZoneName = "";
+	for (size_t i = 0; i < vZones.size(); i++)
+	{
+		BOOL bSubZone = (vZones[i].find(':', 11) != string::npos) ? TRUE : FALSE;
+		string sZone = s_root + "/" + vZones[i];
+
+		if (!ReadName(sZone + "/name", sZoneName))
+			continue;
+
+		if (bSubZone && (sZoneName != "dram"))
+			continue;
+
+		if (!bSubZone && (sZoneName.substr(0, 7) != "package"))
+			continue;
+
+		domain.sEnergyFile = sZone + "/energy_uj";
+		domain.bDRAM = bSubZone;
+		if (!ReadValue(sZone + "/max_energy_range_uj", domain.uiMaxRange) || !ReadValue(domain.sEnergyFile, domain.uiPrev))
+			continue;
+
+		if (domain.bDRAM)
+			bDRAM = TRUE;
+
+		vDomains.push_back(domain);
+		sDomains += (sDomains == "") ? sZoneName : ", " + sZoneName;
+	}
+
+	if (vDomains.size() == 0)
+	{
+		sError = "No readable RAPL domains found in \"" + s_root + "\"";
+		return FALSE;
+	}
+
+	bInitialized = TRUE;
+
+	return TRUE;
+}
+
+
+void CEnergyInfo::Update()
+{
+	unsigned __int64 uiValue = 0;
+	unsigned __int64 uiDelta = 0;
+
+	for (size_t i = 0; i < vDomains.size(); i++)
+	{
+		if (!ReadValue(vDomains[i].sEnergyFile, uiValue))
+			continue;
+
+		//the counter wraps at max_energy_range_uj
+		if (uiValue >= vDomains[i].uiPrev)
+			uiDelta = uiValue - vDomains[i].uiPrev;
+		else
+			uiDelta = (vDomains[i].uiMaxRange - vDomains[i].uiPrev) + uiValue;
+
+		vDomains[i].uiPrev = uiValue;
+
+		if (vDomains[i].bDRAM)
+			dDRAMJoules += (double)uiDelta / 1.0e+6;
+		else
+			dPackageJoules += (double)uiDelta / 1.0e+6;
+	}
+
+	return;
+}
+
+
+BOOL CEnergyInfo::ReadValue(const string &s_file, unsigned __int64 &ui_value)
+{
+	char szBuf[32];
+	FILE *pFile = fopen(s_file.c_str(), "r");
+	if (!pFile)
+		return FALSE;
+
+	BOOL bRet = (fgets(szBuf, sizeof(szBuf), pFile) != NULL) ? TRUE : FALSE;
+	fclose(pFile);
+
+	if (bRet)
+		ui_value = (unsigned __int64)strtoull(szBuf, NULL, 10);
+
+	return bRet;
+}
+
+
+BOOL CEnergyInfo::ReadName(const string &s_file, string &s_name)
+{
+	char szBuf[64];
+	FILE *pFile = fopen(s_file.c_str(), "r");
+	if (!pFile)
+		return FALSE;
+
+	BOOL bRet = (fgets(szBuf, sizeof(szBuf), pFile) != NULL) ? TRUE : FALSE;
+	fclose(pFile);
+
+	if (!bRet)
+		return FALSE;
+
+	s_name = szBuf;
+	s_name.erase(s_name.find_last_not_of(" \t\n\r") + 1);
+
+	return TRUE;
+}
+
+#endif //_WIN32
+
+
+#endif //_ENERGYINFO_H
@@ -0,0 +1,1616 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_FRAMESERVER_H)
+#define _FRAMESERVER_H
+
+#include "common.h"
+#include "exception.h"
+#include "Utility.h"
+#include "Timer.h"
+#include "avs_headers/avisynth.h"
+#include "SyntheticClip.h"
+
+extern const AVS_Linkage *AVS_linkage;
+
+
+/*
+	The clip serving part of a measurement: load the frame server library,
+	create the environment, import the script, query the clip properties,
+	fetch frames and tear everything down again.
+	Errors after Load() are thrown as AvisynthError (or whatever the frame
+	server throws itself), the caller reports them like avisynth errors.
+	The clip properties are returned in a neutral stClipInfo so that the
+	console output, the log, CSV and JSON files are the same for all frame
+	servers.
+*/
+#define CLIP_CF_OTHER  0          //packed (YUY2, RGB24, ...) or unknown
+#define CLIP_CF_GRAY   1
+#define CLIP_CF_YUV    2
+#define CLIP_CF_RGB    3          //planar RGB
+
+struct stClipInfo
+{
+	BOOL         bHasVideo;
+	BOOL         bHasAudio;
+	unsigned int uiFrames;
+	unsigned int uiWidth;
+	unsigned int uiHeight;
+	unsigned int uiFPSNumerator;
+	unsigned int uiFPSDenominator;
+	BOOL         bFieldBased;
+	BOOL         bTFF;
+	BOOL         bBFF;
+	string       sColorspace;         //right-aligned to 10 characters
+	int          iColorFamily;        //CLIP_CF_*
+	int          iBitsPerComponent;   //32: float
+	int          iSubSamplingW;       //log2 of the chroma subsampling
+	int          iSubSamplingH;
+	__int64      iFrameBytes;         //size of one output frame
+	int          iAudioChannels;
+	int          iAudioSampleType;    //avisynth SAMPLE_* value, 0: none
+	int          iAudioSampleRate;
+	__int64      iAudioSamples;
+};
+
+
+//One served frame, rows are iPitch bytes apart (negative for bottom-up frames)
+#define FRAME_MAX_PLANES 4
+
+struct stFramePlanes
+{
+	int          iPlanes;
+	const BYTE   *pData[FRAME_MAX_PLANES];
+	int          iPitch[FRAME_MAX_PLANES];
+	int          iRowSize[FRAME_MAX_PLANES];   //bytes
+	int          iHeight[FRAME_MAX_PLANES];
+};
+
+
+class CFrameServer
+{
+public:
+	CFrameServer();
+	virtual ~CFrameServer() {}
+
+	static BOOL          IsVapourSynthScript(string &s_script);
+	static CFrameServer* Create(string &s_script, int i_avsinterfaceversion, BOOL b_avscapi);
+
+	virtual BOOL      Load(string s_dll) = 0;   //FALSE: sError is set
+	virtual void      CreateEnvironment() = 0;
+	virtual void      Import(string &s_script) = 0;
+	virtual void      InvokeDistributor() {}    //SET MT only, sets iMTMode and dDistributorMS
+	virtual void      GetClipInfo(stClipInfo &clipinfo) = 0;
+	virtual void      SetFrameRange(unsigned int ui_first, unsigned int ui_last) {}
+	virtual void      GetFrame(unsigned int ui_frame) = 0;
+	virtual void      GetFramePlanes(unsigned int ui_frame, stFramePlanes &planes);
+	virtual void      Release() = 0;            //clip, environment and frame requests still in flight
+	virtual BOOL      Unload() = 0;
+
+	void   ThrowError(string s_error);
+
+	string sName;
+	string sVersion;
+	string sDLLPath;
+	BOOL   bInvokeDistributor;
+	int    iMTMode;                 //-1: not a SET MT version
+	double dDistributorMS;          //-1.0 if not invoked
+	DWORD  dwDeleteDelay;           //ms to wait before the environment is deleted
+	unsigned int uiHeldFrames;      //frames kept referenced after GetFramePlanes(), besides the current one
+	string sError;
+
+protected:
+	void   ClearClipInfo(stClipInfo &clipinfo);
+
+	CUtils utils;
+	CTimer timer;
+
+private:
+	string sThrownError;            //AvisynthError only keeps the pointer
+};
+
+
+CFrameServer::CFrameServer()
+{
+	sName = "";
+	sVersion = "";
+	sDLLPath = "";
+	bInvokeDistributor = TRUE;
+	iMTMode = -1;
+	dDistributorMS = -1.0;
+	dwDeleteDelay = 0;
+	uiHeldFrames = 0;
+	sError = "";
+	sThrownError = "";
+}
+
+
+void CFrameServer::GetFramePlanes(unsigned int ui_frame, stFramePlanes &planes)
+{
+	ThrowError(sName + " does not expose the frame data");
+}
+
+
+void CFrameServer::ThrowError(string s_error)
+{
+	sThrownError = s_error;
+	throw AvisynthError(sThrownError.c_str());
+}
+
+
+void CFrameServer::ClearClipInfo(stClipInfo &clipinfo)
+{
+	clipinfo.bHasVideo = FALSE;
+	clipinfo.bHasAudio = FALSE;
+	clipinfo.uiFrames = 0;
+	clipinfo.uiWidth = 0;
+	clipinfo.uiHeight = 0;
+	clipinfo.uiFPSNumerator = 0;
+	clipinfo.uiFPSDenominator = 1;
+	clipinfo.bFieldBased = FALSE;
+	clipinfo.bTFF = FALSE;
+	clipinfo.bBFF = FALSE;
+	clipinfo.sColorspace = "       n/a";
+	clipinfo.iColorFamily = CLIP_CF_OTHER;
+	clipinfo.iBitsPerComponent = 8;
+	clipinfo.iSubSamplingW = 0;
+	clipinfo.iSubSamplingH = 0;
+	clipinfo.iFrameBytes = 0;
+	clipinfo.iAudioChannels = 0;
+	clipinfo.iAudioSampleType = 0;
+	clipinfo.iAudioSampleRate = 0;
+	clipinfo.iAudioSamples = 0;
+
+	return;
+}
+
+
+
+/*
+	Avisynth through the C++ ABI (avisynth.dll / libavisynth.so).
+*/
+class CFrameServerAvisynth : public CFrameServer
+{
+public:
+	CFrameServerAvisynth(int i_interfaceversion);
+	virtual ~CFrameServerAvisynth();
+
+	BOOL      Load(string s_dll);
+	void      CreateEnvironment();
+	void      Import(string &s_script);
+	void      InvokeDistributor();
+	void      GetClipInfo(stClipInfo &clipinfo);
+	void      GetFrame(unsigned int ui_frame);
+	void      GetFramePlanes(unsigned int ui_frame, stFramePlanes &planes);
+	void      Release();
+	BOOL      Unload();
+
+	static string GetColorspaceName(int i_pixeltype);
+
+private:
+	typedef IScriptEnvironment * __stdcall CREATE_ENV(int);
+
+	HINSTANCE           hDLL;
+	CREATE_ENV          *CreateEnv;
+	int                 iInterfaceVersion;
+	IScriptEnvironment  *AVS_env;
+	AVSValue            AVS_main;
+	PClip               AVS_clip;
+	deque<PVideoFrame>  dHeldFrames;
+};
+
+
+CFrameServerAvisynth::CFrameServerAvisynth(int i_interfaceversion)
+{
+	sName = "Avisynth";
+	hDLL = NULL;
+	CreateEnv = NULL;
+	iInterfaceVersion = i_interfaceversion;
+	AVS_env = 0;
+}
+
+CFrameServerAvisynth::~CFrameServerAvisynth()
+{
+	Unload();
+}
+
+
+BOOL CFrameServerAvisynth::Load(string s_dll)
+{
+	sError = "";
+
+	if (s_dll == "")
+		hDLL = ::LoadLibrary("avisynth");
+	else
+		hDLL = ::LoadLibrary(s_dll.c_str());
+
+	if (!hDLL)
+	{
+		sError = "Cannot load avisynth.dll:\n" + utils.LibraryErrorMessage();
+		return FALSE;
+	}
+
+	CreateEnv = (CREATE_ENV *)::GetProcAddress(hDLL, "CreateScriptEnvironment");
+	if (!CreateEnv)
+	{
+		sError = "Failed to load CreateScriptEnvironment()";
+		Unload();
+		return FALSE;
+	}
+
+	char szPath[MAX_PATH + 1];
+	if (::GetModuleFileName(hDLL, szPath, MAX_PATH))
+		sDLLPath = szPath;
+
+	return TRUE;
+}
+
+
+void CFrameServerAvisynth::CreateEnvironment()
+{
+	AVS_env = CreateEnv(iInterfaceVersion);
+	if (!AVS_env)
+		ThrowError("Could not create IScriptenvironment");
+
+	AVS_linkage = AVS_env->GetAVSLinkage();
+
+	return;
+}
+
+
+void CFrameServerAvisynth::Import(string &s_script)
+{
+	AVS_main = CSyntheticClip::ImportScript(AVS_env, s_script);
+
+	if (!AVS_main.IsClip())
+		AVS_env->ThrowError("\"%s\":\nScript did not return a clip", s_script.c_str());
+
+	AVS_clip = AVS_main.AsClip();
+
+	return;
+}
+
+
+void CFrameServerAvisynth::InvokeDistributor()
+{
+	try
+	{
+		AVSValue AVS_temp = AVS_env->Invoke("GetMTMode", false);
+		iMTMode = AVS_temp.IsInt() ? AVS_temp.AsInt() : 0;
+		if ((iMTMode > 0) && (iMTMode < 5) && bInvokeDistributor)
+		{
+			double dStart = timer.GetTimer();
+			AVS_main = AVS_env->Invoke("Distributor", AVS_main);
+			AVS_clip = AVS_main.AsClip();
+			dDistributorMS = (timer.GetTimer() - dStart) * 1000.0;
+		}
+	}
+	catch (IScriptEnvironment::NotFound)
+	{
+		iMTMode = -1;
+	}
+
+	return;
+}
+
+
+void CFrameServerAvisynth::GetClipInfo(stClipInfo &clipinfo)
+{
+	VideoInfo AVS_vidinfo = AVS_clip->GetVideoInfo();
+
+	ClearClipInfo(clipinfo);
+	clipinfo.bHasVideo = AVS_vidinfo.HasVideo() ? TRUE : FALSE;
+	clipinfo.bHasAudio = AVS_vidinfo.HasAudio() ? TRUE : FALSE;
+
+	if (clipinfo.bHasVideo)
+	{
+		clipinfo.uiFrames = (unsigned int)AVS_vidinfo.num_frames;
+		clipinfo.uiWidth = (unsigned int)AVS_vidinfo.width;
+		clipinfo.uiHeight = (unsigned int)AVS_vidinfo.height;
+		clipinfo.uiFPSNumerator = AVS_vidinfo.fps_numerator;
+		clipinfo.uiFPSDenominator = AVS_vidinfo.fps_denominator;
+		clipinfo.bFieldBased = AVS_vidinfo.IsFieldBased() ? TRUE : FALSE;
+		clipinfo.bTFF = AVS_vidinfo.IsTFF() ? TRUE : FALSE;
+		clipinfo.bBFF = AVS_vidinfo.IsBFF() ? TRUE : FALSE;
+		clipinfo.sColorspace = GetColorspaceName(AVS_vidinfo.pixel_type);
+		clipinfo.iBitsPerComponent = AVS_vidinfo.BitsPerComponent();
+		clipinfo.iFrameBytes = AVS_vidinfo.BMPSize();
+
+		if (AVS_vidinfo.IsY())
+			clipinfo.iColorFamily = CLIP_CF_GRAY;
+		else if (AVS_vidinfo.IsPlanarRGB() || AVS_vidinfo.IsPlanarRGBA())
+			clipinfo.iColorFamily = CLIP_CF_RGB;
+		else if (AVS_vidinfo.IsYUV() && AVS_vidinfo.IsPlanar())
+		{
+			clipinfo.iColorFamily = CLIP_CF_YUV;
+			clipinfo.iSubSamplingW = AVS_vidinfo.GetPlaneWidthSubsampling(PLANAR_U);
+			clipinfo.iSubSamplingH = AVS_vidinfo.GetPlaneHeightSubsampling(PLANAR_U);
+		}
+	}
+
+	clipinfo.iAudioChannels = AVS_vidinfo.nchannels;
+	clipinfo.iAudioSampleType = AVS_vidinfo.sample_type;
+	clipinfo.iAudioSampleRate = AVS_vidinfo.audio_samples_per_second;
+	clipinfo.iAudioSamples = AVS_vidinfo.num_audio_samples;
+
+	return;
+}
+
+
+string CFrameServerAvisynth::GetColorspaceName(int i_pixeltype)
+{
+	switch (i_pixeltype)
+	{
+		case VideoInfo::CS_YV411:       return "     YV411";
+		case VideoInfo::CS_YV24:        return "      YV24";
+		case VideoInfo::CS_YV16:        return "      YV16";
+		case VideoInfo::CS_Y8:          return "        Y8";
+		case VideoInfo::CS_YV12:        return "      YV12";
+		case VideoInfo::CS_I420:        return "      i420";
+		case VideoInfo::CS_YUY2:        return "      YUY2";
+		case VideoInfo::CS_BGR24:       return "     RGB24";
+		case VideoInfo::CS_BGR32:       return "     RGB32";
+		case VideoInfo::CS_YUV444P16:   return " YUV444P16";
+		case VideoInfo::CS_YUV422P16:   return " YUV422P16";
+		case VideoInfo::CS_YUV420P16:   return " YUV420P16";
+		case VideoInfo::CS_YUV444PS:    return "  YUV444PS";
+		case VideoInfo::CS_YUV422PS:    return "  YUV422PS";
+		case VideoInfo::CS_YUV420PS:    return "  YUV420PS";
+		case VideoInfo::CS_Y16:         return "       Y16";
+		case VideoInfo::CS_Y32:         return "       Y32";
+		case VideoInfo::CS_YUV444P10:   return " YUV444P10";
+		case VideoInfo::CS_YUV422P10:   return " YUV422P10";
+		case VideoInfo::CS_YUV420P10:   return " YUV420P10";
+		case VideoInfo::CS_Y10:         return "       Y10";
+		case VideoInfo::CS_YUV444P12:   return " YUV444P12";
+		case VideoInfo::CS_YUV422P12:   return " YUV422P12";
+		case VideoInfo::CS_YUV420P12:   return " YUV420P12";
+		case VideoInfo::CS_Y12:         return "       Y12";
+		case VideoInfo::CS_YUV444P14:   return " YUV444P14";
+		case VideoInfo::CS_YUV422P14:   return " YUV422P14";
+		case VideoInfo::CS_YUV420P14:   return " YUV420P14";
+		case VideoInfo::CS_Y14:         return "       Y14";
+		case VideoInfo::CS_BGR48:       return "     BGR48";
+		case VideoInfo::CS_BGR64:       return "     BGR64";
+		case VideoInfo::CS_RGBP:        return "      RGBP";
+		case VideoInfo::CS_RGBP10:      return "    RGBP10";
+		case VideoInfo::CS_RGBP12:      return "    RGBP12";
+		case VideoInfo::CS_RGBP14:      return "    RGBP14";
+		case VideoInfo::CS_RGBP16:      return "    RGBP16";
+		case VideoInfo::CS_RGBPS:       return "     RGBPS";
+		case VideoInfo::CS_RGBAP:       return "     RGBAP";
+		case VideoInfo::CS_RGBAP10:     return "   RGBAP10";
+		case VideoInfo::CS_RGBAP12:     return "   RGBAP12";
+		case VideoInfo::CS_RGBAP14:     return "   RGBAP14";
+		case VideoInfo::CS_RGBAP16:     return "   RGBAP16";
+		case VideoInfo::CS_RGBAPS:      return "    RGBAPS";
+		case VideoInfo::CS_YUVA444:     return "   YUVA444";
+		case VideoInfo::CS_YUVA422:     return "   YUVA422";
+		case VideoInfo::CS_YUVA420:     return "   YUVA420";
+		case VideoInfo::CS_YUVA444P10:  return "YUVA444P10";
+		case VideoInfo::CS_YUVA422P10:  return "YUVA422P10";
+		case VideoInfo::CS_YUVA420P10:  return "YUVA420P10";
+		case VideoInfo::CS_YUVA444P12:  return "YUVA444P12";
+		case VideoInfo::CS_YUVA422P12:  return "YUVA422P12";
+		case VideoInfo::CS_YUVA420P12:  return "YUVA420P12";
+		case VideoInfo::CS_YUVA444P14:  return "YUVA444P14";
+		case VideoInfo::CS_YUVA422P14:  return "YUVA422P14";
+		case VideoInfo::CS_YUVA420P14:  return "YUVA420P14";
+		case VideoInfo::CS_YUVA444P16:  return "YUVA444P16";
+		case VideoInfo::CS_YUVA422P16:  return "YUVA422P16";
+		case VideoInfo::CS_YUVA420P16:  return "YUVA420P16";
+		case VideoInfo::CS_YUVA444PS:   return " YUVA444PS";
+		case VideoInfo::CS_YUVA422PS:   return " YUVA422PS";
+		case VideoInfo::CS_YUVA420PS:   return " YUVA420PS";
+		case VideoInfo::CS_RAW32:       return "     RAW32";
+		case VideoInfo::CS_YUV9:        return "      YUV9";
+		default:                        return "   Unknown";
+	}
+}
+
+
+void CFrameServerAvisynth::GetFrame(unsigned int ui_frame)
+{
+	PVideoFrame src_frame = AVS_clip->GetFrame((int)ui_frame, AVS_env);
+
+	return;
+}
+
+
+void CFrameServerAvisynth::GetFramePlanes(unsigned int ui_frame, stFramePlanes &planes)
+{
+	PVideoFrame src_frame = AVS_clip->GetFrame((int)ui_frame, AVS_env);
+	const VideoInfo &AVS_vidinfo = AVS_clip->GetVideoInfo();
+
+	static const int iPlanesYUV[] = {PLANAR_Y, PLANAR_U, PLANAR_V, PLANAR_A};
+	static const int iPlanesRGB[] = {PLANAR_G, PLANAR_B, PLANAR_R, PLANAR_A};
+	const int *pPlaneIDs = iPlanesYUV;
+
+	if (!AVS_vidinfo.IsPlanar())
+		planes.iPlanes = 1;
+	else if (AVS_vidinfo.IsY())
+		planes.iPlanes = 1;
+	else if (AVS_vidinfo.IsPlanarRGB() || AVS_vidinfo.IsPlanarRGBA())
+	{
+		pPlaneIDs = iPlanesRGB;
+		planes.iPlanes = AVS_vidinfo.IsPlanarRGBA() ? 4 : 3;
+	}
+	else
+		planes.iPlanes = AVS_vidinfo.IsYUVA() ? 4 : 3;
+
+	for (int iPlane = 0; iPlane < planes.iPlanes; iPlane++)
+	{
+		int iPlaneID = (planes.iPlanes > 1) ? pPlaneIDs[iPlane] : 0;
+		planes.pData[iPlane] = src_frame->GetReadPtr(iPlaneID);
+		planes.iPitch[iPlane] = src_frame->GetPitch(iPlaneID);
+		planes.iRowSize[iPlane] = src_frame->GetRowSize(iPlaneID);
+		planes.iHeight[iPlane] = src_frame->GetHeight(iPlaneID);
+	}
+
+	//packed RGB is stored bottom-up
+	if (AVS_vidinfo.IsRGB() && !AVS_vidinfo.IsPlanar())
+	{
+		planes.pData[0] += (__int64)(planes.iHeight[0] - 1) * planes.iPitch[0];
+		planes.iPitch[0] = -planes.iPitch[0];
+	}
+
+	dHeldFrames.push_back(src_frame);
+	while (dHeldFrames.size() > uiHeldFrames + 1)
+		dHeldFrames.pop_front();
+
+	return;
+}
+
+
+void CFrameServerAvisynth::Release()
+{
+	//another environment may have reset the linkage ("-compare" runs two), the frames and clips below need it
+	if (AVS_env)
+		AVS_linkage = AVS_env->GetAVSLinkage();
+
+	dHeldFrames.clear();
+	AVS_clip = 0;
+	AVS_main = 0;
+
+	if (AVS_env)
+	{
+		if (dwDeleteDelay > 0)
+			Sleep(dwDeleteDelay);
+		AVS_env->DeleteScriptEnvironment();
+	}
+
+	AVS_env = 0;
+	AVS_linkage = 0;
+
+	return;
+}
+
+
+BOOL CFrameServerAvisynth::Unload()
+{
+	//the environment is abandoned, not deleted, when a measurement failed
+	dHeldFrames.clear();
+	AVS_clip = 0;
+	AVS_main = 0;
+	AVS_env = 0;
+	AVS_linkage = 0;
+	CreateEnv = NULL;
+
+	BOOL bRet = TRUE;
+	if (hDLL)
+		bRet = ::FreeLibrary(hDLL);
+
+	hDLL = NULL;
+
+	return bRet;
+}
+
+
+/*
+	Avisynth through the C API (avs_create_script_environment(), avs_invoke(),
+	avs_get_frame()), the way ffmpeg, mpv and other C consumers use it. Every
+	frame is released right after avs_get_frame() returns, like the C++
+	backend drops its PVideoFrame.
+	avisynth_c.h is not part of avs_headers, the few declarations needed are
+	below. AVS_Value has the 2.6 layout, AVS+ keeps it on 32 bit by storing
+	its 64 bit types as pointers there.
+*/
+struct AVS_C_Clip;
+struct AVS_C_VideoFrame;
+struct AVS_C_ScriptEnvironment;
+
+struct AVS_C_Value
+{
+	short type;               //'a'rray, 'c'lip, 'b'ool, 'i'nt, 'f'loat, 's'tring, 'v'oid, 'e'rror
+	short array_size;
+	union
+	{
+		void *clip;
+		char boolean;
+		int integer;
+		float floating_pt;
+		const char *string;
+		const AVS_C_Value *array;
+		void *function;
+	} d;
+};
+
+struct AVS_C_VideoInfo
+{
+	int      width;
+	int      height;
+	unsigned fps_numerator;
+	unsigned fps_denominator;
+	int      num_frames;
+	int      pixel_type;
+	int      audio_samples_per_second;
+	int      sample_type;
+	__int64  num_audio_samples;
+	int      nchannels;
+	int      image_type;
+};
+
+
+class CFrameServerAvisynthC : public CFrameServer
+{
+public:
+	CFrameServerAvisynthC(int i_interfaceversion);
+	virtual ~CFrameServerAvisynthC();
+
+	BOOL      Load(string s_dll);
+	void      CreateEnvironment();
+	void      Import(string &s_script);
+	void      InvokeDistributor();
+	void      GetClipInfo(stClipInfo &clipinfo);
+	void      GetFrame(unsigned int ui_frame);
+	void      Release();
+	BOOL      Unload();
+
+private:
+	typedef AVS_C_ScriptEnvironment * (AVSC_CC AVS_CREATE_SCRIPT_ENVIRONMENT)(int version);
+	typedef const char *              (AVSC_CC AVS_GET_ERROR)(AVS_C_ScriptEnvironment *env);
+	typedef void                      (AVSC_CC AVS_DELETE_SCRIPT_ENVIRONMENT)(AVS_C_ScriptEnvironment *env);
+	typedef AVS_C_Value               (AVSC_CC AVS_INVOKE)(AVS_C_ScriptEnvironment *env, const char *name, AVS_C_Value args, const char **arg_names);
+	typedef int                       (AVSC_CC AVS_FUNCTION_EXISTS)(AVS_C_ScriptEnvironment *env, const char *name);
+	typedef AVS_C_Clip *              (AVSC_CC AVS_TAKE_CLIP)(AVS_C_Value value, AVS_C_ScriptEnvironment *env);
+	typedef void                      (AVSC_CC AVS_SET_TO_CLIP)(AVS_C_Value *value, AVS_C_Clip *clip);
+	typedef void                      (AVSC_CC AVS_RELEASE_CLIP)(AVS_C_Clip *clip);
+	typedef void                      (AVSC_CC AVS_RELEASE_VALUE)(AVS_C_Value value);
+	typedef const AVS_C_VideoInfo *   (AVSC_CC AVS_GET_VIDEO_INFO)(AVS_C_Clip *clip);
+	typedef AVS_C_VideoFrame *        (AVSC_CC AVS_GET_FRAME)(AVS_C_Clip *clip, int n);
+	typedef const char *              (AVSC_CC AVS_CLIP_GET_ERROR)(AVS_C_Clip *clip);
+	typedef void                      (AVSC_CC AVS_RELEASE_VIDEO_FRAME)(AVS_C_VideoFrame *frame);
+	typedef int                       (AVSC_CC AVS_BITS_PER_PIXEL)(const AVS_C_VideoInfo *vi);
+
+	void   TakeClip(AVS_C_Value value);
+
+	HINSTANCE                      hDLL;
+	int                            iInterfaceVersion;
+	AVS_CREATE_SCRIPT_ENVIRONMENT  *avs_create_script_environment;
+	AVS_GET_ERROR                  *avs_get_error;
+	AVS_DELETE_SCRIPT_ENVIRONMENT  *avs_delete_script_environment;
+	AVS_INVOKE                     *avs_invoke;
+	AVS_FUNCTION_EXISTS            *avs_function_exists;
+	AVS_TAKE_CLIP                  *avs_take_clip;
+	AVS_SET_TO_CLIP                *avs_set_to_clip;
+	AVS_RELEASE_CLIP               *avs_release_clip;
+	AVS_RELEASE_VALUE              *avs_release_value;
+	AVS_GET_VIDEO_INFO             *avs_get_video_info;
+	AVS_GET_FRAME                  *avs_get_frame;
+	AVS_CLIP_GET_ERROR             *avs_clip_get_error;
+	AVS_RELEASE_VIDEO_FRAME        *avs_release_video_frame;
+	AVS_BITS_PER_PIXEL             *avs_bits_per_pixel;  //AVS+ only, exported as a function
+	AVS_C_ScriptEnvironment        *AVS_env;
+	AVS_C_Clip                     *AVS_clip;
+};
+
+
+CFrameServerAvisynthC::CFrameServerAvisynthC(int i_interfaceversion)
+{
+	sName = "Avisynth (C API)";
+	hDLL = NULL;
+	iInterfaceVersion = i_interfaceversion;
+	avs_create_script_environment = NULL;
+	avs_get_error = NULL;
+	avs_delete_script_environment = NULL;
+	avs_invoke = NULL;
+	avs_function_exists = NULL;
+	avs_take_clip = NULL;
+	avs_set_to_clip = NULL;
+	avs_release_clip = NULL;
+	avs_release_value = NULL;
+	avs_get_video_info = NULL;
+	avs_get_frame = NULL;
+	avs_clip_get_error = NULL;
+	avs_release_video_frame = NULL;
+	avs_bits_per_pixel = NULL;
+	AVS_env = NULL;
+	AVS_clip = NULL;
+}
+
+CFrameServerAvisynthC::~CFrameServerAvisynthC()
+{
+	Unload();
+}
+
+
+BOOL CFrameServerAvisynthC::Load(string s_dll)
+{
+	sError = "";
+
+	if (s_dll == "")
+		hDLL = ::LoadLibrary("avisynth");
+	else
+		hDLL = ::LoadLibrary(s_dll.c_str());
+
+	if (!hDLL)
+	{
+		sError = "Cannot load avisynth.dll:\n" + utils.LibraryErrorMessage();
+		return FALSE;
+	}
+
+	avs_create_script_environment = (AVS_CREATE_SCRIPT_ENVIRONMENT *)::GetProcAddress(hDLL, "avs_create_script_environment");
+	avs_get_error = (AVS_GET_ERROR *)::GetProcAddress(hDLL, "avs_get_error");
+	avs_delete_script_environment = (AVS_DELETE_SCRIPT_ENVIRONMENT *)::GetProcAddress(hDLL, "avs_delete_script_environment");
+	avs_invoke = (AVS_INVOKE *)::GetProcAddress(hDLL, "avs_invoke");
+	avs_function_exists = (AVS_FUNCTION_EXISTS *)::GetProcAddress(hDLL, "avs_function_exists");
+	avs_take_clip = (AVS_TAKE_CLIP *)::GetProcAddress(hDLL, "avs_take_clip");
+	avs_set_to_clip = (AVS_SET_TO_CLIP *)::GetProcAddress(hDLL, "avs_set_to_clip");
+	avs_release_clip = (AVS_RELEASE_CLIP *)::GetProcAddress(hDLL, "avs_release_clip");
+	avs_release_value = (AVS_RELEASE_VALUE *)::GetProcAddress(hDLL, "avs_release_value");
+	avs_get_video_info = (AVS_GET_VIDEO_INFO *)::GetProcAddress(hDLL, "avs_get_video_info");
+	avs_get_frame = (AVS_GET_FRAME *)::GetProcAddress(hDLL, "avs_get_frame");
+	avs_clip_get_error = (AVS_CLIP_GET_ERROR *)::GetProcAddress(hDLL, "avs_clip_get_error");
+	avs_release_video_frame = (AVS_RELEASE_VIDEO_FRAME *)::GetProcAddress(hDLL, "avs_release_video_frame");
+	avs_bits_per_pixel = (AVS_BITS_PER_PIXEL *)::GetProcAddress(hDLL, "avs_bits_per_pixel");
+
+	if (!avs_create_script_environment || !avs_get_error || !avs_delete_script_environment || !avs_invoke || !avs_function_exists || !avs_take_clip ||
+		!avs_set_to_clip || !avs_release_clip || !avs_release_value || !avs_get_video_info || !avs_get_frame || !avs_clip_get_error || !avs_release_video_frame)
+	{
+		sError = "avisynth.dll does not export the C API";
+		Unload();
+		return FALSE;
+	}
+
+	char szPath[MAX_PATH + 1];
+	if (::GetModuleFileName(hDLL, szPath, MAX_PATH))
+		sDLLPath = szPath;
+
+	return TRUE;
+}
+
+
+void CFrameServerAvisynthC::CreateEnvironment()
+{
+	AVS_env = avs_create_script_environment(iInterfaceVersion);
+	if (!AVS_env)
+		ThrowError("Could not create the C API script environment");
+
+	const char *pszError = avs_get_error(AVS_env);
+	if (pszError)
+		ThrowError(utils.StrFormat("Could not create the C API script environment:\n%s", pszError));
+
+	return;
+}
+
+
+void CFrameServerAvisynthC::TakeClip(AVS_C_Value value)
+{
+	AVS_C_Clip *pClip = avs_take_clip(value, AVS_env);
+	if (AVS_clip)
+		avs_release_clip(AVS_clip);
+	AVS_clip = pClip;
+
+	return;
+}
+
+
+void CFrameServerAvisynthC::Import(string &s_script)
+{
+	if (CSyntheticSource::IsSyntheticSpec(s_script))
+		ThrowError(utils.StrFormat("\"%s\":\nSynthetic clips are C++ filters and cannot be served through the C API", s_script.c_str()));
+
+	AVS_C_Value arg;
+	arg.type = 's';
+	arg.array_size = 1;
+	arg.d.string = s_script.c_str();
+
+	AVS_C_Value ret = avs_invoke(AVS_env, "Import", arg, NULL);
+	if (ret.type == 'e')
+	{
+		string sInvokeError = ret.d.string ? ret.d.string : "Import failed";
+		avs_release_value(ret);
+		ThrowError(sInvokeError);
+	}
+
+	if (ret.type != 'c')
+	{
+		avs_release_value(ret);
+		ThrowError(utils.StrFormat("\"%s\":\nScript did not return a clip", s_script.c_str()));
+	}
+
+	TakeClip(ret);
+	avs_release_value(ret);
+
+	return;
+}
+
+
+void CFrameServerAvisynthC::InvokeDistributor()
+{
+	if (!avs_function_exists(AVS_env, "GetMTMode"))
+	{
+		iMTMode = -1;
+		return;
+	}
+
+	AVS_C_Value arg;
+	arg.type = 'b';
+	arg.array_size = 1;
+	arg.d.boolean = 0;
+
+	AVS_C_Value ret = avs_invoke(AVS_env, "GetMTMode", arg, NULL);
+	iMTMode = (ret.type == 'i') ? ret.d.integer : 0;
+	avs_release_value(ret);
+
+	if ((iMTMode > 0) && (iMTMode < 5) && bInvokeDistributor)
+	{
+		double dStart = timer.GetTimer();
+
+		AVS_C_Value clip;
+		avs_set_to_clip(&clip, AVS_clip);
+		ret = avs_invoke(AVS_env, "Distributor", clip, NULL);
+		avs_release_value(clip);
+
+		if (ret.type == 'c')
+			TakeClip(ret);
+		avs_release_value(ret);
+
+		dDistributorMS = (timer.GetTimer() - dStart) * 1000.0;
+	}
+
+	return;
+}
+
+
+void CFrameServerAvisynthC::GetClipInfo(stClipInfo &clipinfo)
+{
+	const AVS_C_VideoInfo *vi = avs_get_video_info(AVS_clip);
+
+	ClearClipInfo(clipinfo);
+	clipinfo.bHasVideo = (vi->width != 0) ? TRUE : FALSE;
+	clipinfo.bHasAudio = (vi->audio_samples_per_second != 0) ? TRUE : FALSE;
+
+	if (clipinfo.bHasVideo)
+	{
+		clipinfo.uiFrames = (unsigned int)vi->num_frames;
+		clipinfo.uiWidth = (unsigned int)vi->width;
+		clipinfo.uiHeight = (unsigned int)vi->height;
+		clipinfo.uiFPSNumerator = vi->fps_numerator;
+		clipinfo.uiFPSDenominator = vi->fps_denominator;
+		clipinfo.bFieldBased = (vi->image_type & VideoInfo::IT_FIELDBASED) ? TRUE : FALSE;
+		clipinfo.bTFF = (vi->image_type & VideoInfo::IT_TFF) ? TRUE : FALSE;
+		clipinfo.bBFF = (vi->image_type & VideoInfo::IT_BFF) ? TRUE : FALSE;
+		clipinfo.sColorspace = CFrameServerAvisynth::GetColorspaceName(vi->pixel_type);
+
+		//BMPSize() has no C API counterpart, DWORD aligned rows of the average bit depth
+		if (avs_bits_per_pixel)
+			clipinfo.iFrameBytes = (__int64)vi->height * (((vi->width * avs_bits_per_pixel(vi) >> 3) + 3) & ~3);
+	}
+
+	clipinfo.iAudioChannels = vi->nchannels;
+	clipinfo.iAudioSampleType = vi->sample_type;
+	clipinfo.iAudioSampleRate = vi->audio_samples_per_second;
+	clipinfo.iAudioSamples = vi->num_audio_samples;
+
+	return;
+}
+
+
+void CFrameServerAvisynthC::GetFrame(unsigned int ui_frame)
+{
+	AVS_C_VideoFrame *src_frame = avs_get_frame(AVS_clip, (int)ui_frame);
+	if (!src_frame)
+	{
+		const char *pszError = avs_clip_get_error(AVS_clip);
+		ThrowError(pszError ? pszError : utils.StrFormat("avs_get_frame() failed on frame %u", ui_frame));
+	}
+
+	avs_release_video_frame(src_frame);
+
+	return;
+}
+
+
+void CFrameServerAvisynthC::Release()
+{
+	if (AVS_clip)
+		avs_release_clip(AVS_clip);
+	AVS_clip = NULL;
+
+	if (AVS_env)
+	{
+		if (dwDeleteDelay > 0)
+			Sleep(dwDeleteDelay);
+		avs_delete_script_environment(AVS_env);
+	}
+
+	AVS_env = NULL;
+
+	return;
+}
+
+
+BOOL CFrameServerAvisynthC::Unload()
+{
+	//the environment is abandoned, not deleted, when a measurement failed
+	AVS_clip = NULL;
+	AVS_env = NULL;
+	avs_create_script_environment = NULL;
+
+	BOOL bRet = TRUE;
+	if (hDLL)
+		bRet = ::FreeLibrary(hDLL);
+
+	hDLL = NULL;
+
+	return bRet;
+}
+
+
+
+/*
+	The parts of the VapourSynth API 4 (VapourSynth4.h, VSScript4.h) used
+	here. Only the leading members of VSAPI and VSSCRIPTAPI are declared,
+	the rest of both tables is never touched.
+*/
+#if defined(_WIN32)
+#define VS_CC __stdcall
+#define VSSCRIPT_DLL "VSScript.dll"
+#else
+#define VS_CC
+#define VSSCRIPT_DLL "libvapoursynth-script.so.0"
+#endif
+
+#define VS_MAKE_VERSION(major, minor) (((major) << 16) | (minor))
+#define VAPOURSYNTH_API_VERSION       VS_MAKE_VERSION(4, 0)
+#define VSSCRIPT_API_VERSION          VS_MAKE_VERSION(4, 0)
+
+struct VSCore;
+struct VSNode;
+struct VSFrame;
+struct VSScript;
+
+enum VSColorFamily { cfUndefined = 0, cfGray = 1, cfRGB = 2, cfYUV = 3 };
+enum VSSampleType  { stInteger = 0, stFloat = 1 };
+enum VSMediaType   { mtVideo = 1, mtAudio = 2 };
+
+struct VSVideoFormat
+{
+	int colorFamily;
+	int sampleType;
+	int bitsPerSample;
+	int bytesPerSample;
+	int subSamplingW;
+	int subSamplingH;
+	int numPlanes;
+};
+
+struct VSVideoInfo
+{
+	VSVideoFormat format;
+	__int64 fpsNum;
+	__int64 fpsDen;
+	int width;
+	int height;
+	int numFrames;
+};
+
+typedef void (VS_CC *VSFrameDoneCallback)(void *user_data, const VSFrame *f, int n, VSNode *node, const char *error_msg);
+
+struct VSAPI
+{
+	void *createVideoFilter;
+	void *createVideoFilter2;
+	void *createAudioFilter;
+	void *createAudioFilter2;
+	void *setLinearFilter;
+	void *setCacheMode;
+	void *setCacheOptions;
+	void (VS_CC *freeNode)(VSNode *node);
+	void *addNodeRef;
+	int (VS_CC *getNodeType)(VSNode *node);
+	const VSVideoInfo *(VS_CC *getVideoInfo)(VSNode *node);
+	void *getAudioInfo;
+	void *newVideoFrame;
+	void *newVideoFrame2;
+	void *newAudioFrame;
+	void *newAudioFrame2;
+	void (VS_CC *freeFrame)(const VSFrame *f);
+	void *addFrameRef;
+	void *copyFrame;
+	void *getFramePropertiesRO;
+	void *getFramePropertiesRW;
+	ptrdiff_t (VS_CC *getStride)(const VSFrame *f, int plane);
+	const BYTE *(VS_CC *getReadPtr)(const VSFrame *f, int plane);
+	void *getWritePtr;
+	const VSVideoFormat *(VS_CC *getVideoFrameFormat)(const VSFrame *f);
+	void *getAudioFrameFormat;
+	void *getFrameType;
+	int (VS_CC *getFrameWidth)(const VSFrame *f, int plane);
+	int (VS_CC *getFrameHeight)(const VSFrame *f, int plane);
+	void *getFrameLength;
+	int (VS_CC *getVideoFormatName)(const VSVideoFormat *format, char *buffer);
+	void *getAudioFormatName;
+	void *queryVideoFormat;
+	void *queryAudioFormat;
+	void *queryVideoFormatID;
+	void *getVideoFormatByID;
+	void *getFrame;
+	void (VS_CC *getFrameAsync)(int n, VSNode *node, VSFrameDoneCallback callback, void *user_data);
+};
+
+struct VSSCRIPTAPI
+{
+	int (VS_CC *getAPIVersion)(void);
+	const VSAPI *(VS_CC *getVSAPI)(int version);
+	VSScript *(VS_CC *createScript)(VSCore *core);
+	VSCore *(VS_CC *getCore)(VSScript *handle);
+	void *evaluateBuffer;
+	int (VS_CC *evaluateFile)(VSScript *handle, const char *script_filename);
+	const char *(VS_CC *getError)(VSScript *handle);
+	void *getExitCode;
+	void *getVariable;
+	void *setVariables;
+	VSNode *(VS_CC *getOutputNode)(VSScript *handle, int index);
+	void *getOutputAlphaNode;
+	void *getAltOutputMode;
+	void (VS_CC *freeScript)(VSScript *handle);
+	void (VS_CC *evalSetWorkingDir)(VSScript *handle, int set_cwd);
+};
+
+
+/*
+	VapourSynth through VSScript, loaded at run time. Frames are requested
+	with getFrameAsync() and up to uiRequests of them are kept in flight so
+	that VapourSynth's own thread pool works on several frames at once, the
+	way vspipe drives it. GetFrame() still returns in frame order.
+*/
+class CFrameServerVapourSynth : public CFrameServer
+{
+public:
+	CFrameServerVapourSynth();
+	virtual ~CFrameServerVapourSynth();
+
+	BOOL      Load(string s_dll);
+	void      CreateEnvironment();
+	void      Import(string &s_script);
+	void      GetClipInfo(stClipInfo &clipinfo);
+	void      SetFrameRange(unsigned int ui_first, unsigned int ui_last);
+	void      GetFrame(unsigned int ui_frame);
+	void      GetFramePlanes(unsigned int ui_frame, stFramePlanes &planes);
+	void      Release();
+	BOOL      Unload();
+
+	unsigned int uiRequests;        //frame requests in flight, 0: number of logical CPUs
+
+private:
+	typedef const VSSCRIPTAPI * VS_CC GET_VSSCRIPTAPI(int);
+
+	static void VS_CC FrameDone(void *user_data, const VSFrame *f, int n, VSNode *node, const char *error_msg);
+
+	const VSFrame*     WaitFrame(unsigned int ui_frame);
+
+	HINSTANCE          hDLL;
+	const VSSCRIPTAPI  *vssapi;
+	const VSAPI        *vsapi;
+	VSScript           *VS_script;
+	VSNode             *VS_node;
+
+	CRITICAL_SECTION   csFrames;
+	HANDLE             hFrameDone;
+	map<unsigned int, const VSFrame*> mDoneFrames;
+	map<unsigned int, string>         mFrameErrors;
+	unsigned int       uiInFlight;
+	unsigned int       uiNextRequest;
+	unsigned int       uiLastFrame;
+	deque<const VSFrame*> dHeldFrames;
+};
+
+
+CFrameServerVapourSynth::CFrameServerVapourSynth()
+{
+	sName = "VapourSynth";
+	uiRequests = 0;
+	hDLL = NULL;
+	vssapi = NULL;
+	vsapi = NULL;
+	VS_script = NULL;
+	VS_node = NULL;
+	uiInFlight = 0;
+	uiNextRequest = 0;
+	uiLastFrame = 0;
+	::InitializeCriticalSection(&csFrames);
+	hFrameDone = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+CFrameServerVapourSynth::~CFrameServerVapourSynth()
+{
+	Unload();
+	::CloseHandle(hFrameDone);
+	::DeleteCriticalSection(&csFrames);
+}
+
+
+BOOL CFrameServerVapourSynth::Load(string s_dll)
+{
+	sError = "";
+
+	if (s_dll == "")
+		hDLL = ::LoadLibrary(VSSCRIPT_DLL);
+	else
+		hDLL = ::LoadLibrary(s_dll.c_str());
+
+	if (!hDLL)
+	{
+		sError = "Cannot load " VSSCRIPT_DLL ":\n" + utils.LibraryErrorMessage();
+		return FALSE;
+	}
+
+	GET_VSSCRIPTAPI *GetVSScriptAPI = (GET_VSSCRIPTAPI *)::GetProcAddress(hDLL, "getVSScriptAPI");
+	if (!GetVSScriptAPI)
+	{
+		sError = "Failed to load getVSScriptAPI()";
+		Unload();
+		return FALSE;
+	}
+
+	vssapi = GetVSScriptAPI(VSSCRIPT_API_VERSION);
+	if (vssapi)
+		vsapi = vssapi->getVSAPI(VAPOURSYNTH_API_VERSION);
+
+	if (!vssapi || !vsapi)
+	{
+		sError = "VSScript does not support API version 4";
+		Unload();
+		return FALSE;
+	}
+
+	int iVersion = vssapi->getAPIVersion();
+	sVersion = utils.StrFormat("VapourSynth (VSScript API R%d.%d)", iVersion >> 16, iVersion & 0xFFFF);
+
+	char szPath[MAX_PATH + 1];
+	if (::GetModuleFileName(hDLL, szPath, MAX_PATH))
+		sDLLPath = szPath;
+
+	if (uiRequests == 0)
+	{
+		SYSTEM_INFO si;
+		::GetSystemInfo(&si);
+		uiRequests = (si.dwNumberOfProcessors > 0) ? (unsigned int)si.dwNumberOfProcessors : 1;
+	}
+
+	return TRUE;
+}
+
+
+void CFrameServerVapourSynth::CreateEnvironment()
+{
+	//a NULL core lets the script create its own, freeScript() releases it
+	VS_script = vssapi->createScript(NULL);
+	if (!VS_script)
+		ThrowError("Could not create the VapourSynth core");
+
+	return;
+}
+
+
+void CFrameServerVapourSynth::Import(string &s_script)
+{
+	vssapi->evalSetWorkingDir(VS_script, 1);
+	if (vssapi->evaluateFile(VS_script, s_script.c_str()))
+	{
+		const char *pszError = vssapi->getError(VS_script);
+		ThrowError(utils.StrFormat("\"%s\":\n%s", s_script.c_str(), pszError ? pszError : "Script evaluation failed"));
+	}
+
+	VS_node = vssapi->getOutputNode(VS_script, 0);
+	if (!VS_node)
+		ThrowError(utils.StrFormat("\"%s\":\nScript did not set an output clip", s_script.c_str()));
+
+	if (vsapi->getNodeType(VS_node) == mtVideo)
+	{
+		const VSVideoInfo *vsvi = vsapi->getVideoInfo(VS_node);
+		if ((vsvi->format.colorFamily == cfUndefined) || (vsvi->width == 0) || (vsvi->height == 0) || (vsvi->fpsNum <= 0) || (vsvi->fpsDen <= 0))
+			ThrowError(utils.StrFormat("\"%s\":\nClips with variable format, dimensions or frame rate are not supported", s_script.c_str()));
+
+		uiNextRequest = 0;
+		uiLastFrame = (vsvi->numFrames > 0) ? (unsigned int)vsvi->numFrames - 1 : 0;
+	}
+
+	return;
+}
+
+
+void CFrameServerVapourSynth::GetClipInfo(stClipInfo &clipinfo)
+{
+	ClearClipInfo(clipinfo);
+
+	//audio outputs are reported as clips without video
+	if (vsapi->getNodeType(VS_node) != mtVideo)
+		return;
+
+	const VSVideoInfo *vsvi = vsapi->getVideoInfo(VS_node);
+	clipinfo.bHasVideo = TRUE;
+	clipinfo.uiFrames = (unsigned int)vsvi->numFrames;
+	clipinfo.uiWidth = (unsigned int)vsvi->width;
+	clipinfo.uiHeight = (unsigned int)vsvi->height;
+	clipinfo.uiFPSNumerator = (unsigned int)vsvi->fpsNum;
+	clipinfo.uiFPSDenominator = (unsigned int)vsvi->fpsDen;
+
+	char szName[32] = "";
+	vsapi->getVideoFormatName(&vsvi->format, szName);
+	clipinfo.sColorspace = utils.StrFormat("%10s", szName);
+
+	switch (vsvi->format.colorFamily)
+	{
+		case cfGray: clipinfo.iColorFamily = CLIP_CF_GRAY; break;
+		case cfYUV:  clipinfo.iColorFamily = CLIP_CF_YUV;  break;
+		case cfRGB:  clipinfo.iColorFamily = CLIP_CF_RGB;  break;
+	}
+
+	clipinfo.iBitsPerComponent = vsvi->format.bitsPerSample;
+	clipinfo.iSubSamplingW = vsvi->format.subSamplingW;
+	clipinfo.iSubSamplingH = vsvi->format.subSamplingH;
+
+	__int64 iLumaBytes = (__int64)vsvi->width * (__int64)vsvi->height * (__int64)vsvi->format.bytesPerSample;
+	clipinfo.iFrameBytes = iLumaBytes;
+	if (vsvi->format.numPlanes > 1)
+		clipinfo.iFrameBytes += (__int64)(vsvi->format.numPlanes - 1) * (iLumaBytes >> (vsvi->format.subSamplingW + vsvi->format.subSamplingH));
+
+	return;
+}
+
+
+void CFrameServerVapourSynth::SetFrameRange(unsigned int ui_first, unsigned int ui_last)
+{
+	uiNextRequest = ui_first;
+	uiLastFrame = ui_last;
+
+	return;
+}
+
+
+void VS_CC CFrameServerVapourSynth::FrameDone(void *user_data, const VSFrame *f, int n, VSNode *node, const char *error_msg)
+{
+	CFrameServerVapourSynth *pServer = (CFrameServerVapourSynth *)user_data;
+
+	::EnterCriticalSection(&pServer->csFrames);
+	pServer->mDoneFrames[(unsigned int)n] = f;
+	if (!f)
+		pServer->mFrameErrors[(unsigned int)n] = error_msg ? error_msg : "Unknown error";
+	--pServer->uiInFlight;
+	::LeaveCriticalSection(&pServer->csFrames);
+
+	::SetEvent(pServer->hFrameDone);
+
+	return;
+}
+
+
+const VSFrame* CFrameServerVapourSynth::WaitFrame(unsigned int ui_frame)
+{
+	if (ui_frame >= uiNextRequest)
+		uiNextRequest = ui_frame;
+
+	while ((uiNextRequest <= uiLastFrame) && (uiNextRequest < ui_frame + uiRequests))
+	{
+		::EnterCriticalSection(&csFrames);
+		++uiInFlight;
+		::LeaveCriticalSection(&csFrames);
+
+		vsapi->getFrameAsync((int)uiNextRequest, VS_node, FrameDone, this);
+		++uiNextRequest;
+	}
+
+	const VSFrame *pFrame = NULL;
+	string sFrameError = "";
+	for (;;)
+	{
+		::EnterCriticalSection(&csFrames);
+		map<unsigned int, const VSFrame*>::iterator it = mDoneFrames.find(ui_frame);
+		BOOL bDone = (it != mDoneFrames.end()) ? TRUE : FALSE;
+		if (bDone)
+		{
+			pFrame = it->second;
+			mDoneFrames.erase(it);
+			if (!pFrame)
+			{
+				sFrameError = mFrameErrors[ui_frame];
+				mFrameErrors.erase(ui_frame);
+			}
+		}
+		::LeaveCriticalSection(&csFrames);
+
+		if (bDone)
+			break;
+
+		::WaitForSingleObject(hFrameDone, INFINITE);
+	}
+
+	if (!pFrame)
+		ThrowError(utils.StrFormat("Frame %u:\n%s", ui_frame, sFrameError.c_str()));
+
+	return pFrame;
+}
+
+
+void CFrameServerVapourSynth::GetFrame(unsigned int ui_frame)
+{
+	vsapi->freeFrame(WaitFrame(ui_frame));
+
+	return;
+}
+
+
+void CFrameServerVapourSynth::GetFramePlanes(unsigned int ui_frame, stFramePlanes &planes)
+{
+	const VSFrame *pFrame = WaitFrame(ui_frame);
+	const VSVideoFormat *pFormat = vsapi->getVideoFrameFormat(pFrame);
+
+	planes.iPlanes = (pFormat->numPlanes < FRAME_MAX_PLANES) ? pFormat->numPlanes : FRAME_MAX_PLANES;
+	for (int iPlane = 0; iPlane < planes.iPlanes; iPlane++)
+	{
+		planes.pData[iPlane] = vsapi->getReadPtr(pFrame, iPlane);
+		planes.iPitch[iPlane] = (int)vsapi->getStride(pFrame, iPlane);
+		planes.iRowSize[iPlane] = vsapi->getFrameWidth(pFrame, iPlane) * pFormat->bytesPerSample;
+		planes.iHeight[iPlane] = vsapi->getFrameHeight(pFrame, iPlane);
+	}
+
+	dHeldFrames.push_back(pFrame);
+	while (dHeldFrames.size() > uiHeldFrames + 1)
+	{
+		vsapi->freeFrame(dHeldFrames.front());
+		dHeldFrames.pop_front();
+	}
+
+	return;
+}
+
+
+void CFrameServerVapourSynth::Release()
+{
+	//requests still in flight (time limit, 'Esc', errors) have to complete before the core goes away
+	for (;;)
+	{
+		::EnterCriticalSection(&csFrames);
+		unsigned int uiPending = uiInFlight;
+		::LeaveCriticalSection(&csFrames);
+
+		if (uiPending == 0)
+			break;
+
+		::WaitForSingleObject(hFrameDone, INFINITE);
+	}
+
+	for (map<unsigned int, const VSFrame*>::iterator it = mDoneFrames.begin(); it != mDoneFrames.end(); ++it)
+	{
+		if (it->second)
+			vsapi->freeFrame(it->second);
+	}
+	mDoneFrames.clear();
+	mFrameErrors.clear();
+
+	for (size_t nFrame = 0; nFrame < dHeldFrames.size(); nFrame++)
+		vsapi->freeFrame(dHeldFrames[nFrame]);
+	dHeldFrames.clear();
+
+	if (VS_node)
+		vsapi->freeNode(VS_node);
+	VS_node = NULL;
+
+	if (VS_script)
+	{
+		if (dwDeleteDelay > 0)
+			Sleep(dwDeleteDelay);
+		vssapi->freeScript(VS_script);
+	}
+	VS_script = NULL;
+
+	return;
+}
+
+
+BOOL CFrameServerVapourSynth::Unload()
+{
+	//unlike avisynth, the core keeps worker threads running, it is always released
+	if (vssapi)
+		Release();
+
+	vssapi = NULL;
+	vsapi = NULL;
+
+	BOOL bRet = TRUE;
+	if (hDLL)
+		bRet = ::FreeLibrary(hDLL);
+
+	hDLL = NULL;
+
+	return bRet;
+}
+
+
+
+/*
+	Synthetic clips (CSyntheticSource) without a frame server library or a
+	script environment, so that the measurement modes also run where avisynth
+	is not installed. GetFrame() is called concurrently by the replay threads,
+	every call renders into a buffer of its own.
+*/
+class CFrameServerSynthetic : public CFrameServer
+{
+public:
+	CFrameServerSynthetic();
+	virtual ~CFrameServerSynthetic();
+
+	BOOL      Load(string s_dll);
+	void      CreateEnvironment();
+	void      Import(string &s_script);
+	void      GetClipInfo(stClipInfo &clipinfo);
+	void      GetFrame(unsigned int ui_frame);
+	void      GetFramePlanes(unsigned int ui_frame, stFramePlanes &planes);
+	void      Release();
+	BOOL      Unload();
+
+	CSyntheticSource source;
+
+private:
+	stSyntheticFrame* AcquireFrame();
+	void              RecycleFrame(stSyntheticFrame *p_frame);
+	unsigned int      ClampFrame(unsigned int ui_frame);
+
+	BOOL                      bImported;
+	CRITICAL_SECTION          csFrames;
+	vector<stSyntheticFrame*> vFreeFrames;
+	deque<stSyntheticFrame*>  dHeldFrames;
+};
+
+
+CFrameServerSynthetic::CFrameServerSynthetic()
+{
+	sName = "Synthetic clip";
+	bImported = FALSE;
+	::InitializeCriticalSection(&csFrames);
+}
+
+CFrameServerSynthetic::~CFrameServerSynthetic()
+{
+	Unload();
+	::DeleteCriticalSection(&csFrames);
+}
+
+
+BOOL CFrameServerSynthetic::Load(string s_dll)
+{
+	//nothing to load, the frames are rendered in-process
+	sError = "";
+	sVersion = "Synthetic clip, no frame server";
+	sDLLPath = "";
+
+	return TRUE;
+}
+
+
+void CFrameServerSynthetic::CreateEnvironment()
+{
+	return;
+}
+
+
+void CFrameServerSynthetic::Import(string &s_script)
+{
+	stSyntheticParams params;
+	string sParseError = "";
+	if (!CSyntheticSource::ParseSpec(s_script, params, sParseError))
+		ThrowError("\"" + s_script + "\":\n" + sParseError);
+
+	if (!source.Init(params))
+		ThrowError("\"" + s_script + "\":\n" + source.sError);
+
+	bImported = TRUE;
+
+	return;
+}
+
+
+void CFrameServerSynthetic::GetClipInfo(stClipInfo &clipinfo)
+{
+	ClearClipInfo(clipinfo);
+	if (!bImported)
+		return;
+
+	int iPixelType = source.params.iPixelType;
+
+	clipinfo.bHasVideo = TRUE;
+	clipinfo.uiFrames = source.params.uiFrames;
+	clipinfo.uiWidth = (unsigned int)source.params.iWidth;
+	clipinfo.uiHeight = (unsigned int)source.params.iHeight;
+	clipinfo.uiFPSNumerator = source.params.uiFPSNum;
+	clipinfo.uiFPSDenominator = source.params.uiFPSDen;
+	clipinfo.sColorspace = CFrameServerAvisynth::GetColorspaceName(iPixelType);
+	clipinfo.iBitsPerComponent = source.iBitsPerComponent;
+
+	//same flag decoding as CSyntheticSource::GetFormat()
+	if (!(iPixelType & VideoInfo::CS_PLANAR))
+		clipinfo.iColorFamily = CLIP_CF_OTHER;
+	else if ((iPixelType & VideoInfo::CS_INTERLEAVED) && (iPixelType & VideoInfo::CS_YUV))
+		clipinfo.iColorFamily = CLIP_CF_GRAY;
+	else if (iPixelType & VideoInfo::CS_BGR)
+		clipinfo.iColorFamily = CLIP_CF_RGB;
+	else
+	{
+		clipinfo.iColorFamily = CLIP_CF_YUV;
+		clipinfo.iSubSamplingW = source.iSubSamplingW;
+		clipinfo.iSubSamplingH = source.iSubSamplingH;
+	}
+
+	//like VideoInfo::BMPSize(), packed rows are DWORD aligned
+	for (int iPlane = 0; iPlane < source.iPlanes; iPlane++)
+	{
+		__int64 iRowBytes = (clipinfo.iColorFamily == CLIP_CF_OTHER) ? ((source.iRowSize[iPlane] + 3) & ~3) : source.iRowSize[iPlane];
+		clipinfo.iFrameBytes += iRowBytes * source.iHeight[iPlane];
+	}
+
+	return;
+}
+
+
+unsigned int CFrameServerSynthetic::ClampFrame(unsigned int ui_frame)
+{
+	if (!bImported)
+		ThrowError("No synthetic clip imported");
+
+	return (ui_frame < source.params.uiFrames) ? ui_frame : (source.params.uiFrames - 1);
+}
+
+
+stSyntheticFrame* CFrameServerSynthetic::AcquireFrame()
+{
+	stSyntheticFrame *pFrame = NULL;
+
+	::EnterCriticalSection(&csFrames);
+	if (vFreeFrames.size() > 0)
+	{
+		pFrame = vFreeFrames.back();
+		vFreeFrames.pop_back();
+	}
+	::LeaveCriticalSection(&csFrames);
+
+	if (pFrame == NULL)
+	{
+		pFrame = new stSyntheticFrame;
+		source.AllocFrame(*pFrame);
+	}
+
+	return pFrame;
+}
+
+
+void CFrameServerSynthetic::RecycleFrame(stSyntheticFrame *p_frame)
+{
+	::EnterCriticalSection(&csFrames);
+	vFreeFrames.push_back(p_frame);
+	::LeaveCriticalSection(&csFrames);
+
+	return;
+}
+
+
+void CFrameServerSynthetic::GetFrame(unsigned int ui_frame)
+{
+	unsigned int uiFrame = ClampFrame(ui_frame);
+
+	stSyntheticFrame *pFrame = AcquireFrame();
+	source.Render(uiFrame, *pFrame);
+	RecycleFrame(pFrame);
+
+	return;
+}
+
+
+void CFrameServerSynthetic::GetFramePlanes(unsigned int ui_frame, stFramePlanes &planes)
+{
+	unsigned int uiFrame = ClampFrame(ui_frame);
+
+	stSyntheticFrame *pFrame = AcquireFrame();
+	source.Render(uiFrame, *pFrame);
+
+	planes.iPlanes = source.iPlanes;
+	for (int iPlane = 0; iPlane < source.iPlanes; iPlane++)
+	{
+		planes.pData[iPlane] = pFrame->pPlane[iPlane];
+		planes.iPitch[iPlane] = pFrame->iPitch[iPlane];
+		planes.iRowSize[iPlane] = source.iRowSize[iPlane];
+		planes.iHeight[iPlane] = source.iHeight[iPlane];
+	}
+
+	dHeldFrames.push_back(pFrame);
+	while (dHeldFrames.size() > uiHeldFrames + 1)
+	{
+		RecycleFrame(dHeldFrames.front());
+		dHeldFrames.pop_front();
+	}
+
+	return;
+}
+
+
+void CFrameServerSynthetic::Release()
+{
+	for (size_t nFrame = 0; nFrame < dHeldFrames.size(); nFrame++)
+		delete dHeldFrames[nFrame];
+	dHeldFrames.clear();
+
+	for (size_t nFrame = 0; nFrame < vFreeFrames.size(); nFrame++)
+		delete vFreeFrames[nFrame];
+	vFreeFrames.clear();
+
+	source.Release();
+	bImported = FALSE;
+
+	return;
+}
+
+
+BOOL CFrameServerSynthetic::Unload()
+{
+	Release();
+
+	return TRUE;
+}
+
+
+
+BOOL CFrameServer::IsVapourSynthScript(string &s_script)
+{
+	if (s_script.length() <= 4)
+		return FALSE;
+
+	string sExt = s_script.substr(s_script.length() - 4);
+	transform(sExt.begin(), sExt.end(), sExt.begin(), ::tolower);
+
+	return (sExt == ".vpy") ? TRUE : FALSE;
+}
+
+
+CFrameServer* CFrameServer::Create(string &s_script, int i_avsinterfaceversion, BOOL b_avscapi)
+{
+	if (CSyntheticSource::IsSyntheticSpec(s_script))
+		return new CFrameServerSynthetic();
+
+	if (IsVapourSynthScript(s_script))
+		return new CFrameServerVapourSynth();
+
+	if (b_avscapi)
+		return new CFrameServerAvisynthC(i_avsinterfaceversion);
+
+	return new CFrameServerAvisynth(i_avsinterfaceversion);
+}
+
+
+#endif //_FRAMESERVER_H
@@ -0,0 +1,289 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_FRAMETRACE_H)
+#define _FRAMETRACE_H
+
+#include "common.h"
+
+#define TRACE_SIGNATURE   "# AVSMeter frame trace 1"
+#define TRACE_MAX_THREADS 64
+
+
+/*
+	Frame request trace, written by the AVSMeterTrace() filter
+	(AVSMeterTrace.cpp) and replayed with "-replay".
+	Text, one request per line, in the order the requests completed:
+	<start ms> <thread> <frame> <duration ms>
+	Start times are relative to the first request, threads are numbered in
+	the order they first asked for a frame.
+*/
+struct stTraceRequest
+{
+	double       dStartMS;
+	unsigned int uiThread;
+	unsigned int uiFrame;
+	double       dDurationMS;
+};
+
+
+class CFrameTrace
+{
+public:
+	CFrameTrace();
+	virtual ~CFrameTrace() {}
+
+	BOOL   Load(string s_file);     //FALSE: sError is set
+
+	vector<stTraceRequest> vRequests;  //sorted by start time
+	unsigned int uiThreads;
+	unsigned int uiUniqueFrames;
+	unsigned int uiMaxConcurrency;     //requests in flight at the same time
+	double       dSpanMS;              //first start to last completion
+	string       sError;
+};
+
+
+CFrameTrace::CFrameTrace()
+{
+	uiThreads = 0;
+	uiUniqueFrames = 0;
+	uiMaxConcurrency = 0;
+	dSpanMS = 0.0;
+	sError = "";
+}
+
+
+static bool CompareTraceStart(const stTraceRequest &first, const stTraceRequest &second)
+{
+	return (first.dStartMS < second.dStartMS);
+}
+
+
+BOOL CFrameTrace::Load(string s_file)
+{
+	vRequests.clear();
+	uiThreads = 0;
+	uiUniqueFrames = 0;
+	uiMaxConcurrency = 0;
+	dSpanMS = 0.0;
+	sError = "";
+
+	ifstream ifTrace(s_file.c_str());
+	if (!ifTrace.is_open())
+	{
+		sError = "Cannot open the trace file:\n" + s_file;
+		return FALSE;
+	}
+
+	string sLine = "";
+	getline(ifTrace, sLine);
+	if (sLine.substr(0, strlen(TRACE_SIGNATURE)) != TRACE_SIGNATURE)
+	{
+		sError = "Not an AVSMeter frame trace:\n" + s_file;
+		return FALSE;
+	}
+
+	unsigned int uiLine = 1;
+	stTraceRequest request;
+	while (getline(ifTrace, sLine))
+	{
+		++uiLine;
+		if ((sLine == "") || (sLine[0] == '#') || (sLine == "\r"))
+			continue;
+
+		if (sscanf(sLine.c_str(), "%lf %u %u %lf", &request.dStartMS, &request.uiThread, &request.uiFrame, &request.dDurationMS) != 4)
+		{
+			char szLine[32];
+			sprintf(szLine, "%u", uiLine);
+			sError = "Invalid trace line " + string(szLine) + ":\n" + sLine;
+			return FALSE;
+		}
+
+		if (request.uiThread >= TRACE_MAX_THREADS)
+		{
+			sError = "The trace has more than 64 threads";
+			return FALSE;
+		}
+
+		vRequests.push_back(request);
+	}
+
+	if (vRequests.size() == 0)
+	{
+		sError = "The trace is empty:\n" + s_file;
+		return FALSE;
+	}
+
+	std::stable_sort(vRequests.begin(), vRequests.end(), CompareTraceStart);
+
+	double dOrigin = vRequests[0].dStartMS;
+	set<unsigned int> sFrames;
+	vector<double> vEnds;
+	for (size_t i = 0; i < vRequests.size(); i++)
+	{
+		vRequests[i].dStartMS -= dOrigin;
+		sFrames.insert(vRequests[i].uiFrame);
+		if (vRequests[i].uiThread + 1 > uiThreads)
+			uiThreads = vRequests[i].uiThread + 1;
+
+		double dEnd = vRequests[i].dStartMS + vRequests[i].dDurationMS;
+		if (dEnd > dSpanMS)
+			dSpanMS = dEnd;
+
+		//requests started before this one and not yet completed
+		size_t nPending = 0;
+		for (size_t j = 0; j < vEnds.size(); j++)
+		{
+			if (vEnds[j] > vRequests[i].dStartMS)
+				vEnds[nPending++] = vEnds[j];
+		}
+		vEnds.resize(nPending);
+		vEnds.push_back(dEnd);
+		if ((unsigned int)vEnds.size() > uiMaxConcurrency)
+			uiMaxConcurrency = (unsigned int)vEnds.size();
+	}
+
+	uiUniqueFrames = (unsigned int)sFrames.size();
+
+	return TRUE;
+}
+
+
+/*
+	Thread safe writer for the filter. Timestamps come straight from the
+	performance counter, CTimer pins the calling thread which would disturb
+	the consumer's threads.
+*/
+class CTraceRecorder
+{
+public:
+	CTraceRecorder();
+	virtual ~CTraceRecorder();
+
+	BOOL   Open(string s_file);     //FALSE: sError is set
+	void   Close();
+	double Now();                   //ms
+	void   Record(unsigned int ui_frame, double d_startms, double d_endms);
+
+	string sError;
+
+private:
+	CRITICAL_SECTION            csTrace;
+	FILE                        *pFile;
+	map<DWORD, unsigned int>    mThreads;
+	double                      dPerfFreq;
+	double                      dOriginMS;
+	BOOL                        bOrigin;
+};
+
+
+CTraceRecorder::CTraceRecorder()
+{
+	::InitializeCriticalSection(&csTrace);
+	pFile = NULL;
+	dOriginMS = 0.0;
+	bOrigin = FALSE;
+	sError = "";
+
+	LARGE_INTEGER liPerfFreq;
+	dPerfFreq = ::QueryPerformanceFrequency(&liPerfFreq) ? (double)liPerfFreq.QuadPart : 1.0;
+}
+
+CTraceRecorder::~CTraceRecorder()
+{
+	Close();
+	::DeleteCriticalSection(&csTrace);
+}
+
+
+BOOL CTraceRecorder::Open(string s_file)
+{
+	Close();
+
+	pFile = fopen(s_file.c_str(), "w");
+	if (pFile == NULL)
+	{
+		sError = "Cannot create the trace file: " + s_file;
+		return FALSE;
+	}
+
+	fprintf(pFile, "%s\n# start_ms thread frame duration_ms\n", TRACE_SIGNATURE);
+	mThreads.clear();
+	bOrigin = FALSE;
+
+	return TRUE;
+}
+
+
+void CTraceRecorder::Close()
+{
+	::EnterCriticalSection(&csTrace);
+	if (pFile != NULL)
+	{
+		fclose(pFile);
+		pFile = NULL;
+	}
+	::LeaveCriticalSection(&csTrace);
+
+	return;
+}
+
+
+double CTraceRecorder::Now()
+{
+	LARGE_INTEGER liPerfCounter = {0,0};
+	::QueryPerformanceCounter(&liPerfCounter);
+
+	return (1000.0 * (double)liPerfCounter.QuadPart) / dPerfFreq;
+}
+
+
+void CTraceRecorder::Record(unsigned int ui_frame, double d_startms, double d_endms)
+{
+	DWORD dwThreadID = ::GetCurrentThreadId();
+
+	::EnterCriticalSection(&csTrace);
+	if (pFile != NULL)
+	{
+		if (!bOrigin)
+		{
+			dOriginMS = d_startms;
+			bOrigin = TRUE;
+		}
+
+		map<DWORD, unsigned int>::iterator it = mThreads.find(dwThreadID);
+		unsigned int uiThread = 0;
+		if (it == mThreads.end())
+		{
+			uiThread = (unsigned int)mThreads.size();
+			mThreads[dwThreadID] = uiThread;
+		}
+		else
+			uiThread = it->second;
+
+		//a request that started before the first completed one gets a negative time, Load() rebases
+		fprintf(pFile, "%.3f %u %u %.3f\n", d_startms - dOriginMS, uiThread, ui_frame, d_endms - d_startms);
+	}
+	::LeaveCriticalSection(&csTrace);
+
+	return;
+}
+
+
+#endif //_FRAMETRACE_H
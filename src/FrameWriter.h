@@ -0,0 +1,417 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_FRAMEWRITER_H)
+#define _FRAMEWRITER_H
+
+#include "common.h"
+#include "Utility.h"
+#include "Timer.h"
+#include "FrameServer.h"
+
+#if !defined(_WIN32)
+#include <sys/uio.h>
+#endif
+
+#define OUTPUT_MAX_HELD_FRAMES  64    //more than that and the pipe is written with writev()
+#define OUTPUT_MAX_IOV          1024  //IOV_MAX on Linux
+
+
+/*
+	Writes the served frames as YUV4MPEG2 or raw planes to stdout ("-") or
+	a file, the way a script is piped into an encoder. The rows are handed
+	to the kernel straight from the frame buffers, nothing is copied:
+	- Windows: one WriteFile() per plane, per row if the pitch is padded
+	- POSIX:   writev() of all rows of a frame
+	- Linux:   vmsplice() if the output is a pipe. The pipe then references
+	           the frame memory until the consumer has read it, so the frame
+	           server has to keep the last uiHeldFrames frames alive.
+	dWriteSeconds is the time spent in these calls, which is mostly the time
+	blocked on a consumer that cannot keep up.
+*/
+class CFrameWriter
+{
+public:
+	CFrameWriter();
+	virtual ~CFrameWriter();
+
+	BOOL   Open(string s_file, BOOL b_y4m, const stClipInfo &clipinfo);  //FALSE: sError is set
+	BOOL   WriteFrame(const stFramePlanes &planes);                       //FALSE: sError is set
+	void   Close();
+
+	string GetY4MColorspace(const stClipInfo &clipinfo);                  //"": not representable
+
+	string           sFile;
+	string           sFormat;
+	string           sMethod;
+	unsigned int     uiHeldFrames;
+	unsigned __int64 uiBytesWritten;
+	unsigned int     uiFramesWritten;
+	double           dWriteSeconds;
+	string           sError;
+
+private:
+	struct stSegment
+	{
+		const BYTE *pData;
+		size_t     nBytes;
+	};
+
+	void   AddSegment(const BYTE *p_data, size_t n_bytes);
+	BOOL   WriteSegments();
+
+	BOOL              bY4M;
+	int               iY4MPlanes;
+	string            sHeader;
+	vector<stSegment> vSegments;
+	BOOL              bCloseFile;
+	CUtils            utils;
+	CTimer            timer;
+
+#if defined(_WIN32)
+	HANDLE            hFile;
+#else
+	int               iFD;
+	BOOL              bVMSplice;
+	vector<struct iovec> vIOV;
+#endif
+};
+
+
+CFrameWriter::CFrameWriter()
+{
+	sFile = "";
+	sFormat = "";
+	sMethod = "";
+	uiHeldFrames = 0;
+	uiBytesWritten = 0;
+	uiFramesWritten = 0;
+	dWriteSeconds = 0.0;
+	sError = "";
+	bY4M = FALSE;
+	iY4MPlanes = 0;
+	sHeader = "";
+	bCloseFile = FALSE;
+#if defined(_WIN32)
+	hFile = INVALID_HANDLE_VALUE;
+#else
+	iFD = -1;
+	bVMSplice = FALSE;
+#endif
+}
+
+CFrameWriter::~CFrameWriter()
+{
+	Close();
+}
+
+
+string CFrameWriter::GetY4MColorspace(const stClipInfo &clipinfo)
+{
+	//the tags ffmpeg and x264 understand, no float, RGB or packed formats
+	if ((clipinfo.iBitsPerComponent > 16) || ((clipinfo.iColorFamily != CLIP_CF_GRAY) && (clipinfo.iColorFamily != CLIP_CF_YUV)))
+		return "";
+
+	if (clipinfo.iColorFamily == CLIP_CF_GRAY)
+		return (clipinfo.iBitsPerComponent == 8) ? "mono" : utils.StrFormat("mono%d", clipinfo.iBitsPerComponent);
+
+	string sSubSampling = "";
+	if ((clipinfo.iSubSamplingW == 1) && (clipinfo.iSubSamplingH == 1))
+		sSubSampling = "420";
+	else if ((clipinfo.iSubSamplingW == 1) && (clipinfo.iSubSamplingH == 0))
+		sSubSampling = "422";
+	else if ((clipinfo.iSubSamplingW == 0) && (clipinfo.iSubSamplingH == 0))
+		sSubSampling = "444";
+	else if ((clipinfo.iSubSamplingW == 2) && (clipinfo.iSubSamplingH == 0) && (clipinfo.iBitsPerComponent == 8))
+		return "411";
+	else
+		return "";
+
+	if (clipinfo.iBitsPerComponent == 8)
+		return (sSubSampling == "420") ? "420jpeg" : sSubSampling;
+
+	return utils.StrFormat("%sp%d", sSubSampling.c_str(), clipinfo.iBitsPerComponent);
+}
+
+
+BOOL CFrameWriter::Open(string s_file, BOOL b_y4m, const stClipInfo &clipinfo)
+{
+	sError = "";
+	sFile = s_file;
+	bY4M = b_y4m;
+	sFormat = bY4M ? "YUV4MPEG2" : "raw";
+
+	if (bY4M)
+	{
+		string sColorspace = GetY4MColorspace(clipinfo);
+		if (sColorspace == "")
+		{
+			string sName = clipinfo.sColorspace;
+			utils.StrTrim(sName);
+			sError = utils.StrFormat("%s cannot be written as YUV4MPEG2, use \"-raw\"", sName.c_str());
+			return FALSE;
+		}
+
+		iY4MPlanes = (clipinfo.iColorFamily == CLIP_CF_GRAY) ? 1 : 3;  //alpha is dropped
+
+		char cInterlacing = 'p';
+		if (clipinfo.bTFF && !clipinfo.bFieldBased)
+			cInterlacing = 't';
+		else if (clipinfo.bBFF && !clipinfo.bFieldBased)
+			cInterlacing = 'b';
+
+		sHeader = utils.StrFormat("YUV4MPEG2 W%u H%u F%u:%u I%c A0:0 C%s\n", clipinfo.uiWidth, clipinfo.uiHeight, clipinfo.uiFPSNumerator, clipinfo.uiFPSDenominator, cInterlacing, sColorspace.c_str());
+	}
+
+#if defined(_WIN32)
+
+	if (sFile == "-")
+		hFile = ::GetStdHandle(STD_OUTPUT_HANDLE);
+	else
+	{
+		hFile = ::CreateFile(sFile.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		bCloseFile = TRUE;
+	}
+
+	if ((hFile == INVALID_HANDLE_VALUE) || (hFile == NULL))
+	{
+		sError = "Cannot open \"" + sFile + "\":\n" + utils.SysErrorMessage();
+		bCloseFile = FALSE;
+		return FALSE;
+	}
+
+	sMethod = "WriteFile";
+
+#else //_WIN32
+
+	if (sFile == "-")
+		iFD = STDOUT_FILENO;
+	else
+	{
+		iFD = open(sFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		bCloseFile = TRUE;
+	}
+
+	if (iFD < 0)
+	{
+		sError = "Cannot open \"" + sFile + "\":\n" + utils.SysErrorMessage();
+		bCloseFile = FALSE;
+		return FALSE;
+	}
+
+	//a consumer that goes away makes write() fail with EPIPE instead of killing the process
+	signal(SIGPIPE, SIG_IGN);
+
+	sMethod = "writev";
+
+#if defined(F_GETPIPE_SZ)
+	struct stat st;
+	if ((fstat(iFD, &st) == 0) && S_ISFIFO(st.st_mode))
+	{
+		//the pipe holds at most its size of the latest output, the smallest frame is a luma plane
+		int iPipeBytes = fcntl(iFD, F_GETPIPE_SZ);
+		__int64 iMinFrameBytes = (__int64)clipinfo.uiWidth * (__int64)clipinfo.uiHeight * (__int64)((clipinfo.iBitsPerComponent + 7) / 8);
+		if ((iPipeBytes > 0) && (iMinFrameBytes > 0))
+		{
+			__int64 iHeld = ((__int64)iPipeBytes + iMinFrameBytes - 1) / iMinFrameBytes;
+			if (iHeld <= OUTPUT_MAX_HELD_FRAMES)
+			{
+				uiHeldFrames = (unsigned int)iHeld;
+				bVMSplice = TRUE;
+				sMethod = "vmsplice";
+			}
+		}
+	}
+#endif
+
+#endif //_WIN32
+
+	if (sHeader != "")
+	{
+		AddSegment((const BYTE *)sHeader.c_str(), sHeader.length());
+		if (!WriteSegments())
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+void CFrameWriter::AddSegment(const BYTE *p_data, size_t n_bytes)
+{
+	if (!vSegments.empty() && ((vSegments.back().pData + vSegments.back().nBytes) == p_data))
+	{
+		vSegments.back().nBytes += n_bytes;
+		return;
+	}
+
+	stSegment segment;
+	segment.pData = p_data;
+	segment.nBytes = n_bytes;
+	vSegments.push_back(segment);
+
+	return;
+}
+
+
+BOOL CFrameWriter::WriteFrame(const stFramePlanes &planes)
+{
+	static const char szFrame[] = "FRAME\n";
+
+	if (bY4M)
+		AddSegment((const BYTE *)szFrame, sizeof(szFrame) - 1);
+
+	int iPlanes = (bY4M && (iY4MPlanes < planes.iPlanes)) ? iY4MPlanes : planes.iPlanes;
+	for (int iPlane = 0; iPlane < iPlanes; iPlane++)
+	{
+		for (int iRow = 0; iRow < planes.iHeight[iPlane]; iRow++)
+			AddSegment(planes.pData[iPlane] + (__int64)iRow * planes.iPitch[iPlane], (size_t)planes.iRowSize[iPlane]);
+	}
+
+	if (!WriteSegments())
+		return FALSE;
+
+	++uiFramesWritten;
+
+	return TRUE;
+}
+
+
+#if defined(_WIN32)
+
+BOOL CFrameWriter::WriteSegments()
+{
+	double dStart = timer.GetTimer();
+	BOOL bRet = TRUE;
+
+	for (size_t nSegment = 0; bRet && (nSegment < vSegments.size()); nSegment++)
+	{
+		const BYTE *pData = vSegments[nSegment].pData;
+		size_t nLeft = vSegments[nSegment].nBytes;
+
+		while (nLeft > 0)
+		{
+			DWORD dwWritten = 0;
+			DWORD dwChunk = (nLeft > 0x40000000) ? 0x40000000 : (DWORD)nLeft;
+			if (!::WriteFile(hFile, pData, dwChunk, &dwWritten, NULL))
+			{
+				if ((::GetLastError() == ERROR_BROKEN_PIPE) || (::GetLastError() == ERROR_NO_DATA))
+					sError = "The output was closed by the consumer";
+				else
+					sError = "Cannot write to \"" + sFile + "\":\n" + utils.SysErrorMessage();
+				bRet = FALSE;
+				break;
+			}
+
+			pData += dwWritten;
+			nLeft -= dwWritten;
+			uiBytesWritten += dwWritten;
+		}
+	}
+
+	vSegments.clear();
+	dWriteSeconds += timer.GetTimer() - dStart;
+
+	return bRet;
+}
+
+#else //_WIN32
+
+BOOL CFrameWriter::WriteSegments()
+{
+	double dStart = timer.GetTimer();
+	BOOL bRet = TRUE;
+
+	vIOV.resize(vSegments.size());
+	for (size_t nSegment = 0; nSegment < vSegments.size(); nSegment++)
+	{
+		vIOV[nSegment].iov_base = (void *)vSegments[nSegment].pData;
+		vIOV[nSegment].iov_len = vSegments[nSegment].nBytes;
+	}
+
+	size_t nIOV = 0;
+	while (nIOV < vIOV.size())
+	{
+		int iCount = ((vIOV.size() - nIOV) > OUTPUT_MAX_IOV) ? OUTPUT_MAX_IOV : (int)(vIOV.size() - nIOV);
+		ssize_t nWritten = bVMSplice ? vmsplice(iFD, &vIOV[nIOV], (unsigned long)iCount, 0) : writev(iFD, &vIOV[nIOV], iCount);
+
+		if (nWritten < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			if (bVMSplice && ((errno == EINVAL) || (errno == ENOSYS)))
+			{
+				bVMSplice = FALSE;
+				sMethod = "writev";
+				continue;
+			}
+
+			if (errno == EPIPE)
+				sError = "The output was closed by the consumer";
+			else
+				sError = "Cannot write to \"" + sFile + "\":\n" + utils.SysErrorMessage();
+			bRet = FALSE;
+			break;
+		}
+
+		uiBytesWritten += (unsigned __int64)nWritten;
+
+		//partial writes leave the rest of the current iovec for the next call
+		size_t nBytes = (size_t)nWritten;
+		while ((nIOV < vIOV.size()) && (nBytes >= vIOV[nIOV].iov_len))
+		{
+			nBytes -= vIOV[nIOV].iov_len;
+			++nIOV;
+		}
+
+		if (nBytes > 0)
+		{
+			vIOV[nIOV].iov_base = (BYTE *)vIOV[nIOV].iov_base + nBytes;
+			vIOV[nIOV].iov_len -= nBytes;
+		}
+	}
+
+	vSegments.clear();
+	dWriteSeconds += timer.GetTimer() - dStart;
+
+	return bRet;
+}
+
+#endif //_WIN32
+
+
+void CFrameWriter::Close()
+{
+#if defined(_WIN32)
+	if (bCloseFile && (hFile != INVALID_HANDLE_VALUE))
+		::CloseHandle(hFile);
+	hFile = INVALID_HANDLE_VALUE;
+#else
+	if (bCloseFile && (iFD >= 0))
+		close(iFD);
+	iFD = -1;
+#endif
+
+	bCloseFile = FALSE;
+
+	return;
+}
+
+
+#endif //_FRAMEWRITER_H
@@ -21,7 +21,7 @@
 
 #include "common.h"
 #include "exception.h"
-#include "utility.h"
+#include "Utility.h"
 
 #define SHMEM_NAME "GPUZShMem"
 #define MAX_RECORDS 128
@@ -112,6 +112,8 @@ CGPUInfo::~CGPUInfo()
 }
 
 
+#if defined(_WIN32)
+
 void CGPUInfo::GPUZInit()
 {
 	sError = "";
@@ -259,5 +261,37 @@ void CGPUInfo::ReadSensors()
 	return;
 }
 
+#else //_WIN32
+
+//GPU-Z publishes its sensors through a named Windows file mapping
+void CGPUInfo::GPUZInit()
+{
+	bInitialized = FALSE;
+	sError = "GPU-Z monitoring is only available on Windows";
+	return;
+}
+
+
+void CGPUInfo::GPUZRelease()
+{
+	bInitialized = FALSE;
+	return;
+}
+
+
+void CGPUInfo::ReadData()
+{
+	return;
+}
+
+
+void CGPUInfo::ReadSensors()
+{
+	sensors.ReadError = TRUE;
+	return;
+}
+
+#endif //_WIN32
+
 
 #endif //_GPUINFO_H
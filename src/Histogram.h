@@ -0,0 +1,113 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_HISTOGRAM_H)
+#define _HISTOGRAM_H
+
+#include "common.h"
+
+#define HISTOGRAM_MIN_MS           0.01  //lower bound of the first bucket
+#define HISTOGRAM_DECADES          7     //0.01 ms ... 100 s
+#define HISTOGRAM_BUCKETS_PER_DEC  20    //~12% bucket width
+
+
+/*
+	Frame time histogram with logarithmic buckets, memory and cost are
+	constant regardless of the number of frames.
+*/
+class CHistogram
+{
+public:
+	CHistogram();
+	virtual ~CHistogram();
+
+	void   Reset();
+	void   Add(double d_ms, unsigned int ui_count);
+	double Percentile(double d_percentile);
+	unsigned __int64 uiCount;
+
+private:
+	unsigned __int64 uiBuckets[HISTOGRAM_DECADES * HISTOGRAM_BUCKETS_PER_DEC + 2]; //+ underflow and overflow
+};
+
+
+CHistogram::CHistogram()
+{
+	Reset();
+}
+
+CHistogram::~CHistogram()
+{
+}
+
+
+void CHistogram::Reset()
+{
+	uiCount = 0;
+	for (int i = 0; i < (HISTOGRAM_DECADES * HISTOGRAM_BUCKETS_PER_DEC + 2); i++)
+		uiBuckets[i] = 0;
+
+	return;
+}
+
+
+void CHistogram::Add(double d_ms, unsigned int ui_count)
+{
+	int iBucket = 0;
+	if (d_ms >= HISTOGRAM_MIN_MS)
+	{
+		iBucket = (int)(log10(d_ms / HISTOGRAM_MIN_MS) * (double)HISTOGRAM_BUCKETS_PER_DEC) + 1;
+		if (iBucket > (HISTOGRAM_DECADES * HISTOGRAM_BUCKETS_PER_DEC + 1))
+			iBucket = HISTOGRAM_DECADES * HISTOGRAM_BUCKETS_PER_DEC + 1;
+	}
+
+	uiBuckets[iBucket] += ui_count;
+	uiCount += ui_count;
+
+	return;
+}
+
+
+double CHistogram::Percentile(double d_percentile)
+{
+	if (uiCount == 0)
+		return 0.0;
+
+	unsigned __int64 uiTarget = (unsigned __int64)((d_percentile / 100.0) * (double)uiCount + 0.5);
+	if (uiTarget < 1)
+		uiTarget = 1;
+
+	unsigned __int64 uiSum = 0;
+	for (int i = 0; i < (HISTOGRAM_DECADES * HISTOGRAM_BUCKETS_PER_DEC + 2); i++)
+	{
+		uiSum += uiBuckets[i];
+		if (uiSum < uiTarget)
+			continue;
+
+		if (i == 0)
+			return HISTOGRAM_MIN_MS;
+
+		//geometric center of the bucket
+		return HISTOGRAM_MIN_MS * pow(10.0, ((double)(i - 1) + 0.5) / (double)HISTOGRAM_BUCKETS_PER_DEC);
+	}
+
+	return HISTOGRAM_MIN_MS * pow(10.0, (double)HISTOGRAM_DECADES);
+}
+
+
+#endif //_HISTOGRAM_H
@@ -0,0 +1,414 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_MEMBENCH_H)
+#define _MEMBENCH_H
+
+#include "common.h"
+#include "Utility.h"
+#include "Timer.h"
+
+#include <immintrin.h>
+
+#define MEMBENCH_ARRAY_BYTES   (32 * 1024 * 1024)  //per array, well beyond the last level cache
+#define MEMBENCH_REPEATS       5                   //best of n
+#define MEMBENCH_MAX_THREADS   64                  //WaitForMultipleObjects() limit
+#define MEMBENCH_CHASE_MIN     (16 * 1024)
+#define MEMBENCH_CHASE_MAX     (64 * 1024 * 1024)
+#define MEMBENCH_CHASE_STEPS   (2 * 1024 * 1024)
+#define MEMBENCH_LINE          64
+
+#define MEMBENCH_COPY          0  //c = a
+#define MEMBENCH_SCALE         1  //b = s * c
+#define MEMBENCH_TRIAD         2  //a = b + s * c
+#define MEMBENCH_KERNELS       3
+
+#define MEMBENCH_SSE2          0
+#define MEMBENCH_AVX2          1
+#define MEMBENCH_ISAS          2
+
+#if defined(__GNUC__)
+#define MEMBENCH_TARGET_AVX2   __attribute__((target("avx2")))
+#else
+#define MEMBENCH_TARGET_AVX2
+#endif
+
+
+struct stMemLatency
+{
+	size_t nBytes;
+	double dNS;
+};
+
+
+/*
+	STREAM style bandwidth (copy, scale, triad) with SSE2 and AVX2 kernels,
+	once on a single thread and once split across all logical CPUs, plus a
+	dependent load chain through a random cyclic permutation of cache lines
+	for the load-to-use latency at growing working set sizes.
+	Bandwidth is counted like STREAM, i.e. without write-allocate traffic.
+*/
+class CMemBench
+{
+public:
+	CMemBench();
+	virtual ~CMemBench();
+
+	BOOL   Run(BOOL b_sse2, BOOL b_avx2);
+	string GetText();
+	double dBandwidth[MEMBENCH_ISAS][MEMBENCH_KERNELS][2]; //MB/s, [0] single thread, [1] all threads
+	BOOL   bISA[MEMBENCH_ISAS];
+	vector<stMemLatency> vLatency;
+	double dPeakMBs;  //best all threads result
+	unsigned int uiThreads;
+	string sError;
+
+private:
+	struct stSlice
+	{
+		CMemBench *pThis;
+		size_t    nBegin;
+		size_t    nEnd;
+		int       iKernel;
+		int       iISA;
+	};
+
+	static unsigned __stdcall ThreadProc(void *p_slice);
+	static void RunKernelSSE2(int i_kernel, double *p_a, double *p_b, double *p_c, size_t n_begin, size_t n_end);
+	static MEMBENCH_TARGET_AVX2 void RunKernelAVX2(int i_kernel, double *p_a, double *p_b, double *p_c, size_t n_begin, size_t n_end);
+	double MeasureBandwidth(int i_kernel, int i_isa, unsigned int ui_threads);
+	double MeasureLatency(size_t n_bytes);
+	double *pA;
+	double *pB;
+	double *pC;
+	size_t nElements;
+	HANDLE hStartEvent;
+	CTimer timer;
+	CUtils utils;
+	volatile size_t nChaseSink;
+};
+
+
+CMemBench::CMemBench()
+{
+	for (int iISA = 0; iISA < MEMBENCH_ISAS; iISA++)
+	{
+		bISA[iISA] = FALSE;
+		for (int iKernel = 0; iKernel < MEMBENCH_KERNELS; iKernel++)
+		{
+			dBandwidth[iISA][iKernel][0] = 0.0;
+			dBandwidth[iISA][iKernel][1] = 0.0;
+		}
+	}
+
+	dPeakMBs = 0.0;
+	uiThreads = 0;
+	sError = "";
+	pA = NULL;
+	pB = NULL;
+	pC = NULL;
+	nElements = 0;
+	hStartEvent = NULL;
+	nChaseSink = 0;
+}
+
+CMemBench::~CMemBench()
+{
+}
+
+
+BOOL CMemBench::Run(BOOL b_sse2, BOOL b_avx2)
+{
+	sError = "";
+	bISA[MEMBENCH_SSE2] = b_sse2;
+	bISA[MEMBENCH_AVX2] = b_avx2;
+
+	if (!b_sse2)
+	{
+		sError = "SSE2 is not supported";
+		return FALSE;
+	}
+
+	SYSTEM_INFO si;
+	::GetSystemInfo(&si);
+	uiThreads = (si.dwNumberOfProcessors > MEMBENCH_MAX_THREADS) ? MEMBENCH_MAX_THREADS : si.dwNumberOfProcessors;
+	if (uiThreads < 1)
+		uiThreads = 1;
+
+	nElements = MEMBENCH_ARRAY_BYTES / sizeof(double);
+	pA = (double*)_aligned_malloc(MEMBENCH_ARRAY_BYTES, MEMBENCH_LINE);
+	pB = (double*)_aligned_malloc(MEMBENCH_ARRAY_BYTES, MEMBENCH_LINE);
+	pC = (double*)_aligned_malloc(MEMBENCH_ARRAY_BYTES, MEMBENCH_LINE);
+	hStartEvent = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if ((pA == NULL) || (pB == NULL) || (pC == NULL) || (hStartEvent == NULL))
+		sError = "Cannot allocate the test buffers";
+	else
+	{
+		//touch every page before the first measurement
+		for (size_t n = 0; n < nElements; n++)
+		{
+			pA[n] = 1.0;
+			pB[n] = 2.0;
+			pC[n] = 0.0;
+		}
+
+		dPeakMBs = 0.0;
+		for (int iISA = 0; iISA < MEMBENCH_ISAS; iISA++)
+		{
+			if (!bISA[iISA])
+				continue;
+
+			for (int iKernel = 0; iKernel < MEMBENCH_KERNELS; iKernel++)
+			{
+				dBandwidth[iISA][iKernel][0] = MeasureBandwidth(iKernel, iISA, 1);
+				dBandwidth[iISA][iKernel][1] = (uiThreads > 1) ? MeasureBandwidth(iKernel, iISA, uiThreads) : dBandwidth[iISA][iKernel][0];
+				if (dBandwidth[iISA][iKernel][1] > dPeakMBs)
+					dPeakMBs = dBandwidth[iISA][iKernel][1];
+			}
+		}
+	}
+
+	if (hStartEvent != NULL)
+		::CloseHandle(hStartEvent);
+	hStartEvent = NULL;
+
+	_aligned_free(pA);
+	_aligned_free(pB);
+	_aligned_free(pC);
+	pA = NULL;
+	pB = NULL;
+	pC = NULL;
+
+	if (sError != "")
+		return FALSE;
+
+	vLatency.clear();
+	for (size_t nBytes = MEMBENCH_CHASE_MIN; nBytes <= MEMBENCH_CHASE_MAX; nBytes *= 4)
+	{
+		stMemLatency latency;
+		latency.nBytes = nBytes;
+		latency.dNS = MeasureLatency(nBytes);
+		if (latency.dNS < 0.0)
+		{
+			sError = utils.StrFormat("Cannot allocate %u KiB for the latency test", (unsigned int)(nBytes / 1024));
+			return FALSE;
+		}
+
+		vLatency.push_back(latency);
+	}
+
+	return TRUE;
+}
+
+
+string CMemBench::GetText()
+{
+	const char *pszKernels[MEMBENCH_KERNELS] = {"Copy", "Scale", "Triad"};
+	const char *pszISAs[MEMBENCH_ISAS] = {"SSE2", "AVX2"};
+	string sText = "";
+
+	sText += utils.StrFormat("Bandwidth (MB/s)         1 thread  %2u threads\n", uiThreads);
+	for (int iISA = 0; iISA < MEMBENCH_ISAS; iISA++)
+	{
+		if (!bISA[iISA])
+			continue;
+
+		for (int iKernel = 0; iKernel < MEMBENCH_KERNELS; iKernel++)
+		{
+			string sName = utils.StrFormat("%s %s:", pszKernels[iKernel], pszISAs[iISA]);
+			sText += utils.StrFormat("  %-20s %10.0f %12.0f\n", sName.c_str(), dBandwidth[iISA][iKernel][0], dBandwidth[iISA][iKernel][1]);
+		}
+	}
+
+	sText += "\nLatency (ns)\n";
+	for (size_t n = 0; n < vLatency.size(); n++)
+	{
+		string sSize = (vLatency[n].nBytes >= (1024 * 1024)) ? utils.StrFormat("%u MiB:", (unsigned int)(vLatency[n].nBytes / (1024 * 1024))) : utils.StrFormat("%u KiB:", (unsigned int)(vLatency[n].nBytes / 1024));
+		sText += utils.StrFormat("  %-20s %10.1f\n", sSize.c_str(), vLatency[n].dNS);
+	}
+
+	return sText;
+}
+
+
+double CMemBench::MeasureBandwidth(int i_kernel, int i_isa, unsigned int ui_threads)
+{
+	double dBytes = (double)nElements * sizeof(double) * ((i_kernel == MEMBENCH_TRIAD) ? 3.0 : 2.0);
+	double dBest = 0.0;
+	size_t nPerThread = ((nElements / ui_threads) / (MEMBENCH_LINE / sizeof(double))) * (MEMBENCH_LINE / sizeof(double));
+
+	stSlice slices[MEMBENCH_MAX_THREADS];
+	HANDLE hThreads[MEMBENCH_MAX_THREADS];
+
+	for (int iRepeat = 0; iRepeat < MEMBENCH_REPEATS; iRepeat++)
+	{
+		double dStart = 0.0;
+
+		if (ui_threads == 1)
+		{
+			dStart = timer.GetTimer();
+			if (i_isa == MEMBENCH_AVX2)
+				RunKernelAVX2(i_kernel, pA, pB, pC, 0, nElements);
+			else
+				RunKernelSSE2(i_kernel, pA, pB, pC, 0, nElements);
+		}
+		else
+		{
+			//threads wait on the start event so that their creation is not timed
+			::ResetEvent(hStartEvent);
+			unsigned int uiStarted = 0;
+			for (unsigned int uiThread = 0; uiThread < ui_threads; uiThread++)
+			{
+				slices[uiThread].pThis = this;
+				slices[uiThread].nBegin = uiThread * nPerThread;
+				slices[uiThread].nEnd = (uiThread == (ui_threads - 1)) ? nElements : (uiThread + 1) * nPerThread;
+				slices[uiThread].iKernel = i_kernel;
+				slices[uiThread].iISA = i_isa;
+
+				hThreads[uiStarted] = (HANDLE)_beginthreadex(NULL, 0, ThreadProc, &slices[uiThread], 0, NULL);
+				if (hThreads[uiStarted] != NULL)
+					++uiStarted;
+			}
+
+			::Sleep(10);
+			dStart = timer.GetTimer();
+			::SetEvent(hStartEvent);
+			::WaitForMultipleObjects(uiStarted, hThreads, TRUE, INFINITE);
+
+			for (unsigned int uiThread = 0; uiThread < uiStarted; uiThread++)
+				::CloseHandle(hThreads[uiThread]);
+
+			if (uiStarted < ui_threads)
+				return 0.0;
+		}
+
+		double dSeconds = timer.GetTimer() - dStart;
+		if ((dSeconds > 0.0) && ((dBytes / dSeconds) > dBest))
+			dBest = dBytes / dSeconds;
+	}
+
+	return dBest / 1.0e+6;
+}
+
+
+unsigned __stdcall CMemBench::ThreadProc(void *p_slice)
+{
+	stSlice *pSlice = (stSlice*)p_slice;
+	CMemBench *pThis = pSlice->pThis;
+
+	::WaitForSingleObject(pThis->hStartEvent, INFINITE);
+
+	if (pSlice->iISA == MEMBENCH_AVX2)
+		RunKernelAVX2(pSlice->iKernel, pThis->pA, pThis->pB, pThis->pC, pSlice->nBegin, pSlice->nEnd);
+	else
+		RunKernelSSE2(pSlice->iKernel, pThis->pA, pThis->pB, pThis->pC, pSlice->nBegin, pSlice->nEnd);
+
+	return 0;
+}
+
+
+void CMemBench::RunKernelSSE2(int i_kernel, double *p_a, double *p_b, double *p_c, size_t n_begin, size_t n_end)
+{
+	__m128d vScale = _mm_set1_pd(3.0);
+	size_t n = 0;
+
+	if (i_kernel == MEMBENCH_COPY)
+	{
+		for (n = n_begin; n < n_end; n += 2)
+			_mm_store_pd(p_c + n, _mm_load_pd(p_a + n));
+	}
+	else if (i_kernel == MEMBENCH_SCALE)
+	{
+		for (n = n_begin; n < n_end; n += 2)
+			_mm_store_pd(p_b + n, _mm_mul_pd(vScale, _mm_load_pd(p_c + n)));
+	}
+	else
+	{
+		for (n = n_begin; n < n_end; n += 2)
+			_mm_store_pd(p_a + n, _mm_add_pd(_mm_load_pd(p_b + n), _mm_mul_pd(vScale, _mm_load_pd(p_c + n))));
+	}
+}
+
+
+MEMBENCH_TARGET_AVX2 void CMemBench::RunKernelAVX2(int i_kernel, double *p_a, double *p_b, double *p_c, size_t n_begin, size_t n_end)
+{
+	__m256d vScale = _mm256_set1_pd(3.0);
+	size_t n = 0;
+
+	if (i_kernel == MEMBENCH_COPY)
+	{
+		for (n = n_begin; n < n_end; n += 4)
+			_mm256_store_pd(p_c + n, _mm256_load_pd(p_a + n));
+	}
+	else if (i_kernel == MEMBENCH_SCALE)
+	{
+		for (n = n_begin; n < n_end; n += 4)
+			_mm256_store_pd(p_b + n, _mm256_mul_pd(vScale, _mm256_load_pd(p_c + n)));
+	}
+	else
+	{
+		for (n = n_begin; n < n_end; n += 4)
+			_mm256_store_pd(p_a + n, _mm256_add_pd(_mm256_load_pd(p_b + n), _mm256_mul_pd(vScale, _mm256_load_pd(p_c + n))));
+	}
+
+	_mm256_zeroupper();
+}
+
+
+double CMemBench::MeasureLatency(size_t n_bytes)
+{
+	size_t nLines = n_bytes / MEMBENCH_LINE;
+	char *pBuffer = (char*)_aligned_malloc(n_bytes, MEMBENCH_LINE);
+	if (pBuffer == NULL)
+		return -1.0;
+
+	//lines are linked in random order so that the hardware prefetchers cannot follow the chain
+	vector<size_t> vOrder(nLines);
+	for (size_t n = 0; n < nLines; n++)
+		vOrder[n] = n;
+
+	unsigned int uiSeed = 0x9E3779B9;
+	for (size_t n = nLines - 1; n > 0; n--)
+	{
+		uiSeed ^= uiSeed << 13;
+		uiSeed ^= uiSeed >> 17;
+		uiSeed ^= uiSeed << 5;
+		std::swap(vOrder[n], vOrder[uiSeed % (n + 1)]);
+	}
+
+	for (size_t n = 0; n < nLines; n++)
+		*(void**)(pBuffer + vOrder[n] * MEMBENCH_LINE) = pBuffer + vOrder[(n + 1) % nLines] * MEMBENCH_LINE;
+
+	void **pNode = (void**)pBuffer;
+	for (size_t n = 0; n < nLines; n++) //warm up
+		pNode = (void**)*pNode;
+
+	double dStart = timer.GetTimer();
+	for (size_t n = 0; n < MEMBENCH_CHASE_STEPS; n++)
+		pNode = (void**)*pNode;
+	double dSeconds = timer.GetTimer() - dStart;
+
+	nChaseSink = (size_t)pNode;
+	_aligned_free(pBuffer);
+
+	return (dSeconds * 1.0e+9) / (double)MEMBENCH_CHASE_STEPS;
+}
+
+
+#endif //_MEMBENCH_H
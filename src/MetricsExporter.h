@@ -0,0 +1,519 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_METRICSEXPORTER_H)
+#define _METRICSEXPORTER_H
+
+#include "common.h"
+#include "Utility.h"
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define SD_SEND        SHUT_WR
+#define SD_BOTH        SHUT_RDWR
+
+static int closesocket(SOCKET s) { return close(s); }
+static int WSAGetLastError() { return errno; }
+#endif
+
+#define METRICS_DEFAULT_PROM_PORT    9273
+#define METRICS_DEFAULT_STATSD_PORT  8125
+#define METRICS_PUSH_INTERVAL        1000  //milliseconds, statsd
+#define METRICS_POLL_INTERVAL        250   //milliseconds, accept()/shutdown check
+#define METRICS_CLIENT_TIMEOUT       2000  //milliseconds a scrape may take to send its request or to read the response
+#define METRICS_STOP_TIMEOUT         5000  //milliseconds Stop() waits for the exporter thread
+
+struct stMetricsSnapshot
+{
+	unsigned int uiFrame;
+	unsigned int uiFramesRead;
+	double       dFPSCurrent;
+	double       dFPSAverage;
+	unsigned int uiFrameInterval;
+	double       dTPFP50;  //ms, percentiles of the interval averages, not of single frames
+	double       dTPFP90;
+	double       dTPFP99;
+	DWORD        dwMemMB;
+	double       dCPUUsage;
+	WORD         wThreadCount;
+};
+
+
+/*
+	Publishes the snapshot of the console refresh from a background thread,
+	either as Prometheus text on http://127.0.0.1:<port>/metrics or as statsd
+	gauges over UDP. The benchmark thread only copies the snapshot under a lock.
+	Frames are timed per measurement interval, so the frame time percentiles
+	are those of the interval averages and are exported under that name.
+*/
+class CMetricsExporter
+{
+public:
+	CMetricsExporter();
+	virtual ~CMetricsExporter();
+
+	BOOL   Start(string s_spec);  //"prometheus[:port]" or "statsd[:host[:port]]"
+	void   Stop();
+	void   Publish(const stMetricsSnapshot &snapshot);
+	string sEndpoint;
+	string sError;
+	BOOL   bRunning;
+
+private:
+	static unsigned __stdcall ThreadProc(void *p_this);
+	void   ServePrometheus();
+	void   PushStatsd();
+	string FormatPrometheus(const stMetricsSnapshot &snapshot);
+	string FormatStatsd(const stMetricsSnapshot &snapshot);
+	BOOL   WaitReadable(SOCKET s);
+
+	BOOL   bPrometheus;
+	string sHost;
+	WORD   wPort;
+	SOCKET sock;
+	SOCKET client;                  //scrape in progress, shut down by Stop()
+	CRITICAL_SECTION csClient;
+	sockaddr_in addrStatsd;
+	HANDLE hThread;
+	HANDLE hStopEvent;
+	BOOL   bWSAStarted;
+	BOOL   bHaveSnapshot;
+	BOOL   bAbandoned;              //Stop() gave up on the thread
+	stMetricsSnapshot latest;
+	CRITICAL_SECTION csSnapshot;
+	CUtils utils;
+};
+
+
+CMetricsExporter::CMetricsExporter()
+{
+	sEndpoint = "";
+	sError = "";
+	bRunning = FALSE;
+	bPrometheus = TRUE;
+	sHost = "127.0.0.1";
+	wPort = 0;
+	sock = INVALID_SOCKET;
+	client = INVALID_SOCKET;
+	hThread = NULL;
+	hStopEvent = NULL;
+	bWSAStarted = FALSE;
+	bHaveSnapshot = FALSE;
+	bAbandoned = FALSE;
+	memset(&latest, 0, sizeof(latest));
+	memset(&addrStatsd, 0, sizeof(addrStatsd));
+	::InitializeCriticalSection(&csSnapshot);
+	::InitializeCriticalSection(&csClient);
+}
+
+CMetricsExporter::~CMetricsExporter()
+{
+	Stop();
+	if (bAbandoned)
+		return;
+
+	::DeleteCriticalSection(&csClient);
+	::DeleteCriticalSection(&csSnapshot);
+}
+
+
+BOOL CMetricsExporter::Start(string s_spec)
+{
+	sError = "";
+	Stop();
+
+	vector<string> vParts;
+	size_t nPos = 0;
+	size_t nColon = 0;
+	while ((nColon = s_spec.find(':', nPos)) != string::npos)
+	{
+		vParts.push_back(s_spec.substr(nPos, nColon - nPos));
+		nPos = nColon + 1;
+	}
+	vParts.push_back(s_spec.substr(nPos));
+
+	string sType = vParts[0];
+	transform(sType.begin(), sType.end(), sType.begin(), ::tolower);
+	string sPort = "";
+
+	if ((sType == "prometheus") && (vParts.size() <= 2))
+	{
+		bPrometheus = TRUE;
+		wPort = METRICS_DEFAULT_PROM_PORT;
+		if (vParts.size() == 2)
+			sPort = vParts[1];
+	}
+	else if ((sType == "statsd") && (vParts.size() <= 3))
+	{
+		bPrometheus = FALSE;
+		wPort = METRICS_DEFAULT_STATSD_PORT;
+		if ((vParts.size() >= 2) && (vParts[1] != ""))
+			sHost = vParts[1];
+		if (vParts.size() == 3)
+			sPort = vParts[2];
+	}
+	else
+	{
+		sError = "Invalid metrics exporter \"" + s_spec + "\", use prometheus[:port] or statsd[:host[:port]]";
+		return FALSE;
+	}
+
+	if (sPort != "")
+	{
+		if (!utils.IsNumeric(sPort) || (atoi(sPort.c_str()) < 1) || (atoi(sPort.c_str()) > 65535))
+		{
+			sError = "Invalid metrics port \"" + sPort + "\"";
+			return FALSE;
+		}
+		wPort = (WORD)atoi(sPort.c_str());
+	}
+
+#if defined(_WIN32)
+	WSADATA wsaData;
+	if (::WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		sError = "WSAStartup() failed";
+		return FALSE;
+	}
+	bWSAStarted = TRUE;
+#endif
+
+	if (bPrometheus)
+	{
+		//loopback only, the endpoint is not meant to be reachable from outside
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(wPort);
+
+		sock = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+#if !defined(_WIN32)
+		//the connections of the previous run linger in TIME_WAIT
+		int iReuse = 1;
+		if (sock != INVALID_SOCKET)
+			::setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &iReuse, sizeof(iReuse));
+#endif
+		if ((sock == INVALID_SOCKET) || (::bind(sock, (sockaddr *)&addr, sizeof(addr)) != 0) || (::listen(sock, 4) != 0))
+		{
+			sError = utils.StrFormat("Cannot listen on 127.0.0.1:%u (error %d)", wPort, ::WSAGetLastError());
+			Stop();
+			return FALSE;
+		}
+
+		sEndpoint = utils.StrFormat("http://127.0.0.1:%u/metrics", wPort);
+	}
+	else
+	{
+		addrinfo hints;
+		addrinfo *pResult = NULL;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_DGRAM;
+		if ((::getaddrinfo(sHost.c_str(), NULL, &hints, &pResult) != 0) || !pResult)
+		{
+			sError = "Cannot resolve statsd host \"" + sHost + "\"";
+			Stop();
+			return FALSE;
+		}
+
+		memcpy(&addrStatsd, pResult->ai_addr, sizeof(addrStatsd));
+		addrStatsd.sin_port = htons(wPort);
+		::freeaddrinfo(pResult);
+
+		sock = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (sock == INVALID_SOCKET)
+		{
+			sError = utils.StrFormat("Cannot create UDP socket (error %d)", ::WSAGetLastError());
+			Stop();
+			return FALSE;
+		}
+
+		sEndpoint = utils.StrFormat("statsd udp://%s:%u", sHost.c_str(), wPort);
+	}
+
+	hStopEvent = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+	hThread = (HANDLE)_beginthreadex(NULL, 0, ThreadProc, this, 0, NULL);
+	if (!hStopEvent || !hThread)
+	{
+		sError = "Cannot create the metrics exporter thread";
+		Stop();
+		return FALSE;
+	}
+
+	bRunning = TRUE;
+
+	return TRUE;
+}
+
+
+void CMetricsExporter::Stop()
+{
+	if (hThread)
+	{
+		::SetEvent(hStopEvent);
+
+		//a scrape that is still connected must not keep AVSMeter from exiting
+		::EnterCriticalSection(&csClient);
+		if (client != INVALID_SOCKET)
+			::shutdown(client, SD_BOTH);
+		::LeaveCriticalSection(&csClient);
+
+		//the thread checks the stop event at least every METRICS_POLL_INTERVAL ms and sends
+		//with a timeout, should it still hang it keeps its socket and event, the process is about to exit
+		if (::WaitForSingleObject(hThread, METRICS_STOP_TIMEOUT) != WAIT_OBJECT_0)
+		{
+			bAbandoned = TRUE;
+			hThread = NULL;
+			hStopEvent = NULL;
+			sock = INVALID_SOCKET;
+			bRunning = FALSE;
+			return;
+		}
+
+		::CloseHandle(hThread);
+		hThread = NULL;
+	}
+
+	if (hStopEvent)
+	{
+		::CloseHandle(hStopEvent);
+		hStopEvent = NULL;
+	}
+
+	if (sock != INVALID_SOCKET)
+	{
+		::closesocket(sock);
+		sock = INVALID_SOCKET;
+	}
+
+#if defined(_WIN32)
+	if (bWSAStarted)
+	{
+		::WSACleanup();
+		bWSAStarted = FALSE;
+	}
+#endif
+
+	bRunning = FALSE;
+
+	return;
+}
+
+
+void CMetricsExporter::Publish(const stMetricsSnapshot &snapshot)
+{
+	if (!bRunning)
+		return;
+
+	::EnterCriticalSection(&csSnapshot);
+	latest = snapshot;
+	bHaveSnapshot = TRUE;
+	::LeaveCriticalSection(&csSnapshot);
+
+	return;
+}
+
+
+unsigned __stdcall CMetricsExporter::ThreadProc(void *p_this)
+{
+	CMetricsExporter *pThis = (CMetricsExporter *)p_this;
+
+	if (pThis->bPrometheus)
+		pThis->ServePrometheus();
+	else
+		pThis->PushStatsd();
+
+	return 0;
+}
+
+
+void CMetricsExporter::ServePrometheus()
+{
+	char szRequest[1024];
+	fd_set fdsRead;
+	timeval tv;
+
+	while (::WaitForSingleObject(hStopEvent, 0) != WAIT_OBJECT_0)
+	{
+		FD_ZERO(&fdsRead);
+		FD_SET(sock, &fdsRead);
+		tv.tv_sec = 0;
+		tv.tv_usec = METRICS_POLL_INTERVAL * 1000;
+		if (::select((int)sock + 1, &fdsRead, NULL, NULL, &tv) <= 0)
+			continue;
+
+		SOCKET accepted = ::accept(sock, NULL, NULL);
+		if (accepted == INVALID_SOCKET)
+			continue;
+
+		::EnterCriticalSection(&csClient);
+		client = accepted;
+		::LeaveCriticalSection(&csClient);
+
+		//a client that never reads would block send() once the socket buffer is full
+#if defined(_WIN32)
+		DWORD dwTimeout = METRICS_CLIENT_TIMEOUT;
+		::setsockopt(accepted, SOL_SOCKET, SO_SNDTIMEO, (const char *)&dwTimeout, sizeof(dwTimeout));
+#else
+		timeval tvTimeout;
+		tvTimeout.tv_sec = METRICS_CLIENT_TIMEOUT / 1000;
+		tvTimeout.tv_usec = (METRICS_CLIENT_TIMEOUT % 1000) * 1000;
+		::setsockopt(accepted, SOL_SOCKET, SO_SNDTIMEO, &tvTimeout, sizeof(tvTimeout));
+#endif
+
+		//the request itself is irrelevant, every path returns the metrics, idle connections are dropped
+		if (!WaitReadable(accepted) || (::recv(accepted, szRequest, sizeof(szRequest), 0) <= 0))
+		{
+			::EnterCriticalSection(&csClient);
+			client = INVALID_SOCKET;
+			::LeaveCriticalSection(&csClient);
+			::closesocket(accepted);
+			continue;
+		}
+
+		::EnterCriticalSection(&csSnapshot);
+		stMetricsSnapshot snapshot = latest;
+		BOOL bValid = bHaveSnapshot;
+		::LeaveCriticalSection(&csSnapshot);
+
+		string sBody = bValid ? FormatPrometheus(snapshot) : "";
+		string sResponse = utils.StrFormat("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %u\r\nConnection: close\r\n\r\n", (unsigned int)sBody.length());
+		sResponse += sBody;
+#if defined(_WIN32)
+		::send(accepted, sResponse.c_str(), (int)sResponse.length(), 0);
+#else
+		::send(accepted, sResponse.c_str(), sResponse.length(), MSG_NOSIGNAL);
+#endif
+		::shutdown(accepted, SD_SEND);
+
+		::EnterCriticalSection(&csClient);
+		client = INVALID_SOCKET;
+		::LeaveCriticalSection(&csClient);
+		::closesocket(accepted);
+	}
+
+	return;
+}
+
+
+//TRUE when data (or the end of the connection) arrived within METRICS_CLIENT_TIMEOUT and Stop() was not called
+BOOL CMetricsExporter::WaitReadable(SOCKET s)
+{
+	fd_set fdsRead;
+	timeval tv;
+
+	for (DWORD dwWaited = 0; dwWaited < METRICS_CLIENT_TIMEOUT; dwWaited += METRICS_POLL_INTERVAL)
+	{
+		if (::WaitForSingleObject(hStopEvent, 0) == WAIT_OBJECT_0)
+			return FALSE;
+
+		FD_ZERO(&fdsRead);
+		FD_SET(s, &fdsRead);
+		tv.tv_sec = 0;
+		tv.tv_usec = METRICS_POLL_INTERVAL * 1000;
+		int iRet = ::select((int)s + 1, &fdsRead, NULL, NULL, &tv);
+		if (iRet > 0)
+			return TRUE;
+		if (iRet < 0)
+			return FALSE;
+	}
+
+	return FALSE;
+}
+
+
+void CMetricsExporter::PushStatsd()
+{
+	while (::WaitForSingleObject(hStopEvent, METRICS_PUSH_INTERVAL) != WAIT_OBJECT_0)
+	{
+		::EnterCriticalSection(&csSnapshot);
+		stMetricsSnapshot snapshot = latest;
+		BOOL bValid = bHaveSnapshot;
+		::LeaveCriticalSection(&csSnapshot);
+
+		if (!bValid)
+			continue;
+
+		string sPacket = FormatStatsd(snapshot);
+		::sendto(sock, sPacket.c_str(), (int)sPacket.length(), 0, (sockaddr *)&addrStatsd, sizeof(addrStatsd));
+	}
+
+	return;
+}
+
+
+string CMetricsExporter::FormatPrometheus(const stMetricsSnapshot &snapshot)
+{
+	string sRet = "";
+
+	sRet += "# HELP avsmeter_frames_processed_total Frames requested from the script so far.\n";
+	sRet += "# TYPE avsmeter_frames_processed_total counter\n";
+	sRet += utils.StrFormat("avsmeter_frames_processed_total %u\n", snapshot.uiFramesRead);
+	sRet += "# TYPE avsmeter_current_frame gauge\n";
+	sRet += utils.StrFormat("avsmeter_current_frame %u\n", snapshot.uiFrame);
+	sRet += "# TYPE avsmeter_fps gauge\n";
+	sRet += utils.StrFormat("avsmeter_fps{window=\"current\"} %.3f\n", snapshot.dFPSCurrent);
+	sRet += utils.StrFormat("avsmeter_fps{window=\"average\"} %.3f\n", snapshot.dFPSAverage);
+	sRet += "# HELP avsmeter_frame_interval Frames per measurement interval.\n";
+	sRet += "# TYPE avsmeter_frame_interval gauge\n";
+	sRet += utils.StrFormat("avsmeter_frame_interval %u\n", snapshot.uiFrameInterval);
+	sRet += "# HELP avsmeter_interval_frame_time_ms Percentiles of the average frame time per measurement interval since the start of the run.\n";
+	sRet += "# TYPE avsmeter_interval_frame_time_ms gauge\n";
+	sRet += utils.StrFormat("avsmeter_interval_frame_time_ms{quantile=\"0.5\"} %.3f\n", snapshot.dTPFP50);
+	sRet += utils.StrFormat("avsmeter_interval_frame_time_ms{quantile=\"0.9\"} %.3f\n", snapshot.dTPFP90);
+	sRet += utils.StrFormat("avsmeter_interval_frame_time_ms{quantile=\"0.99\"} %.3f\n", snapshot.dTPFP99);
+	sRet += "# TYPE avsmeter_memory_mib gauge\n";
+	sRet += utils.StrFormat("avsmeter_memory_mib %u\n", snapshot.dwMemMB);
+	sRet += "# TYPE avsmeter_cpu_usage_percent gauge\n";
+	sRet += utils.StrFormat("avsmeter_cpu_usage_percent %.1f\n", snapshot.dCPUUsage);
+	sRet += "# TYPE avsmeter_threads gauge\n";
+	sRet += utils.StrFormat("avsmeter_threads %u\n", snapshot.wThreadCount);
+
+	return sRet;
+}
+
+
+string CMetricsExporter::FormatStatsd(const stMetricsSnapshot &snapshot)
+{
+	string sRet = "";
+
+	sRet += utils.StrFormat("avsmeter.frames_processed:%u|g\n", snapshot.uiFramesRead);
+	sRet += utils.StrFormat("avsmeter.fps.current:%.3f|g\n", snapshot.dFPSCurrent);
+	sRet += utils.StrFormat("avsmeter.fps.average:%.3f|g\n", snapshot.dFPSAverage);
+	sRet += utils.StrFormat("avsmeter.frame_interval:%u|g\n", snapshot.uiFrameInterval);
+	sRet += utils.StrFormat("avsmeter.interval_frame_time_ms.p50:%.3f|g\n", snapshot.dTPFP50);
+	sRet += utils.StrFormat("avsmeter.interval_frame_time_ms.p90:%.3f|g\n", snapshot.dTPFP90);
+	sRet += utils.StrFormat("avsmeter.interval_frame_time_ms.p99:%.3f|g\n", snapshot.dTPFP99);
+	sRet += utils.StrFormat("avsmeter.memory_mib:%u|g\n", snapshot.dwMemMB);
+	sRet += utils.StrFormat("avsmeter.cpu_usage_percent:%.1f|g\n", snapshot.dCPUUsage);
+	sRet += utils.StrFormat("avsmeter.threads:%u|g", snapshot.wThreadCount);
+
+	return sRet;
+}
+
+
+#endif //_METRICSEXPORTER_H
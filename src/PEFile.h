@@ -0,0 +1,469 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_PEFILE_H)
+#define _PEFILE_H
+
+#include "common.h"
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#define PE_MACHINE_I386           0x014C
+#define PE_MACHINE_AMD64          0x8664
+#define PE_DIRECTORY_EXPORT       0
+#define PE_DIRECTORY_IMPORT       1
+#define PE_MAX_NAME_LENGTH        4096
+#define PE_MAX_IMPORTS            65536
+
+
+/*
+	Read-only PE32/PE32+ parser, works directly on a memory mapped file (or any
+	buffer passed to Attach()) without copying. All offsets are checked against
+	the file size, a corrupt file makes the functions fail instead of faulting.
+	The structures are decoded byte by byte so the parser does not depend on
+	the Windows headers or the host bitness.
+*/
+class CPEFile
+{
+public:
+	CPEFile();
+	virtual ~CPEFile();
+
+	BOOL   Open(const string &s_file);
+	BOOL   Attach(const unsigned char *p_data, size_t n_size);
+	void   Close();
+	BOOL   GetDataDirectory(unsigned int ui_index, DWORD &dw_rva, DWORD &dw_size);
+	const unsigned char *RvaToPtr(DWORD dw_rva, size_t n_size);
+	BOOL   GetExportNames(vector<string> &v_names);
+	BOOL   GetImportNames(vector<string> &v_names);
+	BOOL   bPE32Plus;
+	WORD   wMachine;
+	WORD   wSections;
+	string sError;
+
+private:
+	struct stSection
+	{
+		DWORD dwVirtualAddress;
+		DWORD dwVirtualSize;
+		DWORD dwRawSize;
+		DWORD dwRawOffset;
+	};
+
+	BOOL   Parse();
+	BOOL   Fail(const char *s_error);
+	BOOL   ReadWord(size_t n_offset, WORD &w_value);
+	BOOL   ReadDWord(size_t n_offset, DWORD &dw_value);
+	BOOL   ReadString(DWORD dw_rva, string &s_string);
+
+	const unsigned char *pData;
+	size_t nSize;
+	size_t nDataDirectory;   //file offset
+	DWORD  dwDataDirectories;
+	DWORD  dwSizeOfHeaders;
+	vector<stSection> vSections;
+	BOOL   bMapped;
+#if defined(_WIN32)
+	HANDLE hFile;
+	HANDLE hFileMapping;
+#else
+	int    iFD;
+#endif
+};
+
+
+CPEFile::CPEFile()
+{
+	pData = NULL;
+	nSize = 0;
+	bMapped = FALSE;
+#if defined(_WIN32)
+	hFile = INVALID_HANDLE_VALUE;
+	hFileMapping = NULL;
+#else
+	iFD = -1;
+#endif
+	Close();
+}
+
+CPEFile::~CPEFile()
+{
+	Close();
+}
+
+
+BOOL CPEFile::Open(const string &s_file)
+{
+	Close();
+
+#if defined(_WIN32)
+	hFile = ::CreateFile(s_file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return Fail("Cannot open file");
+
+	LARGE_INTEGER liSize;
+	if (!::GetFileSizeEx(hFile, &liSize) || (liSize.QuadPart == 0) || ((unsigned __int64)liSize.QuadPart > (unsigned __int64)((size_t)-1)))
+	{
+		Close();
+		::SetLastError(ERROR_BAD_EXE_FORMAT);
+		return Fail("Invalid file size");
+	}
+
+	hFileMapping = ::CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	pData = hFileMapping ? (const unsigned char *)::MapViewOfFile(hFileMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!pData)
+	{
+		DWORD dwError = ::GetLastError();
+		Close();
+		::SetLastError(dwError);
+		return Fail("Cannot map file");
+	}
+
+	nSize = (size_t)liSize.QuadPart;
+#else
+	iFD = open(s_file.c_str(), O_RDONLY);
+	if (iFD < 0)
+		return Fail("Cannot open file");
+
+	struct stat st;
+	if ((fstat(iFD, &st) != 0) || (st.st_size <= 0))
+	{
+		Close();
+		errno = ENOEXEC;
+		return Fail("Invalid file size");
+	}
+
+	void *pMap = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, iFD, 0);
+	if (pMap == MAP_FAILED)
+	{
+		int iError = errno;
+		Close();
+		errno = iError;
+		return Fail("Cannot map file");
+	}
+
+	pData = (const unsigned char *)pMap;
+	nSize = (size_t)st.st_size;
+#endif
+
+	bMapped = TRUE;
+
+	return Parse();
+}
+
+
+BOOL CPEFile::Attach(const unsigned char *p_data, size_t n_size)
+{
+	Close();
+	pData = p_data;
+	nSize = n_size;
+
+	return Parse();
+}
+
+
+void CPEFile::Close()
+{
+	if (bMapped && pData)
+	{
+#if defined(_WIN32)
+		::UnmapViewOfFile(pData);
+#else
+		munmap((void *)pData, nSize);
+#endif
+	}
+
+#if defined(_WIN32)
+	if (hFileMapping)
+		::CloseHandle(hFileMapping);
+	if (hFile != INVALID_HANDLE_VALUE)
+		::CloseHandle(hFile);
+	hFileMapping = NULL;
+	hFile = INVALID_HANDLE_VALUE;
+#else
+	if (iFD >= 0)
+		close(iFD);
+	iFD = -1;
+#endif
+
+	pData = NULL;
+	nSize = 0;
+	bMapped = FALSE;
+	bPE32Plus = FALSE;
+	wMachine = 0;
+	wSections = 0;
+	nDataDirectory = 0;
+	dwDataDirectories = 0;
+	dwSizeOfHeaders = 0;
+	vSections.clear();
+	sError = "";
+
+	return;
+}
+
+
+BOOL CPEFile::Parse()
+{
+	WORD wValue = 0;
+	DWORD dwValue = 0;
+	DWORD dwNTHeaders = 0;
+	WORD wOptionalHeaderSize = 0;
+
+	if (!ReadWord(0, wValue) || (wValue != 0x5A4D)) //"MZ"
+		return Fail("No DOS header");
+
+	if (!ReadDWord(0x3C, dwNTHeaders) || !ReadDWord(dwNTHeaders, dwValue) || (dwValue != 0x00004550)) //"PE\0\0"
+		return Fail("No PE header");
+
+	size_t nFileHeader = (size_t)dwNTHeaders + 4;
+	size_t nOptionalHeader = nFileHeader + 20;
+	if (!ReadWord(nFileHeader, wMachine) || !ReadWord(nFileHeader + 2, wSections) || !ReadWord(nFileHeader + 16, wOptionalHeaderSize))
+		return Fail("Truncated file header");
+
+	if (!ReadWord(nOptionalHeader, wValue))
+		return Fail("Truncated optional header");
+
+	if (wValue == 0x010B)
+		bPE32Plus = FALSE;
+	else if (wValue == 0x020B)
+		bPE32Plus = TRUE;
+	else
+		return Fail("Unknown optional header magic");
+
+	nDataDirectory = nOptionalHeader + (bPE32Plus ? 112 : 96);
+	if (!ReadDWord(nOptionalHeader + 60, dwSizeOfHeaders) || !ReadDWord(nOptionalHeader + (bPE32Plus ? 108 : 92), dwDataDirectories))
+		return Fail("Truncated optional header");
+
+	//the directories must lie within the optional header, the count is checked before multiplying so it cannot wrap on 32 bit
+	size_t nMaxDirectories = ((nOptionalHeader + wOptionalHeaderSize) > nDataDirectory) ? ((nOptionalHeader + wOptionalHeaderSize - nDataDirectory) / 8) : 0;
+	if ((size_t)dwDataDirectories > nMaxDirectories)
+		dwDataDirectories = (DWORD)nMaxDirectories;
+
+	size_t nSection = nOptionalHeader + wOptionalHeaderSize;
+	stSection section;
+	for (WORD i = 0; i < wSections; i++, nSection += 40)
+	{
+		if (!ReadDWord(nSection + 8, section.dwVirtualSize) || !ReadDWord(nSection + 12, section.dwVirtualAddress) ||
+		    !ReadDWord(nSection + 16, section.dwRawSize) || !ReadDWord(nSection + 20, section.dwRawOffset))
+			return Fail("Truncated section table");
+
+		vSections.push_back(section);
+	}
+
+	return TRUE;
+}
+
+
+BOOL CPEFile::Fail(const char *s_error)
+{
+	sError = s_error;
+
+	return FALSE;
+}
+
+
+BOOL CPEFile::ReadWord(size_t n_offset, WORD &w_value)
+{
+	if ((n_offset >= nSize) || ((nSize - n_offset) < 2))
+		return FALSE;
+
+	w_value = (WORD)(pData[n_offset] | (pData[n_offset + 1] << 8));
+
+	return TRUE;
+}
+
+
+BOOL CPEFile::ReadDWord(size_t n_offset, DWORD &dw_value)
+{
+	if ((n_offset >= nSize) || ((nSize - n_offset) < 4))
+		return FALSE;
+
+	dw_value = (DWORD)pData[n_offset] | ((DWORD)pData[n_offset + 1] << 8) | ((DWORD)pData[n_offset + 2] << 16) | ((DWORD)pData[n_offset + 3] << 24);
+
+	return TRUE;
+}
+
+
+BOOL CPEFile::GetDataDirectory(unsigned int ui_index, DWORD &dw_rva, DWORD &dw_size)
+{
+	dw_rva = 0;
+	dw_size = 0;
+
+	if (ui_index >= dwDataDirectories)
+		return FALSE;
+
+	if (!ReadDWord(nDataDirectory + ui_index * 8, dw_rva) || !ReadDWord(nDataDirectory + ui_index * 8 + 4, dw_size))
+		return FALSE;
+
+	return (dw_rva != 0) ? TRUE : FALSE;
+}
+
+
+const unsigned char *CPEFile::RvaToPtr(DWORD dw_rva, size_t n_size)
+{
+	size_t nOffset = 0;
+	size_t nAvailable = 0;
+	BOOL bFound = FALSE;
+
+	for (size_t i = 0; i < vSections.size(); i++)
+	{
+		DWORD dwSpan = (vSections[i].dwVirtualSize > vSections[i].dwRawSize) ? vSections[i].dwVirtualSize : vSections[i].dwRawSize;
+		if ((dw_rva < vSections[i].dwVirtualAddress) || ((dw_rva - vSections[i].dwVirtualAddress) >= dwSpan))
+			continue;
+
+		//the part beyond the raw data is zero filled at runtime and not in the file
+		DWORD dwDelta = dw_rva - vSections[i].dwVirtualAddress;
+		if (dwDelta >= vSections[i].dwRawSize)
+			return NULL;
+
+		//raw offset + delta can exceed 4 GiB and wrap a 32 bit size_t
+		unsigned __int64 uiOffset = (unsigned __int64)vSections[i].dwRawOffset + dwDelta;
+		if (uiOffset >= (unsigned __int64)nSize)
+			return NULL;
+
+		nOffset = (size_t)uiOffset;
+		nAvailable = vSections[i].dwRawSize - dwDelta;
+		bFound = TRUE;
+		break;
+	}
+
+	if (!bFound)
+	{
+		if (dw_rva >= dwSizeOfHeaders)
+			return NULL;
+
+		nOffset = dw_rva;
+		nAvailable = dwSizeOfHeaders - dw_rva;
+	}
+
+	if ((nOffset >= nSize) || (n_size > nAvailable) || (n_size > (nSize - nOffset)))
+		return NULL;
+
+	return pData + nOffset;
+}
+
+
+BOOL CPEFile::ReadString(DWORD dw_rva, string &s_string)
+{
+	s_string = "";
+
+	const unsigned char *pString = RvaToPtr(dw_rva, 1);
+	if (!pString)
+		return FALSE;
+
+	size_t nMax = nSize - (size_t)(pString - pData);
+	if (nMax > PE_MAX_NAME_LENGTH)
+		nMax = PE_MAX_NAME_LENGTH;
+
+	size_t nLength = 0;
+	while ((nLength < nMax) && (pString[nLength] != 0))
+		++nLength;
+
+	if (nLength == nMax) //not terminated
+		return FALSE;
+
+	s_string.assign((const char *)pString, nLength);
+
+	return TRUE;
+}
+
+
+BOOL CPEFile::GetExportNames(vector<string> &v_names)
+{
+	v_names.clear();
+
+	DWORD dwRva = 0;
+	DWORD dwSize = 0;
+	if (!GetDataDirectory(PE_DIRECTORY_EXPORT, dwRva, dwSize))
+		return FALSE;
+
+	const unsigned char *pExport = RvaToPtr(dwRva, 40);
+	if (!pExport)
+		return FALSE;
+
+	DWORD dwNames = (DWORD)pExport[24] | ((DWORD)pExport[25] << 8) | ((DWORD)pExport[26] << 16) | ((DWORD)pExport[27] << 24);
+	DWORD dwNamesRva = (DWORD)pExport[32] | ((DWORD)pExport[33] << 8) | ((DWORD)pExport[34] << 16) | ((DWORD)pExport[35] << 24);
+	if (dwNames == 0)
+		return TRUE;
+
+	//NumberOfNames * 4 would wrap a 32 bit size_t
+	if ((size_t)dwNames > (((size_t)-1) / 4))
+		return FALSE;
+
+	const unsigned char *pNames = RvaToPtr(dwNamesRva, (size_t)dwNames * 4);
+	if (!pNames)
+		return FALSE;
+
+	string sName = "";
+	for (DWORD i = 0; i < dwNames; i++)
+	{
+		DWORD dwNameRva = (DWORD)pNames[i * 4] | ((DWORD)pNames[i * 4 + 1] << 8) | ((DWORD)pNames[i * 4 + 2] << 16) | ((DWORD)pNames[i * 4 + 3] << 24);
+		if (ReadString(dwNameRva, sName))
+			v_names.push_back(sName);
+	}
+
+	return TRUE;
+}
+
+
+BOOL CPEFile::GetImportNames(vector<string> &v_names)
+{
+	v_names.clear();
+
+	DWORD dwRva = 0;
+	DWORD dwSize = 0;
+	if (!GetDataDirectory(PE_DIRECTORY_IMPORT, dwRva, dwSize))
+		return FALSE;
+
+	//IMAGE_IMPORT_DESCRIPTOR: 20 bytes, Name at +12, terminated by an all zero entry
+	string sName = "";
+	for (DWORD i = 0; i < PE_MAX_IMPORTS; i++)
+	{
+		const unsigned char *pDescriptor = RvaToPtr(dwRva + i * 20, 20);
+		if (!pDescriptor)
+			return FALSE;
+
+		BOOL bNull = TRUE;
+		for (int j = 0; j < 20; j++)
+		{
+			if (pDescriptor[j] != 0)
+			{
+				bNull = FALSE;
+				break;
+			}
+		}
+
+		if (bNull)
+			break;
+
+		DWORD dwNameRva = (DWORD)pDescriptor[12] | ((DWORD)pDescriptor[13] << 8) | ((DWORD)pDescriptor[14] << 16) | ((DWORD)pDescriptor[15] << 24);
+		if (ReadString(dwNameRva, sName))
+			v_names.push_back(sName);
+	}
+
+	return TRUE;
+}
+
+
+#endif //_PEFILE_H
@@ -0,0 +1,237 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_PERFCOUNTERS_H)
+#define _PERFCOUNTERS_H
+
+#include "common.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+#define PERFCOUNTER_CYCLES            0
+#define PERFCOUNTER_INSTRUCTIONS      1
+#define PERFCOUNTER_LLC_MISSES        2
+#define PERFCOUNTER_BRANCH_MISSES     3
+#define PERFCOUNTER_TASK_CLOCK        4  //nanoseconds
+#define PERFCOUNTER_CONTEXT_SWITCHES  5
+#define PERFCOUNTER_COUNT             6
+
+struct stPerfCounterValues
+{
+	unsigned __int64 uiValue[PERFCOUNTER_COUNT];
+	BOOL             bValid[PERFCOUNTER_COUNT];
+};
+
+
+class CPerfCounters
+{
+public:
+	CPerfCounters();
+	virtual ~CPerfCounters();
+
+	BOOL Open();
+	void Close();
+	BOOL Read(stPerfCounterValues &values);
+	void Delta(const stPerfCounterValues &cur, const stPerfCounterValues &prev, stPerfCounterValues &delta);
+	BOOL bInitialized;
+	string sError;
+
+private:
+#if defined(__linux__)
+	int OpenEvent(unsigned int ui_type, unsigned long long ull_config);
+	int iFD[PERFCOUNTER_COUNT];
+#endif
+};
+
+
+CPerfCounters::CPerfCounters()
+{
+	bInitialized = FALSE;
+	sError = "";
+#if defined(__linux__)
+	for (int i = 0; i < PERFCOUNTER_COUNT; i++)
+		iFD[i] = -1;
+#endif
+}
+
+CPerfCounters::~CPerfCounters()
+{
+	Close();
+}
+
+
+#if defined(__linux__)
+
+int CPerfCounters::OpenEvent(unsigned int ui_type, unsigned long long ull_config)
+{
+	struct perf_event_attr pea;
+	memset(&pea, 0, sizeof(pea));
+	pea.size = sizeof(pea);
+	pea.type = ui_type;
+	pea.config = ull_config;
+	pea.disabled = 1;
+	pea.inherit = 1;
+	pea.exclude_hv = 1;
+	pea.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return (int)syscall(__NR_perf_event_open, &pea, 0, -1, -1, 0);
+}
+
+
+BOOL CPerfCounters::Open()
+{
+	/*
+	Avisynth creates its worker threads while the script is loaded, so the
+	counters have to be opened before that and inherited by new threads.
+	PERF_FORMAT_GROUP cannot be combined with inherit, each event is therefore
+	opened on its own and scaled by enabled/running time if multiplexed.
+	*/
+	sError = "";
+	Close();
+
+	iFD[PERFCOUNTER_CYCLES]           = OpenEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	iFD[PERFCOUNTER_INSTRUCTIONS]     = OpenEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	iFD[PERFCOUNTER_LLC_MISSES]       = OpenEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	iFD[PERFCOUNTER_BRANCH_MISSES]    = OpenEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+	iFD[PERFCOUNTER_TASK_CLOCK]       = OpenEvent(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+	iFD[PERFCOUNTER_CONTEXT_SWITCHES] = OpenEvent(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+
+	if ((iFD[PERFCOUNTER_CYCLES] < 0) || (iFD[PERFCOUNTER_INSTRUCTIONS] < 0))
+	{
+		int iErr = errno;
+		sError = "perf_event_open() failed: ";
+		sError += strerror(iErr);
+		if ((iErr == EACCES) || (iErr == EPERM))
+			sError += "\nCheck /proc/sys/kernel/perf_event_paranoid (must be 2 or lower).";
+		else if (iErr == ENOENT)
+			sError += "\nThe CPU or hypervisor does not expose hardware counters.";
+		Close();
+		return FALSE;
+	}
+
+	for (int i = 0; i < PERFCOUNTER_COUNT; i++)
+	{
+		if (iFD[i] >= 0)
+			ioctl(iFD[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	bInitialized = TRUE;
+
+	return TRUE;
+}
+
+
+void CPerfCounters::Close()
+{
+	for (int i = 0; i < PERFCOUNTER_COUNT; i++)
+	{
+		if (iFD[i] >= 0)
+			close(iFD[i]);
+
+		iFD[i] = -1;
+	}
+
+	bInitialized = FALSE;
+
+	return;
+}
+
+
+BOOL CPerfCounters::Read(stPerfCounterValues &values)
+{
+	unsigned long long ullData[3]; //value, time enabled, time running
+	double dValue = 0.0;
+
+	for (int i = 0; i < PERFCOUNTER_COUNT; i++)
+	{
+		values.uiValue[i] = 0;
+		values.bValid[i] = FALSE;
+
+		if (iFD[i] < 0)
+			continue;
+
+		if (read(iFD[i], ullData, sizeof(ullData)) != (ssize_t)sizeof(ullData))
+			continue;
+
+		if (ullData[2] == 0) //never scheduled on the PMU
+			continue;
+
+		dValue = (double)ullData[0];
+		if (ullData[2] < ullData[1])
+			dValue *= (double)ullData[1] / (double)ullData[2];
+
+		values.uiValue[i] = (unsigned __int64)dValue;
+		values.bValid[i] = TRUE;
+	}
+
+	return bInitialized;
+}
+
+#else //__linux__
+
+BOOL CPerfCounters::Open()
+{
+	sError = "Hardware performance counters are only supported on Linux (perf_event_open)";
+	bInitialized = FALSE;
+
+	return FALSE;
+}
+
+
+void CPerfCounters::Close()
+{
+	bInitialized = FALSE;
+
+	return;
+}
+
+
+BOOL CPerfCounters::Read(stPerfCounterValues &values)
+{
+	for (int i = 0; i < PERFCOUNTER_COUNT; i++)
+	{
+		values.uiValue[i] = 0;
+		values.bValid[i] = FALSE;
+	}
+
+	return FALSE;
+}
+
+#endif //__linux__
+
+
+void CPerfCounters::Delta(const stPerfCounterValues &cur, const stPerfCounterValues &prev, stPerfCounterValues &delta)
+{
+	for (int i = 0; i < PERFCOUNTER_COUNT; i++)
+	{
+		delta.bValid[i] = (cur.bValid[i] && prev.bValid[i]) ? TRUE : FALSE;
+		delta.uiValue[i] = (delta.bValid[i] && (cur.uiValue[i] > prev.uiValue[i])) ? (cur.uiValue[i] - prev.uiValue[i]) : 0;
+	}
+
+	return;
+}
+
+
+#endif //_PERFCOUNTERS_H
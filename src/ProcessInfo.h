@@ -23,6 +23,8 @@
 #define _PROCESSINFO_H
 
 #include "common.h"
+#include "ProcessSampler.h"
+
 
 class CProcessInfo
 {
@@ -32,54 +34,67 @@ public:
 
 	void   Update();
 	void   CloseProcess();
+	void   GetThreadCPUTimes(vector<stThreadCPUTime> &v_threadtimes, unsigned __int64 &ui_processtime);
 	double dCPUUsage;
+	double dBusiestThreadUsage; //percent of one logical CPU, last sampling interval
 	WORD   wThreadCount;
 	DWORD  dwMemMB;
 
 private:
-	WORD GetCurrentThreadCount();
 	void GetCPUUsage();
-	unsigned __int64 SubtractTimes(const FILETIME& ftA, const FILETIME& ftB);
+	void GetThreadUsage(unsigned __int64 ui_now);
 	BOOL bFirstRun;
 	unsigned __int64 GetSTDTimer();
 
-	FILETIME ftPrevSysKernel;
-	FILETIME ftPrevSysUser;
-	FILETIME ftPrevProcKernel;
-	FILETIME ftPrevProcUser;
+	CProcessSampler *pSampler;
+	stProcessSample  sample;
+
+	unsigned __int64 uiPrevSysTime;
+	unsigned __int64 uiPrevProcTime;
+	unsigned __int64 uiStartProcTime;
+
+	map<DWORD, unsigned __int64> mThreadTimeStart;
+	map<DWORD, unsigned __int64> mThreadTimePrev;
+	unsigned __int64             uiPrevThreadSample;
 
-	HANDLE hProcess;
-	PROCESS_MEMORY_COUNTERS pmc;
 	volatile LONG lRunCount;
 };
 
 
 CProcessInfo::CProcessInfo()
 {
-	hProcess = ::OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, ::GetCurrentProcessId());
+	pSampler = CProcessSampler::Create();
 
 	dwMemMB = 0;
-
-	::ZeroMemory(&ftPrevSysKernel, sizeof(FILETIME));
-	::ZeroMemory(&ftPrevSysUser, sizeof(FILETIME));
-	::ZeroMemory(&ftPrevProcKernel, sizeof(FILETIME));
-	::ZeroMemory(&ftPrevProcUser, sizeof(FILETIME));
-
+	wThreadCount = 0;
 	dCPUUsage = 0.0;
-	wThreadCount = GetCurrentThreadCount();
+	dBusiestThreadUsage = 0.0;
+	uiPrevSysTime = 0;
+	uiPrevProcTime = 0;
+	uiStartProcTime = 0;
+	uiPrevThreadSample = 0;
 	bFirstRun = TRUE;
 	lRunCount = 0;
+
+	if (pSampler->Sample(sample))
+		wThreadCount = sample.wThreadCount;
 }
 
 CProcessInfo::~CProcessInfo()
 {
+	CloseProcess();
 }
 
 
 void CProcessInfo::CloseProcess()
 {
-	if (hProcess)
-		::CloseHandle(hProcess);
+	if (pSampler)
+	{
+		pSampler->Close();
+		delete pSampler;
+	}
+
+	pSampler = NULL;
 
 	return;
 }
@@ -88,109 +103,142 @@ void CProcessInfo::CloseProcess()
 void CProcessInfo::Update()
 {
 	static unsigned __int64 uiLastTimeRun;
-	static unsigned __int64 uiLastTimeRunTH;
 
 	if (((GetSTDTimer() - uiLastTimeRun) < 500) && !bFirstRun)
 		return;
 
 	uiLastTimeRun = GetSTDTimer();
 
-	GetCPUUsage();
-	bFirstRun = FALSE;
+	if (::InterlockedIncrement(&lRunCount) == 1)
+	{
+		//one sample per interval covers CPU time, threads and memory of this process only
+		if (pSampler && pSampler->Sample(sample))
+		{
+			GetCPUUsage();
+			GetThreadUsage(uiLastTimeRun);
+			bFirstRun = FALSE;
+
+			wThreadCount = sample.wThreadCount;
+			dwMemMB = (DWORD)(((double)(sample.uiWorkingSet) / 1048576.0) + 0.5);
+		}
+	}
+
+	::InterlockedDecrement(&lRunCount);
 
 	if (dCPUUsage >= 100.0)
 		dCPUUsage = 99.99999999;
 
-	::GetProcessMemoryInfo(hProcess, &pmc, sizeof(pmc));
-	dwMemMB = (DWORD)(((double)(pmc.WorkingSetSize) / 1048576.0) + 0.5);
+	return;
+}
 
-	//Thread count should only be updated every few seconds to reduce overhead
-	if ((GetSTDTimer() - uiLastTimeRunTH) < 5000)
-		return;
 
-	wThreadCount = GetCurrentThreadCount();
-	uiLastTimeRunTH = GetSTDTimer();
+void CProcessInfo::GetCPUUsage()
+{
+	if (!bFirstRun)
+	{
+		/*
+		CPU usage is calculated by getting the total amount of time the system
+		has operated since the last measurement (made up of kernel + user) and
+		the total amount of time the process has run (kernel + user).
+		*/
+		unsigned __int64 uiSysDiff = sample.uiSystemCPUTime - uiPrevSysTime;
+		unsigned __int64 uiProcDiff = sample.uiProcessCPUTime - uiPrevProcTime;
+
+		if (uiSysDiff > 0)
+			dCPUUsage = (100.0 * (double)uiProcDiff) / (double)uiSysDiff;
+	}
+	else
+		uiStartProcTime = sample.uiProcessCPUTime;
+
+	uiPrevSysTime = sample.uiSystemCPUTime;
+	uiPrevProcTime = sample.uiProcessCPUTime;
 
 	return;
 }
 
 
-void CProcessInfo::GetCPUUsage()
+void CProcessInfo::GetThreadUsage(unsigned __int64 ui_now)
 {
-	if (::InterlockedIncrement(&lRunCount) == 1)
+	/*
+	The last known CPU time of every thread is kept in mThreadTimePrev, so
+	threads that have already exited remain available for the final summary.
+	*/
+	unsigned __int64 uiIntervalMS = ui_now - uiPrevThreadSample;
+	unsigned __int64 uiMaxDelta = 0;
+	unsigned __int64 uiTime = 0;
+	DWORD dwThreadID = 0;
+
+	for (size_t i = 0; i < sample.vThreads.size(); i++)
 	{
-		FILETIME ftSysIdle, ftSysKernel, ftSysUser, ftProcCreation, ftProcExit, ftProcKernel, ftProcUser;
-		if (!::GetSystemTimes(&ftSysIdle, &ftSysKernel, &ftSysUser) || !::GetProcessTimes(::GetCurrentProcess(), &ftProcCreation, &ftProcExit, &ftProcKernel, &ftProcUser))
-		{
-			::InterlockedDecrement(&lRunCount);
-			return;
-		}
+		dwThreadID = sample.vThreads[i].dwThreadID;
+		uiTime = sample.vThreads[i].uiCPUTime;
 
-		if (!bFirstRun)
+		if (bFirstRun)
+			mThreadTimeStart[dwThreadID] = uiTime;
+		else if (mThreadTimeStart.find(dwThreadID) == mThreadTimeStart.end())
+			mThreadTimeStart[dwThreadID] = 0; //created after the first sample
+
+		if ((mThreadTimePrev.find(dwThreadID) != mThreadTimePrev.end()) && (uiTime > mThreadTimePrev[dwThreadID]))
 		{
-			/*
-			CPU usage is calculated by getting the total amount of time the system
-			has operated since the last measurement (made up of kernel + user) and
-			the total amount of time the process has run (kernel + user).
-			*/
-			unsigned __int64 uiSysKernelDiff = SubtractTimes(ftSysKernel, ftPrevSysKernel);
-			unsigned __int64 uiSysUserDiff = SubtractTimes(ftSysUser, ftPrevSysUser);
-			unsigned __int64 uiProcKernelDiff = SubtractTimes(ftProcKernel, ftPrevProcKernel);
-			unsigned __int64 uiProcUserDiff = SubtractTimes(ftProcUser, ftPrevProcUser);
-
-			if ((uiSysKernelDiff + uiSysUserDiff) > 0)
-				dCPUUsage = (100.0 * (double)(uiProcKernelDiff + uiProcUserDiff)) / (double)(uiSysKernelDiff + uiSysUserDiff);
+			if ((uiTime - mThreadTimePrev[dwThreadID]) > uiMaxDelta)
+				uiMaxDelta = uiTime - mThreadTimePrev[dwThreadID];
 		}
 
-		ftPrevSysKernel = ftSysKernel;
-		ftPrevSysUser = ftSysUser;
-		ftPrevProcKernel = ftProcKernel;
-		ftPrevProcUser = ftProcUser;
+		mThreadTimePrev[dwThreadID] = uiTime;
 	}
 
-	::InterlockedDecrement(&lRunCount);
-
-	return;
-}
+	if (!bFirstRun && (uiIntervalMS > 0))
+		dBusiestThreadUsage = (100.0 * ((double)uiMaxDelta / 10000.0)) / (double)uiIntervalMS;
 
+	if (dBusiestThreadUsage > 100.0)
+		dBusiestThreadUsage = 100.0;
 
-unsigned __int64 CProcessInfo::SubtractTimes(const FILETIME& ftA, const FILETIME& ftB)
-{
-	unsigned __int64 a = (((unsigned __int64)ftA.dwHighDateTime) << 32) + (unsigned __int64)ftA.dwLowDateTime;
-	unsigned __int64 b = (((unsigned __int64)ftB.dwHighDateTime) << 32) + (unsigned __int64)ftB.dwLowDateTime;
+	uiPrevThreadSample = ui_now;
 
-	return (a - b);
+	return;
 }
 
 
-WORD CProcessInfo::GetCurrentThreadCount()
+void CProcessInfo::GetThreadCPUTimes(vector<stThreadCPUTime> &v_threadtimes, unsigned __int64 &ui_processtime)
 {
-	DWORD dwPID = ::GetCurrentProcessId();
-	HANDLE hThreadSnapshot = INVALID_HANDLE_VALUE;
-	THREADENTRY32 te32;
-
-	hThreadSnapshot = ::CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
-	if (hThreadSnapshot == INVALID_HANDLE_VALUE)
-		return 0;
+	v_threadtimes.clear();
+	ui_processtime = 0;
 
-	te32.dwSize = sizeof(THREADENTRY32);
-
-	if (!::Thread32First(hThreadSnapshot, &te32))
+	if (pSampler && pSampler->Sample(sample))
 	{
-		::CloseHandle(hThreadSnapshot);
-		return 0;
+		ui_processtime = sample.uiProcessCPUTime - uiStartProcTime;
+		for (size_t i = 0; i < sample.vThreads.size(); i++)
+			mThreadTimePrev[sample.vThreads[i].dwThreadID] = sample.vThreads[i].uiCPUTime;
 	}
 
-	WORD wThreads = 0;
-	while (::Thread32Next(hThreadSnapshot, &te32))
+	stThreadCPUTime tct;
+	unsigned __int64 uiTime = 0;
+	map<DWORD, unsigned __int64>::iterator it;
+	for (it = mThreadTimePrev.begin(); it != mThreadTimePrev.end(); ++it)
 	{
-		if (te32.th32OwnerProcessID == dwPID)
-			++wThreads;
+		uiTime = it->second;
+		if (mThreadTimeStart.find(it->first) != mThreadTimeStart.end())
+			uiTime -= (uiTime >= mThreadTimeStart[it->first]) ? mThreadTimeStart[it->first] : uiTime;
+
+		if (uiTime == 0)
+			continue;
+
+		tct.dwThreadID = it->first;
+		tct.uiCPUTime = uiTime;
+		v_threadtimes.push_back(tct);
 	}
 
-	::CloseHandle(hThreadSnapshot);
+	for (size_t i = 1; i < v_threadtimes.size(); i++) //few entries, keep it simple
+	{
+		for (size_t j = i; (j > 0) && (v_threadtimes[j].uiCPUTime > v_threadtimes[j - 1].uiCPUTime); j--)
+		{
+			tct = v_threadtimes[j];
+			v_threadtimes[j] = v_threadtimes[j - 1];
+			v_threadtimes[j - 1] = tct;
+		}
+	}
 
-	return wThreads;
+	return;
 }
 
 
@@ -0,0 +1,442 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_PROCESSSAMPLER_H)
+#define _PROCESSSAMPLER_H
+
+#include "common.h"
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+struct stThreadCPUTime
+{
+	DWORD            dwThreadID;
+	unsigned __int64 uiCPUTime; //kernel + user, 100ns units
+};
+
+struct stProcessSample
+{
+	unsigned __int64        uiProcessCPUTime; //kernel + user of all threads, 100ns units
+	unsigned __int64        uiSystemCPUTime;  //CPU time available to all processes since an arbitrary origin, 100ns units
+	unsigned __int64        uiWorkingSet;     //bytes
+	WORD                    wThreadCount;
+	vector<stThreadCPUTime> vThreads;         //threads alive at the time of the sample
+};
+
+
+/*
+	Samples the current process only. Implementations must be cheap enough to
+	run at every CPU usage update, so neither may enumerate the threads of the
+	whole system.
+*/
+class CProcessSampler
+{
+public:
+	CProcessSampler() {}
+	virtual ~CProcessSampler() {}
+
+	virtual BOOL Sample(stProcessSample &sample) = 0;
+	virtual void Close() = 0;
+
+	static CProcessSampler* Create();
+};
+
+
+#if defined(_WIN32)
+
+class CProcessSamplerWin : public CProcessSampler
+{
+public:
+	CProcessSamplerWin();
+	virtual ~CProcessSamplerWin();
+
+	BOOL Sample(stProcessSample &sample);
+	void Close();
+
+private:
+	typedef LONG  (WINAPI *NTGETNEXTTHREAD)(HANDLE, HANDLE, ACCESS_MASK, ULONG, ULONG, PHANDLE);
+	typedef DWORD (WINAPI *GETTHREADID)(HANDLE);
+
+	void EnumThreadsNt(stProcessSample &sample);
+	void EnumThreadsToolhelp(stProcessSample &sample);
+	void AddThread(DWORD dw_threadid, HANDLE h_thread, stProcessSample &sample);
+	unsigned __int64 FileTimeToUInt64(const FILETIME& ft);
+
+	NTGETNEXTTHREAD     pNtGetNextThread;
+	GETTHREADID         pGetThreadId;
+	HANDLE              hProcess;
+	map<DWORD, HANDLE>  mThreadHandles;
+	PROCESS_MEMORY_COUNTERS pmc;
+};
+
+
+CProcessSamplerWin::CProcessSamplerWin()
+{
+	hProcess = ::OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, ::GetCurrentProcessId());
+
+	//NtGetNextThread walks the threads of one process (Vista and newer), older systems fall back to the Toolhelp snapshot
+	pNtGetNextThread = NULL;
+	pGetThreadId = NULL;
+	HMODULE hNtDll = ::GetModuleHandle("ntdll.dll");
+	HMODULE hKernel32 = ::GetModuleHandle("kernel32.dll");
+	if (hNtDll && hKernel32)
+	{
+		pNtGetNextThread = (NTGETNEXTTHREAD)::GetProcAddress(hNtDll, "NtGetNextThread");
+		pGetThreadId = (GETTHREADID)::GetProcAddress(hKernel32, "GetThreadId");
+		if (!pGetThreadId)
+			pNtGetNextThread = NULL;
+	}
+}
+
+CProcessSamplerWin::~CProcessSamplerWin()
+{
+	Close();
+}
+
+
+void CProcessSamplerWin::Close()
+{
+	map<DWORD, HANDLE>::iterator it;
+	for (it = mThreadHandles.begin(); it != mThreadHandles.end(); ++it)
+		::CloseHandle(it->second);
+
+	mThreadHandles.clear();
+
+	if (hProcess)
+		::CloseHandle(hProcess);
+
+	hProcess = NULL;
+
+	return;
+}
+
+
+BOOL CProcessSamplerWin::Sample(stProcessSample &sample)
+{
+	sample.uiProcessCPUTime = 0;
+	sample.uiSystemCPUTime = 0;
+	sample.uiWorkingSet = 0;
+	sample.wThreadCount = 0;
+	sample.vThreads.clear();
+
+	FILETIME ftSysIdle, ftSysKernel, ftSysUser, ftProcCreation, ftProcExit, ftProcKernel, ftProcUser;
+	if (!::GetSystemTimes(&ftSysIdle, &ftSysKernel, &ftSysUser) || !::GetProcessTimes(::GetCurrentProcess(), &ftProcCreation, &ftProcExit, &ftProcKernel, &ftProcUser))
+		return FALSE;
+
+	//system kernel time includes the idle time
+	sample.uiSystemCPUTime = FileTimeToUInt64(ftSysKernel) + FileTimeToUInt64(ftSysUser);
+	sample.uiProcessCPUTime = FileTimeToUInt64(ftProcKernel) + FileTimeToUInt64(ftProcUser);
+
+	if (hProcess && ::GetProcessMemoryInfo(hProcess, &pmc, sizeof(pmc)))
+		sample.uiWorkingSet = (unsigned __int64)pmc.WorkingSetSize;
+
+	if (pNtGetNextThread)
+		EnumThreadsNt(sample);
+	else
+		EnumThreadsToolhelp(sample);
+
+	sample.wThreadCount = (WORD)sample.vThreads.size();
+
+	return TRUE;
+}
+
+
+void CProcessSamplerWin::EnumThreadsNt(stProcessSample &sample)
+{
+	HANDLE hPrev = NULL;
+	HANDLE hNext = NULL;
+	BOOL bPrevKept = FALSE;
+	BOOL bKept = FALSE;
+	DWORD dwThreadID = 0;
+
+	while (pNtGetNextThread(::GetCurrentProcess(), hPrev, THREAD_QUERY_INFORMATION, 0, 0, &hNext) == 0)
+	{
+		if (hPrev && !bPrevKept)
+			::CloseHandle(hPrev);
+
+		bKept = FALSE;
+		dwThreadID = pGetThreadId(hNext);
+		if (mThreadHandles.find(dwThreadID) == mThreadHandles.end())
+		{
+			mThreadHandles[dwThreadID] = hNext;
+			bKept = TRUE;
+		}
+
+		AddThread(dwThreadID, mThreadHandles[dwThreadID], sample);
+
+		hPrev = hNext;
+		bPrevKept = bKept;
+	}
+
+	if (hPrev && !bPrevKept)
+		::CloseHandle(hPrev);
+
+	return;
+}
+
+
+void CProcessSamplerWin::EnumThreadsToolhelp(stProcessSample &sample)
+{
+	DWORD dwPID = ::GetCurrentProcessId();
+	THREADENTRY32 te32;
+
+	HANDLE hThreadSnapshot = ::CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+	if (hThreadSnapshot == INVALID_HANDLE_VALUE)
+		return;
+
+	te32.dwSize = sizeof(THREADENTRY32);
+
+	if (!::Thread32First(hThreadSnapshot, &te32))
+	{
+		::CloseHandle(hThreadSnapshot);
+		return;
+	}
+
+	HANDLE hThread = NULL;
+	do
+	{
+		if (te32.th32OwnerProcessID != dwPID)
+			continue;
+
+		if (mThreadHandles.find(te32.th32ThreadID) == mThreadHandles.end())
+		{
+			hThread = ::OpenThread(THREAD_QUERY_INFORMATION, FALSE, te32.th32ThreadID);
+			if (!hThread)
+				continue;
+
+			mThreadHandles[te32.th32ThreadID] = hThread;
+		}
+
+		AddThread(te32.th32ThreadID, mThreadHandles[te32.th32ThreadID], sample);
+	}
+	while (::Thread32Next(hThreadSnapshot, &te32));
+
+	::CloseHandle(hThreadSnapshot);
+
+	return;
+}
+
+
+void CProcessSamplerWin::AddThread(DWORD dw_threadid, HANDLE h_thread, stProcessSample &sample)
+{
+	stThreadCPUTime tct;
+	tct.dwThreadID = dw_threadid;
+	tct.uiCPUTime = 0;
+
+	FILETIME ftCreation, ftExit, ftKernel, ftUser;
+	if (::GetThreadTimes(h_thread, &ftCreation, &ftExit, &ftKernel, &ftUser))
+		tct.uiCPUTime = FileTimeToUInt64(ftKernel) + FileTimeToUInt64(ftUser);
+
+	sample.vThreads.push_back(tct);
+
+	return;
+}
+
+
+unsigned __int64 CProcessSamplerWin::FileTimeToUInt64(const FILETIME& ft)
+{
+	return (((unsigned __int64)ft.dwHighDateTime) << 32) + (unsigned __int64)ft.dwLowDateTime;
+}
+
+
+CProcessSampler* CProcessSampler::Create()
+{
+	return new CProcessSamplerWin();
+}
+
+
+#else //_WIN32
+
+class CProcessSamplerLinux : public CProcessSampler
+{
+public:
+	CProcessSamplerLinux();
+	virtual ~CProcessSamplerLinux();
+
+	BOOL Sample(stProcessSample &sample);
+	void Close();
+
+private:
+	BOOL ReadProcStat(const char *s_path, unsigned __int64 &ui_cputime, long &l_threads, long &l_rsspages);
+	BOOL ReadProcStatus(long &l_threads, long &l_rsskb);
+	long lTicksPerSecond;
+	long lCPUs;
+};
+
+
+CProcessSamplerLinux::CProcessSamplerLinux()
+{
+	lTicksPerSecond = sysconf(_SC_CLK_TCK);
+	lCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (lTicksPerSecond <= 0)
+		lTicksPerSecond = 100;
+	if (lCPUs < 1)
+		lCPUs = 1;
+}
+
+CProcessSamplerLinux::~CProcessSamplerLinux()
+{
+}
+
+
+void CProcessSamplerLinux::Close()
+{
+	return;
+}
+
+
+BOOL CProcessSamplerLinux::Sample(stProcessSample &sample)
+{
+	sample.uiProcessCPUTime = 0;
+	sample.uiSystemCPUTime = 0;
+	sample.uiWorkingSet = 0;
+	sample.wThreadCount = 0;
+	sample.vThreads.clear();
+
+	//getrusage has microsecond resolution, /proc/self/stat only clock ticks
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return FALSE;
+
+	sample.uiProcessCPUTime = ((unsigned __int64)ru.ru_utime.tv_sec + (unsigned __int64)ru.ru_stime.tv_sec) * 10000000 +
+	                          ((unsigned __int64)ru.ru_utime.tv_usec + (unsigned __int64)ru.ru_stime.tv_usec) * 10;
+
+	//wall time times the number of CPUs is what GetSystemTimes() reports on Windows
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	sample.uiSystemCPUTime = ((unsigned __int64)ts.tv_sec * 10000000 + (unsigned __int64)ts.tv_nsec / 100) * (unsigned __int64)lCPUs;
+
+	long lThreads = 0;
+	long lRSSkB = 0;
+	if (ReadProcStatus(lThreads, lRSSkB))
+	{
+		sample.uiWorkingSet = (unsigned __int64)lRSSkB * 1024;
+		sample.wThreadCount = (WORD)lThreads;
+	}
+
+	unsigned __int64 uiCPUTime = 0;
+	long lRSSPages = 0;
+
+	DIR *pDir = opendir("/proc/self/task");
+	if (pDir)
+	{
+		struct dirent *pEntry;
+		char szPath[300];
+		stThreadCPUTime tct;
+		while ((pEntry = readdir(pDir)) != NULL)
+		{
+			if (pEntry->d_name[0] < '0' || pEntry->d_name[0] > '9')
+				continue;
+
+			snprintf(szPath, sizeof(szPath), "/proc/self/task/%s/stat", pEntry->d_name);
+			if (!ReadProcStat(szPath, uiCPUTime, lThreads, lRSSPages))
+				continue;
+
+			tct.dwThreadID = (DWORD)atol(pEntry->d_name);
+			tct.uiCPUTime = uiCPUTime;
+			sample.vThreads.push_back(tct);
+		}
+		closedir(pDir);
+	}
+
+	if (sample.wThreadCount == 0)
+		sample.wThreadCount = (WORD)sample.vThreads.size();
+
+	return TRUE;
+}
+
+
+BOOL CProcessSamplerLinux::ReadProcStat(const char *s_path, unsigned __int64 &ui_cputime, long &l_threads, long &l_rsspages)
+{
+	char szBuf[1024];
+	FILE *pFile = fopen(s_path, "r");
+	if (!pFile)
+		return FALSE;
+
+	size_t uiLen = fread(szBuf, 1, sizeof(szBuf) - 1, pFile);
+	fclose(pFile);
+	szBuf[uiLen] = '\0';
+
+	//the command name may contain spaces and parentheses, the fields start after the last ')'
+	char *pFields = strrchr(szBuf, ')');
+	if (!pFields)
+		return FALSE;
+
+	//fields after ')': state(3) ... utime(14) stime(15) ... num_threads(20) ... rss(24)
+	unsigned long long ullUTime = 0;
+	unsigned long long ullSTime = 0;
+	long lThreads = 0;
+	long lRSS = 0;
+	if (sscanf(pFields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %ld %*d %*u %*u %ld",
+		&ullUTime, &ullSTime, &lThreads, &lRSS) != 4)
+		return FALSE;
+
+	ui_cputime = (unsigned __int64)(ullUTime + ullSTime) * 10000000 / (unsigned __int64)lTicksPerSecond;
+	l_threads = lThreads;
+	l_rsspages = lRSS;
+
+	return TRUE;
+}
+
+
+BOOL CProcessSamplerLinux::ReadProcStatus(long &l_threads, long &l_rsskb)
+{
+	char szLine[256];
+	FILE *pFile = fopen("/proc/self/status", "r");
+	if (!pFile)
+		return FALSE;
+
+	int iFound = 0;
+	while ((iFound < 2) && fgets(szLine, sizeof(szLine), pFile))
+	{
+		if (strncmp(szLine, "VmRSS:", 6) == 0)
+		{
+			l_rsskb = atol(szLine + 6);
+			++iFound;
+		}
+		else if (strncmp(szLine, "Threads:", 8) == 0)
+		{
+			l_threads = atol(szLine + 8);
+			++iFound;
+		}
+	}
+	fclose(pFile);
+
+	return (iFound == 2) ? TRUE : FALSE;
+}
+
+
+CProcessSampler* CProcessSampler::Create()
+{
+	return new CProcessSamplerLinux();
+}
+
+#endif //_WIN32
+
+
+#endif //_PROCESSSAMPLER_H
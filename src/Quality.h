@@ -0,0 +1,568 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_QUALITY_H)
+#define _QUALITY_H
+
+#include "common.h"
+#include "Utility.h"
+#include "FrameServer.h"
+
+#include <immintrin.h>
+
+#define QUALITY_PSNR_MAX       100.0  //identical planes
+#define QUALITY_SSIM_MAX_BITS  12     //widest integer samples the SSE2 SSIM kernel sums without overflow
+
+#if defined(__GNUC__)
+#define QUALITY_TARGET_AVX2    __attribute__((target("avx2")))
+#else
+#define QUALITY_TARGET_AVX2
+#endif
+
+
+/*
+	PSNR and SSIM of a candidate clip against a reference, per plane and
+	per frame. SSIM is computed like x264 does it: sums over 4x4 blocks,
+	combined to overlapping 8x8 windows at a step of 4 and averaged.
+	The squared error runs on SSE2 or AVX2 for every integer format, the
+	SSIM block sums on SSE2 for up to 12 bit. Float clips (32 bit) and wider
+	integer samples take the C path, as do the row tails.
+*/
+struct stSSIMBlock
+{
+	double dSumA;
+	double dSumB;
+	double dSumSq;     //a^2 + b^2
+	double dSumAB;
+};
+
+
+class CQualityMetrics
+{
+public:
+	CQualityMetrics();
+	virtual ~CQualityMetrics() {}
+
+	BOOL   Init(const stClipInfo &candidate, const stClipInfo &reference, BOOL b_avx2);  //FALSE: sError is set
+	BOOL   Compare(const stFramePlanes &candidate, const stFramePlanes &reference);     //FALSE: sError is set
+	string GetPlaneName(int i_plane);
+
+	int            iPlanes;
+	unsigned int   uiFrames;
+	double         dPSNRAvg[FRAME_MAX_PLANES];     //mean of the per frame values
+	double         dPSNRMin[FRAME_MAX_PLANES];
+	double         dPSNRGlobal[FRAME_MAX_PLANES];  //from the squared error over all frames
+	double         dSSIMAvg[FRAME_MAX_PLANES];
+	double         dSSIMMin[FRAME_MAX_PLANES];
+	vector<double> vPSNR[FRAME_MAX_PLANES];        //per frame
+	vector<double> vSSIM[FRAME_MAX_PLANES];
+	string         sKernels;
+	string         sError;
+
+private:
+	double PlaneSSE(const BYTE *p_a, int i_pitcha, const BYTE *p_b, int i_pitchb, int i_width, int i_height);
+	double PlaneSSIM(const BYTE *p_a, int i_pitcha, const BYTE *p_b, int i_pitchb, int i_width, int i_height);
+	double RowSSEC(const BYTE *p_a, const BYTE *p_b, int i_first, int i_width);
+	void   BlockSumsC(const BYTE *p_a, int i_pitcha, const BYTE *p_b, int i_pitchb, int i_x, stSSIMBlock &block);
+	double PSNR(double d_sse, double d_samples);
+
+	static unsigned __int64 RowSSE8SSE2(const BYTE *p_a, const BYTE *p_b, int i_width);
+	static unsigned __int64 RowSSE16SSE2(const BYTE *p_a, const BYTE *p_b, int i_width);
+	static QUALITY_TARGET_AVX2 unsigned __int64 RowSSE8AVX2(const BYTE *p_a, const BYTE *p_b, int i_width);
+	static QUALITY_TARGET_AVX2 unsigned __int64 RowSSE16AVX2(const BYTE *p_a, const BYTE *p_b, int i_width);
+	static int  BlockSums8SSE2(const BYTE *p_a, int i_pitcha, const BYTE *p_b, int i_pitchb, int i_blocks, stSSIMBlock *p_blocks);
+	static int  BlockSums16SSE2(const BYTE *p_a, int i_pitcha, const BYTE *p_b, int i_pitchb, int i_blocks, stSSIMBlock *p_blocks);
+
+	int    iColorFamily;
+	int    iBytesPerSample;
+	BOOL   bFloat;
+	BOOL   bAVX2;
+	BOOL   bSIMDSSIM;
+	double dPeak;
+	double dSSIMC1;                         //x264 constants for a 8x8 window
+	double dSSIMC2;
+	double dSSETotal[FRAME_MAX_PLANES];
+	double dSamplesTotal[FRAME_MAX_PLANES];
+	vector<stSSIMBlock> vBlocks[2];         //two rows of 4x4 blocks
+	CUtils utils;
+};
+
+
+CQualityMetrics::CQualityMetrics()
+{
+	iPlanes = 0;
+	uiFrames = 0;
+	sKernels = "";
+	sError = "";
+	iColorFamily = CLIP_CF_OTHER;
+	iBytesPerSample = 1;
+	bFloat = FALSE;
+	bAVX2 = FALSE;
+	bSIMDSSIM = FALSE;
+	dPeak = 255.0;
+	dSSIMC1 = 0.0;
+	dSSIMC2 = 0.0;
+
+	for (int iPlane = 0; iPlane < FRAME_MAX_PLANES; iPlane++)
+	{
+		dPSNRAvg[iPlane] = 0.0;
+		dPSNRMin[iPlane] = 0.0;
+		dPSNRGlobal[iPlane] = 0.0;
+		dSSIMAvg[iPlane] = 0.0;
+		dSSIMMin[iPlane] = 0.0;
+		dSSETotal[iPlane] = 0.0;
+		dSamplesTotal[iPlane] = 0.0;
+	}
+}
+
+
+BOOL CQualityMetrics::Init(const stClipInfo &candidate, const stClipInfo &reference, BOOL b_avx2)
+{
+	sError = "";
+
+	if ((candidate.uiWidth != reference.uiWidth) || (candidate.uiHeight != reference.uiHeight))
+		sError = utils.StrFormat("The frame sizes differ (%ux%u, reference %ux%u)", candidate.uiWidth, candidate.uiHeight, reference.uiWidth, reference.uiHeight);
+	else if ((candidate.iColorFamily != reference.iColorFamily) || (candidate.iBitsPerComponent != reference.iBitsPerComponent) ||
+		(candidate.iSubSamplingW != reference.iSubSamplingW) || (candidate.iSubSamplingH != reference.iSubSamplingH))
+		sError = utils.StrFormat("The formats differ (%s, reference %s)", candidate.sColorspace.c_str(), reference.sColorspace.c_str());
+
+	if (sError != "")
+		return FALSE;
+
+	iColorFamily = candidate.iColorFamily;
+	bFloat = (candidate.iBitsPerComponent == 32) ? TRUE : FALSE;
+	iBytesPerSample = bFloat ? 4 : ((candidate.iBitsPerComponent > 8) ? 2 : 1);
+	dPeak = bFloat ? 1.0 : (double)((1 << candidate.iBitsPerComponent) - 1);
+	dSSIMC1 = 0.01 * 0.01 * dPeak * dPeak * 64.0;
+	dSSIMC2 = 0.03 * 0.03 * dPeak * dPeak * 64.0 * 63.0;
+	bAVX2 = b_avx2;
+	bSIMDSSIM = (!bFloat && (candidate.iBitsPerComponent <= QUALITY_SSIM_MAX_BITS)) ? TRUE : FALSE;
+
+	if (bFloat)
+		sKernels = "C (float)";
+	else
+		sKernels = utils.StrFormat("%s error, %s SSIM", bAVX2 ? "AVX2" : "SSE2", bSIMDSSIM ? "SSE2" : "C");
+
+	iPlanes = 0;
+	uiFrames = 0;
+	for (int iPlane = 0; iPlane < FRAME_MAX_PLANES; iPlane++)
+	{
+		dPSNRAvg[iPlane] = 0.0;
+		dPSNRMin[iPlane] = 0.0;
+		dPSNRGlobal[iPlane] = 0.0;
+		dSSIMAvg[iPlane] = 0.0;
+		dSSIMMin[iPlane] = 0.0;
+		dSSETotal[iPlane] = 0.0;
+		dSamplesTotal[iPlane] = 0.0;
+		vPSNR[iPlane].clear();
+		vSSIM[iPlane].clear();
+	}
+
+	return TRUE;
+}
+
+
+BOOL CQualityMetrics::Compare(const stFramePlanes &candidate, const stFramePlanes &reference)
+{
+	if (candidate.iPlanes != reference.iPlanes)
+	{
+		sError = "The number of planes differs";
+		return FALSE;
+	}
+
+	iPlanes = candidate.iPlanes;
+	for (int iPlane = 0; iPlane < iPlanes; iPlane++)
+	{
+		if ((candidate.iRowSize[iPlane] != reference.iRowSize[iPlane]) || (candidate.iHeight[iPlane] != reference.iHeight[iPlane]))
+		{
+			sError = utils.StrFormat("The size of plane %s differs", GetPlaneName(iPlane).c_str());
+			return FALSE;
+		}
+
+		int iWidth = candidate.iRowSize[iPlane] / iBytesPerSample;
+		int iHeight = candidate.iHeight[iPlane];
+		double dSamples = (double)iWidth * (double)iHeight;
+
+		double dSSE = PlaneSSE(candidate.pData[iPlane], candidate.iPitch[iPlane], reference.pData[iPlane], reference.iPitch[iPlane], iWidth, iHeight);
+		double dPSNR = PSNR(dSSE, dSamples);
+		double dSSIM = PlaneSSIM(candidate.pData[iPlane], candidate.iPitch[iPlane], reference.pData[iPlane], reference.iPitch[iPlane], iWidth, iHeight);
+
+		dSSETotal[iPlane] += dSSE;
+		dSamplesTotal[iPlane] += dSamples;
+		vPSNR[iPlane].push_back(dPSNR);
+		vSSIM[iPlane].push_back(dSSIM);
+
+		if ((uiFrames == 0) || (dPSNR < dPSNRMin[iPlane]))
+			dPSNRMin[iPlane] = dPSNR;
+		if ((uiFrames == 0) || (dSSIM < dSSIMMin[iPlane]))
+			dSSIMMin[iPlane] = dSSIM;
+
+		dPSNRAvg[iPlane] += (dPSNR - dPSNRAvg[iPlane]) / (double)(uiFrames + 1);
+		dSSIMAvg[iPlane] += (dSSIM - dSSIMAvg[iPlane]) / (double)(uiFrames + 1);
+		dPSNRGlobal[iPlane] = PSNR(dSSETotal[iPlane], dSamplesTotal[iPlane]);
+	}
+
+	++uiFrames;
+
+	return TRUE;
+}
+
+
+string CQualityMetrics::GetPlaneName(int i_plane)
+{
+	static const char *pszYUV[] = {"Y", "U", "V", "A"};
+	static const char *pszRGB[] = {"G", "B", "R", "A"};
+
+	if ((iPlanes == 1) && (iColorFamily != CLIP_CF_GRAY))
+		return "packed";  //interleaved samples, e.g. YUY2 or RGB32
+
+	if ((i_plane < 0) || (i_plane >= FRAME_MAX_PLANES))
+		return "?";
+
+	return (iColorFamily == CLIP_CF_RGB) ? pszRGB[i_plane] : pszYUV[i_plane];
+}
+
+
+double CQualityMetrics::PSNR(double d_sse, double d_samples)
+{
+	if ((d_sse <= 0.0) || (d_samples <= 0.0))
+		return QUALITY_PSNR_MAX;
+
+	double dPSNR = 10.0 * log10((dPeak * dPeak) / (d_sse / d_samples));
+
+	return (dPSNR < QUALITY_PSNR_MAX) ? dPSNR : QUALITY_PSNR_MAX;
+}
+
+
+double CQualityMetrics::PlaneSSE(const BYTE *p_a, int i_pitcha, const BYTE *p_b, int i_pitchb, int i_width, int i_height)
+{
+	double dSSE = 0.0;
+	for (int y = 0; y < i_height; y++)
+	{
+		const BYTE *pRowA = p_a + (__int64)y * i_pitcha;
+		const BYTE *pRowB = p_b + (__int64)y * i_pitchb;
+
+		if (bFloat)
+		{
+			dSSE += RowSSEC(pRowA, pRowB, 0, i_width);
+			continue;
+		}
+
+		int iStep = bAVX2 ? ((iBytesPerSample == 1) ? 32 : 16) : ((iBytesPerSample == 1) ? 16 : 8);
+		int iSIMDWidth = i_width - (i_width % iStep);
+		if (iBytesPerSample == 1)
+			dSSE += (double)(bAVX2 ? RowSSE8AVX2(pRowA, pRowB, iSIMDWidth) : RowSSE8SSE2(pRowA, pRowB, iSIMDWidth));
+		else
+			dSSE += (double)(bAVX2 ? RowSSE16AVX2(pRowA, pRowB, iSIMDWidth) : RowSSE16SSE2(pRowA, pRowB, iSIMDWidth));
+
+		dSSE += RowSSEC(pRowA, pRowB, iSIMDWidth, i_width);
+	}
+
+	return dSSE;
+}
+
+
+double CQualityMetrics::RowSSEC(const BYTE *p_a, const BYTE *p_b, int i_first, int i_width)
+{
+	double dSSE = 0.0;
+	double dDiff = 0.0;
+	for (int x = i_first; x < i_width; x++)
+	{
+		if (iBytesPerSample == 1)
+			dDiff = (double)p_a[x] - (double)p_b[x];
+		else if (iBytesPerSample == 2)
+			dDiff = (double)((const WORD *)p_a)[x] - (double)((const WORD *)p_b)[x];
+		else
+			dDiff = (double)((const float *)p_a)[x] - (double)((const float *)p_b)[x];
+
+		dSSE += dDiff * dDiff;
+	}
+
+	return dSSE;
+}
+
+
+//|a - b| from two saturated subtractions, squared pairwise with madd
+unsigned __int64 CQualityMetrics::RowSSE8SSE2(const BYTE *p_a, const BYTE *p_b, int i_width)
+{
+	__m128i vZero = _mm_setzero_si128();
+	__m128i vSum = _mm_setzero_si128();  //4 x 32 bit, at most 4 * 65025 per lane and iteration
+	for (int x = 0; x < i_width; x += 16)
+	{
+		__m128i vA = _mm_loadu_si128((const __m128i *)(p_a + x));
+		__m128i vB = _mm_loadu_si128((const __m128i *)(p_b + x));
+		__m128i vDiff = _mm_or_si128(_mm_subs_epu8(vA, vB), _mm_subs_epu8(vB, vA));
+		__m128i vLo = _mm_unpacklo_epi8(vDiff, vZero);
+		__m128i vHi = _mm_unpackhi_epi8(vDiff, vZero);
+		vSum = _mm_add_epi32(vSum, _mm_add_epi32(_mm_madd_epi16(vLo, vLo), _mm_madd_epi16(vHi, vHi)));
+	}
+
+	__m128i vSum64 = _mm_add_epi64(_mm_unpacklo_epi32(vSum, vZero), _mm_unpackhi_epi32(vSum, vZero));
+	unsigned __int64 uiSum[2];
+	_mm_storeu_si128((__m128i *)uiSum, vSum64);
+
+	return uiSum[0] + uiSum[1];
+}
+
+
+//full 16 bit range, the squares go straight to 64 bit lanes
+unsigned __int64 CQualityMetrics::RowSSE16SSE2(const BYTE *p_a, const BYTE *p_b, int i_width)
+{
+	__m128i vZero = _mm_setzero_si128();
+	__m128i vSum = _mm_setzero_si128();  //2 x 64 bit
+	for (int x = 0; x < i_width; x += 8)
+	{
+		__m128i vA = _mm_loadu_si128((const __m128i *)(p_a + (x * 2)));
+		__m128i vB = _mm_loadu_si128((const __m128i *)(p_b + (x * 2)));
+		__m128i vDiff = _mm_or_si128(_mm_subs_epu16(vA, vB), _mm_subs_epu16(vB, vA));
+		__m128i vLo = _mm_unpacklo_epi16(vDiff, vZero);
+		__m128i vHi = _mm_unpackhi_epi16(vDiff, vZero);
+		vSum = _mm_add_epi64(vSum, _mm_mul_epu32(vLo, vLo));
+		vSum = _mm_add_epi64(vSum, _mm_mul_epu32(_mm_srli_epi64(vLo, 32), _mm_srli_epi64(vLo, 32)));
+		vSum = _mm_add_epi64(vSum, _mm_mul_epu32(vHi, vHi));
+		vSum = _mm_add_epi64(vSum, _mm_mul_epu32(_mm_srli_epi64(vHi, 32), _mm_srli_epi64(vHi, 32)));
+	}
+
+	unsigned __int64 uiSum[2];
+	_mm_storeu_si128((__m128i *)uiSum, vSum);
+
+	return uiSum[0] + uiSum[1];
+}
+
+
+QUALITY_TARGET_AVX2 unsigned __int64 CQualityMetrics::RowSSE8AVX2(const BYTE *p_a, const BYTE *p_b, int i_width)
+{
+	__m256i vZero = _mm256_setzero_si256();
+	__m256i vSum = _mm256_setzero_si256();
+	for (int x = 0; x < i_width; x += 32)
+	{
+		__m256i vA = _mm256_loadu_si256((const __m256i *)(p_a + x));
+		__m256i vB = _mm256_loadu_si256((const __m256i *)(p_b + x));
+		__m256i vDiff = _mm256_or_si256(_mm256_subs_epu8(vA, vB), _mm256_subs_epu8(vB, vA));
+		__m256i vLo = _mm256_unpacklo_epi8(vDiff, vZero);
+		__m256i vHi = _mm256_unpackhi_epi8(vDiff, vZero);
+		vSum = _mm256_add_epi32(vSum, _mm256_add_epi32(_mm256_madd_epi16(vLo, vLo), _mm256_madd_epi16(vHi, vHi)));
+	}
+
+	__m256i vSum64 = _mm256_add_epi64(_mm256_unpacklo_epi32(vSum, vZero), _mm256_unpackhi_epi32(vSum, vZero));
+	unsigned __int64 uiSum[4];
+	_mm256_storeu_si256((__m256i *)uiSum, vSum64);
+	_mm256_zeroupper();
+
+	return uiSum[0] + uiSum[1] + uiSum[2] + uiSum[3];
+}
+
+
+QUALITY_TARGET_AVX2 unsigned __int64 CQualityMetrics::RowSSE16AVX2(const BYTE *p_a, const BYTE *p_b, int i_width)
+{
+	__m256i vZero = _mm256_setzero_si256();
+	__m256i vSum = _mm256_setzero_si256();
+	for (int x = 0; x < i_width; x += 16)
+	{
+		__m256i vA = _mm256_loadu_si256((const __m256i *)(p_a + (x * 2)));
+		__m256i vB = _mm256_loadu_si256((const __m256i *)(p_b + (x * 2)));
+		__m256i vDiff = _mm256_or_si256(_mm256_subs_epu16(vA, vB), _mm256_subs_epu16(vB, vA));
+		__m256i vLo = _mm256_unpacklo_epi16(vDiff, vZero);
+		__m256i vHi = _mm256_unpackhi_epi16(vDiff, vZero);
+		vSum = _mm256_add_epi64(vSum, _mm256_mul_epu32(vLo, vLo));
+		vSum = _mm256_add_epi64(vSum, _mm256_mul_epu32(_mm256_srli_epi64(vLo, 32), _mm256_srli_epi64(vLo, 32)));
+		vSum = _mm256_add_epi64(vSum, _mm256_mul_epu32(vHi, vHi));
+		vSum = _mm256_add_epi64(vSum, _mm256_mul_epu32(_mm256_srli_epi64(vHi, 32), _mm256_srli_epi64(vHi, 32)));
+	}
+
+	unsigned __int64 uiSum[4];
+	_mm256_storeu_si256((__m256i *)uiSum, vSum);
+	_mm256_zeroupper();
+
+	return uiSum[0] + uiSum[1] + uiSum[2] + uiSum[3];
+}
+
+
+double CQualityMetrics::PlaneSSIM(const BYTE *p_a, int i_pitcha, const BYTE *p_b, int i_pitchb, int i_width, int i_height)
+{
+	int iBlocksW = i_width / 4;
+	int iBlocksH = i_height / 4;
+	if ((iBlocksW < 2) || (iBlocksH < 2))
+		return 1.0;
+
+	vBlocks[0].resize(iBlocksW);
+	vBlocks[1].resize(iBlocksW);
+
+	double dSSIM = 0.0;
+	for (int by = 0; by < iBlocksH; by++)
+	{
+		//the previous block row stays in vBlocks[(by - 1) & 1]
+		stSSIMBlock *pBlocks = &vBlocks[by & 1][0];
+		const BYTE *pRowA = p_a + (__int64)(by * 4) * i_pitcha;
+		const BYTE *pRowB = p_b + (__int64)(by * 4) * i_pitchb;
+
+		int bx = 0;
+		if (bSIMDSSIM)
+			bx = (iBytesPerSample == 1) ? BlockSums8SSE2(pRowA, i_pitcha, pRowB, i_pitchb, iBlocksW, pBlocks) : BlockSums16SSE2(pRowA, i_pitcha, pRowB, i_pitchb, iBlocksW, pBlocks);
+
+		for (; bx < iBlocksW; bx++)
+			BlockSumsC(pRowA, i_pitcha, pRowB, i_pitchb, bx * 4, pBlocks[bx]);
+
+		if (by == 0)
+			continue;
+
+		const stSSIMBlock *pAbove = &vBlocks[(by - 1) & 1][0];
+		for (bx = 0; bx < (iBlocksW - 1); bx++)
+		{
+			double dS1 = pAbove[bx].dSumA + pAbove[bx + 1].dSumA + pBlocks[bx].dSumA + pBlocks[bx + 1].dSumA;
+			double dS2 = pAbove[bx].dSumB + pAbove[bx + 1].dSumB + pBlocks[bx].dSumB + pBlocks[bx + 1].dSumB;
+			double dSS = pAbove[bx].dSumSq + pAbove[bx + 1].dSumSq + pBlocks[bx].dSumSq + pBlocks[bx + 1].dSumSq;
+			double dS12 = pAbove[bx].dSumAB + pAbove[bx + 1].dSumAB + pBlocks[bx].dSumAB + pBlocks[bx + 1].dSumAB;
+
+			double dVars = (dSS * 64.0) - (dS1 * dS1) - (dS2 * dS2);
+			double dCovar = (dS12 * 64.0) - (dS1 * dS2);
+			dSSIM += ((2.0 * dS1 * dS2 + dSSIMC1) * (2.0 * dCovar + dSSIMC2)) / (((dS1 * dS1) + (dS2 * dS2) + dSSIMC1) * (dVars + dSSIMC2));
+		}
+	}
+
+	return dSSIM / ((double)(iBlocksW - 1) * (double)(iBlocksH - 1));
+}
+
+
+void CQualityMetrics::BlockSumsC(const BYTE *p_a, int i_pitcha, const BYTE *p_b, int i_pitchb, int i_x, stSSIMBlock &block)
+{
+	block.dSumA = 0.0;
+	block.dSumB = 0.0;
+	block.dSumSq = 0.0;
+	block.dSumAB = 0.0;
+
+	double dA = 0.0;
+	double dB = 0.0;
+	for (int y = 0; y < 4; y++)
+	{
+		const BYTE *pRowA = p_a + (__int64)y * i_pitcha;
+		const BYTE *pRowB = p_b + (__int64)y * i_pitchb;
+		for (int x = i_x; x < (i_x + 4); x++)
+		{
+			if (iBytesPerSample == 1)
+			{
+				dA = (double)pRowA[x];
+				dB = (double)pRowB[x];
+			}
+			else if (iBytesPerSample == 2)
+			{
+				dA = (double)((const WORD *)pRowA)[x];
+				dB = (double)((const WORD *)pRowB)[x];
+			}
+			else
+			{
+				dA = (double)((const float *)pRowA)[x];
+				dB = (double)((const float *)pRowB)[x];
+			}
+
+			block.dSumA += dA;
+			block.dSumB += dB;
+			block.dSumSq += (dA * dA) + (dB * dB);
+			block.dSumAB += dA * dB;
+		}
+	}
+
+	return;
+}
+
+
+//two 4x4 blocks per iteration, returns the number of blocks done
+int CQualityMetrics::BlockSums8SSE2(const BYTE *p_a, int i_pitcha, const BYTE *p_b, int i_pitchb, int i_blocks, stSSIMBlock *p_blocks)
+{
+	__m128i vZero = _mm_setzero_si128();
+	__m128i vOnes = _mm_set1_epi16(1);
+	int iSum1[4], iSum2[4], iSumSq[4], iSum12[4];
+
+	int bx = 0;
+	for (; (bx + 2) <= i_blocks; bx += 2)
+	{
+		__m128i vS1 = _mm_setzero_si128();
+		__m128i vS2 = _mm_setzero_si128();
+		__m128i vSS = _mm_setzero_si128();
+		__m128i vS12 = _mm_setzero_si128();
+		for (int y = 0; y < 4; y++)
+		{
+			__m128i vA = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(p_a + (__int64)y * i_pitcha + (bx * 4))), vZero);
+			__m128i vB = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(p_b + (__int64)y * i_pitchb + (bx * 4))), vZero);
+			vS1 = _mm_add_epi16(vS1, vA);
+			vS2 = _mm_add_epi16(vS2, vB);
+			vSS = _mm_add_epi32(vSS, _mm_add_epi32(_mm_madd_epi16(vA, vA), _mm_madd_epi16(vB, vB)));
+			vS12 = _mm_add_epi32(vS12, _mm_madd_epi16(vA, vB));
+		}
+
+		//32 bit lanes 0, 1: first block, 2, 3: second block
+		_mm_storeu_si128((__m128i *)iSum1, _mm_madd_epi16(vS1, vOnes));
+		_mm_storeu_si128((__m128i *)iSum2, _mm_madd_epi16(vS2, vOnes));
+		_mm_storeu_si128((__m128i *)iSumSq, vSS);
+		_mm_storeu_si128((__m128i *)iSum12, vS12);
+
+		for (int i = 0; i < 2; i++)
+		{
+			p_blocks[bx + i].dSumA = (double)(iSum1[i * 2] + iSum1[i * 2 + 1]);
+			p_blocks[bx + i].dSumB = (double)(iSum2[i * 2] + iSum2[i * 2 + 1]);
+			p_blocks[bx + i].dSumSq = (double)(iSumSq[i * 2] + iSumSq[i * 2 + 1]);
+			p_blocks[bx + i].dSumAB = (double)(iSum12[i * 2] + iSum12[i * 2 + 1]);
+		}
+	}
+
+	return bx;
+}
+
+
+//two 4x4 blocks per iteration, up to QUALITY_SSIM_MAX_BITS so that madd and the 32 bit sums cannot overflow
+int CQualityMetrics::BlockSums16SSE2(const BYTE *p_a, int i_pitcha, const BYTE *p_b, int i_pitchb, int i_blocks, stSSIMBlock *p_blocks)
+{
+	__m128i vOnes = _mm_set1_epi16(1);
+	int iSum1[4], iSum2[4], iSumSq[4], iSum12[4];
+
+	int bx = 0;
+	for (; (bx + 2) <= i_blocks; bx += 2)
+	{
+		__m128i vS1 = _mm_setzero_si128();
+		__m128i vS2 = _mm_setzero_si128();
+		__m128i vSS = _mm_setzero_si128();
+		__m128i vS12 = _mm_setzero_si128();
+		for (int y = 0; y < 4; y++)
+		{
+			__m128i vA = _mm_loadu_si128((const __m128i *)(p_a + (__int64)y * i_pitcha + (bx * 8)));
+			__m128i vB = _mm_loadu_si128((const __m128i *)(p_b + (__int64)y * i_pitchb + (bx * 8)));
+			vS1 = _mm_add_epi32(vS1, _mm_madd_epi16(vA, vOnes));
+			vS2 = _mm_add_epi32(vS2, _mm_madd_epi16(vB, vOnes));
+			vSS = _mm_add_epi32(vSS, _mm_add_epi32(_mm_madd_epi16(vA, vA), _mm_madd_epi16(vB, vB)));
+			vS12 = _mm_add_epi32(vS12, _mm_madd_epi16(vA, vB));
+		}
+
+		_mm_storeu_si128((__m128i *)iSum1, vS1);
+		_mm_storeu_si128((__m128i *)iSum2, vS2);
+		_mm_storeu_si128((__m128i *)iSumSq, vSS);
+		_mm_storeu_si128((__m128i *)iSum12, vS12);
+
+		for (int i = 0; i < 2; i++)
+		{
+			p_blocks[bx + i].dSumA = (double)(iSum1[i * 2] + iSum1[i * 2 + 1]);
+			p_blocks[bx + i].dSumB = (double)(iSum2[i * 2] + iSum2[i * 2 + 1]);
+			p_blocks[bx + i].dSumSq = (double)(iSumSq[i * 2] + iSumSq[i * 2 + 1]);
+			p_blocks[bx + i].dSumAB = (double)(iSum12[i * 2] + iSum12[i * 2 + 1]);
+		}
+	}
+
+	return bx;
+}
+
+
+#endif //_QUALITY_H
@@ -0,0 +1,873 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_SYNTHETICCLIP_H)
+#define _SYNTHETICCLIP_H
+
+#include "common.h"
+#include "Utility.h"
+#include "avs_headers/avisynth.h"
+
+#define SYNTHETIC_PREFIX       "synthetic"
+#define SYNTHETIC_MAX_THREADS  64
+#define SYNTHETIC_MAX_PLANES   4
+#define SYNTHETIC_ALIGN        64
+
+#define SYNTHETIC_COST_CONSTANT 0
+#define SYNTHETIC_COST_JITTER   1  //cost +/- jitter, uniformly distributed
+#define SYNTHETIC_COST_SPIKES   2  //every n-th frame costs "spike" instead
+#define SYNTHETIC_COST_MEMORY   3  //cost plus a read-modify-write pass over a working set
+
+
+struct stSyntheticParams
+{
+	int          iWidth;
+	int          iHeight;
+	int          iPixelType;   //VideoInfo::CS_*
+	string       sPixelType;
+	unsigned int uiFrames;
+	unsigned int uiFPSNum;
+	unsigned int uiFPSDen;
+	int          iCostModel;
+	double       dCostMS;
+	double       dJitterMS;
+	unsigned int uiSpikePeriod;
+	double       dSpikeMS;
+	unsigned int uiMemoryMB;
+	unsigned int uiThreads;    //internal threads per frame
+	unsigned int uiSeed;
+};
+
+
+//frame memory owned by the caller, one pointer/pitch per plane
+struct stSyntheticFrame
+{
+	BYTE *pPlane[SYNTHETIC_MAX_PLANES];
+	int  iPitch[SYNTHETIC_MAX_PLANES];
+	vector<BYTE> vBuffer;  //used by AllocFrame() only
+};
+
+
+/*
+	Frame source that needs no frame server: every frame is a deterministic
+	function of (seed, frame number, plane, row) and costs what the cost model
+	says. CSyntheticClip exposes it as an IClip so that it can also replace a
+	script inside a real script environment, CFrameServerSynthetic serves it
+	without any.
+
+	Spec: synthetic[:WxH][,format][,frames=n][,fps=num/den][,cost=constant|jitter|spikes|memory]
+	      [,ms=x][,jitter=x][,period=n][,spike=x][,mem=MiB][,threads=n][,seed=n]
+*/
+class CSyntheticSource
+{
+public:
+	CSyntheticSource();
+	virtual ~CSyntheticSource();
+
+	static BOOL   IsSyntheticSpec(const string &s_spec);
+	static BOOL   ParseSpec(const string &s_spec, stSyntheticParams &params, string &s_error);
+	static string GetOutputName(const string &s_spec);
+	BOOL   Init(const stSyntheticParams &params);
+	void   Release();
+	void   AllocFrame(stSyntheticFrame &frame);
+	void   Render(unsigned int ui_frame, stSyntheticFrame &frame);
+	double GetFrameCostMS(unsigned int ui_frame);
+	string GetDescription();
+
+	stSyntheticParams params;
+	int    iPlanes;
+	int    iRowSize[SYNTHETIC_MAX_PLANES];  //bytes
+	int    iHeight[SYNTHETIC_MAX_PLANES];
+	int    iPlaneID[SYNTHETIC_MAX_PLANES];  //PLANAR_* for GetWritePtr(), 0 for interleaved formats
+	int    iBitsPerComponent;               //32: float
+	int    iSubSamplingW;                   //log2 of the chroma subsampling, planar YUV only
+	int    iSubSamplingH;
+	string sError;
+
+private:
+	struct stWorker
+	{
+		CSyntheticSource *pThis;
+		unsigned int     uiStrip;
+		HANDLE           hThread;
+		HANDLE           hWake;
+	};
+
+	static unsigned __stdcall WorkerProc(void *p_worker);
+	static unsigned __int64 Hash(unsigned __int64 ui_value);
+	void   RenderStrip(unsigned int ui_strip, unsigned int ui_strips, unsigned int ui_frame, stSyntheticFrame &frame);
+	void   Spin(double d_ms);
+	BOOL   GetFormat(int i_pixeltype);
+
+	vector<stWorker> vWorkers;
+	CRITICAL_SECTION csRender;
+	HANDLE           hDone;
+	volatile LONG    lPending;
+	volatile BOOL    bQuit;
+	unsigned int     uiJobFrame;
+	stSyntheticFrame *pJobFrame;
+	unsigned __int64 uiSampleMask;
+	BYTE             *pWorkingSet;
+	size_t           nWorkingSet;
+	double           dPerfFreq;
+	BOOL             bInitialized;
+	CUtils           utils;
+};
+
+
+class CSyntheticClip : public IClip
+{
+public:
+	CSyntheticClip(const stSyntheticParams &params);
+	virtual ~CSyntheticClip();
+
+	PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env);
+	bool __stdcall GetParity(int n) { return false; }
+	void __stdcall GetAudio(void* buf, __int64 start, __int64 count, IScriptEnvironment* env) {}
+	int __stdcall SetCacheHints(int cachehints, int frame_range);
+	const VideoInfo& __stdcall GetVideoInfo() { return vi; }
+
+	static AVSValue ImportScript(IScriptEnvironment *env, const string &s_script);
+
+	CSyntheticSource source;
+
+private:
+	VideoInfo vi;
+};
+
+
+static const struct
+{
+	const char *pszName;
+	int        iPixelType;
+} SyntheticFormats[] =
+{
+	{"YV12",       VideoInfo::CS_YV12},
+	{"I420",       VideoInfo::CS_I420},
+	{"YV16",       VideoInfo::CS_YV16},
+	{"YV24",       VideoInfo::CS_YV24},
+	{"YV411",      VideoInfo::CS_YV411},
+	{"YUV9",       VideoInfo::CS_YUV9},
+	{"Y8",         VideoInfo::CS_Y8},
+	{"YUY2",       VideoInfo::CS_YUY2},
+	{"RGB24",      VideoInfo::CS_BGR24},
+	{"RGB32",      VideoInfo::CS_BGR32},
+	{"BGR48",      VideoInfo::CS_BGR48},
+	{"BGR64",      VideoInfo::CS_BGR64},
+	{"YUV420P10",  VideoInfo::CS_YUV420P10},
+	{"YUV422P10",  VideoInfo::CS_YUV422P10},
+	{"YUV444P10",  VideoInfo::CS_YUV444P10},
+	{"YUV420P12",  VideoInfo::CS_YUV420P12},
+	{"YUV422P12",  VideoInfo::CS_YUV422P12},
+	{"YUV444P12",  VideoInfo::CS_YUV444P12},
+	{"YUV420P14",  VideoInfo::CS_YUV420P14},
+	{"YUV422P14",  VideoInfo::CS_YUV422P14},
+	{"YUV444P14",  VideoInfo::CS_YUV444P14},
+	{"YUV420P16",  VideoInfo::CS_YUV420P16},
+	{"YUV422P16",  VideoInfo::CS_YUV422P16},
+	{"YUV444P16",  VideoInfo::CS_YUV444P16},
+	{"YUV420PS",   VideoInfo::CS_YUV420PS},
+	{"YUV422PS",   VideoInfo::CS_YUV422PS},
+	{"YUV444PS",   VideoInfo::CS_YUV444PS},
+	{"Y10",        VideoInfo::CS_Y10},
+	{"Y12",        VideoInfo::CS_Y12},
+	{"Y14",        VideoInfo::CS_Y14},
+	{"Y16",        VideoInfo::CS_Y16},
+	{"Y32",        VideoInfo::CS_Y32},
+	{"RGBP",       VideoInfo::CS_RGBP},
+	{"RGBP10",     VideoInfo::CS_RGBP10},
+	{"RGBP12",     VideoInfo::CS_RGBP12},
+	{"RGBP14",     VideoInfo::CS_RGBP14},
+	{"RGBP16",     VideoInfo::CS_RGBP16},
+	{"RGBPS",      VideoInfo::CS_RGBPS},
+	{"RGBAP",      VideoInfo::CS_RGBAP},
+	{"RGBAP10",    VideoInfo::CS_RGBAP10},
+	{"RGBAP12",    VideoInfo::CS_RGBAP12},
+	{"RGBAP14",    VideoInfo::CS_RGBAP14},
+	{"RGBAP16",    VideoInfo::CS_RGBAP16},
+	{"RGBAPS",     VideoInfo::CS_RGBAPS},
+	{"YUVA420",    VideoInfo::CS_YUVA420},
+	{"YUVA422",    VideoInfo::CS_YUVA422},
+	{"YUVA444",    VideoInfo::CS_YUVA444},
+	{"YUVA420P10", VideoInfo::CS_YUVA420P10},
+	{"YUVA422P10", VideoInfo::CS_YUVA422P10},
+	{"YUVA444P10", VideoInfo::CS_YUVA444P10},
+	{"YUVA420P12", VideoInfo::CS_YUVA420P12},
+	{"YUVA422P12", VideoInfo::CS_YUVA422P12},
+	{"YUVA444P12", VideoInfo::CS_YUVA444P12},
+	{"YUVA420P14", VideoInfo::CS_YUVA420P14},
+	{"YUVA422P14", VideoInfo::CS_YUVA422P14},
+	{"YUVA444P14", VideoInfo::CS_YUVA444P14},
+	{"YUVA420P16", VideoInfo::CS_YUVA420P16},
+	{"YUVA422P16", VideoInfo::CS_YUVA422P16},
+	{"YUVA444P16", VideoInfo::CS_YUVA444P16},
+	{"YUVA420PS",  VideoInfo::CS_YUVA420PS},
+	{"YUVA422PS",  VideoInfo::CS_YUVA422PS},
+	{"YUVA444PS",  VideoInfo::CS_YUVA444PS}
+};
+
+
+CSyntheticSource::CSyntheticSource()
+{
+	iPlanes = 0;
+	for (int i = 0; i < SYNTHETIC_MAX_PLANES; i++)
+	{
+		iRowSize[i] = 0;
+		iHeight[i] = 0;
+		iPlaneID[i] = 0;
+	}
+
+	iBitsPerComponent = 8;
+	iSubSamplingW = 0;
+	iSubSamplingH = 0;
+	sError = "";
+	hDone = NULL;
+	lPending = 0;
+	bQuit = FALSE;
+	uiJobFrame = 0;
+	pJobFrame = NULL;
+	uiSampleMask = 0;
+	pWorkingSet = NULL;
+	nWorkingSet = 0;
+	dPerfFreq = 0.0;
+	bInitialized = FALSE;
+	::InitializeCriticalSection(&csRender);
+}
+
+CSyntheticSource::~CSyntheticSource()
+{
+	Release();
+	::DeleteCriticalSection(&csRender);
+}
+
+
+BOOL CSyntheticSource::IsSyntheticSpec(const string &s_spec)
+{
+	size_t nLen = strlen(SYNTHETIC_PREFIX);
+	if (s_spec.length() < nLen)
+		return FALSE;
+
+	string sPrefix = s_spec.substr(0, nLen);
+	transform(sPrefix.begin(), sPrefix.end(), sPrefix.begin(), ::tolower);
+	if (sPrefix != SYNTHETIC_PREFIX)
+		return FALSE;
+
+	return ((s_spec.length() == nLen) || (s_spec[nLen] == ':')) ? TRUE : FALSE;
+}
+
+
+BOOL CSyntheticSource::ParseSpec(const string &s_spec, stSyntheticParams &params, string &s_error)
+{
+	s_error = "";
+
+	params.iWidth = 1920;
+	params.iHeight = 1080;
+	params.iPixelType = VideoInfo::CS_YV12;
+	params.sPixelType = "YV12";
+	params.uiFrames = 100000;
+	params.uiFPSNum = 25;
+	params.uiFPSDen = 1;
+	params.iCostModel = SYNTHETIC_COST_CONSTANT;
+	params.dCostMS = 0.0;
+	params.dJitterMS = 0.0;
+	params.uiSpikePeriod = 0;
+	params.dSpikeMS = 0.0;
+	params.uiMemoryMB = 0;
+	params.uiThreads = 1;
+	params.uiSeed = 1;
+
+	if (!IsSyntheticSpec(s_spec))
+	{
+		s_error = "Not a synthetic clip: \"" + s_spec + "\"";
+		return FALSE;
+	}
+
+	string sOptions = (s_spec.length() > strlen(SYNTHETIC_PREFIX)) ? s_spec.substr(strlen(SYNTHETIC_PREFIX) + 1) : "";
+	string sOption = "";
+	string sKey = "";
+	string sValue = "";
+	while (sOptions != "")
+	{
+		size_t nComma = sOptions.find(',');
+		sOption = sOptions.substr(0, nComma);
+		sOptions = (nComma == string::npos) ? "" : sOptions.substr(nComma + 1);
+		transform(sOption.begin(), sOption.end(), sOption.begin(), ::tolower);
+		if (sOption == "")
+			continue;
+
+		size_t nEqual = sOption.find('=');
+		sKey = sOption.substr(0, nEqual);
+		sValue = (nEqual == string::npos) ? "" : sOption.substr(nEqual + 1);
+
+		if (nEqual == string::npos)
+		{
+			int iWidth = 0, iHeight = 0;
+			char cTrail = 0;
+			if (sscanf(sKey.c_str(), "%dx%d%c", &iWidth, &iHeight, &cTrail) == 2)
+			{
+				params.iWidth = iWidth;
+				params.iHeight = iHeight;
+				continue;
+			}
+
+			BOOL bFound = FALSE;
+			for (size_t i = 0; i < (sizeof(SyntheticFormats) / sizeof(SyntheticFormats[0])); i++)
+			{
+				string sName = SyntheticFormats[i].pszName;
+				transform(sName.begin(), sName.end(), sName.begin(), ::tolower);
+				if (sName == sKey)
+				{
+					params.iPixelType = SyntheticFormats[i].iPixelType;
+					params.sPixelType = SyntheticFormats[i].pszName;
+					bFound = TRUE;
+					break;
+				}
+			}
+
+			if (!bFound)
+			{
+				s_error = "Unknown size or pixel type: \"" + sKey + "\"";
+				return FALSE;
+			}
+		}
+		else if (sKey == "frames")
+			params.uiFrames = (unsigned int)atoi(sValue.c_str());
+		else if (sKey == "fps")
+		{
+			unsigned int uiNum = 0, uiDen = 1;
+			if (sscanf(sValue.c_str(), "%u/%u", &uiNum, &uiDen) < 1)
+				uiNum = 0;
+			params.uiFPSNum = uiNum;
+			params.uiFPSDen = uiDen;
+		}
+		else if (sKey == "cost")
+		{
+			if (sValue == "constant")
+				params.iCostModel = SYNTHETIC_COST_CONSTANT;
+			else if (sValue == "jitter")
+				params.iCostModel = SYNTHETIC_COST_JITTER;
+			else if (sValue == "spikes")
+				params.iCostModel = SYNTHETIC_COST_SPIKES;
+			else if (sValue == "memory")
+				params.iCostModel = SYNTHETIC_COST_MEMORY;
+			else
+			{
+				s_error = "Unknown cost model: \"" + sValue + "\"";
+				return FALSE;
+			}
+		}
+		else if (sKey == "ms")
+			params.dCostMS = atof(sValue.c_str());
+		else if (sKey == "jitter")
+			params.dJitterMS = atof(sValue.c_str());
+		else if (sKey == "period")
+			params.uiSpikePeriod = (unsigned int)atoi(sValue.c_str());
+		else if (sKey == "spike")
+			params.dSpikeMS = atof(sValue.c_str());
+		else if (sKey == "mem")
+			params.uiMemoryMB = (unsigned int)atoi(sValue.c_str());
+		else if (sKey == "threads")
+			params.uiThreads = (unsigned int)atoi(sValue.c_str());
+		else if (sKey == "seed")
+			params.uiSeed = (unsigned int)strtoul(sValue.c_str(), NULL, 0);
+		else
+		{
+			s_error = "Unknown option: \"" + sKey + "\"";
+			return FALSE;
+		}
+	}
+
+	if ((params.iWidth < 1) || (params.iHeight < 1) || (params.iWidth > 16384) || (params.iHeight > 16384))
+		s_error = "Invalid frame size";
+	else if (params.uiFrames < 1)
+		s_error = "Invalid frame count";
+	else if ((params.uiFPSNum < 1) || (params.uiFPSDen < 1))
+		s_error = "Invalid frame rate";
+	else if ((params.dCostMS < 0.0) || (params.dJitterMS < 0.0) || (params.dSpikeMS < 0.0))
+		s_error = "Frame cost must not be negative";
+	else if ((params.iCostModel == SYNTHETIC_COST_SPIKES) && (params.uiSpikePeriod < 1))
+		s_error = "The spikes cost model needs period=n";
+	else if ((params.iCostModel == SYNTHETIC_COST_MEMORY) && (params.uiMemoryMB < 1))
+		s_error = "The memory cost model needs mem=MiB";
+	else if ((params.uiThreads < 1) || (params.uiThreads > SYNTHETIC_MAX_THREADS))
+		s_error = "Invalid thread count";
+
+	return (s_error == "") ? TRUE : FALSE;
+}
+
+
+string CSyntheticSource::GetOutputName(const string &s_spec)
+{
+	//the log/csv writers replace a 4 character extension
+	string sName = s_spec;
+	for (size_t n = 0; n < sName.length(); n++)
+	{
+		if (strchr(":,=/\\*?\"<>| ", sName[n]) != NULL)
+			sName[n] = '_';
+	}
+
+	return sName + ".syn";
+}
+
+
+BOOL CSyntheticSource::Init(const stSyntheticParams &params_in)
+{
+	Release();
+	sError = "";
+	params = params_in;
+
+	if (!GetFormat(params.iPixelType))
+	{
+		sError = utils.StrFormat("Unsupported pixel type: 0x%08X", params.iPixelType);
+		return FALSE;
+	}
+
+	LARGE_INTEGER liPerfFreq = {0,0};
+	::QueryPerformanceFrequency(&liPerfFreq);
+	dPerfFreq = (double)liPerfFreq.QuadPart;
+
+	if (params.iCostModel == SYNTHETIC_COST_MEMORY)
+	{
+		nWorkingSet = (size_t)params.uiMemoryMB * 1024 * 1024;
+		pWorkingSet = (BYTE*)_aligned_malloc(nWorkingSet, SYNTHETIC_ALIGN);
+		if (pWorkingSet == NULL)
+		{
+			sError = utils.StrFormat("Cannot allocate %u MiB", params.uiMemoryMB);
+			return FALSE;
+		}
+		memset(pWorkingSet, 0, nWorkingSet);
+	}
+
+	//strip 0 is rendered by the calling thread
+	if (params.uiThreads > 1)
+	{
+		hDone = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+		bQuit = FALSE;
+		vWorkers.resize(params.uiThreads - 1);
+		for (size_t i = 0; i < vWorkers.size(); i++)
+		{
+			vWorkers[i].pThis = this;
+			vWorkers[i].uiStrip = (unsigned int)i + 1;
+			vWorkers[i].hWake = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+			vWorkers[i].hThread = (HANDLE)_beginthreadex(NULL, 0, WorkerProc, &vWorkers[i], 0, NULL);
+			if ((vWorkers[i].hWake == NULL) || (vWorkers[i].hThread == NULL))
+			{
+				vWorkers.resize(i + 1);
+				Release();
+				sError = "Cannot create the render threads";
+				return FALSE;
+			}
+		}
+	}
+
+	bInitialized = TRUE;
+
+	return TRUE;
+}
+
+
+void CSyntheticSource::Release()
+{
+	if (vWorkers.size() > 0)
+	{
+		bQuit = TRUE;
+		for (size_t i = 0; i < vWorkers.size(); i++)
+		{
+			if (vWorkers[i].hThread != NULL)
+			{
+				::SetEvent(vWorkers[i].hWake);
+				::WaitForSingleObject(vWorkers[i].hThread, INFINITE);
+				::CloseHandle(vWorkers[i].hThread);
+			}
+
+			if (vWorkers[i].hWake != NULL)
+				::CloseHandle(vWorkers[i].hWake);
+		}
+		vWorkers.clear();
+	}
+
+	if (hDone != NULL)
+		::CloseHandle(hDone);
+	hDone = NULL;
+
+	if (pWorkingSet != NULL)
+		_aligned_free(pWorkingSet);
+	pWorkingSet = NULL;
+	nWorkingSet = 0;
+
+	bInitialized = FALSE;
+
+	return;
+}
+
+
+BOOL CSyntheticSource::GetFormat(int i_pixeltype)
+{
+	//same decoding as VideoInfo, which is not usable without a script environment (AVS_linkage)
+	int iBytes = 1;
+	int iBits = 8;
+	int iSubW = 0;
+	int iSubH = 0;
+
+	iPlanes = 1;
+	iPlaneID[0] = 0;
+
+	if (i_pixeltype == VideoInfo::CS_BGR24)
+		iBytes = 3;
+	else if (i_pixeltype == VideoInfo::CS_BGR32)
+		iBytes = 4;
+	else if (i_pixeltype == VideoInfo::CS_YUY2)
+		iBytes = 2;
+	else if (i_pixeltype == VideoInfo::CS_BGR48)
+	{
+		iBytes = 6;
+		iBits = 16;
+	}
+	else if (i_pixeltype == VideoInfo::CS_BGR64)
+	{
+		iBytes = 8;
+		iBits = 16;
+	}
+	else if (i_pixeltype & VideoInfo::CS_PLANAR)
+	{
+		switch (i_pixeltype & VideoInfo::CS_Sample_Bits_Mask)
+		{
+			case VideoInfo::CS_Sample_Bits_8:  iBytes = 1; iBits = 8;  break;
+			case VideoInfo::CS_Sample_Bits_10: iBytes = 2; iBits = 10; break;
+			case VideoInfo::CS_Sample_Bits_12: iBytes = 2; iBits = 12; break;
+			case VideoInfo::CS_Sample_Bits_14: iBytes = 2; iBits = 14; break;
+			case VideoInfo::CS_Sample_Bits_16: iBytes = 2; iBits = 16; break;
+			case VideoInfo::CS_Sample_Bits_32: iBytes = 4; iBits = 32; break;
+			default: return FALSE;
+		}
+
+		if ((i_pixeltype & VideoInfo::CS_INTERLEAVED) && (i_pixeltype & VideoInfo::CS_YUV)) //Y only
+		{
+			iPlanes = 1;
+			iPlaneID[0] = PLANAR_Y;
+		}
+		else if (i_pixeltype & VideoInfo::CS_BGR)
+		{
+			iPlanes = ((i_pixeltype & VideoInfo::CS_RGBA_TYPE) != 0) ? 4 : 3;
+			iPlaneID[0] = PLANAR_G;
+			iPlaneID[1] = PLANAR_B;
+			iPlaneID[2] = PLANAR_R;
+			iPlaneID[3] = PLANAR_A;
+		}
+		else
+		{
+			iPlanes = ((i_pixeltype & VideoInfo::CS_YUVA) == VideoInfo::CS_YUVA) ? 4 : 3;
+			iPlaneID[0] = PLANAR_Y;
+			iPlaneID[1] = PLANAR_U;
+			iPlaneID[2] = PLANAR_V;
+			iPlaneID[3] = PLANAR_A;
+			iSubW = (((i_pixeltype >> VideoInfo::CS_Shift_Sub_Width) & 7) + 1) & 3;
+			iSubH = (((i_pixeltype >> VideoInfo::CS_Shift_Sub_Height) & 7) + 1) & 3;
+		}
+	}
+	else
+		return FALSE;
+
+	for (int i = 0; i < iPlanes; i++)
+	{
+		BOOL bChroma = ((iPlaneID[i] == PLANAR_U) || (iPlaneID[i] == PLANAR_V)) ? TRUE : FALSE;
+		iRowSize[i] = (bChroma ? (params.iWidth >> iSubW) : params.iWidth) * iBytes;
+		iHeight[i] = bChroma ? (params.iHeight >> iSubH) : params.iHeight;
+	}
+
+	iBitsPerComponent = iBits;
+	iSubSamplingW = iSubW;
+	iSubSamplingH = iSubH;
+
+	//keeps integer samples within their bit depth and floats within [0, 1)
+	if (iBits == 32)
+		uiSampleMask = 0x3F7FFFFF3F7FFFFF;
+	else if (iBits > 8)
+		uiSampleMask = ((unsigned __int64)((1 << iBits) - 1)) * 0x0001000100010001;
+	else
+		uiSampleMask = 0xFFFFFFFFFFFFFFFF;
+
+	return TRUE;
+}
+
+
+void CSyntheticSource::AllocFrame(stSyntheticFrame &frame)
+{
+	size_t nSize = 0;
+	for (int i = 0; i < iPlanes; i++)
+	{
+		frame.iPitch[i] = (iRowSize[i] + SYNTHETIC_ALIGN - 1) & ~(SYNTHETIC_ALIGN - 1);
+		nSize += (size_t)frame.iPitch[i] * iHeight[i];
+	}
+
+	frame.vBuffer.resize(nSize + SYNTHETIC_ALIGN);
+	BYTE *pBase = &frame.vBuffer[0];
+	pBase += (SYNTHETIC_ALIGN - ((size_t)pBase & (SYNTHETIC_ALIGN - 1))) & (SYNTHETIC_ALIGN - 1);
+
+	for (int i = 0; i < SYNTHETIC_MAX_PLANES; i++)
+	{
+		frame.pPlane[i] = (i < iPlanes) ? pBase : NULL;
+		if (i < iPlanes)
+			pBase += (size_t)frame.iPitch[i] * iHeight[i];
+		else
+			frame.iPitch[i] = 0;
+	}
+
+	return;
+}
+
+
+void CSyntheticSource::Render(unsigned int ui_frame, stSyntheticFrame &frame)
+{
+	if (!bInitialized)
+		return;
+
+	if (vWorkers.size() == 0)
+	{
+		RenderStrip(0, 1, ui_frame, frame);
+		return;
+	}
+
+	//one frame at a time through the pool, concurrent callers queue up here
+	::EnterCriticalSection(&csRender);
+
+	uiJobFrame = ui_frame;
+	pJobFrame = &frame;
+	lPending = (LONG)vWorkers.size();
+	for (size_t i = 0; i < vWorkers.size(); i++)
+		::SetEvent(vWorkers[i].hWake);
+
+	RenderStrip(0, (unsigned int)vWorkers.size() + 1, ui_frame, frame);
+	::WaitForSingleObject(hDone, INFINITE);
+
+	pJobFrame = NULL;
+	::LeaveCriticalSection(&csRender);
+
+	return;
+}
+
+
+unsigned __stdcall CSyntheticSource::WorkerProc(void *p_worker)
+{
+	stWorker *pWorker = (stWorker*)p_worker;
+	CSyntheticSource *pThis = pWorker->pThis;
+
+	for (;;)
+	{
+		::WaitForSingleObject(pWorker->hWake, INFINITE);
+		if (pThis->bQuit)
+			break;
+
+		pThis->RenderStrip(pWorker->uiStrip, (unsigned int)pThis->vWorkers.size() + 1, pThis->uiJobFrame, *pThis->pJobFrame);
+
+		if (::InterlockedDecrement(&pThis->lPending) == 0)
+			::SetEvent(pThis->hDone);
+	}
+
+	return 0;
+}
+
+
+void CSyntheticSource::RenderStrip(unsigned int ui_strip, unsigned int ui_strips, unsigned int ui_frame, stSyntheticFrame &frame)
+{
+	unsigned __int64 uiFrameSeed = ((unsigned __int64)params.uiSeed << 32) ^ (unsigned __int64)ui_frame;
+
+	for (int iPlane = 0; iPlane < iPlanes; iPlane++)
+	{
+		int iFirst = (int)(((__int64)iHeight[iPlane] * ui_strip) / ui_strips);
+		int iLast = (int)(((__int64)iHeight[iPlane] * (ui_strip + 1)) / ui_strips);
+		int iWords = iRowSize[iPlane] / 8;
+		int iTail = iRowSize[iPlane] % 8;
+
+		for (int y = iFirst; y < iLast; y++)
+		{
+			BYTE *pRow = frame.pPlane[iPlane] + (size_t)frame.iPitch[iPlane] * y;
+			unsigned __int64 uiValue = Hash(uiFrameSeed ^ ((unsigned __int64)iPlane << 56) ^ ((unsigned __int64)y << 24));
+			unsigned __int64 *pWord = (unsigned __int64*)pRow;
+			for (int x = 0; x < iWords; x++)
+				pWord[x] = (uiValue + (unsigned __int64)x * 0x0101010101010101) & uiSampleMask;
+
+			if (iTail > 0)
+			{
+				unsigned __int64 uiLast = (uiValue + (unsigned __int64)iWords * 0x0101010101010101) & uiSampleMask;
+				memcpy(pRow + (size_t)iWords * 8, &uiLast, iTail);
+			}
+		}
+	}
+
+	if (pWorkingSet != NULL)
+	{
+		size_t nBegin = ((nWorkingSet / ui_strips) * ui_strip) & ~((size_t)SYNTHETIC_ALIGN - 1);
+		size_t nEnd = (ui_strip == (ui_strips - 1)) ? nWorkingSet : ((nWorkingSet / ui_strips) * (ui_strip + 1)) & ~((size_t)SYNTHETIC_ALIGN - 1);
+		for (size_t n = nBegin; n < nEnd; n += SYNTHETIC_ALIGN)
+			pWorkingSet[n] += (BYTE)ui_frame;
+	}
+
+	//the frame cost is shared by all strips, like a filter with internal threading
+	Spin(GetFrameCostMS(ui_frame) / (double)ui_strips);
+
+	return;
+}
+
+
+double CSyntheticSource::GetFrameCostMS(unsigned int ui_frame)
+{
+	double dCost = params.dCostMS;
+
+	if (params.iCostModel == SYNTHETIC_COST_JITTER)
+	{
+		double dRandom = (double)(Hash(((unsigned __int64)params.uiSeed << 32) ^ ui_frame ^ 0xA5A5A5A5) >> 11) / 9007199254740992.0; //[0, 1)
+		dCost += params.dJitterMS * ((2.0 * dRandom) - 1.0);
+	}
+	else if (params.iCostModel == SYNTHETIC_COST_SPIKES)
+	{
+		if ((ui_frame % params.uiSpikePeriod) == (params.uiSpikePeriod - 1))
+			dCost = params.dSpikeMS;
+	}
+
+	return (dCost > 0.0) ? dCost : 0.0;
+}
+
+
+void CSyntheticSource::Spin(double d_ms)
+{
+	if ((d_ms <= 0.0) || (dPerfFreq <= 0.0))
+		return;
+
+	//busy wait, a sleeping thread would not show up as CPU load
+	LARGE_INTEGER liStart = {0,0};
+	LARGE_INTEGER liNow = {0,0};
+	::QueryPerformanceCounter(&liStart);
+	__int64 iTicks = (__int64)((d_ms * dPerfFreq) / 1000.0);
+	do
+	{
+		::QueryPerformanceCounter(&liNow);
+	}
+	while ((liNow.QuadPart - liStart.QuadPart) < iTicks);
+
+	return;
+}
+
+
+unsigned __int64 CSyntheticSource::Hash(unsigned __int64 ui_value)
+{
+	//splitmix64 finalizer
+	ui_value += 0x9E3779B97F4A7C15;
+	ui_value = (ui_value ^ (ui_value >> 30)) * 0xBF58476D1CE4E5B9;
+	ui_value = (ui_value ^ (ui_value >> 27)) * 0x94D049BB133111EB;
+
+	return ui_value ^ (ui_value >> 31);
+}
+
+
+string CSyntheticSource::GetDescription()
+{
+	const char *pszModels[] = {"constant", "jitter", "spikes", "memory"};
+	string sText = utils.StrFormat("%dx%d %s, %u frames, %u/%u fps, cost %s %.3f ms", params.iWidth, params.iHeight, params.sPixelType.c_str(),
+		params.uiFrames, params.uiFPSNum, params.uiFPSDen, pszModels[params.iCostModel], params.dCostMS);
+
+	if (params.iCostModel == SYNTHETIC_COST_JITTER)
+		sText += utils.StrFormat(" +/- %.3f ms", params.dJitterMS);
+	else if (params.iCostModel == SYNTHETIC_COST_SPIKES)
+		sText += utils.StrFormat(", %.3f ms every %u frames", params.dSpikeMS, params.uiSpikePeriod);
+	else if (params.iCostModel == SYNTHETIC_COST_MEMORY)
+		sText += utils.StrFormat(" + %u MiB", params.uiMemoryMB);
+
+	sText += utils.StrFormat(", %u thread(s), seed %u", params.uiThreads, params.uiSeed);
+
+	return sText;
+}
+
+
+CSyntheticClip::CSyntheticClip(const stSyntheticParams &params)
+{
+	memset(&vi, 0, sizeof(vi));
+	vi.width = params.iWidth;
+	vi.height = params.iHeight;
+	vi.pixel_type = params.iPixelType;
+	vi.fps_numerator = params.uiFPSNum;
+	vi.fps_denominator = params.uiFPSDen;
+	vi.num_frames = (int)params.uiFrames;
+
+	source.Init(params);
+}
+
+CSyntheticClip::~CSyntheticClip()
+{
+}
+
+
+PVideoFrame __stdcall CSyntheticClip::GetFrame(int n, IScriptEnvironment* env)
+{
+	if (source.sError != "")
+		env->ThrowError("Synthetic clip: %s", source.sError.c_str());
+
+	if (n < 0)
+		n = 0;
+	if (n >= vi.num_frames)
+		n = vi.num_frames - 1;
+
+	PVideoFrame dst = env->NewVideoFrame(vi);
+
+	stSyntheticFrame frame;
+	for (int i = 0; i < SYNTHETIC_MAX_PLANES; i++)
+	{
+		frame.pPlane[i] = (i < source.iPlanes) ? dst->GetWritePtr(source.iPlaneID[i]) : NULL;
+		frame.iPitch[i] = (i < source.iPlanes) ? dst->GetPitch(source.iPlaneID[i]) : 0;
+	}
+
+	source.Render((unsigned int)n, frame);
+
+	return dst;
+}
+
+
+//Import() for scripts and synthetic specs alike
+AVSValue CSyntheticClip::ImportScript(IScriptEnvironment *env, const string &s_script)
+{
+	if (!CSyntheticSource::IsSyntheticSpec(s_script))
+		return env->Invoke("Import", s_script.c_str());
+
+	stSyntheticParams params;
+	string sError = "";
+	if (!CSyntheticSource::ParseSpec(s_script, params, sError))
+		env->ThrowError("\"%s\":\n%s", s_script.c_str(), sError.c_str());
+
+	CSyntheticClip *pClip = new CSyntheticClip(params);
+	if (pClip->source.sError != "")
+	{
+		sError = pClip->source.sError;
+		delete pClip;
+		env->ThrowError("\"%s\":\n%s", s_script.c_str(), sError.c_str());
+	}
+
+	return AVSValue(pClip);
+}
+
+
+int __stdcall CSyntheticClip::SetCacheHints(int cachehints, int frame_range)
+{
+	//the internal pool renders one frame at a time
+	if (cachehints == CACHE_GET_MTMODE)
+		return (source.params.uiThreads > 1) ? MT_SERIALIZED : MT_NICE_FILTER;
+
+	return 0;
+}
+
+
+#endif //_SYNTHETICCLIP_H
@@ -20,10 +20,15 @@
 #define _SYSINFO_H
 
 #include "common.h"
-#include "utility.h"
+#include "Utility.h"
 
 #include <immintrin.h>
+#if defined(_WIN32)
 #include <intrin.h>
+#else
+#include <cpuid.h>
+#include <sys/utsname.h>
+#endif
 
 class CSysInfo
 {
@@ -38,6 +43,11 @@ public:
 	string            CPUBrandString;
 	string            CPUVendorString;
 	string            CPUFeatures;
+	BOOL              bSSE2;   //usable instruction sets (CPU and OS support)
+	BOOL              bSSSE3;
+	BOOL              bSSE41;
+	BOOL              bAVX;
+	BOOL              bAVX2;
 
 private:
 	CUtils            utils;
@@ -50,6 +60,11 @@ private:
 
 CSysInfo::CSysInfo()
 {
+	bSSE2 = FALSE;
+	bSSSE3 = FALSE;
+	bSSE41 = FALSE;
+	bAVX = FALSE;
+	bAVX2 = FALSE;
 }
 
 CSysInfo::~CSysInfo()
@@ -57,6 +72,8 @@ CSysInfo::~CSysInfo()
 }
 
 
+#if defined(_WIN32)
+
 string CSysInfo::GetOSVersion()
 {
 	typedef LONG NTSTATUS, *PNTSTATUS;
@@ -135,6 +152,36 @@ string CSysInfo::GetOSVersion()
 	return sOSVersion + sOSAddendum;
 }
 
+#else //_WIN32
+
+string CSysInfo::GetOSVersion()
+{
+	string sOSVersion = "Unknown OS Version";
+	struct utsname un;
+	if (uname(&un) != 0)
+		return sOSVersion;
+
+	sOSVersion = utils.StrFormat("%s %s (%s)", un.sysname, un.release, un.machine);
+
+	ifstream ifsRelease("/etc/os-release");
+	string sLine = "";
+	while (getline(ifsRelease, sLine))
+	{
+		if (sLine.substr(0, 12) != "PRETTY_NAME=")
+			continue;
+
+		string sName = sLine.substr(12);
+		sName.erase(remove(sName.begin(), sName.end(), '"'), sName.end());
+		if (sName != "")
+			sOSVersion = sName + ", " + sOSVersion;
+		break;
+	}
+
+	return sOSVersion;
+}
+
+#endif //_WIN32
+
 
 string CSysInfo::GetFormattedSystemDateTime()
 {
@@ -282,6 +329,12 @@ void CSysInfo::GetCPUFeatures()
 	if ((xcrFeatureMask & (0x7 << 5)) && (xcrFeatureMask & (0x3 << 1)))
 		OS_FEATURE_AVX512 = OS_FEATURE_AVX;
 
+	bSSE2 = CPU_FEATURE_SSE2;
+	bSSSE3 = CPU_FEATURE_SSSE3;
+	bSSE41 = CPU_FEATURE_SSE41;
+	bAVX = CPU_FEATURE_AVX && OS_FEATURE_AVX;
+	bAVX2 = CPU_FEATURE_AVX2 && OS_FEATURE_AVX;
+
 	CPUFeatures = "";
 
 	if (CPU_FEATURE_MMX)        CPUFeatures += "MMX, ";
@@ -392,7 +445,9 @@ void CSysInfo::cpuid(int *regs, int info_type)
 	regs[2] = 0;
 	regs[3] = 0;
 
-	#if (_MSC_VER < 1500)
+	#if !defined(_MSC_VER)
+		__cpuid_count(info_type, 0, regs[0], regs[1], regs[2], regs[3]);
+	#elif (_MSC_VER < 1500)
 	__asm
 	{
 		mov   esi, regs
@@ -414,7 +469,11 @@ void CSysInfo::cpuid(int *regs, int info_type)
 
 unsigned __int64 CSysInfo::xgetbv(int ctr)
 {
-	#if (defined (_MSC_FULL_VER) && _MSC_FULL_VER >= 160040219)
+	#if !defined(_MSC_VER)
+		unsigned int a, d;
+		__asm__ __volatile__ ("xgetbv" : "=a" (a), "=d" (d) : "c" (ctr));
+		return a | ((unsigned __int64)d << 32);
+	#elif (defined (_MSC_FULL_VER) && _MSC_FULL_VER >= 160040219)
 		return _xgetbv(ctr);
 	#else
 		unsigned int a, d;
@@ -447,6 +506,13 @@ BOOL CSysInfo::Is64BitOS()
 	if (sizeof(void*) == 8)
 		return TRUE; //64 on 64
 
+#if !defined(_WIN32)
+	struct utsname un;
+	if ((uname(&un) == 0) && (strstr(un.machine, "64") != NULL))
+		return TRUE;
+
+	return FALSE;
+#else
 	BOOL bWoW64Process = FALSE;
 	typedef BOOL (WINAPI *LPFN_ISWOW64PROCESS) (HANDLE, PBOOL);
 	LPFN_ISWOW64PROCESS fnIsWow64Process;
@@ -461,6 +527,7 @@ BOOL CSysInfo::Is64BitOS()
 		return TRUE;
 
 	return FALSE;
+#endif
 }
 
 
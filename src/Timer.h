@@ -58,6 +58,7 @@ double CTimer::GetTimer()
 	LARGE_INTEGER liPerfCounter = {0,0};
 	LARGE_INTEGER liPerfFreq = {0,0};
 
+#if defined(_WIN32)
 	DWORD_PTR dwpOldMask = ::SetThreadAffinityMask(::GetCurrentThread(), 0x1);
 
 	::QueryPerformanceFrequency(&liPerfFreq);
@@ -65,6 +66,11 @@ double CTimer::GetTimer()
 
 	if (dwpOldMask != 0)
 		::SetThreadAffinityMask(::GetCurrentThread(), dwpOldMask);
+#else
+	//CLOCK_MONOTONIC is synchronized across cores, no need to pin the thread
+	::QueryPerformanceFrequency(&liPerfFreq);
+	::QueryPerformanceCounter(&liPerfCounter);
+#endif
 
 	return (double)liPerfCounter.QuadPart / (double)liPerfFreq.QuadPart;
 }
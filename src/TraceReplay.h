@@ -0,0 +1,253 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(_TRACEREPLAY_H)
+#define _TRACEREPLAY_H
+
+#include "common.h"
+#include "exception.h"
+#include "Utility.h"
+#include "FrameServer.h"
+#include "FrameTrace.h"
+
+#define REPLAY_SERIAL  TRACE_MAX_THREADS  //Replay() argument: every request, in trace order
+
+
+/*
+	Issues the requests of a frame trace against a loaded script.
+	By default one after the other, as fast as possible. With b_timing every
+	request waits for its recorded start time, with b_threads the requests
+	of every recorded thread are issued from a thread of their own, so
+	lookahead, re-requests and parallel requests hit the script as they did
+	under the consumer. Concurrent requests need a frame server that allows
+	them (Avisynth, not the pipelined VapourSynth server).
+*/
+class CTraceReplay
+{
+public:
+	CTraceReplay();
+	virtual ~CTraceReplay();
+
+	BOOL   Run(CFrameServer *p_frameserver, CFrameTrace &trace, BOOL b_timing, BOOL b_threads); //FALSE: sError is set
+
+	vector<double> vLatencyMS;      //per request, in trace order
+	double         dSeconds;        //first request to last completion
+	unsigned int   uiWorkers;
+	string         sError;
+
+private:
+	struct stReplayWorker
+	{
+		CTraceReplay *pReplay;
+		unsigned int uiThread;
+	};
+
+	static unsigned __stdcall WorkerProc(void *p_worker);
+	void   Replay(unsigned int ui_thread);
+	void   WaitUntil(double d_ms);
+	double Now();                   //ms
+	void   Abort(string s_error);
+
+	CFrameServer     *frameserver;
+	CFrameTrace      *pTrace;
+	BOOL             bTiming;
+	double           dOriginMS;
+	double           dPerfFreq;
+	HANDLE           hStartEvent;
+	volatile LONG    lAbort;
+	CRITICAL_SECTION csError;
+	CUtils           utils;
+};
+
+
+CTraceReplay::CTraceReplay()
+{
+	dSeconds = 0.0;
+	uiWorkers = 0;
+	sError = "";
+	frameserver = NULL;
+	pTrace = NULL;
+	bTiming = FALSE;
+	dOriginMS = 0.0;
+	hStartEvent = NULL;
+	lAbort = 0;
+	::InitializeCriticalSection(&csError);
+
+	LARGE_INTEGER liPerfFreq;
+	dPerfFreq = ::QueryPerformanceFrequency(&liPerfFreq) ? (double)liPerfFreq.QuadPart : 1.0;
+}
+
+CTraceReplay::~CTraceReplay()
+{
+	::DeleteCriticalSection(&csError);
+}
+
+
+BOOL CTraceReplay::Run(CFrameServer *p_frameserver, CFrameTrace &trace, BOOL b_timing, BOOL b_threads)
+{
+	frameserver = p_frameserver;
+	pTrace = &trace;
+	bTiming = b_timing;
+	lAbort = 0;
+	sError = "";
+	dSeconds = 0.0;
+	vLatencyMS.assign(trace.vRequests.size(), 0.0);
+
+	if (!b_threads || (trace.uiThreads < 2))
+	{
+		uiWorkers = 1;
+		dOriginMS = Now();
+		Replay(REPLAY_SERIAL);
+		dSeconds = (Now() - dOriginMS) / 1000.0;
+
+		return (sError == "") ? TRUE : FALSE;
+	}
+
+	hStartEvent = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+	stReplayWorker workers[TRACE_MAX_THREADS];
+	HANDLE hThreads[TRACE_MAX_THREADS];
+	uiWorkers = 0;
+	for (unsigned int uiThread = 0; uiThread < trace.uiThreads; uiThread++)
+	{
+		workers[uiWorkers].pReplay = this;
+		workers[uiWorkers].uiThread = uiThread;
+		hThreads[uiWorkers] = (HANDLE)_beginthreadex(NULL, 0, WorkerProc, &workers[uiWorkers], 0, NULL);
+		if (hThreads[uiWorkers] == NULL)
+		{
+			Abort("Cannot create the replay threads");
+			break;
+		}
+		++uiWorkers;
+	}
+
+	::Sleep(10);
+	dOriginMS = Now();
+	::SetEvent(hStartEvent);
+
+	while (::WaitForMultipleObjects(uiWorkers, hThreads, TRUE, 100) == WAIT_TIMEOUT)
+	{
+		if (_kbhit() && (_getch() == 0x1B)) //ESC
+			Abort("\'ESC\' pressed, cancelled.");
+	}
+
+	dSeconds = (Now() - dOriginMS) / 1000.0;
+
+	for (unsigned int i = 0; i < uiWorkers; i++)
+		::CloseHandle(hThreads[i]);
+	::CloseHandle(hStartEvent);
+	hStartEvent = NULL;
+
+	return (sError == "") ? TRUE : FALSE;
+}
+
+
+unsigned __stdcall CTraceReplay::WorkerProc(void *p_worker)
+{
+	stReplayWorker *pWorker = (stReplayWorker *)p_worker;
+	::WaitForSingleObject(pWorker->pReplay->hStartEvent, INFINITE);
+	pWorker->pReplay->Replay(pWorker->uiThread);
+
+	return 0;
+}
+
+
+void CTraceReplay::Replay(unsigned int ui_thread)
+{
+	try
+	{
+		_set_se_translator(SE_Translator);
+
+		for (size_t i = 0; i < pTrace->vRequests.size(); i++)
+		{
+			if (lAbort != 0)
+				break;
+
+			const stTraceRequest &request = pTrace->vRequests[i];
+			if ((ui_thread != REPLAY_SERIAL) && (request.uiThread != ui_thread))
+				continue;
+
+			if ((ui_thread == REPLAY_SERIAL) && _kbhit())
+			{
+				if (_getch() == 0x1B) //ESC
+					frameserver->ThrowError("\'ESC\' pressed, cancelled.");
+			}
+
+			if (bTiming)
+				WaitUntil(request.dStartMS);
+
+			double dStartMS = Now();
+			frameserver->GetFrame(request.uiFrame);
+			vLatencyMS[i] = Now() - dStartMS;
+		}
+	}
+	catch (AvisynthError err)
+	{
+		Abort(utils.StrFormat("%s", (PCSTR)err.msg));
+	}
+	catch (exception &ex)
+	{
+		Abort(ex.what());
+	}
+	catch (...)
+	{
+		Abort(utils.SysErrorMessage());
+	}
+
+	return;
+}
+
+
+void CTraceReplay::WaitUntil(double d_ms)
+{
+	//sleep while there is enough time left, spin for the rest
+	double dLeftMS = (dOriginMS + d_ms) - Now();
+	while ((dLeftMS > 2.0) && (lAbort == 0))
+	{
+		::Sleep(1);
+		dLeftMS = (dOriginMS + d_ms) - Now();
+	}
+
+	while ((dLeftMS > 0.0) && (lAbort == 0))
+		dLeftMS = (dOriginMS + d_ms) - Now();
+
+	return;
+}
+
+
+double CTraceReplay::Now()
+{
+	LARGE_INTEGER liPerfCounter = {0,0};
+	::QueryPerformanceCounter(&liPerfCounter);
+
+	return (1000.0 * (double)liPerfCounter.QuadPart) / dPerfFreq;
+}
+
+
+void CTraceReplay::Abort(string s_error)
+{
+	::EnterCriticalSection(&csError);
+	if (sError == "")
+		sError = s_error;
+	lAbort = 1;
+	::LeaveCriticalSection(&csError);
+
+	return;
+}
+
+
+#endif //_TRACEREPLAY_H
@@ -64,6 +64,7 @@ public:
 
 	//File/directory/system
 	string         SysErrorMessage();
+	string         LibraryErrorMessage();
 	__int64        FileSize(string s_file);
 	string         GetFileVersion(string s_file);
 	string         GetProductVersion(string s_file);
@@ -94,9 +95,15 @@ public:
 private:
 	HANDLE         hConsole;
 	WORD           wSavedAttributes;
+#if !defined(_WIN32)
+	FILE*          GetConsoleStream();
+	string         FormatTimeStamp(string s_file, const char *s_fmt);
+#endif
 };
 
 
+#if defined(_WIN32)
+
 CUtils::CUtils()
 {
 	hConsole = ::GetStdHandle(STD_OUTPUT_HANDLE);
@@ -132,6 +139,12 @@ string CUtils::SysErrorMessage()
 }
 
 
+string CUtils::LibraryErrorMessage()
+{
+	return SysErrorMessage();
+}
+
+
 int CUtils::GetConsoleWidth()
 {
 	CONSOLE_SCREEN_BUFFER_INFO csbi;
@@ -259,6 +272,210 @@ string CUtils::GetFileDateStamp(string s_file)
 }
 
 
+#else //_WIN32
+
+CUtils::CUtils()
+{
+	hConsole = NULL;
+	wSavedAttributes = FG_GREY;
+}
+
+CUtils::~CUtils()
+{
+}
+
+
+string CUtils::SysErrorMessage()
+{
+	int iLastError = errno;
+	if (iLastError == 0)
+		return "";
+
+	return strerror(iLastError);
+}
+
+
+//only valid right after a failed LoadLibrary(), dlopen() reports through dlerror() and not errno
+string CUtils::LibraryErrorMessage()
+{
+	if (g_sLastDLError != "")
+		return g_sLastDLError;
+
+	return SysErrorMessage();
+}
+
+
+//Colors and cursor moves go to whichever standard stream is a terminal
+FILE* CUtils::GetConsoleStream()
+{
+	if (isatty(STDOUT_FILENO))
+		return stdout;
+	if (isatty(STDERR_FILENO))
+		return stderr;
+
+	return NULL;
+}
+
+
+int CUtils::GetConsoleWidth()
+{
+	struct winsize ws;
+	if ((ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0) && (ws.ws_col > 0))
+		return (int)ws.ws_col;
+	if ((ioctl(STDERR_FILENO, TIOCGWINSZ, &ws) == 0) && (ws.ws_col > 0))
+		return (int)ws.ws_col;
+
+	return 80;
+}
+
+
+void CUtils::CursorUp(unsigned int iRows)
+{
+	FILE *fpConsole = GetConsoleStream();
+	if (fpConsole == NULL)
+		return;
+
+	if (iRows > 0)
+		fprintf(fpConsole, "\x1b[%uA\r", iRows);
+	else
+		fprintf(fpConsole, "\r");
+	fflush(fpConsole);
+
+	return;
+}
+
+
+//Maps the console attribute bits (BGR order) to ANSI SGR colors (RGB order)
+void CUtils::SetConsoleColors(WORD wAttributes)
+{
+	FILE *fpConsole = GetConsoleStream();
+	if (fpConsole == NULL)
+		return;
+
+	static const int iANSI[8] = {0, 4, 2, 6, 1, 5, 3, 7};
+	int iFG = iANSI[wAttributes & 0x07] + ((wAttributes & FOREGROUND_INTENSITY) ? 90 : 30);
+	int iBG = iANSI[(wAttributes >> 4) & 0x07] + ((wAttributes & BACKGROUND_INTENSITY) ? 100 : 40);
+
+	fflush(stdout);
+	fflush(stderr);
+	if ((wAttributes & 0xF0) == 0)
+		fprintf(fpConsole, "\x1b[0;%dm", iFG);
+	else
+		fprintf(fpConsole, "\x1b[0;%d;%dm", iFG, iBG);
+	fflush(fpConsole);
+
+	return;
+}
+
+
+void CUtils::ResetConsoleColors()
+{
+	FILE *fpConsole = GetConsoleStream();
+	if (fpConsole == NULL)
+		return;
+
+	fflush(stdout);
+	fflush(stderr);
+	fprintf(fpConsole, "\x1b[0m");
+	fflush(fpConsole);
+
+	return;
+}
+
+
+__int64 CUtils::FileSize(string s_file)
+{
+	struct stat st;
+	if (stat(s_file.c_str(), &st) != 0)
+		return -1;
+
+	return (__int64)st.st_size;
+}
+
+
+BOOL CUtils::FileExists(string s_file)
+{
+	struct stat st;
+	if (stat(s_file.c_str(), &st) != 0)
+		return FALSE;
+
+	return S_ISDIR(st.st_mode) ? FALSE : TRUE;
+}
+
+
+BOOL CUtils::DirectoryExists(string s_dir)
+{
+	struct stat st;
+	if (stat(s_dir.c_str(), &st) != 0)
+		return FALSE;
+
+	return S_ISDIR(st.st_mode) ? TRUE : FALSE;
+}
+
+
+string CUtils::FormatTimeStamp(string s_file, const char *s_fmt)
+{
+	struct stat st;
+	struct tm tmUTC;
+	if ((stat(s_file.c_str(), &st) != 0) || (gmtime_r(&st.st_mtime, &tmUTC) == NULL))
+		return "Cannot determine timestamp";
+
+	char szStamp[64];
+	strftime(szStamp, sizeof(szStamp), s_fmt, &tmUTC);
+
+	return szStamp;
+}
+
+
+string CUtils::GetFileTimeStamp(string s_file)
+{
+	return FormatTimeStamp(s_file, "%Y-%m-%d, %H:%M:%S (UTC)");
+}
+
+
+string CUtils::GetFileDateStamp(string s_file)
+{
+	return FormatTimeStamp(s_file, "%Y-%m-%d");
+}
+
+
+//There are no version resources, AVSMeter's own version is set by the build
+//and shared objects carry theirs in the file name (libavisynth.so.3.7.3)
+string CUtils::GetFileVersion(string s_file)
+{
+	if (s_file == "")
+	{
+#if defined(AVSMETER_VERSION)
+		return AVSMETER_VERSION;
+#else
+		return "n/a";
+#endif
+	}
+
+	char szReal[PATH_MAX + 1];
+	string sFile = realpath(s_file.c_str(), szReal) ? szReal : s_file;
+	size_t nPos = sFile.rfind(".so.");
+	if ((nPos == string::npos) || (sFile.find('/', nPos) != string::npos))
+		return "n/a";
+
+	return sFile.substr(nPos + 4);
+}
+
+
+string CUtils::GetProductVersion(string s_file)
+{
+	return GetFileVersion(s_file);
+}
+
+
+string CUtils::StrAnsiToOEM(string s_string)
+{
+	return s_string;
+}
+
+#endif //_WIN32
+
+
 string CUtils::StrFormat(char const *fmt, ...)
 {
 	#define MIN_BUF_SIZE   256
@@ -270,7 +487,10 @@ string CUtils::StrFormat(char const *fmt, ...)
 
 	for (;;)
 	{
-		iRet = _vsnprintf(&buffer[0], buffer.size() - 1, fmt, args);
+		va_list argsCopy;
+		va_copy(argsCopy, args);
+		iRet = _vsnprintf(&buffer[0], buffer.size() - 1, fmt, argsCopy);
+		va_end(argsCopy);
 		if (iRet == -1)
 			buffer.resize(buffer.size() * 2);
 		else
@@ -355,6 +575,8 @@ string CUtils::StrFormatTPF(double d_frametime)
 }
 
 
+#if defined(_WIN32)
+
 string CUtils::GetFileVersion(string s_file)
 {
 	string sFileVersion = "n/a";
@@ -440,6 +662,8 @@ string CUtils::GetProductVersion(string s_file)
 	return sProductVersion;
 }
 
+#endif //_WIN32
+
 
 BOOL CUtils::IsNumeric(string s_string)
 {
@@ -502,6 +726,8 @@ void CUtils::StrTokenize(string s_string, vector<string> &tokens, string s_delim
 }
 
 
+#if defined(_WIN32)
+
 string CUtils::StrAnsiToOEM(string s_string)
 {
 	vector<char> buffer(s_string.length() + 1);
@@ -510,5 +736,7 @@ string CUtils::StrAnsiToOEM(string s_string)
 	return sOEM;
 }
 
+#endif //_WIN32
+
 
 #endif //_UTILITY_H
@@ -19,6 +19,8 @@
 #if !defined(_COMMON_H)
 #define _COMMON_H
 
+#if defined(_WIN32)
+
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
 #endif
@@ -36,10 +38,10 @@
 #include <psapi.h>
 #include <tlhelp32.h>
 #include <wintrust.h>
-#include <imagehlp.h>
 #include <conio.h>
 #include <fstream>
 #include <vector>
+#include <deque>
 #include <map>
 #include <set>
 #include <eh.h>
@@ -47,10 +49,31 @@
 #define sprintf sprintf_s
 //#define _snprintf _snprintf_s
 
+#define PATH_SEPARATOR     '\\'
+#define PATH_SEPARATOR_STR "\\"
+
+#else //_WIN32
+
+#include <math.h>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+#define PATH_SEPARATOR     '/'
+#define PATH_SEPARATOR_STR "/"
+
+#endif //_WIN32
+
 using std::string;
 using std::ifstream;
 using std::ofstream;
 using std::vector;
+using std::deque;
 using std::sort;
 using std::map;
 using std::set;
@@ -59,6 +82,10 @@ using std::getline;
 using std::remove;
 using std::exception;
 
+#if !defined(_WIN32)
+#include "posix.h"
+#endif
+
 #define DSE_DELAY 500
 const BOOL PROCESS_64 = (sizeof(void*) == 8) ? TRUE : FALSE;
 const HWND ConsoleHWND = GetConsoleWindow();
@@ -88,6 +115,8 @@ string GetWOW64FilePath(string s_filepath)
 {
 	string sRealFilePath = s_filepath;
 
+#if defined(_WIN32)
+
 	BOOL bWoW64Process = FALSE;
 	typedef BOOL (WINAPI *LPFN_ISWOW64PROCESS) (HANDLE, PBOOL);
 	LPFN_ISWOW64PROCESS fnIsWow64Process;
@@ -127,6 +156,7 @@ string GetWOW64FilePath(string s_filepath)
 			}
 		}
 	}
+#endif
 
 	return sRealFilePath;
 }
@@ -24,6 +24,10 @@
 
 #include "common.h"
 
+#if !defined(_WIN32)
+#include <ucontext.h>
+#endif
+
 //test STATUS_FLOAT_DIVIDE_BY_ZERO:
 //	int a = 0;
 //	int b = 100;
@@ -34,6 +38,8 @@
 //	*pInt = 20;
 
 
+#if defined(_WIN32)
+
 string GetExceptionModule(LPVOID address);
 void SE_Translator(unsigned int, EXCEPTION_POINTERS* pExcept);
 
@@ -1857,6 +1863,116 @@ void SE_Translator(unsigned int, EXCEPTION_POINTERS* pExcept)
   throw exception(msg);
 }
 
+#else //_WIN32
+
+/*
+	Faults are turned into C++ exceptions by throwing from the signal handler,
+	which needs the unwinder to walk through the signal frame. The build sets
+	-fnon-call-exceptions for that, so the same try/catch blocks that catch
+	translated SEH exceptions on Windows catch these.
+*/
+typedef void (*SE_TRANSLATOR_FUNC)(int, siginfo_t*, void*);
+
+string GetExceptionModule(LPVOID address);
+void SE_Translator(int i_signal, siginfo_t* p_info, void* p_context);
+SE_TRANSLATOR_FUNC _set_se_translator(SE_TRANSLATOR_FUNC p_func);
+
+
+string GetExceptionModule(LPVOID address)
+{
+	Dl_info dli;
+	if ((dladdr(address, &dli) == 0) || (dli.dli_fname == NULL))
+		return "";
+
+	char szReal[PATH_MAX + 1];
+	string sModule = realpath(dli.dli_fname, szReal) ? szReal : dli.dli_fname;
+
+	return sModule;
+}
+
+
+void SE_Translator(int i_signal, siginfo_t* p_info, void* p_context)
+{
+	char msg[2048];
+	string sExceptionName = "UNKNOWN_EXCEPTION";
+	void *pAddress = p_info->si_addr;
+
+#if defined(__x86_64__)
+	if (p_context)
+		pAddress = (void *)((ucontext_t *)p_context)->uc_mcontext.gregs[REG_RIP];
+#elif defined(__i386__)
+	if (p_context)
+		pAddress = (void *)((ucontext_t *)p_context)->uc_mcontext.gregs[REG_EIP];
+#endif
+
+	switch (i_signal)
+	{
+		case SIGSEGV:
+			sExceptionName = (p_info->si_code == SEGV_ACCERR) ? "SIGSEGV (access violation)" : "SIGSEGV (address not mapped)";
+			break;
+		case SIGBUS:  sExceptionName = "SIGBUS (misaligned or nonexistent address)"; break;
+		case SIGILL:  sExceptionName = "SIGILL (illegal instruction)"; break;
+		case SIGFPE:
+			switch (p_info->si_code)
+			{
+				case FPE_INTDIV: sExceptionName = "SIGFPE (integer divide by zero)"; break;
+				case FPE_INTOVF: sExceptionName = "SIGFPE (integer overflow)"; break;
+				case FPE_FLTDIV: sExceptionName = "SIGFPE (float divide by zero)"; break;
+				case FPE_FLTOVF: sExceptionName = "SIGFPE (float overflow)"; break;
+				case FPE_FLTUND: sExceptionName = "SIGFPE (float underflow)"; break;
+				case FPE_FLTRES: sExceptionName = "SIGFPE (float inexact result)"; break;
+				case FPE_FLTINV: sExceptionName = "SIGFPE (float invalid operation)"; break;
+				default:         sExceptionName = "SIGFPE"; break;
+			}
+			break;
+		default: sExceptionName = "UNKNOWN_EXCEPTION";
+	}
+
+	string sExceptionModule = GetExceptionModule(pAddress);
+	if (sExceptionModule == "") sExceptionModule = "Cannot determine module";
+
+	//The handler runs with the signal blocked, unblock it or the next fault kills the process
+	sigset_t ssUnblock;
+	sigemptyset(&ssUnblock);
+	sigaddset(&ssUnblock, i_signal);
+	pthread_sigmask(SIG_UNBLOCK, &ssUnblock, NULL);
+
+	snprintf(msg, sizeof(msg), "Signal %d [%s]\nModule:   %s\nAddress:  %p", i_signal, sExceptionName.c_str(), sExceptionModule.c_str(), pAddress);
+
+	throw std::runtime_error(msg);
+}
+
+
+//Signal dispositions are process wide, the Windows translator is per thread
+SE_TRANSLATOR_FUNC _set_se_translator(SE_TRANSLATOR_FUNC p_func)
+{
+	static SE_TRANSLATOR_FUNC pCurrent = NULL;
+	SE_TRANSLATOR_FUNC pPrevious = pCurrent;
+	if (p_func == pCurrent)
+		return pPrevious;
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+	sa.sa_sigaction = p_func;
+	sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+
+	const int iSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL};
+	for (unsigned int i = 0; i < sizeof(iSignals) / sizeof(iSignals[0]); i++)
+	{
+		if (p_func)
+			sigaction(iSignals[i], &sa, NULL);
+		else
+			signal(iSignals[i], SIG_DFL);
+	}
+
+	pCurrent = p_func;
+
+	return pPrevious;
+}
+
+#endif //_WIN32
+
 
 #endif //_EXCEPTION_H
 
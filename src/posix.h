@@ -0,0 +1,978 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+	POSIX platform layer. Provides the subset of the Win32 API and the MSVC
+	runtime that the measurement engine relies on (types, dlopen() based
+	module loading, events, threads, critical sections, timers, affinity and
+	termios key polling), so that the same code benchmarks scripts against
+	libavisynth.so. Only included by common.h on non-Windows builds.
+*/
+
+#if !defined(_POSIX_H)
+#define _POSIX_H
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/file.h>
+#include <sys/select.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <link.h>
+
+
+//Types
+typedef int                BOOL;
+typedef unsigned char      BYTE;
+typedef unsigned short     WORD;
+typedef uint32_t           DWORD;
+typedef int32_t            LONG;
+typedef unsigned int       UINT;
+typedef uint32_t           UINT32;
+typedef uint64_t           ULONGLONG;
+typedef uintptr_t          DWORD_PTR;
+typedef uintptr_t          ULONG_PTR;
+typedef void               VOID;
+typedef void*              LPVOID;
+typedef void*              HANDLE;
+typedef void*              HMODULE;
+typedef void*              HINSTANCE;
+typedef void*              HWND;
+typedef char*              LPTSTR;
+typedef char*              LPSTR;
+typedef const char*        LPCSTR;
+typedef const char*        PCSTR;
+typedef BOOL*              PBOOL;
+typedef BYTE*              LPBYTE;
+typedef DWORD*             LPDWORD;
+typedef wchar_t            WCHAR;
+
+#define __int64            long long
+#define __stdcall
+#define __cdecl
+#define WINAPI
+#define __declspec(x)
+
+#if !defined(TRUE)
+#define TRUE  1
+#define FALSE 0
+#endif
+
+#define MAX_PATH                   4096
+#define INFINITE                   0xFFFFFFFF
+#define WAIT_OBJECT_0              0x00000000
+#define WAIT_TIMEOUT               0x00000102
+#define WAIT_FAILED                0xFFFFFFFF
+#define ERROR_SUCCESS              0
+#define ERROR_ALREADY_EXISTS       EEXIST
+#define INVALID_HANDLE_VALUE       ((HANDLE)(intptr_t)-1)
+#define INVALID_FILE_ATTRIBUTES    0xFFFFFFFF
+#define FILE_ATTRIBUTE_DIRECTORY   0x00000010
+#define FILE_ATTRIBUTE_NORMAL      0x00000080
+
+#define IDLE_PRIORITY_CLASS        0x00000040
+#define NORMAL_PRIORITY_CLASS      0x00000020
+#define HIGH_PRIORITY_CLASS        0x00000080
+
+#define SEM_FAILCRITICALERRORS     0x0001
+#define SEM_NOGPFAULTERRORBOX      0x0002
+#define SEM_NOOPENFILEERRORBOX     0x8000
+
+#define MB_OK                      0x00000000
+#define MB_ICONERROR               0x00000010
+#define MB_ICONEXCLAMATION         0x00000030
+#define MB_ICONWARNING             0x00000030
+#define MB_ICONINFORMATION         0x00000040
+
+#define FOREGROUND_BLUE            0x0001
+#define FOREGROUND_GREEN           0x0002
+#define FOREGROUND_RED             0x0004
+#define FOREGROUND_INTENSITY       0x0008
+#define BACKGROUND_BLUE            0x0010
+#define BACKGROUND_GREEN           0x0020
+#define BACKGROUND_RED             0x0040
+#define BACKGROUND_INTENSITY       0x0080
+
+#define LOWORD(l)                  ((WORD)(((DWORD_PTR)(l)) & 0xffff))
+#define HIWORD(l)                  ((WORD)((((DWORD_PTR)(l)) >> 16) & 0xffff))
+
+typedef union _LARGE_INTEGER
+{
+	struct
+	{
+		DWORD LowPart;
+		LONG  HighPart;
+	};
+	long long QuadPart;
+} LARGE_INTEGER;
+
+typedef struct _FILETIME
+{
+	DWORD dwLowDateTime;
+	DWORD dwHighDateTime;
+} FILETIME;
+
+typedef struct _SYSTEMTIME
+{
+	WORD wYear;
+	WORD wMonth;
+	WORD wDayOfWeek;
+	WORD wDay;
+	WORD wHour;
+	WORD wMinute;
+	WORD wSecond;
+	WORD wMilliseconds;
+} SYSTEMTIME;
+
+typedef struct _SYSTEM_INFO
+{
+	DWORD     dwPageSize;
+	DWORD_PTR dwActiveProcessorMask;
+	DWORD     dwNumberOfProcessors;
+} SYSTEM_INFO;
+
+typedef enum _LOGICAL_PROCESSOR_RELATIONSHIP
+{
+	RelationProcessorCore = 0,
+	RelationNumaNode = 1,
+	RelationCache = 2,
+	RelationProcessorPackage = 3
+} LOGICAL_PROCESSOR_RELATIONSHIP;
+
+typedef struct _SYSTEM_LOGICAL_PROCESSOR_INFORMATION
+{
+	ULONG_PTR                      ProcessorMask;
+	LOGICAL_PROCESSOR_RELATIONSHIP Relationship;
+	struct
+	{
+		BYTE Flags;
+	} ProcessorCore;
+} SYSTEM_LOGICAL_PROCESSOR_INFORMATION;
+
+
+//MSVC runtime
+#define _stricmp    strcasecmp
+#define _strnicmp   strncasecmp
+#define _atoi64     atoll
+
+//MSVC returns -1 on truncation, callers rely on that to grow their buffers
+inline int _vsnprintf(char *s_buf, size_t n_size, const char *s_fmt, va_list args)
+{
+	int iRet = vsnprintf(s_buf, n_size, s_fmt, args);
+	if ((iRet < 0) || ((size_t)iRet >= n_size))
+		return -1;
+
+	return iRet;
+}
+
+inline int _snprintf(char *s_buf, size_t n_size, const char *s_fmt, ...)
+{
+	va_list args;
+	va_start(args, s_fmt);
+	int iRet = _vsnprintf(s_buf, n_size, s_fmt, args);
+	va_end(args);
+	return iRet;
+}
+
+inline void* _aligned_malloc(size_t n_size, size_t n_alignment)
+{
+	void *p = NULL;
+	if (posix_memalign(&p, (n_alignment < sizeof(void*)) ? sizeof(void*) : n_alignment, n_size) != 0)
+		return NULL;
+
+	return p;
+}
+
+inline void _aligned_free(void *p)
+{
+	free(p);
+}
+
+
+//Errors, modules
+static string g_sLastDLError = "";
+
+inline DWORD GetLastError()
+{
+	return (DWORD)errno;
+}
+
+inline void SetLastError(DWORD dw_error)
+{
+	errno = (int)dw_error;
+}
+
+inline HMODULE LoadLibrary(const char *s_library)
+{
+	string sLibrary = s_library;
+	string sLC = sLibrary;
+	transform(sLC.begin(), sLC.end(), sLC.begin(), ::tolower);
+	if ((sLC == "avisynth") || (sLC == "avisynth.dll"))
+		sLibrary = "libavisynth.so";
+
+	void *hLib = dlopen(sLibrary.c_str(), RTLD_NOW | RTLD_GLOBAL);
+	if (hLib == NULL)
+	{
+		const char *pszError = dlerror();
+		g_sLastDLError = pszError ? pszError : "";
+		errno = ENOENT;
+	}
+	else
+		g_sLastDLError = "";
+
+	return (HMODULE)hLib;
+}
+
+inline void* GetProcAddress(HMODULE h_module, const char *s_name)
+{
+	return dlsym(h_module, s_name);
+}
+
+inline BOOL FreeLibrary(HMODULE h_module)
+{
+	return (dlclose(h_module) == 0) ? TRUE : FALSE;
+}
+
+inline DWORD GetModuleFileName(HMODULE h_module, char *s_buf, DWORD dw_size)
+{
+	if ((s_buf == NULL) || (dw_size == 0))
+		return 0;
+
+	string sPath = "";
+	if (h_module == NULL)
+	{
+		char szExe[PATH_MAX + 1];
+		ssize_t nLen = readlink("/proc/self/exe", szExe, PATH_MAX);
+		if (nLen <= 0)
+			return 0;
+		szExe[nLen] = '\0';
+		sPath = szExe;
+	}
+	else
+	{
+		struct link_map *pMap = NULL;
+		if ((dlinfo(h_module, RTLD_DI_LINKMAP, &pMap) != 0) || (pMap == NULL) || (pMap->l_name == NULL) || (pMap->l_name[0] == '\0'))
+			return 0;
+		char szReal[PATH_MAX + 1];
+		sPath = realpath(pMap->l_name, szReal) ? szReal : pMap->l_name;
+	}
+
+	if (sPath.length() >= dw_size)
+		return 0;
+
+	memcpy(s_buf, sPath.c_str(), sPath.length() + 1);
+	return (DWORD)sPath.length();
+}
+
+inline UINT SetErrorMode(UINT)
+{
+	return 0;
+}
+
+
+//Timing
+inline void Sleep(DWORD dw_ms)
+{
+	struct timespec ts;
+	ts.tv_sec = dw_ms / 1000;
+	ts.tv_nsec = (long)(dw_ms % 1000) * 1000000L;
+	while ((nanosleep(&ts, &ts) == -1) && (errno == EINTR)) {}
+}
+
+inline DWORD GetTickCount()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (DWORD)((unsigned long long)ts.tv_sec * 1000ULL + (unsigned long long)ts.tv_nsec / 1000000ULL);
+}
+
+inline BOOL QueryPerformanceFrequency(LARGE_INTEGER *p_freq)
+{
+	p_freq->QuadPart = 1000000000LL;
+	return TRUE;
+}
+
+inline BOOL QueryPerformanceCounter(LARGE_INTEGER *p_count)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	p_count->QuadPart = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	return TRUE;
+}
+
+inline void GetLocalTime(SYSTEMTIME *p_st)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	struct tm tmLocal;
+	localtime_r(&tv.tv_sec, &tmLocal);
+	p_st->wYear = (WORD)(tmLocal.tm_year + 1900);
+	p_st->wMonth = (WORD)(tmLocal.tm_mon + 1);
+	p_st->wDayOfWeek = (WORD)tmLocal.tm_wday;
+	p_st->wDay = (WORD)tmLocal.tm_mday;
+	p_st->wHour = (WORD)tmLocal.tm_hour;
+	p_st->wMinute = (WORD)tmLocal.tm_min;
+	p_st->wSecond = (WORD)tmLocal.tm_sec;
+	p_st->wMilliseconds = (WORD)(tv.tv_usec / 1000);
+}
+
+
+//Events and threads share one waitable handle type
+struct stPosixHandle
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t  cond;
+	BOOL            bManualReset;
+	BOOL            bSignaled;
+	int             iRefs;
+	unsigned        (*pThreadProc)(void *);
+	void            *pThreadArg;
+};
+
+inline stPosixHandle* PosixHandleCreate(BOOL b_manualreset, BOOL b_signaled)
+{
+	stPosixHandle *h = new stPosixHandle;
+	pthread_mutex_init(&h->mutex, NULL);
+	pthread_cond_init(&h->cond, NULL);
+	h->bManualReset = b_manualreset;
+	h->bSignaled = b_signaled;
+	h->iRefs = 1;
+	h->pThreadProc = NULL;
+	h->pThreadArg = NULL;
+	return h;
+}
+
+inline void PosixHandleRelease(stPosixHandle *h)
+{
+	pthread_mutex_lock(&h->mutex);
+	int iRefs = --h->iRefs;
+	pthread_mutex_unlock(&h->mutex);
+	if (iRefs > 0)
+		return;
+
+	pthread_cond_destroy(&h->cond);
+	pthread_mutex_destroy(&h->mutex);
+	delete h;
+}
+
+inline HANDLE CreateEvent(void *, BOOL b_manualreset, BOOL b_initialstate, const char *)
+{
+	return (HANDLE)PosixHandleCreate(b_manualreset, b_initialstate);
+}
+
+inline BOOL SetEvent(HANDLE h_event)
+{
+	stPosixHandle *h = (stPosixHandle *)h_event;
+	pthread_mutex_lock(&h->mutex);
+	h->bSignaled = TRUE;
+	if (h->bManualReset)
+		pthread_cond_broadcast(&h->cond);
+	else
+		pthread_cond_signal(&h->cond);
+	pthread_mutex_unlock(&h->mutex);
+	return TRUE;
+}
+
+inline BOOL ResetEvent(HANDLE h_event)
+{
+	stPosixHandle *h = (stPosixHandle *)h_event;
+	pthread_mutex_lock(&h->mutex);
+	h->bSignaled = FALSE;
+	pthread_mutex_unlock(&h->mutex);
+	return TRUE;
+}
+
+inline DWORD WaitForSingleObject(HANDLE h_object, DWORD dw_ms)
+{
+	if ((h_object == NULL) || (h_object == INVALID_HANDLE_VALUE))
+		return WAIT_FAILED;
+
+	stPosixHandle *h = (stPosixHandle *)h_object;
+	struct timespec tsDeadline;
+	if (dw_ms != INFINITE)
+	{
+		clock_gettime(CLOCK_REALTIME, &tsDeadline);
+		tsDeadline.tv_sec += dw_ms / 1000;
+		tsDeadline.tv_nsec += (long)(dw_ms % 1000) * 1000000L;
+		if (tsDeadline.tv_nsec >= 1000000000L)
+		{
+			tsDeadline.tv_sec++;
+			tsDeadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	DWORD dwRet = WAIT_OBJECT_0;
+	pthread_mutex_lock(&h->mutex);
+	while (!h->bSignaled)
+	{
+		if (dw_ms == INFINITE)
+			pthread_cond_wait(&h->cond, &h->mutex);
+		else if ((dw_ms == 0) || (pthread_cond_timedwait(&h->cond, &h->mutex, &tsDeadline) == ETIMEDOUT))
+		{
+			if (!h->bSignaled)
+				dwRet = WAIT_TIMEOUT;
+			break;
+		}
+	}
+	if ((dwRet == WAIT_OBJECT_0) && !h->bManualReset)
+		h->bSignaled = FALSE;
+	pthread_mutex_unlock(&h->mutex);
+
+	return dwRet;
+}
+
+inline DWORD WaitForMultipleObjects(DWORD dw_count, const HANDLE *p_handles, BOOL b_waitall, DWORD dw_ms)
+{
+	DWORD dwStart = GetTickCount();
+	for (;;)
+	{
+		DWORD dwElapsed = GetTickCount() - dwStart;
+		DWORD dwLeft = (dw_ms == INFINITE) ? INFINITE : ((dwElapsed >= dw_ms) ? 0 : dw_ms - dwElapsed);
+
+		if (b_waitall)
+		{
+			for (DWORD i = 0; i < dw_count; i++)
+			{
+				if (WaitForSingleObject(p_handles[i], dwLeft) != WAIT_OBJECT_0)
+					return WAIT_TIMEOUT;
+			}
+			return WAIT_OBJECT_0;
+		}
+
+		for (DWORD i = 0; i < dw_count; i++)
+		{
+			if (WaitForSingleObject(p_handles[i], 0) == WAIT_OBJECT_0)
+				return WAIT_OBJECT_0 + i;
+		}
+
+		if (dwLeft == 0)
+			return WAIT_TIMEOUT;
+
+		Sleep(1);
+	}
+}
+
+inline BOOL CloseHandle(HANDLE h_object)
+{
+	if ((h_object == NULL) || (h_object == INVALID_HANDLE_VALUE))
+		return FALSE;
+
+	PosixHandleRelease((stPosixHandle *)h_object);
+	return TRUE;
+}
+
+inline void* PosixThreadStart(void *p_handle)
+{
+	stPosixHandle *h = (stPosixHandle *)p_handle;
+	h->pThreadProc(h->pThreadArg);
+
+	pthread_mutex_lock(&h->mutex);
+	h->bSignaled = TRUE;
+	pthread_cond_broadcast(&h->cond);
+	pthread_mutex_unlock(&h->mutex);
+
+	PosixHandleRelease(h);
+	return NULL;
+}
+
+//The handle is signaled (manual reset) when the thread returns
+inline uintptr_t _beginthreadex(void *, unsigned, unsigned (*p_proc)(void *), void *p_arg, unsigned, unsigned *)
+{
+	stPosixHandle *h = PosixHandleCreate(TRUE, FALSE);
+	h->pThreadProc = p_proc;
+	h->pThreadArg = p_arg;
+	h->iRefs = 2;
+
+	pthread_t thread;
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	int iRet = pthread_create(&thread, &attr, PosixThreadStart, h);
+	pthread_attr_destroy(&attr);
+
+	if (iRet != 0)
+	{
+		h->iRefs = 1;
+		PosixHandleRelease(h);
+		return 0;
+	}
+
+	return (uintptr_t)h;
+}
+
+
+//Critical sections, interlocked
+typedef pthread_mutex_t CRITICAL_SECTION;
+
+inline void InitializeCriticalSection(CRITICAL_SECTION *p_cs)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(p_cs, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+inline void DeleteCriticalSection(CRITICAL_SECTION *p_cs)
+{
+	pthread_mutex_destroy(p_cs);
+}
+
+inline void EnterCriticalSection(CRITICAL_SECTION *p_cs)
+{
+	pthread_mutex_lock(p_cs);
+}
+
+inline void LeaveCriticalSection(CRITICAL_SECTION *p_cs)
+{
+	pthread_mutex_unlock(p_cs);
+}
+
+inline LONG InterlockedIncrement(volatile LONG *p_value)
+{
+	return __sync_add_and_fetch(p_value, 1);
+}
+
+inline LONG InterlockedDecrement(volatile LONG *p_value)
+{
+	return __sync_sub_and_fetch(p_value, 1);
+}
+
+
+//Process, CPUs, affinity. Pseudo handles as on Windows.
+#define POSIX_CURRENT_PROCESS ((HANDLE)(intptr_t)-1)
+#define POSIX_CURRENT_THREAD  ((HANDLE)(intptr_t)-2)
+
+inline HANDLE GetCurrentProcess()
+{
+	return POSIX_CURRENT_PROCESS;
+}
+
+inline HANDLE GetCurrentThread()
+{
+	return POSIX_CURRENT_THREAD;
+}
+
+inline DWORD GetCurrentProcessId()
+{
+	return (DWORD)getpid();
+}
+
+inline DWORD GetCurrentThreadId()
+{
+	return (DWORD)syscall(SYS_gettid);
+}
+
+inline void GetSystemInfo(SYSTEM_INFO *p_si)
+{
+	memset(p_si, 0, sizeof(SYSTEM_INFO));
+	long lCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+	long lPage = sysconf(_SC_PAGESIZE);
+	p_si->dwNumberOfProcessors = (lCPUs > 0) ? (DWORD)lCPUs : 1;
+	p_si->dwPageSize = (lPage > 0) ? (DWORD)lPage : 4096;
+	for (DWORD i = 0; (i < p_si->dwNumberOfProcessors) && (i < sizeof(DWORD_PTR) * 8); i++)
+		p_si->dwActiveProcessorMask |= ((DWORD_PTR)1 << i);
+}
+
+inline DWORD_PTR CPUSetToMask(const cpu_set_t &cpuset)
+{
+	DWORD_PTR dwpMask = 0;
+	for (unsigned int i = 0; i < sizeof(DWORD_PTR) * 8; i++)
+	{
+		if (CPU_ISSET(i, &cpuset))
+			dwpMask |= ((DWORD_PTR)1 << i);
+	}
+
+	return dwpMask;
+}
+
+inline void MaskToCPUSet(DWORD_PTR dwp_mask, cpu_set_t &cpuset)
+{
+	CPU_ZERO(&cpuset);
+	for (unsigned int i = 0; i < sizeof(DWORD_PTR) * 8; i++)
+	{
+		if (dwp_mask & ((DWORD_PTR)1 << i))
+			CPU_SET(i, &cpuset);
+	}
+}
+
+//Only the calling thread, matching every use with GetCurrentThread()
+inline DWORD_PTR SetThreadAffinityMask(HANDLE, DWORD_PTR dwp_mask)
+{
+	cpu_set_t cpuset;
+	if (sched_getaffinity(0, sizeof(cpuset), &cpuset) != 0)
+		return 0;
+	DWORD_PTR dwpOld = CPUSetToMask(cpuset);
+
+	MaskToCPUSet(dwp_mask, cpuset);
+	if (sched_setaffinity(0, sizeof(cpuset), &cpuset) != 0)
+		return 0;
+
+	return dwpOld;
+}
+
+inline BOOL GetProcessAffinityMask(HANDLE, DWORD_PTR *p_processmask, DWORD_PTR *p_systemmask)
+{
+	cpu_set_t cpuset;
+	if (sched_getaffinity(getpid(), sizeof(cpuset), &cpuset) != 0)
+		return FALSE;
+
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	*p_processmask = CPUSetToMask(cpuset);
+	*p_systemmask = si.dwActiveProcessorMask;
+	return TRUE;
+}
+
+//Linux affinity is per thread, so apply the mask to every thread of the process
+inline BOOL SetProcessAffinityMask(HANDLE, DWORD_PTR dwp_mask)
+{
+	cpu_set_t cpuset;
+	MaskToCPUSet(dwp_mask, cpuset);
+
+	BOOL bRet = FALSE;
+	DIR *pDir = opendir("/proc/self/task");
+	if (pDir == NULL)
+		return (sched_setaffinity(0, sizeof(cpuset), &cpuset) == 0) ? TRUE : FALSE;
+
+	struct dirent *pEntry = NULL;
+	while ((pEntry = readdir(pDir)) != NULL)
+	{
+		if (pEntry->d_name[0] == '.')
+			continue;
+		pid_t tid = (pid_t)atoi(pEntry->d_name);
+		if (sched_setaffinity(tid, sizeof(cpuset), &cpuset) == 0)
+			bRet = TRUE;
+	}
+	closedir(pDir);
+
+	return bRet;
+}
+
+//Physical cores from the sysfs topology, one entry per core
+inline BOOL GetLogicalProcessorInformation(SYSTEM_LOGICAL_PROCESSOR_INFORMATION *p_buffer, DWORD *p_length)
+{
+	map<string, DWORD_PTR> mCores;
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+
+	for (unsigned int i = 0; (i < si.dwNumberOfProcessors) && (i < sizeof(DWORD_PTR) * 8); i++)
+	{
+		char szPath[256];
+		snprintf(szPath, sizeof(szPath), "/sys/devices/system/cpu/cpu%u/topology/core_id", i);
+		string sKey = "";
+		FILE *fp = fopen(szPath, "r");
+		if (fp)
+		{
+			int iCore = -1;
+			if (fscanf(fp, "%d", &iCore) == 1)
+				sKey = std::to_string(iCore);
+			fclose(fp);
+		}
+		snprintf(szPath, sizeof(szPath), "/sys/devices/system/cpu/cpu%u/topology/physical_package_id", i);
+		fp = fopen(szPath, "r");
+		if (fp)
+		{
+			int iPackage = -1;
+			if (fscanf(fp, "%d", &iPackage) == 1)
+				sKey = std::to_string(iPackage) + ":" + sKey;
+			fclose(fp);
+		}
+		if (sKey == "")
+			sKey = "cpu" + std::to_string(i);
+
+		mCores[sKey] |= ((DWORD_PTR)1 << i);
+	}
+
+	DWORD dwNeeded = (DWORD)(mCores.size() * sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if ((p_buffer == NULL) || (*p_length < dwNeeded))
+	{
+		*p_length = dwNeeded;
+		errno = ENOSPC;
+		return FALSE;
+	}
+
+	DWORD i = 0;
+	for (map<string, DWORD_PTR>::iterator it = mCores.begin(); it != mCores.end(); ++it, i++)
+	{
+		memset(&p_buffer[i], 0, sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+		p_buffer[i].ProcessorMask = it->second;
+		p_buffer[i].Relationship = RelationProcessorCore;
+		p_buffer[i].ProcessorCore.Flags = ((it->second & (it->second - 1)) != 0) ? 1 : 0;
+	}
+	*p_length = dwNeeded;
+
+	return TRUE;
+}
+
+//100ns units, as FILETIME
+inline void UInt64ToFileTime(unsigned long long ull_value, FILETIME *p_ft)
+{
+	p_ft->dwLowDateTime = (DWORD)(ull_value & 0xFFFFFFFF);
+	p_ft->dwHighDateTime = (DWORD)(ull_value >> 32);
+}
+
+inline BOOL GetProcessTimes(HANDLE, FILETIME *p_creation, FILETIME *p_exit, FILETIME *p_kernel, FILETIME *p_user)
+{
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return FALSE;
+
+	UInt64ToFileTime(0, p_creation);
+	UInt64ToFileTime(0, p_exit);
+	UInt64ToFileTime((unsigned long long)ru.ru_stime.tv_sec * 10000000ULL + (unsigned long long)ru.ru_stime.tv_usec * 10ULL, p_kernel);
+	UInt64ToFileTime((unsigned long long)ru.ru_utime.tv_sec * 10000000ULL + (unsigned long long)ru.ru_utime.tv_usec * 10ULL, p_user);
+	return TRUE;
+}
+
+inline BOOL SetPriorityClass(HANDLE, DWORD dw_class)
+{
+	int iNice = 0;
+	if (dw_class == IDLE_PRIORITY_CLASS)
+		iNice = 19;
+	else if (dw_class == HIGH_PRIORITY_CLASS)
+		iNice = -10;  //needs CAP_SYS_NICE, silently stays at 0 otherwise
+
+	return (setpriority(PRIO_PROCESS, 0, iNice) == 0) ? TRUE : FALSE;
+}
+
+//Single instance lock, held until the process exits
+inline HANDLE CreateMutex(void *, BOOL, const char *s_name)
+{
+	string sLock = string("/tmp/") + s_name + ".lock";
+	int fd = open(sLock.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+	if (fd < 0)
+		return NULL;
+
+	if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+	{
+		close(fd);
+		errno = EEXIST;
+		return NULL;
+	}
+
+	errno = 0;
+	return (HANDLE)(intptr_t)fd;
+}
+
+
+//Files
+inline DWORD GetFileAttributes(const char *s_path)
+{
+	struct stat st;
+	if (stat(s_path, &st) != 0)
+		return INVALID_FILE_ATTRIBUTES;
+
+	return S_ISDIR(st.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+}
+
+inline DWORD GetFullPathName(const char *s_path, DWORD dw_size, char *s_buf, char **p_filepart)
+{
+	string sPath = s_path;
+	if ((sPath == "") || (sPath[0] != '/'))
+	{
+		char szCwd[PATH_MAX + 1];
+		if (getcwd(szCwd, PATH_MAX) == NULL)
+			return 0;
+		sPath = string(szCwd) + "/" + sPath;
+	}
+
+	char szReal[PATH_MAX + 1];
+	if (realpath(sPath.c_str(), szReal))
+		sPath = szReal;
+
+	if (sPath.length() >= dw_size)
+		return (DWORD)sPath.length() + 1;
+
+	memcpy(s_buf, sPath.c_str(), sPath.length() + 1);
+	if (p_filepart)
+	{
+		char *pSlash = strrchr(s_buf, '/');
+		*p_filepart = pSlash ? pSlash + 1 : s_buf;
+	}
+
+	return (DWORD)sPath.length();
+}
+
+inline DWORD GetCurrentDirectory(DWORD dw_size, char *s_buf)
+{
+	if (getcwd(s_buf, dw_size) == NULL)
+		return 0;
+
+	return (DWORD)strlen(s_buf);
+}
+
+
+//Console
+inline HWND GetConsoleWindow()
+{
+	return NULL;
+}
+
+inline int MessageBox(HWND, const char *s_text, const char *s_caption, UINT)
+{
+	string sText = s_text;
+	sText.erase(remove(sText.begin(), sText.end(), '\r'), sText.end());
+	fprintf(stderr, "\n%s: %s\n", s_caption, sText.c_str());
+	return 1;
+}
+
+static struct termios g_tiSaved;
+static BOOL g_bRawTerminal = FALSE;
+
+inline void PosixRestoreTerminal()
+{
+	if (g_bRawTerminal)
+	{
+		tcsetattr(STDIN_FILENO, TCSANOW, &g_tiSaved);
+		g_bRawTerminal = FALSE;
+	}
+}
+
+//Non-canonical, no echo, so single key presses can be polled as with conio.h
+inline void PosixRawTerminal()
+{
+	if (g_bRawTerminal || !isatty(STDIN_FILENO))
+		return;
+
+	if (tcgetattr(STDIN_FILENO, &g_tiSaved) != 0)
+		return;
+
+	struct termios ti = g_tiSaved;
+	ti.c_lflag &= ~(ICANON | ECHO);
+	ti.c_cc[VMIN] = 1;
+	ti.c_cc[VTIME] = 0;
+	if (tcsetattr(STDIN_FILENO, TCSANOW, &ti) == 0)
+	{
+		g_bRawTerminal = TRUE;
+		atexit(PosixRestoreTerminal);
+	}
+}
+
+inline int _kbhit()
+{
+	PosixRawTerminal();
+
+	fd_set fdsRead;
+	FD_ZERO(&fdsRead);
+	FD_SET(STDIN_FILENO, &fdsRead);
+	struct timeval tv;
+	tv.tv_sec = 0;
+	tv.tv_usec = 0;
+
+	return (select(STDIN_FILENO + 1, &fdsRead, NULL, NULL, &tv) > 0) ? 1 : 0;
+}
+
+//File dialogs become a console prompt, an empty answer keeps the suggested name
+#define OFN_HIDEREADONLY     0x00000004
+#define OFN_OVERWRITEPROMPT  0x00000002
+#define OFN_EXPLORER         0x00080000
+
+typedef struct tagOFN
+{
+	DWORD       lStructSize;
+	HWND        hwndOwner;
+	HINSTANCE   hInstance;
+	LPCSTR      lpstrFilter;
+	LPSTR       lpstrCustomFilter;
+	DWORD       nMaxCustFilter;
+	DWORD       nFilterIndex;
+	LPSTR       lpstrFile;
+	DWORD       nMaxFile;
+	LPSTR       lpstrFileTitle;
+	DWORD       nMaxFileTitle;
+	LPCSTR      lpstrInitialDir;
+	LPCSTR      lpstrTitle;
+	DWORD       Flags;
+	WORD        nFileOffset;
+	WORD        nFileExtension;
+	LPCSTR      lpstrDefExt;
+	intptr_t    lCustData;
+	void        *lpfnHook;
+	LPCSTR      lpTemplateName;
+} OPENFILENAME;
+
+inline BOOL GetOpenFileName(OPENFILENAME *p_ofn)
+{
+	PosixRestoreTerminal();
+	if (!isatty(STDIN_FILENO))
+		return FALSE;
+
+	if (p_ofn->lpstrFile[0] != '\0')
+		fprintf(stderr, "\n%s [%s]: ", p_ofn->lpstrTitle, p_ofn->lpstrFile);
+	else
+		fprintf(stderr, "\n%s: ", p_ofn->lpstrTitle);
+	fflush(stderr);
+
+	char szLine[MAX_PATH + 1];
+	if (fgets(szLine, sizeof(szLine), stdin) == NULL)
+		return FALSE;
+
+	szLine[strcspn(szLine, "\r\n")] = '\0';
+	if (szLine[0] != '\0')
+	{
+		if (strlen(szLine) >= p_ofn->nMaxFile)
+			return FALSE;
+		memcpy(p_ofn->lpstrFile, szLine, strlen(szLine) + 1);
+	}
+
+	return (p_ofn->lpstrFile[0] != '\0') ? TRUE : FALSE;
+}
+
+inline BOOL GetSaveFileName(OPENFILENAME *p_ofn)
+{
+	return GetOpenFileName(p_ofn);
+}
+
+inline int _getch()
+{
+	PosixRawTerminal();
+
+	//EOF counts as a key, so "press any key" loops end when stdin is closed
+	unsigned char c = 0;
+	if (read(STDIN_FILENO, &c, 1) != 1)
+		return EOF;
+
+	return (int)c;
+}
+
+
+#endif //_POSIX_H
@@ -0,0 +1,201 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+	CEnergyInfo against the fake powercap trees in tests/data/powercap.
+	Usage: EnergyInfoTest <fixture directory> <work directory>
+	The zone directories are stored as "intel-rapl_N_M" so that the tree can
+	be checked out on Windows, each tree is copied to the work directory with
+	the sysfs names restored and energy_uj is rewritten there between Update()
+	calls. "rapl" has a package counter about to wrap and a DRAM zone, "nodram"
+	has none.
+*/
+
+#include "common.h"
+#include "Utility.h"
+#include "EnergyInfo.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+
+
+static BOOL CopyFixtureFile(const string &s_from, const string &s_to)
+{
+	ifstream ifFile(s_from.c_str(), std::ios::binary);
+	if (!ifFile.is_open())
+		return FALSE;
+
+	ofstream ofFile(s_to.c_str(), std::ios::binary | std::ios::trunc);
+	if (!ofFile.is_open())
+		return FALSE;
+
+	ofFile << ifFile.rdbuf();
+
+	return ofFile.good() ? TRUE : FALSE;
+}
+
+
+static BOOL MakeDirectory(const string &s_dir)
+{
+	if ((mkdir(s_dir.c_str(), 0755) != 0) && (errno != EEXIST))
+		return FALSE;
+
+	return TRUE;
+}
+
+
+static BOOL CopyTree(const string &s_from, const string &s_to)
+{
+	if (!MakeDirectory(s_to))
+		return FALSE;
+
+	DIR *pDir = opendir(s_from.c_str());
+	if (!pDir)
+		return FALSE;
+
+	BOOL bRet = TRUE;
+	struct dirent *pEntry;
+	while ((pEntry = readdir(pDir)) != NULL)
+	{
+		string sZone(pEntry->d_name);
+		if ((sZone == ".") || (sZone == ".."))
+			continue;
+
+		string sSysName = sZone;
+		replace(sSysName.begin(), sSysName.end(), '_', ':');
+
+		string sFrom = s_from + PATH_SEPARATOR_STR + sZone;
+		string sTo = s_to + PATH_SEPARATOR_STR + sSysName;
+		if (!MakeDirectory(sTo)
+			|| !CopyFixtureFile(sFrom + "/name", sTo + "/name")
+			|| !CopyFixtureFile(sFrom + "/max_energy_range_uj", sTo + "/max_energy_range_uj")
+			|| !CopyFixtureFile(sFrom + "/energy_uj", sTo + "/energy_uj"))
+			bRet = FALSE;
+	}
+	closedir(pDir);
+
+	return bRet;
+}
+
+
+static BOOL WriteCounter(const string &s_root, const char *psz_zone, unsigned __int64 ui_value)
+{
+	string sFile = s_root + PATH_SEPARATOR_STR + psz_zone + "/energy_uj";
+	FILE *pFile = fopen(sFile.c_str(), "w");
+	if (!pFile)
+		return FALSE;
+
+	fprintf(pFile, "%llu\n", (unsigned long long)ui_value);
+	fclose(pFile);
+
+	return TRUE;
+}
+
+
+static BOOL Near(double d_value, double d_expected)
+{
+	return (fabs(d_value - d_expected) < 1.0e-5) ? TRUE : FALSE;
+}
+
+
+static unsigned int Check(BOOL b_ok, const char *psz_tree, const char *psz_what, const string &s_detail)
+{
+	if (b_ok)
+		return 0;
+
+	printf("FAIL %s: %s %s\n", psz_tree, psz_what, s_detail.c_str());
+
+	return 1;
+}
+
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		printf("Usage: EnergyInfoTest <fixture directory> <work directory>\n");
+		return 2;
+	}
+
+	unsigned int uiFailed = 0;
+	CUtils utils;
+	string sFixtures = argv[1];
+	string sWork = argv[2];
+	CEnergyInfo energyinfo;
+
+	if (!MakeDirectory(sWork))
+	{
+		printf("FAIL cannot create %s\n", sWork.c_str());
+		return 1;
+	}
+
+	//package and DRAM, the package counter wraps at max_energy_range_uj, core and psys are not counted
+	string sRoot = sWork + PATH_SEPARATOR_STR + "rapl";
+	uiFailed += Check(CopyTree(sFixtures + PATH_SEPARATOR_STR + "rapl", sRoot), "rapl", "copy", sRoot);
+	uiFailed += Check(energyinfo.Init(sRoot), "rapl", "Init()", energyinfo.sError);
+	uiFailed += Check(energyinfo.bDRAM, "rapl", "DRAM domain", "");
+	uiFailed += Check(energyinfo.sDomains == "package-0, dram", "rapl", "domains", energyinfo.sDomains);
+
+	energyinfo.Update();
+	uiFailed += Check(Near(energyinfo.dPackageJoules, 0.0) && Near(energyinfo.dDRAMJoules, 0.0), "rapl", "unchanged counters",
+		utils.StrFormat("%.6f J, %.6f J", energyinfo.dPackageJoules, energyinfo.dDRAMJoules));
+
+	WriteCounter(sRoot, "intel-rapl:0", 500000);      //wrapped, 1000000 uJ to the limit
+	WriteCounter(sRoot, "intel-rapl:0:0", 7000000);
+	WriteCounter(sRoot, "intel-rapl:0:1", 3500000);
+	WriteCounter(sRoot, "intel-rapl:1", 99000000);
+	energyinfo.Update();
+	uiFailed += Check(Near(energyinfo.dPackageJoules, 1.5), "rapl", "package after wraparound", utils.StrFormat("%.6f J", energyinfo.dPackageJoules));
+	uiFailed += Check(Near(energyinfo.dDRAMJoules, 2.5), "rapl", "DRAM", utils.StrFormat("%.6f J", energyinfo.dDRAMJoules));
+
+	WriteCounter(sRoot, "intel-rapl:0", 1500000);
+	energyinfo.Update();
+	uiFailed += Check(Near(energyinfo.dPackageJoules, 2.5), "rapl", "package after wraparound, second sample", utils.StrFormat("%.6f J", energyinfo.dPackageJoules));
+	uiFailed += Check(Near(energyinfo.dDRAMJoules, 2.5), "rapl", "DRAM, second sample", utils.StrFormat("%.6f J", energyinfo.dDRAMJoules));
+	printf("%-26s package %.3f J, DRAM %.3f J\n", "rapl", energyinfo.dPackageJoules, energyinfo.dDRAMJoules);
+
+	//no DRAM zone, the package is still counted and DRAM stays at 0
+	sRoot = sWork + PATH_SEPARATOR_STR + "nodram";
+	uiFailed += Check(CopyTree(sFixtures + PATH_SEPARATOR_STR + "nodram", sRoot), "nodram", "copy", sRoot);
+	uiFailed += Check(energyinfo.Init(sRoot), "nodram", "Init()", energyinfo.sError);
+	uiFailed += Check(!energyinfo.bDRAM, "nodram", "DRAM domain", "");
+	uiFailed += Check(energyinfo.sDomains == "package-0", "nodram", "domains", energyinfo.sDomains);
+
+	WriteCounter(sRoot, "intel-rapl:0", 6000000);
+	WriteCounter(sRoot, "intel-rapl:0:1", 9000000);
+	energyinfo.Update();
+	uiFailed += Check(Near(energyinfo.dPackageJoules, 4.0), "nodram", "package", utils.StrFormat("%.6f J", energyinfo.dPackageJoules));
+	uiFailed += Check(Near(energyinfo.dDRAMJoules, 0.0), "nodram", "DRAM", utils.StrFormat("%.6f J", energyinfo.dDRAMJoules));
+	printf("%-26s package %.3f J, DRAM %.3f J\n", "nodram", energyinfo.dPackageJoules, energyinfo.dDRAMJoules);
+
+	//no powercap tree at all
+	sRoot = sWork + PATH_SEPARATOR_STR + "missing";
+	uiFailed += Check(!energyinfo.Init(sRoot), "missing", "Init()", "succeeded");
+	uiFailed += Check(energyinfo.sError != "", "missing", "error message", "");
+	printf("%-26s %s\n", "missing", energyinfo.sError.c_str());
+
+	if (uiFailed > 0)
+	{
+		printf("%u check(s) failed\n", uiFailed);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+
+	return 0;
+}
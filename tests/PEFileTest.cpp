@@ -0,0 +1,167 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+	CPEFile against the fixtures in tests/data/pe (make_fixtures.py).
+	Usage: PEFileTest <fixture directory>
+	Every fixture is copied to a buffer of its exact size and parsed with
+	Attach(), the valid ones are also cut at every length so a read past the
+	end shows up under a memory checker.
+*/
+
+#include "common.h"
+#include "PEFile.h"
+
+struct stPETestCase
+{
+	const char *pszFile;
+	BOOL       bParses;
+	WORD       wMachine;
+	BOOL       bPE32Plus;
+	BOOL       bExports;        //GetExportNames() result
+	const char *pszExports;     //joined with ','
+	BOOL       bImports;
+	const char *pszImports;
+};
+
+static const stPETestCase testcases[] =
+{
+	{"plugin32.dll",             TRUE,  PE_MACHINE_I386,  FALSE, TRUE,  "AvisynthPluginInit2,AvisynthPluginInit3", TRUE,  "KERNEL32.dll,avisynth.dll"},
+	{"plugin64.dll",             TRUE,  PE_MACHINE_AMD64, TRUE,  TRUE,  "AvisynthPluginInit3",                     TRUE,  "KERNEL32.dll,MSVCP140.dll,VCRUNTIME140.dll"},
+	{"exports_overflow.dll",     TRUE,  PE_MACHINE_I386,  FALSE, FALSE, "",                                        TRUE,  "KERNEL32.dll"},
+	{"imports_unterminated.dll", TRUE,  PE_MACHINE_AMD64, TRUE,  FALSE, "",                                        FALSE, ""},
+	{"truncated.dll",            FALSE, 0,                FALSE, FALSE, "",                                        FALSE, ""},
+	{"no_pe_header.dll",         FALSE, 0,                FALSE, FALSE, "",                                        FALSE, ""},
+	{"not_mz.dll",               FALSE, 0,                FALSE, FALSE, "",                                        FALSE, ""}
+};
+
+
+static BOOL ReadFixture(const string &s_file, vector<unsigned char> &v_data)
+{
+	ifstream ifFile(s_file.c_str(), std::ios::binary);
+	if (!ifFile.is_open())
+		return FALSE;
+
+	v_data.assign(std::istreambuf_iterator<char>(ifFile), std::istreambuf_iterator<char>());
+
+	return (v_data.size() > 0) ? TRUE : FALSE;
+}
+
+
+static string JoinNames(const vector<string> &v_names)
+{
+	string sJoined = "";
+	for (size_t i = 0; i < v_names.size(); i++)
+		sJoined += (i == 0) ? v_names[i] : "," + v_names[i];
+
+	return sJoined;
+}
+
+
+static unsigned int Check(BOOL b_ok, const char *psz_file, const char *psz_what, const string &s_detail)
+{
+	if (b_ok)
+		return 0;
+
+	printf("FAIL %s: %s %s\n", psz_file, psz_what, s_detail.c_str());
+
+	return 1;
+}
+
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: PEFileTest <fixture directory>\n");
+		return 2;
+	}
+
+	unsigned int uiFailed = 0;
+	vector<unsigned char> vData;
+	vector<string> vNames;
+	CPEFile pefile;
+
+	for (size_t i = 0; i < sizeof(testcases) / sizeof(testcases[0]); i++)
+	{
+		const stPETestCase &tc = testcases[i];
+		string sFile = string(argv[1]) + PATH_SEPARATOR_STR + tc.pszFile;
+		if (!ReadFixture(sFile, vData))
+		{
+			uiFailed += Check(FALSE, tc.pszFile, "cannot read", sFile);
+			continue;
+		}
+
+		unsigned char *pBuffer = new unsigned char[vData.size()];
+		memcpy(pBuffer, &vData[0], vData.size());
+
+		BOOL bParses = pefile.Attach(pBuffer, vData.size());
+		string sResult = bParses ? "parsed" : pefile.sError;
+		uiFailed += Check(bParses == tc.bParses, tc.pszFile, "Attach()", sResult);
+
+		if (bParses && tc.bParses)
+		{
+			uiFailed += Check(pefile.wMachine == tc.wMachine, tc.pszFile, "machine", "");
+			uiFailed += Check(pefile.bPE32Plus == tc.bPE32Plus, tc.pszFile, "PE32+", "");
+
+			BOOL bExports = pefile.GetExportNames(vNames);
+			uiFailed += Check(bExports == tc.bExports, tc.pszFile, "GetExportNames()", "");
+			if (bExports)
+				uiFailed += Check(JoinNames(vNames) == tc.pszExports, tc.pszFile, "exports", JoinNames(vNames));
+
+			BOOL bImports = pefile.GetImportNames(vNames);
+			uiFailed += Check(bImports == tc.bImports, tc.pszFile, "GetImportNames()", "");
+			if (bImports)
+				uiFailed += Check(JoinNames(vNames) == tc.pszImports, tc.pszFile, "imports", JoinNames(vNames));
+		}
+
+		//the same image cut short, nothing may be read beyond the buffer
+		if (tc.bParses)
+		{
+			for (size_t nSize = 1; nSize < vData.size(); nSize++)
+			{
+				unsigned char *pCut = new unsigned char[nSize];
+				memcpy(pCut, &vData[0], nSize);
+				if (pefile.Attach(pCut, nSize))
+				{
+					pefile.GetExportNames(vNames);
+					pefile.GetImportNames(vNames);
+				}
+				pefile.Close();
+				delete [] pCut;
+			}
+		}
+
+		//Open() maps the file instead
+		uiFailed += Check(pefile.Open(sFile) == tc.bParses, tc.pszFile, "Open()", pefile.sError);
+		pefile.Close();
+		delete [] pBuffer;
+
+		printf("%-26s %s\n", tc.pszFile, sResult.c_str());
+	}
+
+	if (uiFailed > 0)
+	{
+		printf("%u check(s) failed\n", uiFailed);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+
+	return 0;
+}
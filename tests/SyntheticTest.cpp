@@ -0,0 +1,340 @@
+/*
+	This file is part of AVSMeter, Copyright(C) Groucho2004.
+
+	AVSMeter is free software. You can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation, either
+	version 3 of the License, or any later version.
+
+	AVSMeter is distributed in the hope that it will be useful
+	but WITHOUT ANY WARRANTY and without the implied warranty
+	of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with AVSMeter. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+	CFrameServerSynthetic, CTraceReplay, CHistogram and CProcessSampler
+	without avisynth.
+	Usage: SyntheticTest <trace directory>
+	The trace directory holds synthetic.trace, the meter itself is run
+	against synthetic clips by the ctest targets in CMakeLists.txt.
+*/
+
+#include "common.h"
+#include "FrameServer.h"
+#include "TraceReplay.h"
+#include "Histogram.h"
+#include "ProcessSampler.h"
+
+const AVS_Linkage *AVS_linkage = 0;
+
+
+struct stClipTestCase
+{
+	const char *pszSpec;
+	int        iColorFamily;
+	int        iBitsPerComponent;
+	int        iSubSamplingW;
+	int        iSubSamplingH;
+	__int64    iFrameBytes;
+	int        iPlanes;
+};
+
+static const stClipTestCase cliptests[] =
+{
+	{"synthetic:64x48,frames=20",           CLIP_CF_YUV,   8,  1, 1, 64 * 48 * 3 / 2, 3},
+	{"synthetic:64x48,YV16,frames=20",      CLIP_CF_YUV,   8,  1, 0, 64 * 48 * 2,     3},
+	{"synthetic:64x48,YUV420P10,frames=20", CLIP_CF_YUV,   10, 1, 1, 64 * 48 * 3,     3},
+	{"synthetic:64x48,Y8,frames=20",        CLIP_CF_GRAY,  8,  0, 0, 64 * 48,         1},
+	{"synthetic:64x48,RGBPS,frames=20",     CLIP_CF_RGB,   32, 0, 0, 64 * 48 * 12,    3},
+	{"synthetic:30x48,RGB24,frames=20",     CLIP_CF_OTHER, 8,  0, 0, 92 * 48,         1}
+};
+
+
+static unsigned int Check(BOOL b_ok, const char *psz_what, const string &s_detail)
+{
+	if (b_ok)
+		return 0;
+
+	printf("FAIL %s %s\n", psz_what, s_detail.c_str());
+
+	return 1;
+}
+
+
+static BOOL SamePlanes(const stFramePlanes &first, const stFramePlanes &second)
+{
+	for (int iPlane = 0; iPlane < first.iPlanes; iPlane++)
+	{
+		for (int y = 0; y < first.iHeight[iPlane]; y++)
+		{
+			if (memcmp(first.pData[iPlane] + (size_t)first.iPitch[iPlane] * y, second.pData[iPlane] + (size_t)second.iPitch[iPlane] * y, first.iRowSize[iPlane]) != 0)
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+
+static unsigned int TestClipInfo()
+{
+	unsigned int uiFailed = 0;
+
+	for (size_t i = 0; i < sizeof(cliptests) / sizeof(cliptests[0]); i++)
+	{
+		const stClipTestCase &tc = cliptests[i];
+		string sSpec = tc.pszSpec;
+		CFrameServer *frameserver = CFrameServer::Create(sSpec, 6, FALSE);
+		uiFailed += Check(frameserver->sName == "Synthetic clip", tc.pszSpec, "Create() returned " + frameserver->sName);
+		uiFailed += Check(frameserver->Load(""), tc.pszSpec, frameserver->sError);
+
+		try
+		{
+			stClipInfo clipinfo;
+			stFramePlanes planes;
+			frameserver->CreateEnvironment();
+			frameserver->Import(sSpec);
+			frameserver->GetClipInfo(clipinfo);
+			uiFailed += Check(clipinfo.bHasVideo && !clipinfo.bHasAudio && (clipinfo.uiFrames == 20), tc.pszSpec, "clip info");
+			uiFailed += Check(clipinfo.iColorFamily == tc.iColorFamily, tc.pszSpec, "color family");
+			uiFailed += Check(clipinfo.iBitsPerComponent == tc.iBitsPerComponent, tc.pszSpec, "bits per component");
+			uiFailed += Check((clipinfo.iSubSamplingW == tc.iSubSamplingW) && (clipinfo.iSubSamplingH == tc.iSubSamplingH), tc.pszSpec, "subsampling");
+			uiFailed += Check(clipinfo.iFrameBytes == tc.iFrameBytes, tc.pszSpec, "frame size");
+
+			frameserver->GetFramePlanes(19, planes);
+			uiFailed += Check(planes.iPlanes == tc.iPlanes, tc.pszSpec, "plane count");
+		}
+		catch (AvisynthError err)
+		{
+			uiFailed += Check(FALSE, tc.pszSpec, (PCSTR)err.msg);
+		}
+
+		frameserver->Unload();
+		delete frameserver;
+	}
+
+	return uiFailed;
+}
+
+
+static unsigned int TestFrames()
+{
+	unsigned int uiFailed = 0;
+	string sSpec = "synthetic:96x64,YUV420P10,frames=10";
+	CFrameServer *frameserver = CFrameServer::Create(sSpec, 6, FALSE);
+	frameserver->Load("");
+
+	try
+	{
+		stFramePlanes planes[3];
+		frameserver->uiHeldFrames = 2;
+		frameserver->Import(sSpec);
+		frameserver->GetFramePlanes(3, planes[0]);
+		frameserver->GetFramePlanes(4, planes[1]);
+		frameserver->GetFramePlanes(3, planes[2]);
+		uiFailed += Check(SamePlanes(planes[0], planes[2]), "frames", "the same frame differs");
+		uiFailed += Check(!SamePlanes(planes[0], planes[1]), "frames", "different frames are equal");
+
+		//10 bit samples stay within their bit depth
+		BOOL bInRange = TRUE;
+		for (int y = 0; y < planes[1].iHeight[0]; y++)
+		{
+			const WORD *pRow = (const WORD *)(planes[1].pData[0] + (size_t)planes[1].iPitch[0] * y);
+			for (int x = 0; x < planes[1].iRowSize[0] / 2; x++)
+				bInRange = (pRow[x] < 1024) ? bInRange : FALSE;
+		}
+		uiFailed += Check(bInRange, "frames", "10 bit sample out of range");
+
+		//beyond the last frame like avisynth
+		frameserver->GetFramePlanes(9, planes[0]);
+		frameserver->GetFramePlanes(1000, planes[1]);
+		uiFailed += Check(SamePlanes(planes[0], planes[1]), "frames", "not clamped to the last frame");
+	}
+	catch (AvisynthError err)
+	{
+		uiFailed += Check(FALSE, "frames", (PCSTR)err.msg);
+	}
+
+	frameserver->Unload();
+	delete frameserver;
+
+	//errors are thrown like the ones of a script
+	string sInvalid = "synthetic:64x48,cost=nothing";
+	frameserver = CFrameServer::Create(sInvalid, 6, FALSE);
+	frameserver->Load("");
+	BOOL bThrown = FALSE;
+	try
+	{
+		frameserver->Import(sInvalid);
+	}
+	catch (AvisynthError err)
+	{
+		bThrown = (strstr((PCSTR)err.msg, "Unknown cost model") != NULL) ? TRUE : FALSE;
+	}
+	uiFailed += Check(bThrown, "invalid spec", "no AvisynthError");
+
+	frameserver->Unload();
+	delete frameserver;
+
+	return uiFailed;
+}
+
+
+static unsigned int TestReplay(const string &s_tracefile)
+{
+	unsigned int uiFailed = 0;
+
+	CFrameTrace trace;
+	if (!trace.Load(s_tracefile))
+		return Check(FALSE, "trace", trace.sError);
+
+	uiFailed += Check((trace.vRequests.size() == 24) && (trace.uiThreads == 2) && (trace.uiUniqueFrames == 13), "trace", "unexpected request, thread or frame count");
+
+	string sSpec = "synthetic:64x48,frames=13,ms=1";
+	CFrameServer *frameserver = CFrameServer::Create(sSpec, 6, FALSE);
+	frameserver->Load("");
+
+	try
+	{
+		frameserver->Import(sSpec);
+
+		for (int iThreads = 0; iThreads < 2; iThreads++)
+		{
+			CTraceReplay replay;
+			BOOL bRun = replay.Run(frameserver, trace, FALSE, (iThreads == 1) ? TRUE : FALSE);
+			uiFailed += Check(bRun, "replay", replay.sError);
+			uiFailed += Check(replay.uiWorkers == ((iThreads == 1) ? 2 : 1), "replay", "worker count");
+			uiFailed += Check(replay.vLatencyMS.size() == trace.vRequests.size(), "replay", "latency count");
+
+			//every request spins for 1 ms
+			CHistogram histogram;
+			for (size_t i = 0; i < replay.vLatencyMS.size(); i++)
+				histogram.Add(replay.vLatencyMS[i], 1);
+			uiFailed += Check(histogram.uiCount == trace.vRequests.size(), "replay", "histogram count");
+			uiFailed += Check(histogram.Percentile(50.0) >= 0.9, "replay", "median latency below the frame cost");
+		}
+	}
+	catch (AvisynthError err)
+	{
+		uiFailed += Check(FALSE, "replay", (PCSTR)err.msg);
+	}
+
+	frameserver->Unload();
+	delete frameserver;
+
+	return uiFailed;
+}
+
+
+static unsigned int TestHistogram()
+{
+	unsigned int uiFailed = 0;
+	CHistogram histogram;
+
+	uiFailed += Check(histogram.Percentile(50.0) == 0.0, "histogram", "empty histogram");
+
+	//90 frames at 10 ms, 10 at 100 ms, buckets are ~12% wide
+	histogram.Add(10.0, 90);
+	histogram.Add(100.0, 10);
+	double dP50 = histogram.Percentile(50.0);
+	double dP99 = histogram.Percentile(99.0);
+	uiFailed += Check((dP50 > 9.0) && (dP50 < 11.5), "histogram", "P50");
+	uiFailed += Check((dP99 > 90.0) && (dP99 < 115.0), "histogram", "P99");
+
+	//below the first and beyond the last bucket
+	histogram.Reset();
+	histogram.Add(0.001, 1);
+	histogram.Add(1.0e9, 1);
+	uiFailed += Check(histogram.Percentile(1.0) == HISTOGRAM_MIN_MS, "histogram", "underflow");
+	uiFailed += Check(histogram.Percentile(100.0) >= HISTOGRAM_MIN_MS * pow(10.0, (double)HISTOGRAM_DECADES), "histogram", "overflow");
+
+	return uiFailed;
+}
+
+
+static unsigned int TestSampler()
+{
+	unsigned int uiFailed = 0;
+
+	CProcessSampler *pSampler = CProcessSampler::Create();
+	if (pSampler == NULL)
+		return Check(FALSE, "sampler", "Create() failed");
+
+	//the render threads of the clip have to show up as busy threads of this process
+	string sSpec = "synthetic:64x48,frames=1000,ms=4,threads=4";
+	CFrameServer *frameserver = CFrameServer::Create(sSpec, 6, FALSE);
+	frameserver->Load("");
+
+	try
+	{
+		stProcessSample first;
+		stProcessSample second;
+		frameserver->Import(sSpec);
+		uiFailed += Check(pSampler->Sample(first), "sampler", "first sample");
+
+		for (unsigned int uiFrame = 0; uiFrame < 50; uiFrame++)
+			frameserver->GetFrame(uiFrame);
+
+		uiFailed += Check(pSampler->Sample(second), "sampler", "second sample");
+		uiFailed += Check(second.wThreadCount >= 4, "sampler", "thread count");
+		uiFailed += Check(second.vThreads.size() >= 4, "sampler", "per thread times");
+		uiFailed += Check(second.uiWorkingSet > 0, "sampler", "working set");
+
+		//50 frames of 4 ms spread over 4 strips, at least 1 ms of CPU time per frame even on a single core, 100ns units
+		unsigned __int64 uiCPUTime = second.uiProcessCPUTime - first.uiProcessCPUTime;
+		uiFailed += Check(uiCPUTime >= 500000, "sampler", "process CPU time below the rendering time");
+		uiFailed += Check(second.uiSystemCPUTime > first.uiSystemCPUTime, "sampler", "system CPU time");
+
+		unsigned int uiBusyThreads = 0;
+		for (size_t i = 0; i < second.vThreads.size(); i++)
+		{
+			if (second.vThreads[i].uiCPUTime >= 10000)
+				++uiBusyThreads;
+		}
+		uiFailed += Check(uiBusyThreads >= 4, "sampler", "busy threads");
+	}
+	catch (AvisynthError err)
+	{
+		uiFailed += Check(FALSE, "sampler", (PCSTR)err.msg);
+	}
+
+	frameserver->Unload();
+	delete frameserver;
+
+	pSampler->Close();
+	delete pSampler;
+
+	return uiFailed;
+}
+
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: SyntheticTest <trace directory>\n");
+		return 2;
+	}
+
+	unsigned int uiFailed = 0;
+	uiFailed += TestClipInfo();
+	uiFailed += TestFrames();
+	uiFailed += TestReplay(string(argv[1]) + PATH_SEPARATOR_STR + "synthetic.trace");
+	uiFailed += TestHistogram();
+	uiFailed += TestSampler();
+
+	if (uiFailed > 0)
+	{
+		printf("%u check(s) failed\n", uiFailed);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+
+	return 0;
+}
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+#
+# Writes the PE fixtures for PEFileTest. Minimal DLL images: headers, one
+# section holding the export directory, its name table and the import
+# descriptors. Nothing in them is executable.
+#
+
+import os
+import struct
+
+SECTION_RVA = 0x1000
+SECTION_RAW = 0x200
+SECTION_SIZE = 0x200
+
+
+def image(pe32plus, exports, imports, number_of_names=None, import_terminator=True):
+	section = bytearray(SECTION_SIZE)
+	strings = 0x180
+
+	def put_string(s):
+		nonlocal strings
+		rva = SECTION_RVA + strings
+		data = s.encode("ascii") + b"\0"
+		section[strings:strings + len(data)] = data
+		strings += len(data)
+		return rva
+
+	# export directory at +0x000, name pointers at +0x040
+	export_rva = 0
+	if exports:
+		export_rva = SECTION_RVA
+		names = [put_string(name) for name in exports]
+		struct.pack_into("<I", section, 12, put_string("fixture.dll"))
+		struct.pack_into("<I", section, 24, len(names) if number_of_names is None else number_of_names)
+		struct.pack_into("<I", section, 32, SECTION_RVA + 0x40)
+		for i, rva in enumerate(names):
+			struct.pack_into("<I", section, 0x40 + i * 4, rva)
+
+	# import descriptors at +0x080, 20 bytes each, all zero terminator
+	import_rva = 0
+	if imports:
+		import_rva = SECTION_RVA + 0x80
+		for i, name in enumerate(imports):
+			struct.pack_into("<I", section, 0x80 + i * 20 + 12, put_string(name))
+		if not import_terminator:
+			# fill every descriptor up to the end of the section so there is no terminator
+			for offset in range(0x80, SECTION_SIZE - 19, 20):
+				if section[offset + 12:offset + 16] == b"\0\0\0\0":
+					struct.pack_into("<I", section, offset + 12, SECTION_RVA + 0x180)
+			section[0x180:SECTION_SIZE] = b"A" * (SECTION_SIZE - 0x180)
+
+	optional_size = 240 if pe32plus else 224
+	headers = bytearray(SECTION_RAW)
+	headers[0:2] = b"MZ"
+	struct.pack_into("<I", headers, 0x3C, 0x40)
+	headers[0x40:0x44] = b"PE\0\0"
+	struct.pack_into("<HHIIIHH", headers, 0x44, 0x8664 if pe32plus else 0x014C, 1, 0, 0, 0, optional_size, 0x2102)
+
+	optional = 0x58
+	struct.pack_into("<H", headers, optional, 0x20B if pe32plus else 0x10B)
+	struct.pack_into("<I", headers, optional + 60, SECTION_RAW)
+	directories = optional + (112 if pe32plus else 96)
+	struct.pack_into("<I", headers, directories - 4, 16)
+	struct.pack_into("<II", headers, directories, export_rva, 0x80 if exports else 0)
+	struct.pack_into("<II", headers, directories + 8, import_rva, 0x40 if imports else 0)
+
+	table = optional + optional_size
+	headers[table:table + 8] = b".rdata\0\0"
+	struct.pack_into("<IIII", headers, table + 8, SECTION_SIZE, SECTION_RVA, SECTION_SIZE, SECTION_RAW)
+
+	return bytes(headers) + bytes(section)
+
+
+def write(name, data):
+	with open(os.path.join(os.path.dirname(os.path.abspath(__file__)), name), "wb") as f:
+		f.write(data)
+
+
+plugin32 = image(False, ["AvisynthPluginInit2", "AvisynthPluginInit3"], ["KERNEL32.dll", "avisynth.dll"])
+plugin64 = image(True, ["AvisynthPluginInit3"], ["KERNEL32.dll", "MSVCP140.dll", "VCRUNTIME140.dll"])
+
+write("plugin32.dll", plugin32)
+write("plugin64.dll", plugin64)
+write("truncated.dll", plugin64[:0x150])
+write("exports_overflow.dll", image(False, ["AvisynthPluginInit3"], ["KERNEL32.dll"], number_of_names=0x40000001))
+write("imports_unterminated.dll", image(True, [], ["KERNEL32.dll"], import_terminator=False))
+write("no_pe_header.dll", b"MZ" + b"\0" * 0x3A + struct.pack("<I", 0xFFFFFFF0) + b"\0" * 0x40)
+write("not_mz.dll", b"\x7fELF" + b"\0" * 60)